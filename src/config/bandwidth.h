@@ -0,0 +1,19 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <cstdint>
+
+namespace syncspirit::config {
+
+/* limits are in KiB/s, zero means no limit */
+struct bandwidth_config_t {
+    std::uint32_t upload_limit;
+    std::uint32_t download_limit;
+    std::uint32_t peer_upload_limit;
+    std::uint32_t peer_download_limit;
+    bool limit_lan;
+};
+
+} // namespace syncspirit::config
@@ -16,6 +16,12 @@ struct bep_config_t {
     std::uint32_t rx_timeout;
     std::uint32_t blocks_max_requested;
     std::uint32_t blocks_simultaneous_write;
+    std::uint32_t files_max_active;
+    std::uint32_t tx_control_quantum;
+    std::uint32_t tx_index_quantum;
+    std::uint32_t tx_request_quantum;
+    std::uint32_t tx_response_quantum;
+    std::uint32_t peer_connections;
 };
 
 } // namespace syncspirit::config
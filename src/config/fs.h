@@ -9,6 +9,8 @@ namespace syncspirit::config {
 struct fs_config_t {
     std::uint32_t temporally_timeout;
     std::uint32_t mru_size;
+    std::uint32_t sync_batch_size;
+    std::uint32_t sync_batch_timeout;
 };
 
 } // namespace syncspirit::config
@@ -4,6 +4,7 @@
 #pragma once
 #include <cstdint>
 #include <map>
+#include "bandwidth.h"
 #include "bep.h"
 #include "db.h"
 #include "dialer.h"
@@ -33,10 +34,12 @@ struct main_t {
     fs_config_t fs_config;
     db_config_t db_config;
     relay_config_t relay_config;
+    bandwidth_config_t bandwidth_config;
 
     std::uint32_t timeout;
     std::string device_name;
     std::uint32_t hasher_threads;
+    std::uint32_t net_threads;
 };
 
 } // namespace syncspirit::config
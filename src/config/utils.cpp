@@ -79,6 +79,12 @@ config_result_t get_config(std::istream &config, const boost::filesystem::path &
             return "main/hasher_threads is incorrect or missing";
         }
         c.hasher_threads = hasher_threads.value();
+
+        auto net_threads = t["net_threads"].value<std::uint32_t>();
+        if (!net_threads) {
+            return "main/net_threads is incorrect or missing";
+        }
+        c.net_threads = net_threads.value();
     };
 
     // log
@@ -257,6 +263,42 @@ config_result_t get_config(std::istream &config, const boost::filesystem::path &
         c.rx_buff_size = rx_buff_size.value();
     };
 
+    // bandwidth
+    {
+        auto t = root_tbl["bandwidth"];
+        auto &c = cfg.bandwidth_config;
+
+        auto upload_limit = t["upload_limit"].value<std::uint32_t>();
+        if (!upload_limit) {
+            return "bandwidth/upload_limit is incorrect or missing";
+        }
+        c.upload_limit = upload_limit.value();
+
+        auto download_limit = t["download_limit"].value<std::uint32_t>();
+        if (!download_limit) {
+            return "bandwidth/download_limit is incorrect or missing";
+        }
+        c.download_limit = download_limit.value();
+
+        auto peer_upload_limit = t["peer_upload_limit"].value<std::uint32_t>();
+        if (!peer_upload_limit) {
+            return "bandwidth/peer_upload_limit is incorrect or missing";
+        }
+        c.peer_upload_limit = peer_upload_limit.value();
+
+        auto peer_download_limit = t["peer_download_limit"].value<std::uint32_t>();
+        if (!peer_download_limit) {
+            return "bandwidth/peer_download_limit is incorrect or missing";
+        }
+        c.peer_download_limit = peer_download_limit.value();
+
+        auto limit_lan = t["limit_lan"].value<bool>();
+        if (!limit_lan) {
+            return "bandwidth/limit_lan is incorrect or missing";
+        }
+        c.limit_lan = limit_lan.value();
+    };
+
     // bep
     {
         auto t = root_tbl["bep"];
@@ -308,6 +350,42 @@ config_result_t get_config(std::istream &config, const boost::filesystem::path &
             return "bep/blocks_simultaneous_write is incorrect or missing";
         }
         c.blocks_simultaneous_write = blocks_simultaneous_write.value();
+
+        auto files_max_active = t["files_max_active"].value<std::uint32_t>();
+        if (!files_max_active) {
+            return "bep/files_max_active is incorrect or missing";
+        }
+        c.files_max_active = files_max_active.value();
+
+        auto tx_control_quantum = t["tx_control_quantum"].value<std::uint32_t>();
+        if (!tx_control_quantum) {
+            return "bep/tx_control_quantum is incorrect or missing";
+        }
+        c.tx_control_quantum = tx_control_quantum.value();
+
+        auto tx_index_quantum = t["tx_index_quantum"].value<std::uint32_t>();
+        if (!tx_index_quantum) {
+            return "bep/tx_index_quantum is incorrect or missing";
+        }
+        c.tx_index_quantum = tx_index_quantum.value();
+
+        auto tx_request_quantum = t["tx_request_quantum"].value<std::uint32_t>();
+        if (!tx_request_quantum) {
+            return "bep/tx_request_quantum is incorrect or missing";
+        }
+        c.tx_request_quantum = tx_request_quantum.value();
+
+        auto tx_response_quantum = t["tx_response_quantum"].value<std::uint32_t>();
+        if (!tx_response_quantum) {
+            return "bep/tx_response_quantum is incorrect or missing";
+        }
+        c.tx_response_quantum = tx_response_quantum.value();
+
+        auto peer_connections = t["peer_connections"].value<std::uint32_t>();
+        if (!peer_connections || !peer_connections.value()) {
+            return "bep/peer_connections is incorrect or missing";
+        }
+        c.peer_connections = peer_connections.value();
     }
 
     // dialer
@@ -344,6 +422,18 @@ config_result_t get_config(std::istream &config, const boost::filesystem::path &
             return "fs/mru_size is incorrect or missing";
         }
         c.mru_size = mru_size.value();
+
+        auto sync_batch_size = t["sync_batch_size"].value<std::uint32_t>();
+        if (!sync_batch_size) {
+            return "fs/sync_batch_size is incorrect or missing";
+        }
+        c.sync_batch_size = sync_batch_size.value();
+
+        auto sync_batch_timeout = t["sync_batch_timeout"].value<std::uint32_t>();
+        if (!sync_batch_timeout) {
+            return "fs/sync_batch_timeout is incorrect or missing";
+        }
+        c.sync_batch_timeout = sync_batch_timeout.value();
     }
 
     // db
@@ -408,6 +498,7 @@ outcome::result<void> serialize(const main_t cfg, std::ostream &out) noexcept {
     auto tbl = toml::table{{
         {"main", toml::table{{
                      {"hasher_threads", cfg.hasher_threads},
+                     {"net_threads", cfg.net_threads},
                      {"timeout", cfg.timeout},
                      {"device_name", cfg.device_name},
                      {"default_location", cfg.default_location.c_str()},
@@ -443,6 +534,12 @@ outcome::result<void> serialize(const main_t cfg, std::ostream &out) noexcept {
                     {"rx_timeout", cfg.bep_config.rx_timeout},
                     {"blocks_max_requested", cfg.bep_config.blocks_max_requested},
                     {"blocks_simultaneous_write", cfg.bep_config.blocks_simultaneous_write},
+                    {"files_max_active", cfg.bep_config.files_max_active},
+                    {"tx_control_quantum", cfg.bep_config.tx_control_quantum},
+                    {"tx_index_quantum", cfg.bep_config.tx_index_quantum},
+                    {"tx_request_quantum", cfg.bep_config.tx_request_quantum},
+                    {"tx_response_quantum", cfg.bep_config.tx_response_quantum},
+                    {"peer_connections", cfg.bep_config.peer_connections},
                 }}},
         {"dialer", toml::table{{
                        {"enabled", cfg.dialer_config.enabled},
@@ -451,6 +548,8 @@ outcome::result<void> serialize(const main_t cfg, std::ostream &out) noexcept {
         {"fs", toml::table{{
                    {"temporally_timeout", cfg.fs_config.temporally_timeout},
                    {"mru_size", cfg.fs_config.mru_size},
+                   {"sync_batch_size", cfg.fs_config.sync_batch_size},
+                   {"sync_batch_timeout", cfg.fs_config.sync_batch_timeout},
                }}},
         {"db", toml::table{{
                    {"upper_limit", cfg.db_config.upper_limit},
@@ -461,6 +560,13 @@ outcome::result<void> serialize(const main_t cfg, std::ostream &out) noexcept {
                       {"discovery_url", cfg.relay_config.discovery_url},
                       {"rx_buff_size", cfg.relay_config.rx_buff_size},
                   }}},
+        {"bandwidth", toml::table{{
+                          {"upload_limit", cfg.bandwidth_config.upload_limit},
+                          {"download_limit", cfg.bandwidth_config.download_limit},
+                          {"peer_upload_limit", cfg.bandwidth_config.peer_upload_limit},
+                          {"peer_download_limit", cfg.bandwidth_config.peer_download_limit},
+                          {"limit_lan", cfg.bandwidth_config.limit_lan},
+                      }}},
     }};
     // clang-format on
     out << tbl;
@@ -507,6 +613,7 @@ outcome::result<main_t> generate_config(const boost::filesystem::path &config_pa
     cfg.timeout = 5000;
     cfg.device_name = device;
     cfg.hasher_threads = 3;
+    cfg.net_threads = 0;
     cfg.log_configs = {
         log_config_t {
             "default", spdlog::level::level_enum::info, {"stdout"}
@@ -543,6 +650,12 @@ outcome::result<main_t> generate_config(const boost::filesystem::path &config_pa
         300000,             /* rx_timeout */
         16,                 /* blocks_max_requested */
         32,                 /* blocks_simultaneous_write */
+        16,                 /* files_max_active */
+        64 * 1024,          /* tx_control_quantum */
+        256 * 1024,         /* tx_index_quantum */
+        64 * 1024,          /* tx_request_quantum */
+        1024 * 1024,        /* tx_response_quantum */
+        1,                  /* peer_connections */
     };
     cfg.dialer_config = dialer_config_t {
         true,       /* enabled */
@@ -551,6 +664,8 @@ outcome::result<main_t> generate_config(const boost::filesystem::path &config_pa
     cfg.fs_config = fs_config_t {
         86400000,   /* temporally_timeout, 24h default */
         128,        /* mru_size max number of open files for reading and writing */
+        64,         /* sync_batch_size max number of finished files synced at once */
+        100,        /* sync_batch_timeout max delay of finished files sync */
     };
     cfg.db_config = db_config_t {
         0x400000000,   /* upper_limit, 16Gb */
@@ -561,6 +676,13 @@ outcome::result<main_t> generate_config(const boost::filesystem::path &config_pa
         "https://relays.syncthing.net/endpoint",    /* discovery url */
         1024 * 1024,                                /* rx buff size */
     };
+    cfg.bandwidth_config = bandwidth_config_t {
+        0,      /* upload_limit */
+        0,      /* download_limit */
+        0,      /* peer_upload_limit */
+        0,      /* peer_download_limit */
+        false,  /* limit_lan */
+    };
     return cfg;
 }
 
@@ -10,6 +10,17 @@ namespace syncspirit::constants {
 static const constexpr std::uint32_t bep_magic = 0x2EA7D90B;
 static const constexpr std::uint32_t rescan_interval = 3600;
 static const constexpr std::int_fast32_t tx_blocks_max_factor = 3;
+static const constexpr std::uint32_t rx_blocks_max_window = 1024;
+static const constexpr std::uint32_t rx_request_min_timeout = 5000;
+static const constexpr std::uint32_t download_progress_interval = 2000;
+static const constexpr std::uint32_t bep_max_frame_size = 500 * 1024 * 1024;
+static const constexpr std::uint32_t tx_batch_max_size = 256 * 1024;
+static const constexpr std::uint32_t tx_coalesce_size = 16 * 1024;
+static const constexpr std::uint32_t dial_attempt_delay = 250;
+static const constexpr std::uint32_t dial_relay_delay = 1000;
+static const constexpr std::uint32_t tls_session_lifetime = 4 * 3600;
+static const constexpr std::uint32_t tls_session_cache_size = 1024;
+static const constexpr std::uint32_t index_chunk_weight = 16 * 1024;
 SYNCSPIRIT_API extern const char *client_name;
 SYNCSPIRIT_API extern const char *issuer_name;
 SYNCSPIRIT_API extern const char *protocol_name;
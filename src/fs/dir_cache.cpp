@@ -0,0 +1,296 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "dir_cache.h"
+#include "utils.h"
+#include <algorithm>
+#include <errno.h>
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32)
+#define SYNCSPIRIT_FS_AT_API
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace syncspirit::fs;
+
+static sys::error_code last_error() noexcept { return sys::error_code{errno, sys::system_category()}; }
+
+dir_cache_t::dir_cache_t(bfs::path root_, size_t max_handles_) noexcept
+    : root{std::move(root_)}, max_handles{std::max(max_handles_, size_t{1})} {
+    root.remove_trailing_separator();
+    root_str = root.string();
+}
+
+dir_cache_t::~dir_cache_t() {
+    while (!handles.empty()) {
+        close_handle(handles.begin());
+    }
+}
+
+bool dir_cache_t::is_managed(const bfs::path &path) const noexcept {
+#ifdef SYNCSPIRIT_FS_AT_API
+    auto &str = path.native();
+    if (str.size() < root_str.size() || str.compare(0, root_str.size(), root_str) != 0) {
+        return false;
+    }
+    return str.size() == root_str.size() || str[root_str.size()] == '/';
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void dir_cache_t::close_handle(handles_t::iterator it) noexcept {
+#ifdef SYNCSPIRIT_FS_AT_API
+    ::close(it->second);
+#endif
+    handles_map.erase(std::string_view(it->first));
+    handles.erase(it);
+}
+
+auto dir_cache_t::get_handle(const bfs::path &dir) noexcept -> outcome::result<int> {
+#ifdef SYNCSPIRIT_FS_AT_API
+    auto &key = dir.native();
+    auto it = handles_map.find(std::string_view(key));
+    if (it != handles_map.end()) {
+        handles.splice(handles.begin(), handles, it->second);
+        return it->second->second;
+    }
+
+    int fd = -1;
+    if (key.size() == root_str.size()) {
+        fd = ::open(key.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    } else {
+        auto parent = get_handle(dir.parent_path());
+        if (!parent) {
+            return parent.assume_error();
+        }
+        fd = ::openat(parent.assume_value(), dir.filename().c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    }
+    if (fd < 0) {
+        return last_error();
+    }
+
+    handles.emplace_front(key, fd);
+    handles_map[std::string_view(handles.front().first)] = handles.begin();
+    while (handles.size() > max_handles) {
+        close_handle(std::prev(handles.end()));
+    }
+    return fd;
+#else
+    (void)dir;
+    return sys::errc::make_error_code(sys::errc::not_supported);
+#endif
+}
+
+auto dir_cache_t::create_directories(const bfs::path &dir) noexcept -> outcome::result<void> {
+    auto key = dir.string();
+    if (known.count(key)) {
+        return outcome::success();
+    }
+
+    if (!is_managed(dir) || key.size() == root_str.size()) {
+        sys::error_code ec;
+        bfs::create_directories(dir, ec);
+        if (ec) {
+            return ec;
+        }
+        known.emplace(std::move(key));
+        return outcome::success();
+    }
+
+#ifdef SYNCSPIRIT_FS_AT_API
+    auto parent_path = dir.parent_path();
+    auto r = create_directories(parent_path);
+    if (!r) {
+        return r;
+    }
+    auto parent = get_handle(parent_path);
+    if (!parent) {
+        return parent.assume_error();
+    }
+    if (::mkdirat(parent.assume_value(), dir.filename().c_str(), 0777) && errno != EEXIST) {
+        return last_error();
+    }
+#endif
+    known.emplace(std::move(key));
+    return outcome::success();
+}
+
+auto dir_cache_t::open(const bfs::path &path, open_mode_t mode) noexcept -> outcome::result<FILE *> {
+    auto fmode = mode == open_mode_t::read ? "rb" : "r+b";
+    if (!is_managed(path)) {
+        auto path_str = path.string();
+        auto file = fopen(path_str.c_str(), fmode);
+        if (!file && mode == open_mode_t::write && errno == ENOENT) {
+            file = fopen(path_str.c_str(), "w+b");
+        }
+        if (!file) {
+            return last_error();
+        }
+        return file;
+    }
+
+#ifdef SYNCSPIRIT_FS_AT_API
+    auto parent_path = path.parent_path();
+    auto flags = (mode == open_mode_t::read ? O_RDONLY : O_RDWR | O_CREAT) | O_CLOEXEC;
+    auto try_open = [&]() -> outcome::result<int> {
+        auto parent = get_handle(parent_path);
+        if (!parent) {
+            return parent.assume_error();
+        }
+        auto fd = ::openat(parent.assume_value(), path.filename().c_str(), flags, 0666);
+        if (fd < 0) {
+            return last_error();
+        }
+        return fd;
+    };
+
+    auto fd_opt = try_open();
+    if (!fd_opt && fd_opt.assume_error().value() == ENOENT && mode == open_mode_t::write) {
+        /* some directory might be removed behind our back, re-create the chain */
+        forget_missing(parent_path);
+        auto r = create_directories(parent_path);
+        if (!r) {
+            return r.assume_error();
+        }
+        fd_opt = try_open();
+    }
+    if (!fd_opt) {
+        return fd_opt.assume_error();
+    }
+    auto fd = fd_opt.assume_value();
+    auto file = fdopen(fd, fmode);
+    if (!file) {
+        auto ec = last_error();
+        ::close(fd);
+        return ec;
+    }
+    return file;
+#else
+    return sys::errc::make_error_code(sys::errc::not_supported);
+#endif
+}
+
+auto dir_cache_t::rename(const bfs::path &from, const bfs::path &to) noexcept -> outcome::result<void> {
+    auto parent = from.parent_path();
+    if (!is_managed(from) || parent != to.parent_path()) {
+        sys::error_code ec;
+        bfs::rename(from, to, ec);
+        if (ec) {
+            return ec;
+        }
+        if (bfs::is_directory(to, ec)) {
+            forget(from);
+            forget(to);
+        }
+        return outcome::success();
+    }
+
+#ifdef SYNCSPIRIT_FS_AT_API
+    auto fd = get_handle(parent);
+    if (!fd) {
+        return fd.assume_error();
+    }
+    auto dir_fd = fd.assume_value();
+    auto to_name = to.filename();
+    if (::renameat(dir_fd, from.filename().c_str(), dir_fd, to_name.c_str())) {
+        return last_error();
+    }
+    /* cached handles of a renamed directory (and of its subdirs) now point to
+     * the new location, i.e. they are stale for both paths */
+    struct stat st;
+    if (!::fstatat(dir_fd, to_name.c_str(), &st, AT_SYMLINK_NOFOLLOW) && S_ISDIR(st.st_mode)) {
+        forget(from);
+        forget(to);
+    }
+#endif
+    return outcome::success();
+}
+
+auto dir_cache_t::set_modified(const bfs::path &path, std::time_t modified) noexcept -> outcome::result<void> {
+    if (!is_managed(path)) {
+        sys::error_code ec;
+        bfs::last_write_time(path, modified, ec);
+        if (ec) {
+            return ec;
+        }
+        return outcome::success();
+    }
+
+#ifdef SYNCSPIRIT_FS_AT_API
+    auto fd = get_handle(path.parent_path());
+    if (!fd) {
+        return fd.assume_error();
+    }
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = modified;
+    times[1].tv_nsec = 0;
+    if (::utimensat(fd.assume_value(), path.filename().c_str(), times, 0)) {
+        return last_error();
+    }
+#endif
+    return outcome::success();
+}
+
+auto dir_cache_t::sync(const bfs::path &dir) noexcept -> outcome::result<void> {
+    if (!is_managed(dir)) {
+        return sync_directory(dir);
+    }
+
+#ifdef SYNCSPIRIT_FS_AT_API
+    auto fd = get_handle(dir);
+    if (!fd) {
+        return fd.assume_error();
+    }
+    if (::fsync(fd.assume_value())) {
+        return last_error();
+    }
+#endif
+    return outcome::success();
+}
+
+void dir_cache_t::forget(const bfs::path &path) noexcept {
+    auto prefix = path.string();
+    auto matches = [&](const std::string &item) -> bool {
+        if (item.size() < prefix.size() || item.compare(0, prefix.size(), prefix) != 0) {
+            return false;
+        }
+        return item.size() == prefix.size() || item[prefix.size()] == '/' || item[prefix.size()] == '\\';
+    };
+
+    for (auto it = known.begin(); it != known.end();) {
+        if (matches(*it)) {
+            it = known.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (auto it = handles.begin(); it != handles.end();) {
+        auto next = std::next(it);
+        if (matches(it->first)) {
+            close_handle(it);
+        }
+        it = next;
+    }
+}
+
+void dir_cache_t::forget_missing(const bfs::path &dir) noexcept {
+    auto missing = bfs::path{};
+    for (auto path = dir; is_managed(path); path = path.parent_path()) {
+        sys::error_code ec;
+        if (bfs::is_directory(path, ec)) {
+            break;
+        }
+        missing = path;
+        if (path.native().size() == root_str.size()) {
+            break;
+        }
+    }
+    forget(missing.empty() ? dir : missing);
+}
@@ -0,0 +1,69 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <cstdio>
+#include <ctime>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <boost/outcome.hpp>
+#include <boost/filesystem.hpp>
+#include "model/misc/arc.hpp"
+#include "syncspirit-export.h"
+
+namespace syncspirit::fs {
+
+namespace outcome = boost::outcome_v2;
+namespace bfs = boost::filesystem;
+namespace sys = boost::system;
+
+/* Per-folder cache of directories. It remembers which directories are
+ * known to exist and keeps a bounded MRU set of opened directory handles,
+ * so that file operations are performed relative to them (openat, mkdirat,
+ * renameat, utimensat) instead of walking the full path in kernel each time.
+ *
+ * Paths outside of the root, as well as platforms without *at() family,
+ * are served via regular boost::filesystem calls.
+ */
+struct SYNCSPIRIT_API dir_cache_t : model::arc_base_t<dir_cache_t> {
+    enum open_mode_t { read, write };
+
+    dir_cache_t(bfs::path root, size_t max_handles) noexcept;
+    dir_cache_t(const dir_cache_t &) = delete;
+    ~dir_cache_t();
+
+    inline const bfs::path &get_root() const noexcept { return root; }
+    inline size_t opened_handles() const noexcept { return handles.size(); }
+
+    outcome::result<void> create_directories(const bfs::path &dir) noexcept;
+    outcome::result<FILE *> open(const bfs::path &path, open_mode_t mode) noexcept;
+    outcome::result<void> rename(const bfs::path &from, const bfs::path &to) noexcept;
+    outcome::result<void> set_modified(const bfs::path &path, std::time_t modified) noexcept;
+    outcome::result<void> sync(const bfs::path &dir) noexcept;
+    void forget(const bfs::path &path) noexcept;
+
+  private:
+    using handle_t = std::pair<std::string, int>;
+    using handles_t = std::list<handle_t>;
+    using handles_map_t = std::unordered_map<std::string_view, handles_t::iterator>;
+    using known_t = std::unordered_set<std::string>;
+
+    bool is_managed(const bfs::path &path) const noexcept;
+    void forget_missing(const bfs::path &dir) noexcept;
+    outcome::result<int> get_handle(const bfs::path &dir) noexcept;
+    void close_handle(handles_t::iterator it) noexcept;
+
+    bfs::path root;
+    std::string root_str;
+    size_t max_handles;
+    handles_t handles;
+    handles_map_t handles_map;
+    known_t known;
+};
+
+using dir_cache_ptr_t = model::intrusive_ptr_t<dir_cache_t>;
+
+} // namespace syncspirit::fs
@@ -7,54 +7,56 @@
 #include <errno.h>
 #include <cassert>
 
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
 using namespace syncspirit::fs;
 
-auto file_t::open_write(model::file_info_ptr_t model) noexcept -> outcome::result<file_t> {
+auto file_t::open_write(model::file_info_ptr_t model, dir_cache_ptr_t dirs) noexcept -> outcome::result<file_t> {
     auto tmp = model->get_size() > 0;
     auto path = tmp ? make_temporal(model->get_path()) : model->get_path();
-    auto path_str = path.string();
 
-    auto mode = "r+b";
-    auto ec = sys::error_code{};
-    bool need_resize = true;
+    auto file_opt = dirs->open(path, dir_cache_t::open_mode_t::write);
+    if (!file_opt) {
+        return file_opt.assume_error();
+    }
+    auto file = file_opt.assume_value();
+    auto fd = fileno(file);
     auto exptected_size = (uint64_t)model->get_size();
-    if (bfs::exists(path, ec)) {
-        auto file_size = bfs::file_size(path, ec);
-        if (ec) {
-            return ec;
-        }
-        if (file_size == exptected_size) {
-            need_resize = false;
-        }
-        if (file_size != exptected_size) {
-        }
-    } else {
-        auto file = fopen(path_str.c_str(), "w");
-        if (!file) {
-            return sys::error_code{errno, sys::system_category()};
-        }
-        if (fclose(file)) {
-            return sys::error_code{errno, sys::system_category()};
-        }
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    struct _stat64 stat_buff;
+    auto r = _fstat64(fd, &stat_buff);
+#else
+    struct stat stat_buff;
+    auto r = fstat(fd, &stat_buff);
+#endif
+    if (r) {
+        auto ec = sys::error_code{errno, sys::system_category()};
+        fclose(file);
+        return ec;
     }
 
-    if (need_resize) {
-        bfs::resize_file(path, exptected_size, ec);
-        if (ec) {
+    if ((uint64_t)stat_buff.st_size != exptected_size) {
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+        r = _chsize_s(fd, (__int64)exptected_size);
+#else
+        r = ftruncate(fd, (off_t)exptected_size);
+#endif
+        if (r) {
+            auto ec = sys::error_code{errno, sys::system_category()};
+            fclose(file);
             return ec;
         }
     }
 
-    auto file = fopen(path_str.c_str(), mode);
-    if (!file) {
-        return sys::error_code{errno, sys::system_category()};
-    }
-    /*    auto r = fseek(file, 0L, SEEK_SET);
-        if (r != 0) {
-            return sys::error_code{errno, sys::system_category()};
-        } */
     rewind(file);
-    return file_t(file, std::move(model), std::move(path), tmp);
+    return file_t(file, std::move(model), std::move(path), std::move(dirs), tmp);
 }
 
 auto file_t::open_read(const bfs::path &path) noexcept -> outcome::result<file_t> {
@@ -68,8 +70,10 @@ auto file_t::open_read(const bfs::path &path) noexcept -> outcome::result<file_t
 
 file_t::file_t() noexcept : backend{nullptr} {}
 
-file_t::file_t(FILE *backend_, model::file_info_ptr_t model_, bfs::path path_, bool temporal_) noexcept
-    : backend{backend_}, model{std::move(model_)}, path{std::move(path_)}, last_op{w}, temporal{temporal_} {
+file_t::file_t(FILE *backend_, model::file_info_ptr_t model_, bfs::path path_, dir_cache_ptr_t dirs_,
+               bool temporal_) noexcept
+    : backend{backend_}, model{std::move(model_)}, dirs{std::move(dirs_)}, path{std::move(path_)}, last_op{w},
+      temporal{temporal_} {
     auto model_path = model->get_path();
     path_str = model_path.string();
 }
@@ -82,6 +86,7 @@ file_t::file_t(file_t &&other) noexcept : backend{nullptr} { *this = std::move(o
 file_t &file_t::operator=(file_t &&other) noexcept {
     std::swap(backend, other.backend);
     std::swap(model, other.model);
+    std::swap(dirs, other.dirs);
     std::swap(path, other.path);
     std::swap(path_str, other.path_str);
     std::swap(last_op, other.last_op);
@@ -118,24 +123,45 @@ auto file_t::close(bool remove_temporal) noexcept -> outcome::result<void> {
 
     backend = nullptr;
 
-    sys::error_code ec;
     auto orig_path = model->get_path();
     if (remove_temporal) {
         assert(temporal);
-        bfs::rename(path, orig_path, ec);
-        if (ec) {
-            return ec;
+        auto r = dirs->rename(path, orig_path);
+        if (!r) {
+            return r;
         }
     } else if (orig_path != path) {
         orig_path = path;
     }
 
     std::time_t modified = model->get_modified_s();
-    bfs::last_write_time(orig_path, modified, ec);
-    if (ec) {
-        return ec;
+    return dirs->set_modified(orig_path, modified);
+}
+
+auto file_t::flush() noexcept -> outcome::result<void> {
+    assert(backend && "flush has sense for opened file");
+    if (fflush(backend)) {
+        return sys::error_code{errno, sys::system_category()};
+    }
+    return outcome::success();
+}
+
+auto file_t::sync() noexcept -> outcome::result<void> {
+    assert(backend && "sync has sense for opened file");
+    if (fflush(backend)) {
+        return sys::error_code{errno, sys::system_category()};
     }
 
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+    auto r = _commit(_fileno(backend));
+#elif defined(__linux__)
+    auto r = fdatasync(fileno(backend));
+#else
+    auto r = fsync(fileno(backend));
+#endif
+    if (r) {
+        return sys::error_code{errno, sys::system_category()};
+    }
     return outcome::success();
 }
 
@@ -8,6 +8,7 @@
 #include <boost/outcome.hpp>
 #include <boost/filesystem.hpp>
 #include "model/file_info.h"
+#include "dir_cache.h"
 #include "syncspirit-export.h"
 
 namespace syncspirit::fs {
@@ -34,22 +35,25 @@ struct SYNCSPIRIT_API file_t : model::arc_base_t<file_t> {
     const bfs::path &get_path() const noexcept;
 
     outcome::result<void> close(bool remove_temporal) noexcept;
+    outcome::result<void> flush() noexcept;
+    outcome::result<void> sync() noexcept;
     outcome::result<void> remove() noexcept;
     outcome::result<void> write(size_t offset, std::string_view data) noexcept;
     outcome::result<void> copy(size_t my_offset, const file_t &from, size_t source_offset, size_t size) noexcept;
     outcome::result<std::string> read(size_t offset, size_t size) const noexcept;
 
-    static outcome::result<file_t> open_write(model::file_info_ptr_t model) noexcept;
+    static outcome::result<file_t> open_write(model::file_info_ptr_t model, dir_cache_ptr_t dirs) noexcept;
     static outcome::result<file_t> open_read(const bfs::path &path) noexcept;
 
   private:
-    file_t(FILE *backend, model::file_info_ptr_t model, bfs::path path, bool temporal) noexcept;
+    file_t(FILE *backend, model::file_info_ptr_t model, bfs::path path, dir_cache_ptr_t dirs, bool temporal) noexcept;
     file_t(FILE *backend, bfs::path path) noexcept;
 
     enum last_op_t { r, w };
 
     FILE *backend;
     model::file_info_ptr_t model;
+    dir_cache_ptr_t dirs;
     bfs::path path;
     std::string path_str;
     mutable size_t pos = 0;
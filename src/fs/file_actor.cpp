@@ -10,11 +10,20 @@
 #include "model/diff/modify/clone_file.h"
 #include "model/diff/modify/finish_file.h"
 #include "model/diff/modify/finish_file_ack.h"
+#include "model/diff/modify/mark_reachable.h"
 #include "utils.h"
 #include <fstream>
+#include <map>
+#include <set>
 
 using namespace syncspirit::fs;
 
+namespace {
+namespace resource {
+r::plugin::resource_id_t sync_timer = 0;
+}
+} // namespace
+
 file_actor_t::write_ack_t::write_ack_t(const model::diff::modify::block_transaction_t &txn_) noexcept
     : txn{txn_}, success{false} {}
 
@@ -30,7 +39,8 @@ file_actor_t::write_ack_t::~write_ack_t() {
 }
 
 file_actor_t::file_actor_t(config_t &cfg)
-    : r::actor_base_t{cfg}, cluster{cfg.cluster}, rw_cache(cfg.mru_size), ro_cache(cfg.mru_size) {
+    : r::actor_base_t{cfg}, cluster{cfg.cluster}, dir_handles{cfg.mru_size}, rw_cache(cfg.mru_size),
+      ro_cache(cfg.mru_size), sync_batch_size{cfg.sync_batch_size}, sync_batch_timeout{cfg.sync_batch_timeout} {
     log = utils::get_logger("fs.file_actor");
 }
 
@@ -60,7 +70,15 @@ void file_actor_t::on_start() noexcept {
 void file_actor_t::shutdown_start() noexcept {
     LOG_TRACE(log, "{}, shutdown_start", identity);
     r::actor_base_t::shutdown_start();
+    if (sync_timer) {
+        cancel_timer(*sync_timer);
+    }
+    if (!finished_files.empty() || !unsynced_dirs.empty()) {
+        sync_finished();
+    }
     rw_cache.clear();
+    ro_cache.clear();
+    dir_caches.clear();
 }
 
 void file_actor_t::on_model_update(model::message::model_update_t &message) noexcept {
@@ -93,7 +111,7 @@ void file_actor_t::on_block_request(message::block_request_t &message) noexcept
     auto folder_info = folder->get_folder_infos().by_device(*cluster->get_device());
     auto file_info = folder_info->get_file_infos().by_name(req.name());
     auto &path = file_info->get_path();
-    auto file_opt = open_file_ro(path, true);
+    auto file_opt = open_for_upload(*file_info);
     auto ec = sys::error_code{};
     auto data = std::string{};
     if (!file_opt) {
@@ -116,9 +134,11 @@ void file_actor_t::on_block_request(message::block_request_t &message) noexcept
 auto file_actor_t::reflect(model::file_info_ptr_t &file_ptr) noexcept -> outcome::result<void> {
     auto &file = *file_ptr;
     auto &path = file.get_path();
+    auto dirs = get_dir_cache(file);
     sys::error_code ec;
 
     if (file.is_deleted()) {
+        dirs->forget(path);
         if (bfs::exists(path, ec)) {
             LOG_DEBUG(log, "{} removing {}", identity, path.string());
             auto ok = bfs::remove_all(path, ec);
@@ -132,14 +152,9 @@ auto file_actor_t::reflect(model::file_info_ptr_t &file_ptr) noexcept -> outcome
         return outcome::success();
     }
 
-    auto parent = path.parent_path();
-
-    bool exists = bfs::exists(parent, ec);
-    if (!exists) {
-        bfs::create_directories(parent, ec);
-        if (ec) {
-            return ec;
-        }
+    auto parent_ok = dirs->create_directories(path.parent_path());
+    if (!parent_ok) {
+        return parent_ok;
     }
 
     if (file.is_file()) {
@@ -170,16 +185,16 @@ auto file_actor_t::reflect(model::file_info_ptr_t &file_ptr) noexcept -> outcome
             out.close();
 
             std::time_t modified = file.get_modified_s();
-            bfs::last_write_time(path, modified, ec);
-            if (ec) {
-                return ec;
+            auto r = dirs->set_modified(path, modified);
+            if (!r) {
+                return r;
             }
         }
     } else if (file.is_dir()) {
         LOG_DEBUG(log, "{}, creating directory {}", identity, path.string());
-        bfs::create_directory(path, ec);
-        if (ec) {
-            return ec;
+        auto r = dirs->create_directories(path);
+        if (!r) {
+            return r;
         }
     } else if (file.is_link()) {
         auto target = bfs::path(file.get_link_target());
@@ -231,27 +246,155 @@ auto file_actor_t::operator()(const model::diff::modify::finish_file_t &diff, vo
     }
 
     rw_cache.remove(backend);
-    auto ok = backend->close(true);
-    if (!ok) {
-        auto &ec = ok.assume_error();
-        LOG_ERROR(log, "{}, cannot close file: {}: {}", identity, path, ec.message());
-        return ec;
+    forget_ro(make_temporal(file->get_path()));
+    finished_files.emplace_back(finished_file_t{std::move(backend), std::move(file)});
+    if (finished_files.size() >= sync_batch_size) {
+        sync_finished();
+        if (sync_timer && unsynced_dirs.empty()) {
+            cancel_timer(*sync_timer);
+        }
+        return outcome::success();
     }
 
-    LOG_INFO(log, "{}, file {} ({} bytes) is now locally available", identity, path, file->get_size());
-
-    auto ack = model::diff::cluster_diff_ptr_t{};
-    ack = new model::diff::modify::finish_file_ack_t(*file);
-    send<model::payload::model_update_t>(coordinator, std::move(ack), this);
+    if (!sync_timer) {
+        sync_timer = start_timer(sync_batch_timeout, *this, &file_actor_t::on_sync_timer);
+        resources->acquire(resource::sync_timer);
+    }
     return outcome::success();
 }
 
+void file_actor_t::on_sync_timer(r::request_id_t, bool cancelled) noexcept {
+    LOG_TRACE(log, "{}, on_sync_timer, cancelled = {}", identity, cancelled);
+    resources->release(resource::sync_timer);
+    sync_timer.reset();
+    if (state == r::state_t::OPERATIONAL && (!finished_files.empty() || !unsynced_dirs.empty())) {
+        sync_finished();
+    }
+}
+
+/* Makes the whole batch of finished files durable with the constant amount
+ * of syncs: data of all files is flushed first (at once per filesystem, if
+ * possible), then temporal files are renamed, then the affected directories
+ * are synced, and only after that the files are acknowledged as locally
+ * available.
+ *
+ * Errors are per file: the failed file is reported as io error and its
+ * source is marked unreachable (so the puller releases it), while the rest
+ * of the batch goes on.
+ *
+ * A failed directory sync does not fail the files: they are already renamed
+ * to their final paths, so they are acknowledged to keep the model in line
+ * with the disk, and the directory sync is retried later (with the next
+ * batch or on the sync timer). */
+void file_actor_t::sync_finished() noexcept {
+    auto files = finished_files_t{};
+    std::swap(files, finished_files);
+    LOG_DEBUG(log, "{}, syncing {} finished file(s)", identity, files.size());
+
+    auto fail = [&](finished_file_t &it, std::string_view what, const sys::error_code &ec) {
+        LOG_ERROR(log, "{}, cannot {} file: {}: {}", identity, what, it.file->get_path().string(), ec.message());
+        it.ec = ec;
+    };
+
+    /* syncfs does not cover data in userspace buffers */
+    auto pending = size_t{0};
+    for (auto &it : files) {
+        auto r = it.backend->flush();
+        if (!r) {
+            fail(it, "flush", r.assume_error());
+        } else {
+            ++pending;
+        }
+    }
+
+    bool synced = false;
+    if (pending > 1) {
+        auto roots = std::set<bfs::path>{};
+        for (auto &it : files) {
+            if (!it.ec) {
+                roots.emplace(it.file->get_folder_info()->get_folder()->get_path());
+            }
+        }
+        synced = true;
+        for (auto &root : roots) {
+            auto r = sync_filesystem(root);
+            if (!r) {
+                LOG_TRACE(log, "{}, cannot sync filesystem of {} : {}, fallback to per-file sync", identity,
+                          root.string(), r.assume_error().message());
+                synced = false;
+                break;
+            }
+        }
+    }
+
+    if (!synced) {
+        for (auto &it : files) {
+            if (it.ec) {
+                continue;
+            }
+            auto r = it.backend->sync();
+            if (!r) {
+                fail(it, "sync", r.assume_error());
+            }
+        }
+    }
+
+    auto dirs = unsynced_dirs_t{};
+    std::swap(dirs, unsynced_dirs);
+    for (auto &it : files) {
+        if (it.ec) {
+            continue;
+        }
+        auto ok = it.backend->close(true);
+        if (!ok) {
+            fail(it, "close", ok.assume_error());
+            continue;
+        }
+        dirs.emplace(it.file->get_path().parent_path(), get_dir_cache(*it.file));
+    }
+
+    for (auto &[dir, cache] : dirs) {
+        auto r = cache->sync(dir);
+        if (!r) {
+            auto &ec = r.assume_error();
+            LOG_WARN(log, "{}, cannot sync directory: {}: {}, will retry", identity, dir.string(), ec.message());
+            unsynced_dirs.emplace(dir, cache);
+        }
+    }
+    if (!unsynced_dirs.empty() && !sync_timer && state == r::state_t::OPERATIONAL) {
+        sync_timer = start_timer(sync_batch_timeout, *this, &file_actor_t::on_sync_timer);
+        resources->acquire(resource::sync_timer);
+    }
+
+    auto errors = model::io_errors_t{};
+    for (auto &it : files) {
+        auto &file = it.file;
+        auto diff = model::diff::cluster_diff_ptr_t{};
+        if (!it.ec) {
+            LOG_INFO(log, "{}, file {} ({} bytes) is now locally available", identity, file->get_path().string(),
+                     file->get_size());
+            diff = new model::diff::modify::finish_file_ack_t(*file);
+        } else {
+            errors.push_back(model::io_error_t{file->get_path(), it.ec});
+            auto source = file->get_source();
+            if (!source) {
+                LOG_DEBUG(log, "{}, file {} has no source, nothing to mark unreachable", identity,
+                          file->get_path().string());
+                continue;
+            }
+            diff = new model::diff::modify::mark_reachable_t(*source, false);
+        }
+        send<model::payload::model_update_t>(coordinator, std::move(diff), this);
+    }
+    if (!errors.empty()) {
+        send<model::payload::io_error_t>(coordinator, std::move(errors));
+    }
+}
+
 auto file_actor_t::operator()(const model::diff::modify::append_block_t &diff, void *) noexcept
     -> outcome::result<void> {
     auto ack = write_ack_t(diff);
-    auto folder = cluster->get_folders().by_id(diff.folder_id);
-    auto file_info = folder->get_folder_infos().by_device_id(diff.device_id);
-    auto file = file_info->get_file_infos().by_name(diff.file_name);
+    auto file = model::file_info_ptr_t(diff.get_file(*cluster));
     auto &path = file->get_path();
     auto path_str = path.string();
     auto file_opt = open_file_rw(path, file);
@@ -294,12 +437,8 @@ auto file_actor_t::get_source_for_cloning(model::file_info_ptr_t &source, const
 auto file_actor_t::operator()(const model::diff::modify::clone_block_t &diff, void *) noexcept
     -> outcome::result<void> {
     auto ack = write_ack_t(diff);
-    auto folder = cluster->get_folders().by_id(diff.folder_id);
-    auto target_folder_info = folder->get_folder_infos().by_device_id(diff.device_id);
-    auto target = target_folder_info->get_file_infos().by_name(diff.file_name);
-
-    auto source_folder_info = folder->get_folder_infos().by_device_id(diff.source_device_id);
-    auto source = source_folder_info->get_file_infos().by_name(diff.source_file_name);
+    auto target = model::file_info_ptr_t(diff.get_file(*cluster));
+    auto source = model::file_info_ptr_t(diff.get_source_file(*cluster));
 
     auto &target_path = target->get_path();
     auto file_opt = open_file_rw(target_path, target);
@@ -322,6 +461,18 @@ auto file_actor_t::operator()(const model::diff::modify::clone_block_t &diff, vo
     return ack(target_backend->copy(target_offset, *source_backend, source_offset, block->get_size()));
 }
 
+auto file_actor_t::get_dir_cache(const model::file_info_t &file) noexcept -> dir_cache_ptr_t {
+    auto folder = file.get_folder_info()->get_folder();
+    auto folder_id = std::string(folder->get_id());
+    auto it = dir_caches.find(folder_id);
+    if (it != dir_caches.end()) {
+        return it->second;
+    }
+    auto cache = dir_cache_ptr_t(new dir_cache_t(folder->get_path(), dir_handles));
+    dir_caches.emplace(std::move(folder_id), cache);
+    return cache;
+}
+
 auto file_actor_t::open_file_rw(const boost::filesystem::path &path, model::file_info_ptr_t info) noexcept
     -> outcome::result<file_ptr_t> {
     auto item = rw_cache.get(path.string());
@@ -331,29 +482,56 @@ auto file_actor_t::open_file_rw(const boost::filesystem::path &path, model::file
 
     auto size = info->get_size();
     LOG_TRACE(log, "{}, open_file (model), path = {} ({} bytes)", identity, path.string(), size);
-    // auto opt = file_t::open_write(path, )
-    // bfs::path operational_path = temporal ? make_temporal(path) : path;
 
-    auto parent = path.parent_path();
-    sys::error_code ec;
-
-    bool exists = bfs::exists(parent, ec);
-    if (!exists) {
-        bfs::create_directories(parent, ec);
-        if (ec) {
-            return ec;
-        }
+    auto dirs = get_dir_cache(*info);
+    auto parent_ok = dirs->create_directories(path.parent_path());
+    if (!parent_ok) {
+        return parent_ok.assume_error();
     }
 
-    auto option = file_t::open_write(info);
+    auto option = file_t::open_write(info, std::move(dirs));
     if (!option) {
         return option.assume_error();
     }
     auto ptr = file_ptr_t(new file_t(std::move(option.assume_value())));
     rw_cache.put(ptr);
+    /* the file is going to be modified, read-only handle might be stale */
+    forget_ro(make_temporal(info->get_path()));
     return ptr;
 }
 
+void file_actor_t::forget_ro(const bfs::path &path) noexcept {
+    if (auto cached = ro_cache.get(path.string()); cached) {
+        ro_cache.remove(cached);
+    }
+}
+
+auto file_actor_t::open_for_upload(const model::file_info_t &file) noexcept -> outcome::result<file_ptr_t> {
+    auto &path = file.get_path();
+    auto source = file.get_source();
+    if (!source || !source->is_locked()) {
+        return open_file_ro(path, true);
+    }
+
+    /* the file is being downloaded, so its blocks are in the temporal file */
+    if (auto cached = rw_cache.get(path.string()); cached) {
+        return cached;
+    }
+    auto path_tmp = make_temporal(path);
+    auto key = path_tmp.string();
+    if (auto cached = rw_cache.get(key); cached) {
+        return cached;
+    }
+    if (auto cached = ro_cache.get(key); cached) {
+        return cached;
+    }
+    auto opt = open_file_ro(path_tmp, false);
+    if (opt) {
+        ro_cache.put(opt.assume_value());
+    }
+    return opt;
+}
+
 auto file_actor_t::open_file_ro(const bfs::path &path, bool use_cache) noexcept -> outcome::result<file_ptr_t> {
     LOG_TRACE(log, "{}, open_file (by path), path = {}", identity, path.string());
     if (use_cache) {
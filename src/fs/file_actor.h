@@ -13,6 +13,10 @@
 #include "utils/log.h"
 #include "utils.h"
 #include <rotor.hpp>
+#include <map>
+#include <optional>
+#include <unordered_map>
+#include <vector>
 
 namespace syncspirit {
 
@@ -32,6 +36,8 @@ namespace outcome = boost::outcome_v2;
 struct SYNCSPIRIT_API file_actor_config_t : r::actor_config_t {
     model::cluster_ptr_t cluster;
     size_t mru_size;
+    size_t sync_batch_size = 0;
+    r::pt::time_duration sync_batch_timeout = r::pt::time_duration{};
 };
 
 template <typename Actor> struct file_actor_config_builder_t : r::actor_config_builder_t<Actor> {
@@ -48,6 +54,16 @@ template <typename Actor> struct file_actor_config_builder_t : r::actor_config_b
         parent_t::config.mru_size = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
+
+    builder_t &&sync_batch_size(size_t value) && noexcept {
+        parent_t::config.sync_batch_size = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
+
+    builder_t &&sync_batch_timeout(const r::pt::time_duration &value) && noexcept {
+        parent_t::config.sync_batch_timeout = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
 };
 
 struct SYNCSPIRIT_API file_actor_t : public r::actor_base_t,
@@ -64,6 +80,7 @@ struct SYNCSPIRIT_API file_actor_t : public r::actor_base_t,
 
   private:
     using cache_t = model::mru_list_t<file_ptr_t>;
+    using dir_caches_t = std::unordered_map<std::string, dir_cache_ptr_t>;
 
     struct write_ack_t {
         write_ack_t(const model::diff::modify::block_transaction_t &txn) noexcept;
@@ -75,15 +92,26 @@ struct SYNCSPIRIT_API file_actor_t : public r::actor_base_t,
         bool success;
     };
 
+    struct finished_file_t {
+        file_ptr_t backend;
+        model::file_info_ptr_t file;
+        sys::error_code ec = {};
+    };
+    using finished_files_t = std::vector<finished_file_t>;
+    using unsynced_dirs_t = std::map<bfs::path, dir_cache_ptr_t>;
+
     void on_model_update(model::message::model_update_t &message) noexcept;
     void on_block_update(model::message::block_update_t &message) noexcept;
     void on_block_request(message::block_request_t &message) noexcept;
+    void on_sync_timer(r::request_id_t, bool cancelled) noexcept;
 
     outcome::result<file_ptr_t> get_source_for_cloning(model::file_info_ptr_t &source,
                                                        const file_ptr_t &target_backend) noexcept;
 
     outcome::result<file_ptr_t> open_file_rw(const bfs::path &path, model::file_info_ptr_t info) noexcept;
     outcome::result<file_ptr_t> open_file_ro(const bfs::path &path, bool use_cache = false) noexcept;
+    outcome::result<file_ptr_t> open_for_upload(const model::file_info_t &file) noexcept;
+    void forget_ro(const bfs::path &path) noexcept;
 
     outcome::result<void> operator()(const model::diff::modify::clone_file_t &, void *) noexcept override;
     outcome::result<void> operator()(const model::diff::modify::finish_file_t &, void *) noexcept override;
@@ -91,12 +119,22 @@ struct SYNCSPIRIT_API file_actor_t : public r::actor_base_t,
     outcome::result<void> operator()(const model::diff::modify::clone_block_t &, void *) noexcept override;
 
     outcome::result<void> reflect(model::file_info_ptr_t &file) noexcept;
+    void sync_finished() noexcept;
+    dir_cache_ptr_t get_dir_cache(const model::file_info_t &file) noexcept;
 
     model::cluster_ptr_t cluster;
     utils::logger_t log;
     r::address_ptr_t coordinator;
+    size_t dir_handles;
+    dir_caches_t dir_caches;
     cache_t rw_cache;
     cache_t ro_cache;
+    finished_files_t finished_files;
+    /* directories, where files have been renamed, but not synced yet */
+    unsynced_dirs_t unsynced_dirs;
+    size_t sync_batch_size;
+    r::pt::time_duration sync_batch_timeout;
+    std::optional<r::request_id_t> sync_timer;
 };
 
 } // namespace fs
@@ -50,6 +50,8 @@ void fs_supervisor_t::launch() noexcept {
         return create_actor<file_actor_t>()
             .cluster(cluster)
             .mru_size(fs_config.mru_size)
+            .sync_batch_size(fs_config.sync_batch_size)
+            .sync_batch_timeout(r::pt::millisec{fs_config.sync_batch_timeout})
             .timeout(timeout)
             .spawner_address(spawner)
             .finish();
@@ -4,6 +4,14 @@
 #include "utils.h"
 #include "utils/tls.h"
 #include <zlib.h>
+#include <errno.h>
+
+#if defined(WIN32) || defined(_WIN32) || defined(__WIN32)
+#define SYNCSPIRIT_FS_WIN
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
 
 namespace syncspirit::fs {
 
@@ -81,4 +89,54 @@ relative_result_t relativize(const bfs::path &path, const boost::filesystem::pat
     return {bfs::path(new_path), true};
 }
 
+#ifndef SYNCSPIRIT_FS_WIN
+static outcome::result<int> open_ro(const bfs::path &path) noexcept {
+    auto fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        return sys::error_code{errno, sys::system_category()};
+    }
+    return fd;
+}
+#endif
+
+outcome::result<void> sync_directory(const bfs::path &path) noexcept {
+#ifdef SYNCSPIRIT_FS_WIN
+    (void)path;
+    return outcome::success();
+#else
+    auto fd_opt = open_ro(path);
+    if (!fd_opt) {
+        return fd_opt.assume_error();
+    }
+    auto fd = fd_opt.assume_value();
+    auto r = ::fsync(fd);
+    auto ec = r ? sys::error_code{errno, sys::system_category()} : sys::error_code{};
+    ::close(fd);
+    if (ec) {
+        return ec;
+    }
+    return outcome::success();
+#endif
+}
+
+outcome::result<void> sync_filesystem(const bfs::path &path) noexcept {
+#if defined(__linux__)
+    auto fd_opt = open_ro(path);
+    if (!fd_opt) {
+        return fd_opt.assume_error();
+    }
+    auto fd = fd_opt.assume_value();
+    auto r = ::syncfs(fd);
+    auto ec = r ? sys::error_code{errno, sys::system_category()} : sys::error_code{};
+    ::close(fd);
+    if (ec) {
+        return ec;
+    }
+    return outcome::success();
+#else
+    (void)path;
+    return sys::errc::make_error_code(sys::errc::not_supported);
+#endif
+}
+
 } // namespace syncspirit::fs
@@ -34,6 +34,13 @@ struct relative_result_t {
 
 SYNCSPIRIT_API relative_result_t relativize(const bfs::path &path, const bfs::path &root) noexcept;
 
+/* makes directory entries (i.e. renames) durable; no-op where not supported */
+SYNCSPIRIT_API outcome::result<void> sync_directory(const bfs::path &path) noexcept;
+
+/* flushes the whole filesystem, containing the path, at once; not_supported
+ * is returned on platforms without syncfs */
+SYNCSPIRIT_API outcome::result<void> sync_filesystem(const bfs::path &path) noexcept;
+
 SYNCSPIRIT_API extern const std::size_t block_sizes_sz;
 SYNCSPIRIT_API extern const std::size_t *block_sizes;
 
@@ -5,6 +5,8 @@
 
 #include "misc/arc.hpp"
 #include "misc/uuid.h"
+#include "misc/swarm.h"
+#include "misc/file_table.h"
 #include "device.h"
 #include "ignored_device.h"
 #include "ignored_folder.h"
@@ -45,10 +47,15 @@ struct SYNCSPIRIT_API cluster_t final : arc_base_t<cluster_t> {
     inline void mark_tainted() noexcept { tainted = true; }
     int32_t get_write_requests() const noexcept;
     void modify_write_requests(int32_t delta) noexcept;
+    inline swarm_t &get_swarm() noexcept { return swarm; }
+    inline file_table_t &get_file_table() noexcept { return file_table; }
+    inline const file_table_t &get_file_table() const noexcept { return file_table; }
 
     outcome::result<diff::cluster_diff_ptr_t> process(proto::ClusterConfig &msg, const device_t &peer) const noexcept;
-    outcome::result<diff::cluster_diff_ptr_t> process(proto::Index &msg, const device_t &peer) const noexcept;
-    outcome::result<diff::cluster_diff_ptr_t> process(proto::IndexUpdate &msg, const device_t &peer) const noexcept;
+    outcome::result<diff::cluster_diff_ptr_t> process(const proto::Index &msg, const device_t &peer,
+                                                      std::shared_ptr<const void> owner = {}) const noexcept;
+    outcome::result<diff::cluster_diff_ptr_t> process(const proto::IndexUpdate &msg, const device_t &peer,
+                                                      std::shared_ptr<const void> owner = {}) const noexcept;
 
   private:
     using rng_engine_t = std::mt19937;
@@ -67,6 +74,8 @@ struct SYNCSPIRIT_API cluster_t final : arc_base_t<cluster_t> {
     unknown_folders_t unknown_folders;
     bool tainted = false;
     int32_t write_requests;
+    swarm_t swarm;
+    file_table_t file_table;
 };
 
 using cluster_ptr_t = intrusive_ptr_t<cluster_t>;
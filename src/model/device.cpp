@@ -82,12 +82,37 @@ std::string device_t::serialize() noexcept {
     return r.SerializeAsString();
 }
 
-void device_t::update_state(device_state_t new_state) { state = new_state; }
+void device_t::update_state(device_state_t new_state) {
+    state = new_state;
+    if (state == device_state_t::offline) {
+        extra_connections = 0;
+    }
+}
+
+void device_t::update_connections(bool connected) noexcept {
+    if (connected) {
+        if (state == device_state_t::online) {
+            ++extra_connections;
+        }
+    } else if (extra_connections) {
+        --extra_connections;
+    }
+}
 
 std::string_view device_t::get_key() const noexcept { return id.get_key(); }
 
 void device_t::assign_uris(const uris_t &uris_) noexcept { uris = uris_; }
 
+void device_t::record_dial(std::string_view uri, bool success) noexcept {
+    auto &stats = dial_history[std::string(uri)];
+    if (success) {
+        ++stats.successes;
+        stats.consecutive_failures = 0;
+    } else {
+        ++stats.consecutive_failures;
+    }
+}
+
 local_device_t::local_device_t(const device_id_t &device_id, std::string_view name, std::string_view cert_name) noexcept
     : device_t(device_id, name, cert_name) {
     state = device_state_t::online;
@@ -13,6 +13,8 @@
 #include "bep.pb.h"
 #include "structs.pb.h"
 #include <boost/outcome.hpp>
+#include <chrono>
+#include <unordered_map>
 
 namespace syncspirit::model {
 
@@ -23,9 +25,26 @@ using device_ptr_t = intrusive_ptr_t<device_t>;
 
 enum class device_state_t { offline, dialing, online };
 
+/* live (non-persistent) metrics of block downloads from the peer */
+struct rx_metrics_t {
+    std::uint32_t window = 0;
+    std::chrono::microseconds min_rtt{0};
+    std::chrono::microseconds srtt{0};
+    std::chrono::microseconds timeout{0};
+    /* bytes per second */
+    double bandwidth = 0;
+};
+
+/* live (non-persistent) outcome of dialing the peer uri */
+struct dial_stats_t {
+    std::uint32_t successes = 0;
+    std::uint32_t consecutive_failures = 0;
+};
+
 struct SYNCSPIRIT_API device_t : arc_base_t<device_t> {
     using uris_t = std::vector<utils::URI>;
     using name_option_t = std::optional<std::string>;
+    using dial_history_t = std::unordered_map<std::string, dial_stats_t>;
 
     static outcome::result<device_ptr_t> create(std::string_view key, const db::Device &data) noexcept;
     static outcome::result<device_ptr_t> create(const device_id_t &device_id, std::string_view name,
@@ -40,6 +59,9 @@ struct SYNCSPIRIT_API device_t : arc_base_t<device_t> {
     inline bool is_dynamic() const noexcept { return static_uris.empty(); }
     inline device_state_t get_state() const noexcept { return state; }
     void update_state(device_state_t new_state);
+    /* extra (non-primary) connections of the online peer */
+    inline std::uint32_t get_extra_connections() const noexcept { return extra_connections; }
+    void update_connections(bool connected) noexcept;
     inline device_id_t &device_id() noexcept { return id; }
     inline const device_id_t &device_id() const noexcept { return id; }
     inline std::string_view get_name() const noexcept { return name; }
@@ -48,6 +70,10 @@ struct SYNCSPIRIT_API device_t : arc_base_t<device_t> {
     inline bool is_introducer() const noexcept { return introducer; }
     inline bool get_skip_introduction_removals() const noexcept { return skip_introduction_removals; }
     inline auto &get_remote_folder_infos() noexcept { return remote_folder_infos; }
+    inline const rx_metrics_t &get_rx_metrics() const noexcept { return rx_metrics; }
+    inline void set_rx_metrics(const rx_metrics_t &value) noexcept { rx_metrics = value; }
+    inline const dial_history_t &get_dial_history() const noexcept { return dial_history; }
+    void record_dial(std::string_view uri, bool success) noexcept;
 
     inline const uris_t &get_uris() const noexcept { return uris; }
 
@@ -71,7 +97,10 @@ struct SYNCSPIRIT_API device_t : arc_base_t<device_t> {
     bool paused;
     bool skip_introduction_removals;
     device_state_t state = device_state_t::offline;
+    std::uint32_t extra_connections = 0;
     remote_folder_infos_map_t remote_folder_infos;
+    rx_metrics_t rx_metrics;
+    dial_history_t dial_history;
 };
 
 struct local_device_t final : device_t {
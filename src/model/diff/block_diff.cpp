@@ -7,16 +7,31 @@
 using namespace syncspirit::model::diff;
 
 block_diff_t::block_diff_t(const block_diff_t &source) noexcept
-    : file_name(source.file_name), folder_id{source.folder_id}, device_id{source.device_id},
+    : handle{source.handle}, file_name(source.file_name), folder_id{source.folder_id}, device_id{source.device_id},
       block_index{source.block_index} {}
 
 block_diff_t::block_diff_t(const file_info_t &file, size_t block_index_) noexcept
-    : file_name{file.get_name()}, block_index{block_index_} {
+    : handle{file.get_handle()}, file_name{file.get_name()}, block_index{block_index_} {
     auto fi = file.get_folder_info();
     folder_id = fi->get_folder()->get_id();
     device_id = fi->get_device()->device_id().get_sha256();
 }
 
+auto block_diff_t::get_file(cluster_t &cluster) const noexcept -> file_info_t * {
+    if (auto file = cluster.get_file_table().get(handle, folder_id, device_id, file_name); file) {
+        return file;
+    }
+    auto folder = cluster.get_folders().by_id(folder_id);
+    if (!folder) {
+        return nullptr;
+    }
+    auto folder_info = folder->get_folder_infos().by_device_id(device_id);
+    if (!folder_info) {
+        return nullptr;
+    }
+    return folder_info->get_file_infos().by_name(file_name).get();
+}
+
 auto block_diff_t::visit(block_visitor_t &, void *) const noexcept -> outcome::result<void> {
     return outcome::success();
 }
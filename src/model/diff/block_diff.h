@@ -5,10 +5,12 @@
 
 #include "generic_diff.hpp"
 #include "block_visitor.h"
+#include "../misc/file_handle.h"
 #include "syncspirit-export.h"
 
 namespace syncspirit::model {
 
+struct cluster_t;
 struct file_info_t;
 
 namespace diff {
@@ -18,6 +20,11 @@ struct SYNCSPIRIT_API block_diff_t : generic_diff_t<tag::block> {
     block_diff_t(const file_info_t &file, size_t block_index = 0) noexcept;
     virtual outcome::result<void> visit(block_visitor_t &, void *custom) const noexcept override;
 
+    /* resolves the file via handle, and via folder/device/name when the handle
+     * is stale or refers to some other file */
+    file_info_t *get_file(cluster_t &cluster) const noexcept;
+
+    file_handle_t handle;
     std::string file_name;
     std::string folder_id;
     std::string device_id;
@@ -25,6 +25,10 @@ auto cluster_visitor_t::operator()(const peer::peer_state_t &, void *) noexcept
     return outcome::success();
 }
 
+auto cluster_visitor_t::operator()(const peer::peer_connection_t &, void *) noexcept -> outcome::result<void> {
+    return outcome::success();
+}
+
 auto cluster_visitor_t::operator()(const modify::create_folder_t &, void *) noexcept -> outcome::result<void> {
     return outcome::success();
 }
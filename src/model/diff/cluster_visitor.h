@@ -16,6 +16,7 @@ namespace peer {
 struct cluster_remove_t;
 struct cluster_update_t;
 struct peer_state_t;
+struct peer_connection_t;
 struct update_folder_t;
 } // namespace peer
 
@@ -41,6 +42,7 @@ template <> struct SYNCSPIRIT_API generic_visitor_t<tag::cluster> {
     virtual outcome::result<void> operator()(const peer::cluster_remove_t &, void *custom) noexcept;
     virtual outcome::result<void> operator()(const peer::cluster_update_t &, void *custom) noexcept;
     virtual outcome::result<void> operator()(const peer::peer_state_t &, void *custom) noexcept;
+    virtual outcome::result<void> operator()(const peer::peer_connection_t &, void *custom) noexcept;
     virtual outcome::result<void> operator()(const peer::update_folder_t &, void *custom) noexcept;
 
     virtual outcome::result<void> operator()(const modify::clone_file_t &, void *custom) noexcept;
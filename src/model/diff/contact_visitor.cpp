@@ -16,3 +16,7 @@ auto contact_visitor_t::operator()(const modify::update_contact_t &, void *) noe
 auto contact_visitor_t::operator()(const modify::relay_connect_request_t &, void *) noexcept -> outcome::result<void> {
     return outcome::success();
 }
+
+auto contact_visitor_t::operator()(const modify::dial_result_t &, void *) noexcept -> outcome::result<void> {
+    return outcome::success();
+}
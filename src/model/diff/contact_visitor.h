@@ -10,6 +10,7 @@ namespace syncspirit::model::diff {
 
 namespace modify {
 struct update_contact_t;
+struct dial_result_t;
 struct connect_request_t;
 struct relay_connect_request_t;
 } // namespace modify
@@ -20,6 +21,7 @@ template <> struct SYNCSPIRIT_API generic_visitor_t<tag::contact> {
     virtual outcome::result<void> operator()(const modify::update_contact_t &, void *custom) noexcept;
     virtual outcome::result<void> operator()(const modify::connect_request_t &, void *custom) noexcept;
     virtual outcome::result<void> operator()(const modify::relay_connect_request_t &, void *custom) noexcept;
+    virtual outcome::result<void> operator()(const modify::dial_result_t &, void *custom) noexcept;
 };
 
 using contact_visitor_t = generic_visitor_t<tag::contact>;
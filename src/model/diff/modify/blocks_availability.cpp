@@ -16,9 +16,7 @@ blocks_availability_t::blocks_availability_t(const file_info_t &file, size_t las
 }
 
 auto blocks_availability_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::result<void> {
-    auto folder = cluster.get_folders().by_id(folder_id);
-    auto folder_info = folder->get_folder_infos().by_device_id(device_id);
-    auto file = folder_info->get_file_infos().by_name(file_name);
+    auto file = get_file(cluster);
     auto ok = file && (compare(version, file->get_version()) == version_relation_t::identity);
     if (ok) {
         for (size_t i = 0; i <= block_index; ++i) {
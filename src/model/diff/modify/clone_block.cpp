@@ -33,11 +33,28 @@ clone_block_t::clone_block_t(const file_block_t &file_block, dispose_callback_t
                                                                               .at(block_index)
                                                                               ->get_hash());
     auto source_fi = source_file->get_folder_info();
+    source_handle = source_file->get_handle();
     source_device_id = source_fi->get_device()->device_id().get_sha256();
     source_folder_id = source_fi->get_folder()->get_id();
     source_file_name = source_file->get_name();
 }
 
+auto clone_block_t::get_source_file(cluster_t &cluster) const noexcept -> file_info_t * {
+    auto &table = cluster.get_file_table();
+    if (auto file = table.get(source_handle, source_folder_id, source_device_id, source_file_name); file) {
+        return file;
+    }
+    auto folder = cluster.get_folders().by_id(source_folder_id);
+    if (!folder) {
+        return nullptr;
+    }
+    auto folder_info = folder->get_folder_infos().by_device_id(source_device_id);
+    if (!folder_info) {
+        return nullptr;
+    }
+    return folder_info->get_file_infos().by_name(source_file_name).get();
+}
+
 auto clone_block_t::visit(block_visitor_t &visitor, void *custom) const noexcept -> outcome::result<void> {
     LOG_TRACE(log, "visiting clone_block_t");
     return visitor(*this, custom);
@@ -13,6 +13,9 @@ struct SYNCSPIRIT_API clone_block_t final : block_transaction_t {
 
     outcome::result<void> visit(block_visitor_t &, void *) const noexcept override;
 
+    file_info_t *get_source_file(cluster_t &cluster) const noexcept;
+
+    file_handle_t source_handle;
     std::string source_device_id;
     std::string source_folder_id;
     std::string source_file_name;
@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "dial_result.h"
+#include "../contact_visitor.h"
+#include "../../cluster.h"
+#include "../../misc/devices_view.h"
+
+using namespace syncspirit::model::diff::modify;
+
+dial_result_t::dial_result_t(const model::cluster_t &cluster, const model::device_id_t &device,
+                             const utils::URI &uri_, bool success_) noexcept
+    : peer_id{device.get_sha256()}, uri{uri_.full}, success{success_} {
+    known = (bool)cluster.get_devices().by_sha256(peer_id);
+}
+
+dial_result_t::dial_result_t(const model::devices_view_t &devices, const model::device_id_t &device,
+                             const utils::URI &uri_, bool success_) noexcept
+    : peer_id{device.get_sha256()}, uri{uri_.full}, success{success_} {
+    known = devices.is_known(peer_id);
+}
+
+auto dial_result_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::result<void> {
+    if (known) {
+        auto peer = cluster.get_devices().by_sha256(peer_id);
+        peer->record_dial(uri, success);
+    }
+    return outcome::success();
+}
+
+auto dial_result_t::visit(contact_visitor_t &visitor, void *custom) const noexcept -> outcome::result<void> {
+    return visitor(*this, custom);
+}
@@ -0,0 +1,32 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include "../contact_diff.h"
+#include "model/cluster.h"
+
+namespace syncspirit::model {
+struct devices_view_t;
+}
+
+namespace syncspirit::model::diff::modify {
+
+/* outcome of dialing the peer via the uri; it is recorded in the (live)
+ * dial history of the device, which affects the order of the next dialing */
+struct SYNCSPIRIT_API dial_result_t final : contact_diff_t {
+    dial_result_t(const model::cluster_t &cluster, const model::device_id_t &device, const utils::URI &uri,
+                  bool success) noexcept;
+    dial_result_t(const model::devices_view_t &devices, const model::device_id_t &device, const utils::URI &uri,
+                  bool success) noexcept;
+
+    outcome::result<void> apply_impl(cluster_t &) const noexcept override;
+    outcome::result<void> visit(contact_visitor_t &, void *) const noexcept override;
+
+    std::string peer_id;
+    std::string uri;
+    bool success;
+    bool known;
+};
+
+} // namespace syncspirit::model::diff::modify
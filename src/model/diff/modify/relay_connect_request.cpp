@@ -4,8 +4,9 @@
 using namespace syncspirit::model::diff::modify;
 
 relay_connect_request_t::relay_connect_request_t(model::device_id_t peer_, std::string session_key_,
-                                                 tcp::endpoint relay_) noexcept
-    : peer{std::move(peer_)}, session_key{std::move(session_key_)}, relay{std::move(relay_)} {}
+                                                 tcp::endpoint relay_, std::uint64_t session_limit_) noexcept
+    : peer{std::move(peer_)}, session_key{std::move(session_key_)}, relay{std::move(relay_)},
+      session_limit{session_limit_} {}
 
 auto relay_connect_request_t::apply_impl(cluster_t &) const noexcept -> outcome::result<void> {
     return outcome::success();
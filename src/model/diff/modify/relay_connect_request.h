@@ -15,7 +15,8 @@ namespace asio = boost::asio;
 using tcp = asio::ip::tcp;
 
 struct SYNCSPIRIT_API relay_connect_request_t final : contact_diff_t {
-    relay_connect_request_t(model::device_id_t peer, std::string session_key, tcp::endpoint relay) noexcept;
+    relay_connect_request_t(model::device_id_t peer, std::string session_key, tcp::endpoint relay,
+                            std::uint64_t session_limit = 0) noexcept;
 
     outcome::result<void> apply_impl(cluster_t &) const noexcept override;
     outcome::result<void> visit(contact_visitor_t &, void *) const noexcept override;
@@ -23,6 +24,8 @@ struct SYNCSPIRIT_API relay_connect_request_t final : contact_diff_t {
     model::device_id_t peer;
     std::string session_key;
     tcp::endpoint relay;
+    /* bytes per second, 0 means no limit */
+    std::uint64_t session_limit;
 };
 
 } // namespace syncspirit::model::diff::modify
@@ -47,13 +47,15 @@ auto share_folder_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::r
 
     auto db = db::FolderInfo();
     db.set_index_id(index);
-    db.set_max_sequence(max_sequence);
     auto fi_opt = folder_info_t::create(cluster.next_uuid(), db, peer, folder);
     if (!fi_opt) {
         return fi_opt.assume_error();
     }
 
     auto &fi = fi_opt.value();
+    if (max_sequence) {
+        fi->set_max_sequence(max_sequence);
+    }
     folder->add(fi);
     if (index) {
         unknown.erase_after(unknown_it);
@@ -64,6 +64,7 @@ auto unshare_folder_t::apply_impl(cluster_t &cluster) const noexcept -> outcome:
         return make_error_code(error_code_t::folder_is_not_shared);
     }
 
+    folder_info->release_handles();
     folder_infos.remove(folder_info);
 
     LOG_TRACE(log, "applyging unshare_folder_t, folder {} with device {}", folder_id, peer->device_id());
@@ -175,15 +175,19 @@ auto cluster_update_t::apply_impl(cluster_t &cluster) const noexcept -> outcome:
         assert(folder);
         auto &folder_infos = folder->get_folder_infos();
         auto folder_info = folder_infos.by_device_id(info.device.id());
+        folder_info->release_handles();
         folder_infos.remove(folder_info);
         db::FolderInfo db_fi;
         db_fi.set_index_id(info.device.index_id());
-        db_fi.set_max_sequence(info.device.max_sequence());
         auto opt = folder_info_t::create(cluster.next_uuid(), db_fi, folder_info->get_device(), folder);
         if (!opt) {
             return opt.assume_error();
         }
-        folder_infos.put(opt.assume_value());
+        auto &fi = opt.assume_value();
+        if (auto max_seq = info.device.max_sequence(); max_seq) {
+            fi->set_max_sequence(max_seq);
+        }
+        folder_infos.put(fi);
     }
 
     auto &blocks = cluster.get_blocks();
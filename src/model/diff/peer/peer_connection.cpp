@@ -0,0 +1,33 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "peer_connection.h"
+#include "model/cluster.h"
+#include "model/misc/devices_view.h"
+#include "model/diff/cluster_visitor.h"
+
+using namespace syncspirit::model::diff::peer;
+
+peer_connection_t::peer_connection_t(cluster_t &cluster, std::string_view peer_id_,
+                                     const r::address_ptr_t &peer_addr_, bool connected_) noexcept
+    : peer_id{peer_id_}, peer_addr{peer_addr_}, connected{connected_} {
+    known = (bool)cluster.get_devices().by_sha256(peer_id);
+}
+
+peer_connection_t::peer_connection_t(const devices_view_t &devices, std::string_view peer_id_,
+                                     const r::address_ptr_t &peer_addr_, bool connected_) noexcept
+    : peer_id{peer_id_}, peer_addr{peer_addr_}, connected{connected_} {
+    known = devices.is_known(peer_id);
+}
+
+auto peer_connection_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::result<void> {
+    if (known) {
+        auto peer = cluster.get_devices().by_sha256(peer_id);
+        peer->update_connections(connected);
+    }
+    return outcome::success();
+}
+
+auto peer_connection_t::visit(cluster_visitor_t &visitor, void *custom) const noexcept -> outcome::result<void> {
+    return visitor(*this, custom);
+}
@@ -0,0 +1,35 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <rotor/address.hpp>
+#include "../cluster_diff.h"
+
+namespace syncspirit::model {
+struct devices_view_t;
+}
+
+namespace syncspirit::model::diff::peer {
+
+namespace r = rotor;
+
+/* extra connection of the online peer has been established or lost; the
+ * peer controller stripes block requests over all peer connections */
+struct SYNCSPIRIT_API peer_connection_t final : cluster_diff_t {
+
+    peer_connection_t(cluster_t &cluster, std::string_view peer_id_, const r::address_ptr_t &peer_addr_,
+                      bool connected_) noexcept;
+    peer_connection_t(const devices_view_t &devices, std::string_view peer_id_, const r::address_ptr_t &peer_addr_,
+                      bool connected_) noexcept;
+
+    outcome::result<void> apply_impl(cluster_t &) const noexcept override;
+    outcome::result<void> visit(cluster_visitor_t &, void *custom) const noexcept override;
+
+    std::string peer_id;
+    r::address_ptr_t peer_addr;
+    bool connected;
+    bool known;
+};
+
+} // namespace syncspirit::model::diff::peer
@@ -8,6 +8,10 @@
 #include "model/device.h"
 #include <boost/asio/ip/tcp.hpp>
 
+namespace syncspirit::model {
+struct devices_view_t;
+}
+
 namespace syncspirit::model::diff::peer {
 
 namespace r = rotor;
@@ -17,7 +21,10 @@ struct SYNCSPIRIT_API peer_state_t final : cluster_diff_t {
 
     peer_state_t(cluster_t &cluster, std::string_view peer_id_, const r::address_ptr_t &peer_addr_,
                  model::device_state_t state, std::string cert_name_ = {}, tcp::endpoint endpoint_ = {},
-                 std::string_view client_name_ = {}) noexcept;
+                 std::string_view client_name_ = {}, std::uint64_t session_limit_ = 0) noexcept;
+    peer_state_t(const devices_view_t &devices, std::string_view peer_id_, const r::address_ptr_t &peer_addr_,
+                 model::device_state_t state, std::string cert_name_ = {}, tcp::endpoint endpoint_ = {},
+                 std::string_view client_name_ = {}, std::uint64_t session_limit_ = 0) noexcept;
 
     outcome::result<void> apply_impl(cluster_t &) const noexcept override;
     outcome::result<void> visit(cluster_visitor_t &, void *custom) const noexcept override;
@@ -27,6 +34,8 @@ struct SYNCSPIRIT_API peer_state_t final : cluster_diff_t {
     std::string cert_name;
     tcp::endpoint endpoint;
     std::string client_name;
+    /* of the relay, bytes per second, 0 means no limit */
+    std::uint64_t session_limit;
     model::device_state_t state;
     bool known;
 };
@@ -4,14 +4,15 @@
 #include "update_folder.h"
 #include "model/diff/cluster_visitor.h"
 #include "model/misc/error_code.h"
+#include <algorithm>
 
 using namespace syncspirit::model;
 using namespace syncspirit::model::diff::peer;
 
 update_folder_t::update_folder_t(std::string_view folder_id_, std::string_view peer_id_, files_t files_,
-                                 blocks_t blocks_) noexcept
+                                 blocks_t blocks_, owner_t owner_) noexcept
     : folder_id{std::string(folder_id_)}, peer_id{std::string(peer_id_)}, files{std::move(files_)},
-      blocks{std::move(blocks_)} {}
+      blocks{std::move(blocks_)}, owner{std::move(owner_)} {}
 
 auto update_folder_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::result<void> {
     auto folder = cluster.get_folders().by_id(folder_id);
@@ -19,8 +20,8 @@ auto update_folder_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::
 
     auto &bm = cluster.get_blocks();
     auto blocks_map = block_infos_map_t();
-    for (const auto &b : blocks) {
-        auto opt = block_info_t::create(b);
+    for (auto b : blocks) {
+        auto opt = block_info_t::create(*b);
         if (!opt) {
             return opt.assume_error();
         }
@@ -31,7 +32,8 @@ auto update_folder_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::
     auto max_seq = folder_info->get_max_sequence();
     auto files_map = file_infos_map_t();
     auto &fm = folder_info->get_file_infos();
-    for (const auto &f : files) {
+    for (auto file_ptr : files) {
+        auto &f = *file_ptr;
         auto file = file_info_ptr_t{};
         uuid_t file_uuid;
         auto prev_file = fm.by_name(f.name());
@@ -73,7 +75,8 @@ auto update_folder_t::apply_impl(cluster_t &cluster) const noexcept -> outcome::
     for (auto &it : files_map) {
         folder_info->add(it.item, true);
     }
-    LOG_TRACE(log, "update_folder_t, apply(); max seq: {} -> {}", max_seq, folder_info->get_max_sequence());
+    LOG_TRACE(log, "update_folder_t, apply(); max seq: {} -> {}, received seq: {}", max_seq,
+              folder_info->get_max_sequence(), folder_info->get_received_sequence());
 
     return outcome::success();
 }
@@ -85,10 +88,60 @@ auto update_folder_t::visit(cluster_visitor_t &visitor, void *custom) const noex
 
 using diff_t = diff::cluster_diff_ptr_t;
 
+/* files are ordered by sequence, so the applied chunks are always a prefix of
+ * the index, and it can be resumed from the received sequence */
 template <typename T>
-static auto instantiate(const cluster_t &cluster, const device_t &source, const T &message) noexcept
-    -> outcome::result<diff_t> {
-    auto folder = cluster.get_folders().by_id(message.folder());
+static auto split(const T &message, std::size_t chunk_weight) noexcept -> outcome::result<update_folder_t::chunks_t> {
+    auto files = update_folder_t::files_t();
+    files.reserve(static_cast<size_t>(message.files_size()));
+    for (int i = 0; i < message.files_size(); ++i) {
+        auto &f = message.files(i);
+        if (f.deleted() && f.blocks_size()) {
+            auto log = update_folder_t::get_log();
+            LOG_WARN(log, "file {}, should not have blocks", f.name());
+            return make_error_code(error_code_t::unexpected_blocks);
+        }
+        files.emplace_back(&f);
+    }
+    auto by_sequence = [](const proto::FileInfo *a, const proto::FileInfo *b) { return a->sequence() < b->sequence(); };
+    std::stable_sort(files.begin(), files.end(), by_sequence);
+
+    auto chunks = update_folder_t::chunks_t(1);
+    auto weight = std::size_t{0};
+    for (auto f : files) {
+        auto file_weight = 1 + static_cast<std::size_t>(f->blocks_size());
+        if (chunk_weight && weight && weight + file_weight > chunk_weight) {
+            chunks.emplace_back();
+            weight = 0;
+        }
+        weight += file_weight;
+        chunks.back().emplace_back(f);
+    }
+    return outcome::success(std::move(chunks));
+}
+
+template <typename T>
+static auto instantiate(const cluster_t &cluster, const device_t &source, const T &original,
+                        update_folder_t::owner_t owner) noexcept -> outcome::result<diff_t> {
+    auto message_ptr = &original;
+    if (!owner) {
+        auto copy = std::make_shared<T>(original);
+        message_ptr = copy.get();
+        owner = std::move(copy);
+    }
+    auto &message = *message_ptr;
+
+    auto chunks_opt = split(message, 0);
+    if (!chunks_opt) {
+        return chunks_opt.assume_error();
+    }
+    auto &files = chunks_opt.assume_value().front();
+    return update_folder_t::create(cluster, source, message.folder(), std::move(files), std::move(owner));
+}
+
+auto update_folder_t::create(const cluster_t &cluster, const model::device_t &source, std::string_view folder_id,
+                             files_t files, owner_t owner) noexcept -> outcome::result<cluster_diff_ptr_t> {
+    auto folder = cluster.get_folders().by_id(folder_id);
     if (!folder) {
         return make_error_code(error_code_t::folder_does_not_exist);
     }
@@ -99,37 +152,40 @@ static auto instantiate(const cluster_t &cluster, const device_t &source, const
         return make_error_code(error_code_t::folder_is_not_shared);
     }
 
-    auto max_seq = fi->get_max_sequence();
     auto &blocks = cluster.get_blocks();
-    update_folder_t::files_t files;
     update_folder_t::blocks_t new_blocks;
-    files.reserve(static_cast<size_t>(message.files_size()));
-    for (int i = 0; i < message.files_size(); ++i) {
-        auto &f = message.files(i);
-        if (f.deleted() && f.blocks_size()) {
-            auto log = update_folder_t::get_log();
-            LOG_WARN(log, "file {}, should not have blocks", f.name());
-            return make_error_code(error_code_t::unexpected_blocks);
-        }
-        for (int j = 0; j < f.blocks_size(); ++j) {
-            auto &b = f.blocks(j);
+    for (auto f : files) {
+        for (int j = 0; j < f->blocks_size(); ++j) {
+            auto &b = f->blocks(j);
             if (!blocks.get(b.hash())) {
-                new_blocks.emplace_back(std::move(b));
+                new_blocks.emplace_back(&b);
             }
         }
-        files.emplace_back(std::move(message.files(i)));
     }
 
-    auto diff = diff_t(new update_folder_t(message.folder(), device_id, std::move(files), std::move(new_blocks)));
+    auto diff =
+        diff_t(new update_folder_t(folder_id, device_id, std::move(files), std::move(new_blocks), std::move(owner)));
     return outcome::success(std::move(diff));
 }
 
+auto update_folder_t::prepare(const proto::Index &message, std::size_t chunk_weight) noexcept
+    -> outcome::result<chunks_t> {
+    return split(message, chunk_weight);
+}
+
+auto update_folder_t::prepare(const proto::IndexUpdate &message, std::size_t chunk_weight) noexcept
+    -> outcome::result<chunks_t> {
+    return split(message, chunk_weight);
+}
+
 auto update_folder_t::create(const cluster_t &cluster, const model::device_t &source,
-                             const proto::Index &message) noexcept -> outcome::result<cluster_diff_ptr_t> {
-    return instantiate(cluster, source, message);
+                             const proto::Index &message, owner_t owner) noexcept
+    -> outcome::result<cluster_diff_ptr_t> {
+    return instantiate(cluster, source, message, std::move(owner));
 }
 
 auto update_folder_t::create(const cluster_t &cluster, const model::device_t &source,
-                             const proto::IndexUpdate &message) noexcept -> outcome::result<cluster_diff_ptr_t> {
-    return instantiate(cluster, source, message);
+                             const proto::IndexUpdate &message, owner_t owner) noexcept
+    -> outcome::result<cluster_diff_ptr_t> {
+    return instantiate(cluster, source, message, std::move(owner));
 }
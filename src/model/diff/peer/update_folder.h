@@ -10,23 +10,41 @@
 
 namespace syncspirit::model::diff::peer {
 
+/* Files and blocks refer the original message, which is kept alive by the
+ * owner (e.g. the arena it is decoded into); without the owner the message
+ * is copied.
+ *
+ * The construction of the diff for a large message might be split: the
+ * message is validated and its files are split into chunks without the
+ * model (i.e. on any thread), and then a diff is created for each chunk. */
 struct SYNCSPIRIT_API update_folder_t final : cluster_diff_t {
-    using files_t = std::vector<proto::FileInfo>;
-    using blocks_t = std::vector<proto::BlockInfo>;
+    using files_t = std::vector<const proto::FileInfo *>;
+    using blocks_t = std::vector<const proto::BlockInfo *>;
+    using chunks_t = std::vector<files_t>;
+    using owner_t = std::shared_ptr<const void>;
 
     static outcome::result<cluster_diff_ptr_t> create(const cluster_t &cluster, const model::device_t &source,
-                                                      const proto::Index &message) noexcept;
+                                                      const proto::Index &message, owner_t owner = {}) noexcept;
     static outcome::result<cluster_diff_ptr_t> create(const cluster_t &cluster, const model::device_t &source,
-                                                      const proto::IndexUpdate &message) noexcept;
+                                                      const proto::IndexUpdate &message, owner_t owner = {}) noexcept;
+    static outcome::result<cluster_diff_ptr_t> create(const cluster_t &cluster, const model::device_t &source,
+                                                      std::string_view folder_id, files_t files,
+                                                      owner_t owner) noexcept;
+
+    /* chunk weight is the amount of files and blocks, zero means no limit */
+    static outcome::result<chunks_t> prepare(const proto::Index &message, std::size_t chunk_weight) noexcept;
+    static outcome::result<chunks_t> prepare(const proto::IndexUpdate &message, std::size_t chunk_weight) noexcept;
 
     outcome::result<void> apply_impl(cluster_t &) const noexcept override;
     outcome::result<void> visit(cluster_visitor_t &, void *) const noexcept override;
 
-    update_folder_t(std::string_view folder_id, std::string_view peer_id, files_t files, blocks_t blocks) noexcept;
+    update_folder_t(std::string_view folder_id, std::string_view peer_id, files_t files, blocks_t blocks,
+                    owner_t owner) noexcept;
     std::string folder_id;
     std::string peer_id;
     files_t files;
     blocks_t blocks;
+    owner_t owner;
 };
 
 } // namespace syncspirit::model::diff::peer
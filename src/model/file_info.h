@@ -9,6 +9,7 @@
 #include <boost/filesystem.hpp>
 #include <boost/outcome.hpp>
 #include "misc/arc.hpp"
+#include "misc/file_handle.h"
 #include "misc/map.hpp"
 #include "misc/uuid.h"
 #include "block_info.h"
@@ -121,6 +122,9 @@ struct SYNCSPIRIT_API file_info_t final : arc_base_t<file_info_t> {
     file_info_ptr_t get_source() const noexcept;
     void set_source(const file_info_ptr_t &peer_file) noexcept;
 
+    inline const file_handle_t &get_handle() const noexcept { return handle; }
+    inline void set_handle(const file_handle_t &value) noexcept { handle = value; }
+
     static const constexpr auto data_length = 1 + uuid_length * 2;
 
     outcome::result<void> fields_update(const db::FileInfo &) noexcept;
@@ -164,6 +168,7 @@ struct SYNCSPIRIT_API file_info_t final : arc_base_t<file_info_t> {
     marks_vector_t marks;
     size_t missing_blocks;
     std::string source_device;
+    file_handle_t handle;
 
     friend struct blocks_iterator_t;
 };
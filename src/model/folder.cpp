@@ -82,7 +82,7 @@ std::optional<proto::Folder> folder_t::generate(const model::device_t &device) c
         if (auto cn = d.get_cert_name(); cn) {
             pd.set_cert_name(cn.value());
         }
-        std::int64_t max_seq = fi.get_max_sequence();
+        std::int64_t max_seq = fi.get_received_sequence();
         pd.set_max_sequence(max_seq);
         pd.set_index_id(fi.get_index());
         pd.set_introducer(d.is_introducer());
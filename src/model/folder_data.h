@@ -14,10 +14,12 @@ namespace bfs = boost::filesystem;
 
 struct SYNCSPIRIT_API folder_data_t {
     enum class foldet_type_t { send = 0, receive, send_and_receive };
-    enum class pull_order_t { random = 0, alphabetic, largest, oldest, newest };
+    enum class pull_order_t { random = 0, alphabetic, smallest, largest, oldest, newest };
 
     const std::string &get_label() noexcept { return label; }
     std::string_view get_id() const noexcept { return id; }
+    pull_order_t get_pull_order() const noexcept { return pull_order; }
+    bool is_temp_indexes_disabled() const noexcept { return disable_temp_indixes; }
 
   protected:
     inline const bfs::path &get_path() noexcept { return path; }
@@ -66,6 +66,7 @@ folder_info_t::folder_info_t(const uuid_t &uuid, const device_ptr_t &device_, co
 void folder_info_t::assign_fields(const db::FolderInfo &fi) noexcept {
     index = fi.index_id();
     max_sequence = fi.max_sequence();
+    received_sequence = max_sequence;
     actualized = max_sequence == 0;
 }
 
@@ -81,8 +82,27 @@ bool folder_info_t::operator==(const folder_info_t &other) const noexcept {
 }
 
 void folder_info_t::add(const file_info_ptr_t &file_info, bool inc_max_sequence) noexcept {
+    auto cluster = folder ? folder->get_cluster() : nullptr;
+    if (cluster) {
+        /* the newer version of the file takes over the handle of the previous one */
+        auto &table = cluster->get_file_table();
+        auto prev = file_infos.by_name(file_info->get_name());
+        if (!prev) {
+            prev = file_infos.get<0>(file_info->get_uuid());
+        }
+        if (prev && prev->get_handle()) {
+            if (prev != file_info) {
+                table.assign(prev->get_handle(), *file_info);
+            }
+        } else {
+            table.acquire(*file_info);
+        }
+    }
     file_infos.put(file_info);
     auto seq = file_info->get_sequence();
+    if (seq > received_sequence) {
+        received_sequence = seq;
+    }
     if (inc_max_sequence && seq > max_sequence) {
         max_sequence = seq;
         actualized = true;
@@ -92,10 +112,21 @@ void folder_info_t::add(const file_info_ptr_t &file_info, bool inc_max_sequence)
     }
 }
 
+void folder_info_t::release_handles() noexcept {
+    auto cluster = folder ? folder->get_cluster() : nullptr;
+    if (!cluster) {
+        return;
+    }
+    auto &table = cluster->get_file_table();
+    for (auto &it : file_infos) {
+        table.release(it.item->get_handle());
+    }
+}
+
 std::string folder_info_t::serialize() noexcept {
     db::FolderInfo r;
     r.set_index_id(index);
-    r.set_max_sequence(max_sequence);
+    r.set_max_sequence(received_sequence);
     return r.SerializeAsString();
 }
 
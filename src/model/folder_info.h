@@ -35,6 +35,8 @@ struct SYNCSPIRIT_API folder_info_t final : arc_base_t<folder_info_t> {
     bool operator!=(const folder_info_t &other) const noexcept { return !(*this == other); }
 
     void add(const file_info_ptr_t &file_info, bool inc_max_sequence) noexcept;
+    /* frees the cluster file table slots of the files, when the folder info is removed */
+    void release_handles() noexcept;
     std::string serialize() noexcept;
 
     inline std::uint64_t get_index() const noexcept { return index; }
@@ -42,6 +44,7 @@ struct SYNCSPIRIT_API folder_info_t final : arc_base_t<folder_info_t> {
     inline device_t *get_device() const noexcept { return device; }
     inline folder_t *get_folder() const noexcept { return folder; }
     inline std::int64_t get_max_sequence() const noexcept { return max_sequence; }
+    inline std::int64_t get_received_sequence() const noexcept { return received_sequence; }
     void set_max_sequence(std::int64_t value) noexcept;
     inline file_infos_map_t &get_file_infos() noexcept { return file_infos; }
     bool is_actual() noexcept;
@@ -57,7 +60,11 @@ struct SYNCSPIRIT_API folder_info_t final : arc_base_t<folder_info_t> {
     char key[data_length];
 
     std::uint64_t index;
+    /* max sequence is the announced one, while the received sequence is the
+     * sequence of files, which have actually been added, i.e. it is the point
+     * to resume the peer index from */
     std::int64_t max_sequence;
+    std::int64_t received_sequence;
     device_t *device;
     folder_t *folder;
     file_infos_map_t file_infos;
@@ -39,6 +39,15 @@ struct block_update_t {
     const void *custom;
 };
 
+/* see diff_router_t; the subscription is cancelled, when subscribe is false */
+struct model_interest_t {
+    r::address_ptr_t subscriber;
+    const void *owner;
+    std::string peer_id;
+    std::uint32_t kinds;
+    bool subscribe;
+};
+
 struct contact_update_t {
     model::diff::contact_diff_ptr_t diff;
     const void *custom;
@@ -54,6 +63,7 @@ namespace message {
 
 using model_update_t = r::message_t<payload::model_update_t>;
 using block_update_t = r::message_t<payload::block_update_t>;
+using model_interest_t = r::message_t<payload::model_interest_t>;
 using contact_update_t = r::message_t<payload::contact_update_t>;
 using io_error_t = r::message_t<payload::io_error_t>;
 
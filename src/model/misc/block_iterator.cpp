@@ -21,7 +21,7 @@ void blocks_iterator_t::advance() noexcept {
     auto &sb = source->get_blocks();
     auto max = sb.size();
     while (i < max && sb[i]) {
-        if (!source->is_locally_available(i) && !sb[i]->is_locked()) {
+        if (!source->is_locally_available(i)) {
             break;
         }
         ++i;
@@ -0,0 +1,117 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "devices_view.h"
+#include "../cluster.h"
+#include "../diff/cluster_visitor.h"
+#include "../diff/contact_visitor.h"
+#include "../diff/load/load_cluster.h"
+#include "../diff/modify/dial_result.h"
+#include "../diff/modify/update_contact.h"
+#include "../diff/modify/update_peer.h"
+#include "../diff/peer/peer_connection.h"
+#include "../diff/peer/peer_state.h"
+#include <vector>
+
+using namespace syncspirit::model;
+
+namespace {
+
+using result_t = outcome::result<void>;
+
+/* collects devices, which are affected by a diff (and by its sub-diffs) */
+struct resolver_t final : diff::cluster_visitor_t, diff::contact_visitor_t {
+    result_t add(std::string_view sha256) noexcept {
+        peers.emplace_back(sha256);
+        return outcome::success();
+    }
+
+    result_t operator()(const diff::load::load_cluster_t &, void *) noexcept override {
+        all = true;
+        return outcome::success();
+    }
+    result_t operator()(const diff::peer::peer_state_t &diff, void *) noexcept override { return add(diff.peer_id); }
+    result_t operator()(const diff::peer::peer_connection_t &diff, void *) noexcept override {
+        return add(diff.peer_id);
+    }
+    result_t operator()(const diff::modify::update_peer_t &diff, void *) noexcept override {
+        return add(diff.peer_id);
+    }
+    result_t operator()(const diff::modify::update_contact_t &diff, void *) noexcept override {
+        return add(diff.device.get_sha256());
+    }
+    result_t operator()(const diff::modify::dial_result_t &diff, void *) noexcept override {
+        return add(diff.peer_id);
+    }
+
+    std::vector<std::string_view> peers;
+    bool all = false;
+};
+
+} // namespace
+
+device_id_t devices_view_t::get_self() const noexcept {
+    auto lock = std::lock_guard(mutex);
+    return self;
+}
+
+auto devices_view_t::get(std::string_view sha256) const noexcept -> device_option_t {
+    auto lock = std::lock_guard(mutex);
+    auto it = devices.find(std::string(sha256));
+    if (it == devices.end()) {
+        return {};
+    }
+    return it->second;
+}
+
+bool devices_view_t::is_known(std::string_view sha256) const noexcept {
+    auto lock = std::lock_guard(mutex);
+    return devices.count(std::string(sha256));
+}
+
+void devices_view_t::update(const cluster_t &cluster) noexcept {
+    auto lock = std::lock_guard(mutex);
+    self = cluster.get_device()->device_id();
+    devices.clear();
+    for (auto &it : cluster.get_devices()) {
+        update(cluster, it.item->device_id().get_sha256());
+    }
+}
+
+void devices_view_t::update(const cluster_t &cluster, const diff::cluster_diff_t &diff) noexcept {
+    auto resolver = resolver_t();
+    auto r = diff.visit(static_cast<diff::cluster_visitor_t &>(resolver), nullptr);
+    (void)r;
+    if (resolver.all) {
+        return update(cluster);
+    }
+    auto lock = std::lock_guard(mutex);
+    for (auto peer_id : resolver.peers) {
+        update(cluster, peer_id);
+    }
+}
+
+void devices_view_t::update(const cluster_t &cluster, const diff::contact_diff_t &diff) noexcept {
+    auto resolver = resolver_t();
+    auto r = diff.visit(static_cast<diff::contact_visitor_t &>(resolver), nullptr);
+    (void)r;
+    auto lock = std::lock_guard(mutex);
+    for (auto peer_id : resolver.peers) {
+        update(cluster, peer_id);
+    }
+}
+
+/* the lock is held by the caller */
+void devices_view_t::update(const cluster_t &cluster, std::string_view sha256) noexcept {
+    auto device = cluster.get_devices().by_sha256(sha256);
+    if (!device) {
+        devices.erase(std::string(sha256));
+        return;
+    }
+    auto &view = devices[std::string(sha256)];
+    view.device_id = device->device_id();
+    view.state = device->get_state();
+    view.extra_connections = device->get_extra_connections();
+    view.uris = device->get_uris();
+    view.dial_history = device->get_dial_history();
+}
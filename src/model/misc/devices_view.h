@@ -0,0 +1,66 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include "../device.h"
+#include "../device_id.h"
+#include "../diff/cluster_diff.h"
+#include "../diff/contact_diff.h"
+#include "syncspirit-export.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace syncspirit::model {
+
+struct cluster_t;
+
+/* Identity and connection state of the devices for the net threads.
+ *
+ * Peers, served on the net threads, need neither folders nor files, so
+ * instead of the full cluster replica they read this view. It is written
+ * by the coordinator only, right after a diff has been applied to the
+ * cluster, and it is shared by all threads, i.e. they see the same state
+ * as the coordinator does.
+ *
+ * Only plain values are kept (no model pointers), and they are copied out
+ * under the lock.
+ */
+struct SYNCSPIRIT_API devices_view_t {
+    struct device_t {
+        device_id_t device_id;
+        device_state_t state = device_state_t::offline;
+        std::uint32_t extra_connections = 0;
+        model::device_t::uris_t uris;
+        model::device_t::dial_history_t dial_history;
+    };
+    using device_option_t = std::optional<device_t>;
+
+    device_id_t get_self() const noexcept;
+    device_option_t get(std::string_view sha256) const noexcept;
+    bool is_known(std::string_view sha256) const noexcept;
+
+    /* the coordinator side */
+    void update(const cluster_t &cluster) noexcept;
+    void update(const cluster_t &cluster, const diff::cluster_diff_t &diff) noexcept;
+    void update(const cluster_t &cluster, const diff::contact_diff_t &diff) noexcept;
+
+  private:
+    using devices_t = std::unordered_map<std::string, device_t>;
+
+    void update(const cluster_t &cluster, std::string_view sha256) noexcept;
+
+    mutable std::mutex mutex;
+    device_id_t self;
+    devices_t devices;
+};
+
+using devices_view_ptr_t = std::shared_ptr<devices_view_t>;
+
+} // namespace syncspirit::model
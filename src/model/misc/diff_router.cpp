@@ -0,0 +1,199 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "diff_router.h"
+#include "../folder.h"
+#include "../folder_info.h"
+#include "../diff/cluster_visitor.h"
+#include "../diff/block_visitor.h"
+#include "../diff/load/load_cluster.h"
+#include "../diff/modify/append_block.h"
+#include "../diff/modify/block_ack.h"
+#include "../diff/modify/block_rej.h"
+#include "../diff/modify/blocks_availability.h"
+#include "../diff/modify/clone_block.h"
+#include "../diff/modify/clone_file.h"
+#include "../diff/modify/create_folder.h"
+#include "../diff/modify/file_availability.h"
+#include "../diff/modify/finish_file.h"
+#include "../diff/modify/finish_file_ack.h"
+#include "../diff/modify/local_update.h"
+#include "../diff/modify/lock_file.h"
+#include "../diff/modify/mark_reachable.h"
+#include "../diff/modify/share_folder.h"
+#include "../diff/modify/unshare_folder.h"
+#include "../diff/modify/update_peer.h"
+#include "../diff/peer/cluster_remove.h"
+#include "../diff/peer/cluster_update.h"
+#include "../diff/peer/peer_connection.h"
+#include "../diff/peer/peer_state.h"
+#include "../diff/peer/update_folder.h"
+#include <algorithm>
+
+using namespace syncspirit::model;
+
+namespace {
+
+using kind_t = diff_router_t::kind_t;
+using scopes_t = diff_router_t::scopes_t;
+using result_t = outcome::result<void>;
+
+/* collects kinds, folders and peers of a diff (and of its sub-diffs) */
+struct resolver_t final : diff::cluster_visitor_t, diff::block_visitor_t {
+    result_t add(kind_t kind, std::string_view folder_id = {}, std::string_view peer_id = {}) noexcept {
+        scopes.emplace_back(diff_router_t::scope_t{kind, folder_id, peer_id});
+        return outcome::success();
+    }
+
+    result_t operator()(const diff::load::load_cluster_t &, void *) noexcept override {
+        return add(kind_t::load_cluster);
+    }
+    result_t operator()(const diff::peer::cluster_remove_t &diff, void *) noexcept override {
+        return add(kind_t::cluster_remove, {}, diff.source_device);
+    }
+    result_t operator()(const diff::peer::cluster_update_t &diff, void *) noexcept override {
+        return add(kind_t::cluster_update, {}, diff.source_peer.device_id().get_sha256());
+    }
+    result_t operator()(const diff::peer::peer_state_t &diff, void *) noexcept override {
+        return add(kind_t::peer_state, {}, diff.peer_id);
+    }
+    result_t operator()(const diff::peer::peer_connection_t &diff, void *) noexcept override {
+        return add(kind_t::peer_connection, {}, diff.peer_id);
+    }
+    result_t operator()(const diff::peer::update_folder_t &diff, void *) noexcept override {
+        return add(kind_t::update_folder, diff.folder_id, diff.peer_id);
+    }
+    result_t operator()(const diff::modify::clone_file_t &diff, void *) noexcept override {
+        return add(kind_t::clone_file, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::create_folder_t &, void *) noexcept override {
+        return add(kind_t::create_folder);
+    }
+    result_t operator()(const diff::modify::file_availability_t &diff, void *) noexcept override {
+        return add(kind_t::file_availability, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::finish_file_t &diff, void *) noexcept override {
+        return add(kind_t::finish_file, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::finish_file_ack_t &diff, void *) noexcept override {
+        return add(kind_t::finish_file_ack, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::lock_file_t &diff, void *) noexcept override {
+        return add(kind_t::lock_file, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::mark_reachable_t &diff, void *) noexcept override {
+        return add(kind_t::mark_reachable, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::local_update_t &diff, void *) noexcept override {
+        return add(kind_t::local_update, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::share_folder_t &diff, void *) noexcept override {
+        return add(kind_t::share_folder, diff.folder_id, diff.peer_id);
+    }
+    result_t operator()(const diff::modify::unshare_folder_t &diff, void *) noexcept override {
+        return add(kind_t::unshare_folder, diff.folder_id, diff.peer_id);
+    }
+    result_t operator()(const diff::modify::update_peer_t &diff, void *) noexcept override {
+        return add(kind_t::update_peer, {}, diff.peer_id);
+    }
+
+    result_t operator()(const diff::modify::append_block_t &diff, void *) noexcept override {
+        return add(kind_t::append_block, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::block_ack_t &diff, void *) noexcept override {
+        return add(kind_t::block_ack, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::block_rej_t &diff, void *) noexcept override {
+        return add(kind_t::block_rej, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::blocks_availability_t &diff, void *) noexcept override {
+        return add(kind_t::blocks_availability, diff.folder_id);
+    }
+    result_t operator()(const diff::modify::clone_block_t &diff, void *) noexcept override {
+        return add(kind_t::clone_block, diff.folder_id);
+    }
+
+    scopes_t scopes;
+};
+
+} // namespace
+
+void diff_router_t::add(r::address_ptr_t address, const void *owner, std::string_view peer_id,
+                        std::uint32_t kinds) noexcept {
+    if (owner) {
+        owners[owner] = address;
+    }
+    subscribers.emplace(std::string(peer_id), subscriber_t{std::move(address), owner, kinds});
+}
+
+void diff_router_t::remove(const r::address_ptr_t &address) noexcept {
+    for (auto it = subscribers.begin(); it != subscribers.end();) {
+        if (it->second.address == address) {
+            owners.erase(it->second.owner);
+            it = subscribers.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+auto diff_router_t::route(const cluster_t &cluster, const diff::cluster_diff_t &diff, const void *custom) const noexcept
+    -> addresses_t {
+    auto resolver = resolver_t();
+    auto r = diff.visit(static_cast<diff::cluster_visitor_t &>(resolver), nullptr);
+    (void)r;
+    return route(cluster, resolver.scopes, custom);
+}
+
+auto diff_router_t::route(const cluster_t &cluster, const diff::block_diff_t &diff, const void *custom) const noexcept
+    -> addresses_t {
+    auto resolver = resolver_t();
+    auto r = diff.visit(static_cast<diff::block_visitor_t &>(resolver), nullptr);
+    (void)r;
+    return route(cluster, resolver.scopes, custom);
+}
+
+auto diff_router_t::route(const cluster_t &cluster, const scopes_t &scopes, const void *custom) const noexcept
+    -> addresses_t {
+    auto addresses = addresses_t();
+    auto push = [&](const r::address_ptr_t &address) {
+        if (std::find(addresses.begin(), addresses.end(), address) == addresses.end()) {
+            addresses.emplace_back(address);
+        }
+    };
+    auto push_peer = [&](std::string_view peer_id, std::uint32_t kind) {
+        auto [it, end] = subscribers.equal_range(std::string(peer_id));
+        for (; it != end; ++it) {
+            if (it->second.kinds & kind) {
+                push(it->second.address);
+            }
+        }
+    };
+
+    if (custom) {
+        if (auto it = owners.find(custom); it != owners.end()) {
+            push(it->second);
+        }
+    }
+
+    for (auto &scope : scopes) {
+        if (!scope.peer_id.empty()) {
+            push_peer(scope.peer_id, scope.kind);
+        } else if (!scope.folder_id.empty()) {
+            auto folder = cluster.get_folders().by_id(scope.folder_id);
+            if (!folder) {
+                continue;
+            }
+            for (auto &it : folder->get_folder_infos()) {
+                push_peer(it.item->get_device()->device_id().get_sha256(), scope.kind);
+            }
+        } else {
+            for (auto &it : subscribers) {
+                if (it.second.kinds & scope.kind) {
+                    push(it.second.address);
+                }
+            }
+        }
+    }
+    return addresses;
+}
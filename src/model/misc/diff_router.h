@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include "../cluster.h"
+#include "../diff/cluster_diff.h"
+#include "../diff/block_diff.h"
+#include "syncspirit-export.h"
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <rotor/address.hpp>
+
+namespace syncspirit::model {
+
+namespace r = rotor;
+
+/* Dispatches applied diffs to the interested subscribers only, instead of
+ * broadcasting them to everyone.
+ *
+ * A subscriber (e.g. peer controller) declares the peer and the diff kinds
+ * it is interested in. It gets the diffs it has originated itself (i.e. the
+ * diff custom is the subscriber owner) and the diffs of the declared kinds,
+ * which concern the peer or a folder shared with the peer. Diffs without
+ * a particular folder or peer go to everyone interested in their kind.
+ *
+ * So the dispatching cost of a diff is proportional to the amount of
+ * interested subscribers.
+ */
+struct SYNCSPIRIT_API diff_router_t {
+    enum kind_t : std::uint32_t {
+        load_cluster = 1 << 0,
+        cluster_remove = 1 << 1,
+        cluster_update = 1 << 2,
+        peer_state = 1 << 3,
+        peer_connection = 1 << 4,
+        update_folder = 1 << 5,
+        clone_file = 1 << 6,
+        create_folder = 1 << 7,
+        file_availability = 1 << 8,
+        finish_file = 1 << 9,
+        finish_file_ack = 1 << 10,
+        lock_file = 1 << 11,
+        mark_reachable = 1 << 12,
+        local_update = 1 << 13,
+        share_folder = 1 << 14,
+        unshare_folder = 1 << 15,
+        update_peer = 1 << 16,
+        append_block = 1 << 17,
+        block_ack = 1 << 18,
+        block_rej = 1 << 19,
+        blocks_availability = 1 << 20,
+        clone_block = 1 << 21,
+    };
+    static const constexpr std::uint32_t all_kinds = (1 << 22) - 1;
+
+    using addresses_t = std::vector<r::address_ptr_t>;
+
+    void add(r::address_ptr_t address, const void *owner, std::string_view peer_id, std::uint32_t kinds) noexcept;
+    void remove(const r::address_ptr_t &address) noexcept;
+
+    addresses_t route(const cluster_t &cluster, const diff::cluster_diff_t &diff, const void *custom) const noexcept;
+    addresses_t route(const cluster_t &cluster, const diff::block_diff_t &diff, const void *custom) const noexcept;
+
+    struct scope_t {
+        std::uint32_t kind;
+        std::string_view folder_id;
+        std::string_view peer_id;
+    };
+    using scopes_t = std::vector<scope_t>;
+
+  private:
+    struct subscriber_t {
+        r::address_ptr_t address;
+        const void *owner;
+        std::uint32_t kinds;
+    };
+    using subscribers_t = std::unordered_multimap<std::string, subscriber_t>;
+    using owners_t = std::unordered_map<const void *, r::address_ptr_t>;
+
+    addresses_t route(const cluster_t &cluster, const scopes_t &scopes, const void *custom) const noexcept;
+
+    subscribers_t subscribers;
+    owners_t owners;
+};
+
+} // namespace syncspirit::model
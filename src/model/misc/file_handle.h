@@ -0,0 +1,24 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <cstdint>
+
+namespace syncspirit::model {
+
+/* Index of a file in the cluster file table; the generation is checked
+ * on resolving, so a stale handle (the file has gone) resolves to nothing.
+ * The zero generation is never issued, i.e. the default handle is invalid.
+ */
+struct file_handle_t {
+    std::uint32_t index = 0;
+    std::uint32_t generation = 0;
+
+    inline explicit operator bool() const noexcept { return generation != 0; }
+    inline bool operator==(const file_handle_t &other) const noexcept {
+        return index == other.index && generation == other.generation;
+    }
+};
+
+} // namespace syncspirit::model
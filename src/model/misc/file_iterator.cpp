@@ -1,8 +1,9 @@
 // SPDX-License-Identifier: GPL-3.0-or-later
-// SPDX-FileCopyrightText: 2019-2023 Ivan Baidakou
+// SPDX-FileCopyrightText: 2019-2024 Ivan Baidakou
 
 #include "file_iterator.h"
 #include "../cluster.h"
+#include <tuple>
 
 using namespace syncspirit::model;
 
@@ -12,6 +13,36 @@ file_iterator_t::file_iterator_t(cluster_t &cluster_, const device_ptr_t &peer_)
     prepare();
 }
 
+bool file_iterator_t::item_comparator_t::operator()(const item_t &lhs, const item_t &rhs) const noexcept {
+    /* std::priority_queue is max-heap, so the comparison is reversed */
+    return std::tie(rhs.kind, rhs.weight, rhs.name, rhs.seq) < std::tie(lhs.kind, lhs.weight, lhs.name, lhs.seq);
+}
+
+void file_iterator_t::push(file_info_t &file, kind_t kind) noexcept {
+    using order_t = folder_data_t::pull_order_t;
+    auto item = item_t{kind, 0, {}, seq++, &file};
+    switch (file.get_folder_info()->get_folder()->get_pull_order()) {
+    case order_t::alphabetic:
+        item.name = file.get_name();
+        break;
+    case order_t::smallest:
+        item.weight = file.get_size();
+        break;
+    case order_t::largest:
+        item.weight = -file.get_size();
+        break;
+    case order_t::oldest:
+        item.weight = file.get_modified_s();
+        break;
+    case order_t::newest:
+        item.weight = -file.get_modified_s();
+        break;
+    default:
+        break;
+    }
+    queue.emplace(std::move(item));
+}
+
 void file_iterator_t::append(file_info_t &file) noexcept {
     bool skip = file.is_locally_locked() || file.is_locked() || file.is_unreachable() || file.is_invalid();
     if (skip) {
@@ -25,7 +56,7 @@ void file_iterator_t::append(file_info_t &file) noexcept {
     if (!local_file) {
         if (!missing_done.count(&file)) {
             missing_done.emplace(&file);
-            missing.push_back(&file);
+            push(file, kind_t::missing);
         }
         return;
     }
@@ -35,12 +66,12 @@ void file_iterator_t::append(file_info_t &file) noexcept {
     }
     if (local_file->is_partly_available()) {
         if (!incomplete_done.count(&file)) {
-            incomplete.push_back(&file);
+            push(file, kind_t::incomplete);
             incomplete_done.emplace(&file);
         }
     } else {
         if (!needed_done.count(&file)) {
-            needed.push_back(&file);
+            push(file, kind_t::needed);
             needed_done.emplace(&file);
         }
     }
@@ -72,19 +103,9 @@ void file_iterator_t::renew(file_info_t &f) noexcept {
 }
 
 void file_iterator_t::prepare() noexcept {
-    if (!incomplete.empty()) {
-        file = incomplete.front();
-        incomplete.pop_front();
-        return;
-    }
-    if (!needed.empty()) {
-        file = needed.front();
-        needed.pop_front();
-        return;
-    }
-    while (!missing.empty()) {
-        file = missing.front();
-        missing.pop_front();
+    if (!queue.empty()) {
+        file = queue.top().file;
+        queue.pop();
         return;
     }
     file = nullptr;
@@ -8,7 +8,10 @@
 #include "../folder_info.h"
 #include "../folder.h"
 #include "syncspirit-export.h"
-#include <deque>
+#include <cstdint>
+#include <queue>
+#include <string_view>
+#include <vector>
 
 namespace syncspirit::model {
 
@@ -26,18 +29,37 @@ struct SYNCSPIRIT_API file_iterator_t : arc_base_t<file_iterator_t> {
     void renew(file_info_t &file) noexcept;
 
   private:
-    using queue_t = std::deque<file_info_ptr_t>;
+    /* partly downloaded files go first, then outdated, then missing ones */
+    enum class kind_t { incomplete = 0, needed, missing };
+
+    /* within the same kind files are ordered according to the folder
+     * pull order: the weight is size or modification time (negated for
+     * the descending orders), the name is used for alphabetic order, and
+     * the arrival sequence for random order and as a tie-breaker */
+    struct item_t {
+        kind_t kind;
+        std::int64_t weight;
+        std::string_view name;
+        std::uint64_t seq;
+        file_info_ptr_t file;
+    };
+
+    struct item_comparator_t {
+        bool operator()(const item_t &lhs, const item_t &rhs) const noexcept;
+    };
+
+    using queue_t = std::priority_queue<item_t, std::vector<item_t>, item_comparator_t>;
     using set_t = std::unordered_set<file_info_ptr_t>;
 
     void prepare() noexcept;
     void append(file_info_t &file) noexcept;
+    void push(file_info_t &file, kind_t kind) noexcept;
 
     cluster_t &cluster;
     device_ptr_t peer;
     file_info_ptr_t file;
-    queue_t missing;
-    queue_t incomplete;
-    queue_t needed;
+    queue_t queue;
+    std::uint64_t seq = 0;
     set_t missing_done;
     set_t incomplete_done;
     set_t needed_done;
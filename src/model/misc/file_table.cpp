@@ -0,0 +1,70 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "file_table.h"
+#include "../folder_info.h"
+#include "../folder.h"
+#include "../device.h"
+#include <cassert>
+
+using namespace syncspirit::model;
+
+file_handle_t file_table_t::acquire(file_info_t &file) noexcept {
+    auto index = std::uint32_t{0};
+    if (!free_slots.empty()) {
+        index = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        index = static_cast<std::uint32_t>(slots.size());
+        slots.emplace_back();
+    }
+    auto &slot = slots[index];
+    slot.file = &file;
+    auto handle = file_handle_t{index, slot.generation};
+    file.set_handle(handle);
+    return handle;
+}
+
+void file_table_t::assign(const file_handle_t &handle, file_info_t &file) noexcept {
+    assert(get(handle));
+    slots[handle.index].file = &file;
+    file.set_handle(handle);
+}
+
+void file_table_t::release(const file_handle_t &handle) noexcept {
+    if (!get(handle)) {
+        return;
+    }
+    auto &slot = slots[handle.index];
+    slot.file->set_handle({});
+    slot.file.reset();
+    if (++slot.generation == 0) {
+        slot.generation = 1;
+    }
+    free_slots.emplace_back(handle.index);
+}
+
+file_info_t *file_table_t::get(const file_handle_t &handle) const noexcept {
+    if (handle.index >= slots.size()) {
+        return nullptr;
+    }
+    auto &slot = slots[handle.index];
+    if (slot.generation != handle.generation) {
+        return nullptr;
+    }
+    return slot.file.get();
+}
+
+file_info_t *file_table_t::get(const file_handle_t &handle, std::string_view folder_id, std::string_view device_id,
+                               std::string_view name) const noexcept {
+    auto file = get(handle);
+    if (!file || file->get_name() != name) {
+        return nullptr;
+    }
+    auto folder_info = file->get_folder_info();
+    if (!folder_info || folder_info->get_folder()->get_id() != folder_id ||
+        folder_info->get_device()->device_id().get_sha256() != device_id) {
+        return nullptr;
+    }
+    return file;
+}
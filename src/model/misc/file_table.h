@@ -0,0 +1,49 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include "file_handle.h"
+#include "../file_info.h"
+#include "syncspirit-export.h"
+
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+namespace syncspirit::model {
+
+/* Cluster-wide table of files, which lets diffs refer to a file via handle
+ * instead of folder id, device id and file name lookups.
+ *
+ * Slots are acquired and released only when diffs are applied. As every
+ * cluster copy applies the same diffs in the same order, a handle, created
+ * against one copy, refers to the same file in every other copy.
+ *
+ * When a file is replaced by its newer version (the same name), the new
+ * file takes over the slot and the handle of the previous one.
+ */
+struct SYNCSPIRIT_API file_table_t {
+    file_handle_t acquire(file_info_t &file) noexcept;
+    void assign(const file_handle_t &handle, file_info_t &file) noexcept;
+    void release(const file_handle_t &handle) noexcept;
+    file_info_t *get(const file_handle_t &handle) const noexcept;
+    /* as above, but the file must also match the folder, device and name,
+     * which the handle has been taken for */
+    file_info_t *get(const file_handle_t &handle, std::string_view folder_id, std::string_view device_id,
+                     std::string_view name) const noexcept;
+    inline std::size_t size() const noexcept { return slots.size() - free_slots.size(); }
+
+  private:
+    struct slot_t {
+        file_info_ptr_t file;
+        std::uint32_t generation = 1;
+    };
+    using slots_t = std::vector<slot_t>;
+    using free_slots_t = std::vector<std::uint32_t>;
+
+    slots_t slots;
+    free_slots_t free_slots;
+};
+
+} // namespace syncspirit::model
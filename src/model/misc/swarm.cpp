@@ -0,0 +1,299 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "swarm.h"
+#include "version_utils.h"
+#include "../folder.h"
+#include "../folder_info.h"
+#include "../block_info.h"
+#include <algorithm>
+
+using namespace syncspirit::model;
+
+namespace {
+/* how often the peer throughput is re-estimated, in seconds */
+static constexpr double rate_period = 1.0;
+} // namespace
+
+std::string swarm_t::make_key(const file_info_t &file) noexcept {
+    auto folder = file.get_folder_info()->get_folder();
+    auto key = std::string(folder->get_id());
+    key += '/';
+    key += file.get_name();
+    return key;
+}
+
+auto swarm_t::find(const file_info_t &file) noexcept -> entry_t * {
+    auto it = entries.find(make_key(file));
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+auto swarm_t::find(const file_info_t &file) const noexcept -> const entry_t * {
+    auto it = entries.find(make_key(file));
+    return it != entries.end() ? &it->second : nullptr;
+}
+
+void swarm_t::add(file_info_t &source, wakeup_t wakeup) noexcept {
+    auto &entry = entries[make_key(source)];
+    entry = entry_t{&source, std::move(wakeup), {}, {}, {}, source.get_blocks().size()};
+}
+
+void swarm_t::remove(const file_info_t &source) noexcept { entries.erase(make_key(source)); }
+
+bool swarm_t::is_pulled(const file_info_t &file) const noexcept { return find(file) != nullptr; }
+
+bool swarm_t::is_busy(const file_info_t &source) const noexcept {
+    auto entry = find(source);
+    return entry && (!entry->requested.empty() || !entry->returned.empty());
+}
+
+bool swarm_t::is_wanted(const file_info_t &source, std::size_t block_index) const noexcept {
+    auto &block = source.get_blocks()[block_index];
+    return block && !source.is_locally_available(block_index) && !is_fetching(*block);
+}
+
+file_block_t swarm_t::take_returned(const file_info_t &source) noexcept {
+    auto entry = find(source);
+    return entry ? take_returned(*entry, false) : file_block_t{};
+}
+
+file_block_t swarm_t::take_returned(entry_t &entry, bool helper) noexcept {
+    auto &file = *entry.source;
+    auto &blocks = file.get_blocks();
+    auto &returned = entry.returned;
+    for (auto it = returned.rbegin(); it != returned.rend();) {
+        auto i = *it;
+        if (helper && blocks[i] && is_fetching(*blocks[i])) {
+            /* leave it to the owner, which waits for the fetch */
+            ++it;
+            continue;
+        }
+        it = decltype(it)(returned.erase(std::next(it).base()));
+        if (blocks[i] && !file.is_locally_available(i)) {
+            return {blocks[i].get(), &file, i};
+        }
+    }
+    return {};
+}
+
+auto swarm_t::find_temp(device_t &peer, const std::string &key, const proto::Vector &version) const noexcept
+    -> const temp_file_t * {
+    auto it = progress.find(device_ptr_t(&peer));
+    if (it == progress.end()) {
+        return nullptr;
+    }
+    auto &temp_files = it->second;
+    auto file_it = temp_files.find(key);
+    if (file_it == temp_files.end()) {
+        return nullptr;
+    }
+    auto &temp = file_it->second;
+    return compare(temp.version, version) == version_relation_t::identity ? &temp : nullptr;
+}
+
+auto swarm_t::next_block(device_t &peer) noexcept -> assignment_t {
+    auto device = device_ptr_t(&peer);
+    for (auto &it : entries) {
+        auto &entry = it.second;
+        auto &source = *entry.source;
+        auto folder_info = source.get_folder_info();
+        if (folder_info->get_device() == &peer || entry.excluded.count(device)) {
+            continue;
+        }
+        if (!source.is_locked() || source.is_unreachable()) {
+            continue;
+        }
+
+        auto peer_folder = folder_info->get_folder()->get_folder_infos().by_device(peer);
+        if (!peer_folder) {
+            continue;
+        }
+        auto peer_file = peer_folder->get_file_infos().by_name(source.get_name());
+        auto usable = peer_file && !peer_file->is_unreachable() && !peer_file->is_invalid() &&
+                      compare(peer_file->get_version(), source.get_version()) == version_relation_t::identity;
+
+        auto &blocks = source.get_blocks();
+        auto block = file_block_t();
+        if (usable) {
+            block = take_returned(entry, true);
+            while (!block && entry.tail > 0) {
+                auto i = --entry.tail;
+                if (is_wanted(source, i)) {
+                    block = file_block_t(blocks[i].get(), &source, i);
+                }
+            }
+        } else if (auto temp = find_temp(peer, it.first, source.get_version()); temp) {
+            /* the peer has not the file yet, but some of its blocks; the
+             * request is made by the source file name */
+            peer_file = &source;
+            for (auto i : temp->blocks) {
+                if (i < blocks.size() && is_wanted(source, i)) {
+                    block = file_block_t(blocks[i].get(), &source, i);
+                    break;
+                }
+            }
+        }
+        if (block) {
+            entry.requested.emplace_back(device, block.block_index());
+            return {std::move(peer_file), block};
+        }
+    }
+    return {};
+}
+
+bool swarm_t::release(device_t &peer, const file_block_t &block, bool failed) noexcept {
+    auto entry = find(*block.file());
+    if (!entry) {
+        return false;
+    }
+    auto &requested = entry->requested;
+    auto key = std::make_pair(device_ptr_t(&peer), block.block_index());
+    auto it = std::find(requested.begin(), requested.end(), key);
+    if (it == requested.end()) {
+        /* the peer has been forgotten meanwhile */
+        return false;
+    }
+    requested.erase(it);
+    if (failed) {
+        entry->excluded.emplace(&peer);
+        entry->returned.push_back(block.block_index());
+    }
+    if ((failed || requested.empty()) && entry->wakeup) {
+        entry->wakeup();
+    }
+    return true;
+}
+
+void swarm_t::on_received(device_t &peer, std::size_t bytes, clock_t::time_point now) noexcept {
+    auto &s = stats[&peer];
+    if (s.since == clock_t::time_point{}) {
+        s.since = now;
+    }
+    s.bytes += bytes;
+    auto elapsed = std::chrono::duration<double>(now - s.since).count();
+    if (elapsed >= rate_period) {
+        auto rate = s.bytes / elapsed;
+        s.rate = s.rate > 0 ? (s.rate + rate) / 2 : rate;
+        s.bytes = 0;
+        s.since = now;
+    }
+}
+
+std::uint32_t swarm_t::get_quota(device_t &peer, std::uint32_t window) const noexcept {
+    auto it = stats.find(&peer);
+    if (it == stats.end() || it->second.rate <= 0) {
+        return window;
+    }
+    auto max_rate = 0.0;
+    for (auto &s : stats) {
+        max_rate = std::max(max_rate, s.second.rate);
+    }
+    auto quota = static_cast<std::uint32_t>(window * it->second.rate / max_rate);
+    return std::max(quota, std::uint32_t{1});
+}
+
+void swarm_t::forget(device_t &peer) noexcept {
+    auto device = device_ptr_t(&peer);
+    for (auto &it : entries) {
+        auto &entry = it.second;
+        auto &requested = entry.requested;
+        auto predicate = [&](auto &item) { return item.first == device; };
+        auto tail = std::stable_partition(requested.begin(), requested.end(), std::not_fn(predicate));
+        if (tail != requested.end()) {
+            for (auto r = tail; r != requested.end(); ++r) {
+                entry.returned.push_back(r->second);
+            }
+            requested.erase(tail, requested.end());
+            if (entry.wakeup) {
+                entry.wakeup();
+            }
+        }
+    }
+    stats.erase(device);
+    progress.erase(device);
+
+    for (auto it = fetches.begin(); it != fetches.end();) {
+        if (it->second.peer == device) {
+            auto fetch = std::move(it->second);
+            it = fetches.erase(it);
+            wake_up(fetch);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void swarm_t::apply_progress(device_t &peer, std::string_view folder_id,
+                             const proto::FileDownloadProgressUpdate &update) noexcept {
+    auto key = std::string(folder_id);
+    key += '/';
+    key += update.name();
+
+    auto &temp_files = progress[&peer];
+    if (update.update_type() == proto::FileDownloadProgressUpdateType::FORGET) {
+        temp_files.erase(key);
+        return;
+    }
+
+    auto &temp = temp_files[key];
+    if (compare(temp.version, update.version()) != version_relation_t::identity) {
+        temp.version = update.version();
+        temp.blocks.clear();
+    }
+
+    /* upper bound is checked, when the file is pulled */
+    for (auto i : update.block_indexes()) {
+        if (i >= 0) {
+            temp.blocks.push_back(static_cast<std::size_t>(i));
+        }
+    }
+}
+
+bool swarm_t::has_temp_block(device_t &peer, const file_info_t &file, std::size_t block_index) const noexcept {
+    auto temp = find_temp(peer, make_key(file), file.get_version());
+    if (!temp) {
+        return false;
+    }
+    auto &blocks = temp->blocks;
+    return std::find(blocks.begin(), blocks.end(), block_index) != blocks.end();
+}
+
+void swarm_t::start_fetch(device_t &peer, const block_info_t &block) noexcept {
+    fetches.emplace(std::string(block.get_hash()), fetch_t{&peer, {}});
+}
+
+void swarm_t::finish_fetch(device_t &peer, const block_info_t &block) noexcept {
+    auto it = fetches.find(std::string(block.get_hash()));
+    if (it == fetches.end() || it->second.peer != &peer) {
+        return;
+    }
+    auto fetch = std::move(it->second);
+    fetches.erase(it);
+    wake_up(fetch);
+}
+
+bool swarm_t::is_fetching(const block_info_t &block) const noexcept {
+    return fetches.count(std::string(block.get_hash())) > 0;
+}
+
+void swarm_t::wait_fetch(const block_info_t &block, const file_info_t &source) noexcept {
+    auto it = fetches.find(std::string(block.get_hash()));
+    if (it == fetches.end()) {
+        return;
+    }
+    auto &waiters = it->second.waiters;
+    auto key = make_key(source);
+    if (std::find(waiters.begin(), waiters.end(), key) == waiters.end()) {
+        waiters.emplace_back(std::move(key));
+    }
+}
+
+void swarm_t::wake_up(fetch_t &fetch) noexcept {
+    /* the waiting file might be released meanwhile */
+    for (auto &key : fetch.waiters) {
+        auto it = entries.find(key);
+        if (it != entries.end() && it->second.wakeup) {
+            it->second.wakeup();
+        }
+    }
+}
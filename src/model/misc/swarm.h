@@ -0,0 +1,129 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include "arc.hpp"
+#include "file_block.h"
+#include "../device.h"
+#include "../file_info.h"
+#include "syncspirit-export.h"
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace syncspirit::model {
+
+/* Cluster-wide registry of files, which are being downloaded right now.
+ *
+ * The peer controller, which pulls a file (the owner) registers it here,
+ * so other controllers do not start pulling the same file. Instead, if their
+ * peers advertise the identical version of the file, they fetch its blocks
+ * (helpers): helpers take blocks from the file tail, while the owner iterates
+ * from the head. The amount of helper requests in flight is proportional
+ * to the peer throughput.
+ *
+ * Peers, which download the same file version themselves, announce their
+ * already written blocks via DownloadProgress (temporary index); these
+ * blocks are fetched from them too.
+ *
+ * Block fetches in flight are tracked by block hash: when some other file
+ * needs the same block, it waits for the first fetch and then clones the
+ * block locally, so each unique block crosses the network once.
+ *
+ * All peer controllers live on the same thread, so no locking is needed.
+ */
+struct SYNCSPIRIT_API swarm_t {
+    using clock_t = std::chrono::steady_clock;
+    using wakeup_t = std::function<void()>;
+
+    struct assignment_t {
+        /* the peer file to be requested */
+        file_info_ptr_t peer_file;
+        /* the block of the pulled (source) file */
+        file_block_t block;
+
+        inline explicit operator bool() const noexcept { return (bool)peer_file; }
+    };
+
+    void add(file_info_t &source, wakeup_t wakeup) noexcept;
+    void remove(const file_info_t &source) noexcept;
+    bool is_pulled(const file_info_t &file) const noexcept;
+    bool is_busy(const file_info_t &source) const noexcept;
+
+    assignment_t next_block(device_t &peer) noexcept;
+    file_block_t take_returned(const file_info_t &source) noexcept;
+    bool release(device_t &peer, const file_block_t &block, bool failed) noexcept;
+
+    void on_received(device_t &peer, std::size_t bytes, clock_t::time_point now = clock_t::now()) noexcept;
+    std::uint32_t get_quota(device_t &peer, std::uint32_t window) const noexcept;
+    void forget(device_t &peer) noexcept;
+
+    void apply_progress(device_t &peer, std::string_view folder_id,
+                        const proto::FileDownloadProgressUpdate &update) noexcept;
+    bool has_temp_block(device_t &peer, const file_info_t &file, std::size_t block_index) const noexcept;
+
+    void start_fetch(device_t &peer, const block_info_t &block) noexcept;
+    void finish_fetch(device_t &peer, const block_info_t &block) noexcept;
+    bool is_fetching(const block_info_t &block) const noexcept;
+    void wait_fetch(const block_info_t &block, const file_info_t &source) noexcept;
+
+  private:
+    using devices_t = std::unordered_set<device_ptr_t>;
+    using indices_t = std::vector<std::size_t>;
+    using requested_t = std::vector<std::pair<device_ptr_t, std::size_t>>;
+
+    struct entry_t {
+        file_info_ptr_t source;
+        wakeup_t wakeup;
+        devices_t excluded;
+        indices_t returned;
+        requested_t requested;
+        std::size_t tail;
+    };
+
+    /* temporary index entry of a peer */
+    struct temp_file_t {
+        proto::Vector version;
+        indices_t blocks;
+    };
+
+    /* the peer, which fetches the block, and the pulled files waiting for it */
+    struct fetch_t {
+        device_ptr_t peer;
+        std::vector<std::string> waiters;
+    };
+
+    struct device_stats_t {
+        clock_t::time_point since;
+        std::uint64_t bytes = 0;
+        double rate = 0;
+    };
+
+    using entries_t = std::unordered_map<std::string, entry_t>;
+    using stats_t = std::unordered_map<device_ptr_t, device_stats_t>;
+    using temp_files_t = std::unordered_map<std::string, temp_file_t>;
+    using progress_t = std::unordered_map<device_ptr_t, temp_files_t>;
+    using fetches_t = std::unordered_map<std::string, fetch_t>;
+
+    static std::string make_key(const file_info_t &file) noexcept;
+    entry_t *find(const file_info_t &file) noexcept;
+    const entry_t *find(const file_info_t &file) const noexcept;
+    const temp_file_t *find_temp(device_t &peer, const std::string &key, const proto::Vector &version) const noexcept;
+    file_block_t take_returned(entry_t &entry, bool helper) noexcept;
+    bool is_wanted(const file_info_t &source, std::size_t block_index) const noexcept;
+    void wake_up(fetch_t &fetch) noexcept;
+
+    entries_t entries;
+    stats_t stats;
+    progress_t progress;
+    fetches_t fetches;
+};
+
+} // namespace syncspirit::model
@@ -69,9 +69,12 @@ auto cluster_supervisor_t::operator()(const model::diff::peer::peer_state_t &dif
                 .request_pool(bep_config.rx_buff_size)
                 .outgoing_buffer_max(bep_config.tx_buff_limit)
                 .blocks_max_requested(bep_config.blocks_max_requested)
+                .files_max_active(bep_config.files_max_active)
                 .timeout(init_timeout * 7 / 9)
                 .peer(peer)
                 .peer_addr(diff.peer_addr)
+                .peer_endpoint(diff.endpoint)
+                .session_limit(diff.session_limit)
                 .request_timeout(pt::milliseconds(bep_config.request_timeout))
                 .cluster(cluster)
                 .finish();
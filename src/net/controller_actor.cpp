@@ -17,10 +17,16 @@
 #include "model/diff/modify/finish_file_ack.h"
 #include "model/diff/modify/share_folder.h"
 #include "model/diff/modify/unshare_folder.h"
+#include "model/diff/peer/peer_connection.h"
+#include "model/diff/peer/update_folder.h"
+#include "model/misc/diff_router.h"
+#include "model/misc/version_utils.h"
 #include "proto/bep_support.h"
 #include "utils/error_code.h"
 #include "utils/format.hpp"
+#include "utils/network_interface.h"
 
+#include <algorithm>
 #include <utility>
 
 using namespace syncspirit;
@@ -36,9 +42,17 @@ r::plugin::resource_id_t hash = 1;
 
 controller_actor_t::controller_actor_t(config_t &config)
     : r::actor_base_t{config}, cluster{config.cluster}, peer{config.peer}, peer_addr{config.peer_addr},
-      request_timeout{config.request_timeout}, rx_blocks_requested{0}, tx_blocks_requested{0}, outgoing_buffer{0},
+      rx_blocks_requested{0}, tx_blocks_requested{0}, swarm_requested{0}, outgoing_buffer{0},
       outgoing_buffer_max{config.outgoing_buffer_max}, request_pool{config.request_pool},
-      blocks_max_requested{config.blocks_max_requested} {
+      blocks_max_requested{config.blocks_max_requested},
+      files_max_active{std::max(config.files_max_active, uint32_t{1})},
+      index_chunk_weight{config.index_chunk_weight ? config.index_chunk_weight : constants::index_chunk_weight},
+      rx_window{config.blocks_max_requested, constants::rx_blocks_max_window,
+                std::chrono::milliseconds(constants::rx_request_min_timeout),
+                std::chrono::microseconds(config.request_timeout.total_microseconds())} {
+    using direction_t = utils::bandwidth_shaper_t::direction_t;
+    auto lan = utils::is_lan(config.peer_endpoint.address());
+    rx_bucket = utils::bandwidth_shaper_t::instance().make_bucket(direction_t::download, lan, config.session_limit);
     log = utils::get_logger("net.controller_actor");
 }
 
@@ -53,18 +67,14 @@ void controller_actor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
     plugin.with_casted<r::plugin::registry_plugin_t>([&](auto &p) {
         p.discover_name(names::fs_actor, fs_addr, false).link();
         p.discover_name(names::hasher_proxy, hasher_proxy, false).link();
-        p.discover_name(names::coordinator, coordinator, false).link(false).callback([&](auto phase, auto &ee) {
-            if (!ee && phase == r::plugin::registry_plugin_t::phase_t::linking) {
-                auto p = get_plugin(r::plugin::starter_plugin_t::class_identity);
-                auto plugin = static_cast<r::plugin::starter_plugin_t *>(p);
-                plugin->subscribe_actor(&controller_actor_t::on_model_update, coordinator);
-                plugin->subscribe_actor(&controller_actor_t::on_block_update, coordinator);
-            }
-        });
+        p.discover_name(names::coordinator, coordinator, false).link(false);
     });
     plugin.with_casted<r::plugin::link_client_plugin_t>([&](auto &p) { p.link(peer_addr, false); });
     plugin.with_casted<r::plugin::starter_plugin_t>([&](auto &p) {
+        p.subscribe_actor(&controller_actor_t::on_model_update);
+        p.subscribe_actor(&controller_actor_t::on_block_update);
         p.subscribe_actor(&controller_actor_t::on_forward);
+        p.subscribe_actor(&controller_actor_t::on_forwarded_request);
         p.subscribe_actor(&controller_actor_t::on_pull_ready);
         p.subscribe_actor(&controller_actor_t::on_termination);
         p.subscribe_actor(&controller_actor_t::on_block);
@@ -78,6 +88,7 @@ void controller_actor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
 void controller_actor_t::on_start() noexcept {
     r::actor_base_t::on_start();
     LOG_TRACE(log, "{}, on_start", identity);
+    subscribe_model(true);
     send<payload::start_reading_t>(peer_addr, get_address(), true);
 
     send_cluster_config();
@@ -88,45 +99,93 @@ void controller_actor_t::on_start() noexcept {
 
 void controller_actor_t::shutdown_start() noexcept {
     LOG_TRACE(log, "{}, shutdown_start", identity);
+    if (progress_timer) {
+        cancel_timer(*progress_timer);
+    }
+    if (shaper_timer) {
+        cancel_timer(*shaper_timer);
+    }
     if (peer_addr) {
         send<payload::termination_t>(peer_addr, shutdown_reason);
     }
+    for (auto &connection : connections) {
+        send<payload::termination_t>(connection, shutdown_reason);
+    }
+    subscribe_model(false);
+    connections.clear();
     r::actor_base_t::shutdown_start();
 }
 
+/* the diffs, which are relevant only for the controller, which has made
+ * them, are not routed to other controllers */
+void controller_actor_t::subscribe_model(bool subscribe) noexcept {
+    using router_t = model::diff_router_t;
+    if (!coordinator) {
+        return;
+    }
+    auto own_kinds = router_t::update_folder | router_t::clone_file | router_t::lock_file | router_t::block_rej |
+                     router_t::append_block | router_t::clone_block | router_t::blocks_availability;
+    auto kinds = router_t::all_kinds & ~own_kinds;
+    auto peer_id = std::string(peer->device_id().get_sha256());
+    send<model::payload::model_interest_t>(coordinator, get_address(), this, std::move(peer_id), kinds, subscribe);
+}
+
 void controller_actor_t::shutdown_finish() noexcept {
     LOG_TRACE(log, "{}, shutdown_finish, blocks_requested = {}", identity, rx_blocks_requested);
+    auto &swarm = cluster->get_swarm();
+    for (auto &it : pulled_files) {
+        it.file->locally_unlock();
+        swarm.remove(*it.file);
+    }
+    swarm.forget(*peer);
+    peer->set_rx_metrics({});
     if (!locked_files.empty()) {
         using diffs_t = model::diff::aggregate_t::diffs_t;
         auto diffs = diffs_t{};
         for (auto &file : locked_files) {
-            if (!file->is_unlocking()) {
+            if (!file->is_unlocking() || finishing_files.count(file)) {
                 LOG_TRACE(log, "{}, going to unlock {} ({}); is_unlocking {}", identity, file->get_full_name(),
                           (void *)file.get(), file->is_unlocking());
                 diffs.push_back(new model::diff::modify::lock_file_t(*file, false));
             }
             file->set_unlocking(false);
         }
-        for (auto &file : locally_locked_files) {
-            file->locally_unlock();
-        }
 
-        LOG_DEBUG(log, "{} unlocking {} model files and {} local files", identity, diffs.size(),
-                  locally_locked_files.size());
+        LOG_DEBUG(log, "{} unlocking {} model files and {} local files", identity, diffs.size(), pulled_files.size());
         auto diff = model::diff::cluster_diff_ptr_t{};
         diff = new model::diff::aggregate_t(std::move(diffs));
         send<model::payload::model_update_t>(coordinator, std::move(diff), this);
     }
+    for (auto &it : block_fetches) {
+        it.second.block.block()->unlock();
+    }
+    block_fetches.clear();
+    finishing_files.clear();
+    pulled_files.clear();
     r::actor_base_t::shutdown_finish();
 }
 
-void controller_actor_t::send_cluster_config() noexcept {
+/* each peer connection starts with ClusterConfig, hence it is sent either
+ * to the specified connection or to all of them */
+void controller_actor_t::send_cluster_config(const r::address_ptr_t &connection) noexcept {
     LOG_TRACE(log, "{}, sending cluster config", identity);
     auto cluster_config = cluster->generate(*peer);
     fmt::memory_buffer data;
-    proto::serialize(data, cluster_config);
+    proto::serialize(data, cluster_config, proto::make_compression(peer->get_compression(), true));
+    if (connection) {
+        if (connection == peer_addr) {
+            outgoing_buffer += static_cast<uint32_t>(data.size());
+        }
+        send<payload::transfer_data_t>(connection, std::move(data), tx_class_t::control);
+        return;
+    }
+    for (auto &extra : connections) {
+        auto copy = fmt::memory_buffer();
+        copy.append(data.data(), data.data() + data.size());
+        send<payload::transfer_data_t>(extra, std::move(copy), tx_class_t::control);
+    }
     outgoing_buffer += static_cast<uint32_t>(data.size());
-    send<payload::transfer_data_t>(peer_addr, std::move(data));
+    send<payload::transfer_data_t>(peer_addr, std::move(data), tx_class_t::control);
 }
 
 void controller_actor_t::on_transfer_push(message::transfer_push_t &message) noexcept {
@@ -187,9 +246,9 @@ void controller_actor_t::push_pending() noexcept {
     for (auto &p : indices) {
         auto &index = p.second;
         if (index.files_size() > 0) {
-            proto::serialize(data, index);
+            proto::serialize(data, index, proto::make_compression(peer->get_compression(), true));
             outgoing_buffer += static_cast<uint32_t>(data.size());
-            send<payload::transfer_data_t>(peer_addr, std::move(data));
+            send<payload::transfer_data_t>(peer_addr, std::move(data), tx_class_t::index);
         }
     }
 }
@@ -204,66 +263,197 @@ model::file_info_ptr_t controller_actor_t::next_file(bool reset) noexcept {
     return {};
 }
 
-model::file_block_t controller_actor_t::next_block(bool reset) noexcept {
-    if (file->is_file() && !file->is_deleted()) {
-        if (reset) {
-            block_iterator = new model::blocks_iterator_t(*file);
+void controller_actor_t::on_pull_ready(message::pull_signal_t &) noexcept {
+    LOG_TRACE(log, "{}, on_pull_ready, blocks requested = {}, files = {}", identity, rx_blocks_requested,
+              pulled_files.size());
+    bool ignore = (request_pool < 0)                      // rx buff is going to be full
+                  || (state != r::state_t::OPERATIONAL) // we are shutting down
+        ;
+    if (ignore) {
+        return;
+    }
+
+    schedule_blocks();
+    activate_files();
+}
+
+void controller_actor_t::activate_files() noexcept {
+    auto &swarm = cluster->get_swarm();
+    while (pulled_files.size() < files_max_active) {
+        auto file = next_file(!file_iterator);
+        if (!file) {
+            file_iterator.reset();
+            return;
         }
-        if (block_iterator && *block_iterator) {
-            return block_iterator->next(!reset);
+        if (swarm.is_pulled(*file)) {
+            LOG_TRACE(log, "{}, {} is pulled by other peer, skipping", identity, file->get_full_name());
+            continue;
+        }
+        /* keep the file out of the file iterator until it is released */
+        file->locally_lock();
+        swarm.add(*file, [this]() { pull_ready(); });
+        auto it = pulled_files.emplace(pulled_files.end(), pulled_file_t{file, {}, pull_state_t::cloning, {}});
+        if (!file->local_file()) {
+            LOG_DEBUG(log, "{}, next_file = {}", identity, file->get_name());
+            auto diff = model::diff::cluster_diff_ptr_t{};
+            diff = new model::diff::modify::clone_file_t(*file);
+            send<model::payload::model_update_t>(coordinator, std::move(diff), this);
+        } else {
+            start_pulling(it);
         }
     }
-    return {};
 }
 
-void controller_actor_t::on_pull_ready(message::pull_signal_t &) noexcept {
-    LOG_TRACE(log, "{}, on_pull_ready, blocks requested = {}", identity, rx_blocks_requested);
-    bool ignore = (rx_blocks_requested > blocks_max_requested || request_pool < 0) // rx buff is going to be full
-                  || (state != r::state_t::OPERATIONAL) // request pool sz = 32505856e are shutting down
-        ;
-    if (ignore) {
-        return;
+void controller_actor_t::start_pulling(pulled_files_t::iterator it) noexcept {
+    auto &file = *it->file;
+    if (file.get_size() && file.local_file() && file.is_file() && !file.is_deleted()) {
+        auto block_iterator = model::block_iterator_ptr_t(new model::blocks_iterator_t(file));
+        if (*block_iterator) {
+            LOG_TRACE(log, "{}, locking {}", identity, file.get_full_name());
+            it->block_iterator = std::move(block_iterator);
+            it->state = pull_state_t::locking;
+            auto diff = model::diff::cluster_diff_ptr_t{};
+            diff = new model::diff::modify::lock_file_t(file, true);
+            send<model::payload::model_update_t>(coordinator, std::move(diff), this);
+            return;
+        }
     }
+    release_file(it);
+}
 
-    if (file && file->get_size() && file->local_file() && cluster->get_write_requests()) {
-        auto reset_block = !(substate & substate_t::iterating_blocks);
-        auto block = next_block(reset_block);
-        if (block) {
-            substate |= substate_t::iterating_blocks;
-            if (reset_block) {
-                auto diff = model::diff::cluster_diff_ptr_t{};
-                diff = new model::diff::modify::lock_file_t(*file, true);
-                send<model::payload::model_update_t>(coordinator, std::move(diff), this);
-            } else {
-                preprocess_block(block);
+auto controller_actor_t::release_file(pulled_files_t::iterator it) noexcept -> pulled_files_t::iterator {
+    it->file->locally_unlock();
+    cluster->get_swarm().remove(*it->file);
+    return pulled_files.erase(it);
+}
+
+auto controller_actor_t::find_pulled(const model::file_info_t &file) noexcept -> pulled_files_t::iterator {
+    return std::find_if(pulled_files.begin(), pulled_files.end(),
+                        [&](const pulled_file_t &it) { return it.file.get() == &file; });
+}
+
+void controller_actor_t::block_done(const model::file_info_t &file) noexcept {
+    auto it = find_pulled(file);
+    if (it != pulled_files.end() && it->in_flight) {
+        --it->in_flight;
+    }
+}
+
+void controller_actor_t::schedule_blocks() noexcept {
+    auto can_request = [&]() -> bool {
+        return rx_blocks_requested < rx_window.get_window() && request_pool >= 0 && cluster->get_write_requests() > 0 &&
+               !is_shaped();
+    };
+    auto &swarm = cluster->get_swarm();
+    /* the file is done, when there is nothing to request and nothing is
+     * in flight, neither own requests nor the ones on behalf of other peers */
+    auto is_exhausted = [&](pulled_file_t &it) -> bool {
+        if (it.state != pull_state_t::pulling) {
+            return false;
+        }
+        auto &file = *it.file;
+        return file.is_unreachable() ||
+               (!*it.block_iterator && it.waiting.empty() && !it.in_flight && !swarm.is_busy(file));
+    };
+    auto next_block = [&](pulled_file_t &it) -> model::file_block_t {
+        auto &waiting = it.waiting;
+        for (auto b = waiting.begin(); b != waiting.end(); ++b) {
+            if (!swarm.is_fetching(*b->block())) {
+                /* re-create to pick up its local availability */
+                auto block = model::file_block_t(b->block(), b->file(), b->block_index());
+                waiting.erase(b);
+                return block;
             }
-        } else {
-            substate = substate & ~substate_t::iterating_blocks;
         }
+        if (*it.block_iterator) {
+            return it.block_iterator->next(true);
+        }
+        return swarm.take_returned(*it.file);
+    };
+
+    for (auto it = pulled_files.begin(); it != pulled_files.end();) {
+        it = is_exhausted(*it) ? release_file(it) : std::next(it);
     }
-    if (!(substate & substate_t::iterating_blocks)) {
-        bool reset_file = !(substate & substate_t::iterating_files);
-        file = next_file(reset_file);
-        if (file) {
-            substate |= substate_t::iterating_files;
-            if (!file->local_file()) {
-                LOG_DEBUG(log, "{}, next_file = {}", identity, file->get_name());
-                file->locally_lock();
-                locally_locked_files.emplace(file);
-                auto diff = model::diff::cluster_diff_ptr_t{};
-                diff = new model::diff::modify::clone_file_t(*file);
-                send<model::payload::model_update_t>(coordinator, std::move(diff), this);
-            } else {
-                pull_ready();
+
+    /* round-robin over the pulled files, one block per file per pass, so
+     * many small files share the requests window, as a single big one does */
+    bool progress = true;
+    while (progress && can_request()) {
+        progress = false;
+        for (auto it = pulled_files.begin(); it != pulled_files.end() && can_request();) {
+            if (it->state != pull_state_t::pulling) {
+                ++it;
+                continue;
             }
-        } else {
-            substate = substate & ~substate_t::iterating_files;
+            auto block = next_block(*it);
+            if (block) {
+                /* the block might be taken by some other peer meanwhile */
+                auto index = block.block_index();
+                if (!it->file->is_locally_available(index)) {
+                    if (!block.is_locally_available() && swarm.is_fetching(*block.block())) {
+                        LOG_TRACE(log, "{}, block {} of '{}' is being fetched, waiting for it", identity, index,
+                                  it->file->get_name());
+                        swarm.wait_fetch(*block.block(), *it->file);
+                        it->waiting.emplace_back(std::move(block));
+                    } else {
+                        preprocess_block(block);
+                        ++it->in_flight;
+                    }
+                }
+                progress = true;
+            }
+            it = is_exhausted(*it) ? release_file(it) : std::next(it);
+        }
+    }
+
+    /* spare window: help pulling files of other peers, if our peer has them */
+    auto quota = swarm.get_quota(*peer, rx_window.get_window());
+    while (swarm_requested < quota && can_request()) {
+        auto assignment = swarm.next_block(*peer);
+        if (!assignment) {
+            break;
         }
+        auto &file_block = assignment.block;
+        auto sz = file_block.block()->get_size();
+        LOG_TRACE(log, "{} swarm request_block on file '{}'; block index = {}, sz = {}", identity,
+                  file_block.file()->get_full_name(), file_block.block_index(), sz);
+        request_block(pick_connection(), assignment.peer_file, file_block);
+        swarm.start_fetch(*peer, *file_block.block());
+        ++rx_blocks_requested;
+        ++swarm_requested;
+        request_pool -= (int64_t)sz;
+        rx_bucket->consume(sz);
+    }
+}
+
+/* the download rate limit is applied to the requests window: while the
+ * limit is exceeded no more blocks are requested */
+bool controller_actor_t::is_shaped() noexcept {
+    if (shaper_timer) {
+        return true;
+    }
+    auto delay = rx_bucket->get_delay();
+    if (!delay.count()) {
+        return false;
+    }
+    if (state == r::state_t::OPERATIONAL) {
+        LOG_TRACE(log, "{}, shaping delay {}us", identity, delay.count());
+        auto timeout = pt::microseconds(delay.count());
+        shaper_timer = start_timer(timeout, *this, &controller_actor_t::on_shaper_timer);
+    }
+    return true;
+}
+
+void controller_actor_t::on_shaper_timer(r::request_id_t, bool cancelled) noexcept {
+    shaper_timer.reset();
+    if (!cancelled) {
+        pull_ready();
     }
 }
 
 void controller_actor_t::preprocess_block(model::file_block_t &file_block) noexcept {
     using namespace model::diff;
+    auto file = model::file_info_ptr_t(file_block.file());
     assert(file->local_file());
 
     if (file_block.is_locally_available()) {
@@ -276,11 +466,93 @@ void controller_actor_t::preprocess_block(model::file_block_t &file_block) noexc
         auto sz = block->get_size();
         LOG_TRACE(log, "{} request_block on file '{}'; block index = {} / {}, sz = {}, request pool sz = {}", identity,
                   file->get_full_name(), file_block.block_index(), file->get_blocks().size() - 1, sz, request_pool);
-        request<payload::block_request_t>(peer_addr, file, file_block).send(request_timeout);
+        request_block(pick_connection(), file, file_block);
+        cluster->get_swarm().start_fetch(*peer, *block);
         ++rx_blocks_requested;
         request_pool -= (int64_t)sz;
+        rx_bucket->consume(sz);
+    }
+}
+
+void controller_actor_t::request_block(const r::address_ptr_t &connection, const model::file_info_ptr_t &file,
+                                       const model::file_block_t &file_block) noexcept {
+    auto block = file_block.block();
+    auto folder_id = file->get_folder_info()->get_folder()->get_id();
+    auto timeout = pt::microseconds(rx_window.get_timeout().count());
+    auto request_id = request<payload::block_request_t>(connection, std::string(folder_id), std::string(file->get_name()),
+                                                        file_block.block_index(), file_block.get_offset(),
+                                                        block->get_size(), std::string(block->get_hash()))
+                          .send(timeout);
+    block->lock();
+    block_fetches.emplace(request_id, block_fetch_t{file, file_block, std::chrono::steady_clock::now(), connection});
+}
+
+void controller_actor_t::release_fetch(r::request_id_t request_id) noexcept {
+    auto it = block_fetches.find(request_id);
+    if (it != block_fetches.end()) {
+        it->second.block.block()->unlock();
+        block_fetches.erase(it);
+    }
+}
+
+/* block requests are striped over all peer connections, the primary one
+ * included; the rest of traffic goes via the primary connection */
+const r::address_ptr_t &controller_actor_t::pick_connection() noexcept {
+    if (connections.empty()) {
+        return peer_addr;
+    }
+    auto index = next_connection++ % (connections.size() + 1);
+    return index ? connections[index - 1] : peer_addr;
+}
+
+/* the lost extra connection is not used any longer, and the blocks, which
+ * have been requested via it, are re-requested via the primary connection
+ * at once, i.e. without waiting for the request timeouts; the blocks, which
+ * are already received and are being validated, are left as is */
+void controller_actor_t::drop_connection(const r::address_ptr_t &connection) noexcept {
+    auto it = std::find(connections.begin(), connections.end(), connection);
+    if (it != connections.end()) {
+        connections.erase(it);
+        LOG_DEBUG(log, "{}, extra connection has been removed, total: {}", identity, connections.size() + 1);
+        send<payload::termination_t>(connection, make_error(r::make_error_code(r::shutdown_code_t::normal)));
+    }
+    if (!peer_addr || state != r::state_t::OPERATIONAL) {
+        return;
+    }
+
+    using request_ids_t = std::vector<r::request_id_t>;
+    auto request_ids = request_ids_t{};
+    for (auto &[request_id, fetch] : block_fetches) {
+        if (fetch.connection == connection && !fetch.received) {
+            request_ids.emplace_back(request_id);
+        }
+    }
+    for (auto request_id : request_ids) {
+        auto &fetch = block_fetches.at(request_id);
+        auto file = fetch.file;
+        auto file_block = fetch.block;
+        auto sz = file_block.block()->get_size();
+        auto swarm_block = file->get_folder_info()->get_device() != peer.get();
+        LOG_DEBUG(log, "{}, re-requesting block #{} of '{}' via primary connection", identity,
+                  file_block.block_index(), file->get_full_name());
+
+        /* the lost request is not in flight anymore */
+        release_fetch(request_id);
+        --rx_blocks_requested;
+        request_pool += (int64_t)sz;
+        if (swarm_block) {
+            --swarm_requested;
+        }
+
+        /* the swarm fetch is still in progress, only the request is new */
+        request_block(peer_addr, file, file_block);
+        ++rx_blocks_requested;
+        request_pool -= (int64_t)sz;
+        rx_bucket->consume(sz);
+        if (swarm_block) {
+            ++swarm_requested;
+        }
     }
-    pull_ready();
 }
 
 void controller_actor_t::on_forward(message::forwarded_message_t &message) noexcept {
@@ -290,6 +562,14 @@ void controller_actor_t::on_forward(message::forwarded_message_t &message) noexc
     std::visit([this](auto &msg) { on_message(msg); }, message.payload);
 }
 
+void controller_actor_t::on_forwarded_request(message::forwarded_request_t &message) noexcept {
+    if (state != r::state_t::OPERATIONAL) {
+        return;
+    }
+    auto &p = message.payload;
+    on_message(p.request, p.connection);
+}
+
 void controller_actor_t::on_model_update(model::message::model_update_t &message) noexcept {
     LOG_TRACE(log, "{}, on_model_update", identity);
     auto &diff = *message.payload.diff;
@@ -316,9 +596,9 @@ auto controller_actor_t::operator()(const model::diff::peer::cluster_update_t &,
                 LOG_DEBUG(log, "{}, sending new index", identity);
                 auto index = *index_opt;
                 fmt::memory_buffer data;
-                proto::serialize(data, index);
+                proto::serialize(data, index, proto::make_compression(peer->get_compression(), true));
                 outgoing_buffer += static_cast<uint32_t>(data.size());
-                send<payload::transfer_data_t>(peer_addr, std::move(data));
+                send<payload::transfer_data_t>(peer_addr, std::move(data), tx_class_t::index);
             }
         }
     }
@@ -327,6 +607,33 @@ auto controller_actor_t::operator()(const model::diff::peer::cluster_update_t &,
     return outcome::success();
 }
 
+auto controller_actor_t::operator()(const model::diff::peer::update_folder_t &, void *custom) noexcept
+    -> outcome::result<void> {
+    if (custom == this && index_busy) {
+        apply_index_chunk();
+    }
+    return outcome::success();
+}
+
+auto controller_actor_t::operator()(const model::diff::peer::peer_connection_t &diff, void *) noexcept
+    -> outcome::result<void> {
+    if (!diff.peer_addr || diff.peer_id != peer->device_id().get_sha256()) {
+        return outcome::success();
+    }
+    auto &connection = diff.peer_addr;
+    if (diff.connected) {
+        if (state == r::state_t::OPERATIONAL && peer_addr) {
+            connections.emplace_back(connection);
+            LOG_DEBUG(log, "{}, extra connection has been added, total: {}", identity, connections.size() + 1);
+            send<payload::start_reading_t>(connection, get_address(), true);
+            send_cluster_config(connection);
+        }
+    } else {
+        drop_connection(connection);
+    }
+    return outcome::success();
+}
+
 auto controller_actor_t::operator()(const model::diff::modify::clone_file_t &diff, void *custom) noexcept
     -> outcome::result<void> {
     if (custom != this) {
@@ -338,9 +645,10 @@ auto controller_actor_t::operator()(const model::diff::modify::clone_file_t &dif
     auto folder = cluster->get_folders().by_id(folder_id);
     auto folder_info = folder->get_folder_infos().by_device(*peer);
     auto file = folder_info->get_file_infos().by_name(file_name);
-    file->locally_unlock();
-    auto it = locally_locked_files.find(file);
-    locally_locked_files.erase(it);
+    auto it = find_pulled(*file);
+    if (it != pulled_files.end()) {
+        start_pulling(it);
+    }
     return outcome::success();
 }
 
@@ -351,9 +659,23 @@ auto controller_actor_t::operator()(const model::diff::modify::finish_file_ack_t
     auto file = folder_info->get_file_infos().by_name(diff.file_name);
     assert(file);
     updates_streamer.on_update(*file);
+    release_finishing(file);
     return outcome::success();
 }
 
+void controller_actor_t::release_finishing(const model::file_info_ptr_t &file) noexcept {
+    /* the source is kept locked until the final path is durable */
+    auto it = finishing_files.find(file);
+    if (it == finishing_files.end()) {
+        return;
+    }
+    finishing_files.erase(it);
+    LOG_TRACE(log, "{}, unlocking finished {}", identity, file->get_full_name());
+    auto diff = model::diff::cluster_diff_ptr_t{};
+    diff = new model::diff::modify::lock_file_t(*file, false);
+    send<model::payload::model_update_t>(coordinator, std::move(diff), this);
+}
+
 auto controller_actor_t::operator()(const model::diff::modify::lock_file_t &diff, void *custom) noexcept
     -> outcome::result<void> {
     if (custom != this) {
@@ -366,6 +688,10 @@ auto controller_actor_t::operator()(const model::diff::modify::lock_file_t &diff
     auto folder_info = folder->get_folder_infos().by_device(*peer);
     auto file = folder_info->get_file_infos().by_name(file_name);
     if (diff.locked) {
+        auto it = find_pulled(*file);
+        if (it != pulled_files.end() && it->state == pull_state_t::locking) {
+            it->state = pull_state_t::pulling;
+        }
         locked_files.emplace(std::move(file));
     } else {
         file->set_unlocking(false);
@@ -427,6 +753,14 @@ auto controller_actor_t::operator()(const model::diff::modify::mark_reachable_t
         file->set_unlocking(true);
         diff = new model::diff::modify::lock_file_t(*file, false);
         send<model::payload::model_update_t>(coordinator, std::move(diff), this);
+    } else if (!diff.reachable && diff.device_id == peer->device_id().get_sha256()) {
+        /* fs has failed to finish the file */
+        auto folder = cluster->get_folders().by_id(diff.folder_id);
+        auto folder_info = folder->get_folder_infos().by_device(*peer);
+        auto file = folder_info->get_file_infos().by_name(diff.file_name);
+        if (file) {
+            release_finishing(file);
+        }
     }
     push_pending();
     return outcome::success();
@@ -435,44 +769,63 @@ auto controller_actor_t::operator()(const model::diff::modify::mark_reachable_t
 auto controller_actor_t::operator()(const model::diff::modify::block_ack_t &diff, void *custom) noexcept
     -> outcome::result<void> {
 
-    auto folder = cluster->get_folders().by_id(diff.folder_id);
-    auto folder_info = folder->get_folder_infos().by_device_id(diff.device_id);
-    auto source_file = folder_info->get_file_infos().by_name(diff.file_name);
-    if (source_file->is_locally_available()) {
-        using diffs_t = model::diff::aggregate_t::diffs_t;
+    auto source_file = model::file_info_ptr_t(diff.get_file(*cluster));
+    queue_progress(*source_file, diff.block_index);
+    if (custom == this) {
+        block_done(*source_file);
+    }
+
+    /* the last block might be written on behalf of other peer, but the file
+     * is finalized by its owner, i.e. the one, which has it locked; when the
+     * last blocks are acked via several peers, the file is finalized once */
+    auto owned = locked_files.count(source_file) > 0;
+    if (owned && !source_file->is_unlocking() && source_file->is_locally_available()) {
         LOG_TRACE(log, "{}, on_block_update, finalizing {}", identity, source_file->get_name());
         auto my_file = source_file->local_file();
-        auto diffs = diffs_t{};
         source_file->set_unlocking(true);
-        diffs.push_back(new model::diff::modify::lock_file_t(*source_file, false));
-        diffs.push_back(new model::diff::modify::finish_file_t(*my_file));
+        finishing_files.emplace(source_file);
         auto diff = model::diff::cluster_diff_ptr_t{};
-        diff = new model::diff::aggregate_t(std::move(diffs));
+        diff = new model::diff::modify::finish_file_t(*my_file);
         send<model::payload::model_update_t>(coordinator, std::move(diff), this);
+
+        auto it = find_pulled(*source_file);
+        if (it != pulled_files.end()) {
+            release_file(it);
+        }
     }
 
-    cluster->modify_write_requests(1);
-    process_block_write();
-    pull_ready();
+    if (custom == this) {
+        auto &block = source_file->get_blocks()[diff.block_index];
+        cluster->get_swarm().finish_fetch(*peer, *block);
+        cluster->modify_write_requests(1);
+        process_block_write();
+    }
+    if (custom == this || owned) {
+        pull_ready();
+    }
 
     return outcome::success();
 }
 
 auto controller_actor_t::operator()(const model::diff::modify::block_rej_t &diff, void *custom) noexcept
     -> outcome::result<void> {
+    if (custom != this) {
+        return outcome::success();
+    }
+    auto source_file = model::file_info_ptr_t(diff.get_file(*cluster));
+    cluster->get_swarm().finish_fetch(*peer, *source_file->get_blocks()[diff.block_index]);
+    block_done(*source_file);
     LOG_ERROR(log, "{}, on block rej, not implemented", identity);
     return outcome::success();
 }
 
 void controller_actor_t::on_block_update(model::message::block_update_t &message) noexcept {
-    if (message.payload.custom == this) {
-        LOG_TRACE(log, "{}, on_block_update", identity);
-        auto &diff = *message.payload.diff;
-        auto r = diff.visit(*this, const_cast<void *>(message.payload.custom));
-        if (!r) {
-            auto ee = make_error(r.assume_error());
-            return do_shutdown(ee);
-        }
+    LOG_TRACE(log, "{}, on_block_update", identity);
+    auto &diff = *message.payload.diff;
+    auto r = diff.visit(*this, const_cast<void *>(message.payload.custom));
+    if (!r) {
+        auto ee = make_error(r.assume_error());
+        return do_shutdown(ee);
     }
 }
 
@@ -488,36 +841,79 @@ void controller_actor_t::on_message(proto::message::ClusterConfig &message) noex
 }
 
 void controller_actor_t::on_message(proto::message::Index &message) noexcept {
-    auto &msg = *message;
-    LOG_DEBUG(log, "{}, on_message (Index)", identity);
-    auto diff_opt = cluster->process(msg, *peer);
-    if (!diff_opt) {
-        auto &ec = diff_opt.assume_error();
-        LOG_ERROR(log, "{}, error processing message from {} : {}", identity, peer->device_id(), ec.message());
+    LOG_DEBUG(log, "{}, on_message (Index), folder = {}, files = {}", identity, message->folder(),
+              message->files_size());
+    index_queue.emplace_back(std::move(message));
+    process_index();
+}
+
+void controller_actor_t::on_message(proto::message::IndexUpdate &message) noexcept {
+    LOG_DEBUG(log, "{}, on_message (IndexUpdate), folder = {}, files = {}", identity, message->folder(),
+              message->files_size());
+    index_queue.emplace_back(std::move(message));
+    process_index();
+}
+
+/* Index and IndexUpdate messages are handled one by one, in the order of
+ * arrival. The message is validated and split into chunks, then the chunks
+ * are applied one after another, i.e. the next chunk is sent, when the
+ * previous one has been applied; so the other messages (e.g. I/O of other
+ * peers) are processed in between. The work per chunk is bounded by the
+ * chunk weight, not by the index size. */
+void controller_actor_t::process_index() noexcept {
+    using namespace model::diff;
+    if (index_busy || index_queue.empty() || state != r::state_t::OPERATIONAL) {
+        return;
+    }
+    auto message = std::move(index_queue.front());
+    index_queue.pop_front();
+    auto weight = static_cast<std::size_t>(index_chunk_weight);
+    auto chunks_opt = std::visit(
+        [&](auto &msg) {
+            index_folder = msg->folder();
+            index_owner = msg;
+            return peer::update_folder_t::prepare(*msg, weight);
+        },
+        message);
+    if (!chunks_opt) {
+        auto &ec = chunks_opt.assume_error();
+        LOG_ERROR(log, "{}, error processing index from {} : {}", identity, peer->device_id(), ec.message());
+        index_owner.reset();
         return do_shutdown(make_error(ec));
     }
-    auto folder = cluster->get_folders().by_id(msg.folder());
-    LOG_DEBUG(log, "{}, on_message (Index), folder = {}, files = {}", identity, folder->get_label(), msg.files_size());
-    send<model::payload::model_update_t>(coordinator, std::move(diff_opt.assume_value()), this);
+    index_busy = true;
+    index_chunks = std::move(chunks_opt.assume_value());
+    index_chunk = 0;
+    LOG_TRACE(log, "{}, index of folder {} is split into {} chunk(s)", identity, index_folder, index_chunks.size());
+    apply_index_chunk();
 }
 
-void controller_actor_t::on_message(proto::message::IndexUpdate &message) noexcept {
-    LOG_TRACE(log, "{}, on_message (IndexUpdate)", identity);
-    auto &msg = *message;
-    auto diff_opt = cluster->process(msg, *peer);
+void controller_actor_t::apply_index_chunk() noexcept {
+    using namespace model::diff;
+    if (index_chunk == index_chunks.size()) {
+        index_chunks.clear();
+        index_owner.reset();
+        index_busy = false;
+        return process_index();
+    }
+    using clock_t = std::chrono::steady_clock;
+    auto &files = index_chunks[index_chunk++];
+    auto files_count = files.size();
+    auto started = clock_t::now();
+    auto diff_opt = peer::update_folder_t::create(*cluster, *peer, index_folder, std::move(files), index_owner);
     if (!diff_opt) {
         auto &ec = diff_opt.assume_error();
         LOG_ERROR(log, "{}, error processing message from {} : {}", identity, peer->device_id(), ec.message());
         return do_shutdown(make_error(ec));
     }
-    auto folder = cluster->get_folders().by_id(msg.folder());
-    LOG_DEBUG(log, "{}, on_message (IndexUpdate), folder = {}, files = {}", identity, folder->get_label(),
-              msg.files_size());
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(clock_t::now() - started);
+    LOG_DEBUG(log, "{}, index chunk {}/{} ({} files) of folder {} is prepared in {}us", identity, index_chunk,
+              index_chunks.size(), files_count, index_folder, elapsed.count());
     send<model::payload::model_update_t>(coordinator, std::move(diff_opt.assume_value()), this);
 }
 
-void controller_actor_t::on_message(proto::message::Request &req) noexcept {
-    proto::Response res;
+void controller_actor_t::on_message(proto::message::Request &req, const r::address_ptr_t &connection) noexcept {
+    auto &reply_to = connection ? connection : peer_addr;
     fmt::memory_buffer data;
     auto code = proto::ErrorCode::NO_BEP_ERROR;
 
@@ -543,6 +939,13 @@ void controller_actor_t::on_message(proto::message::Request &req) noexcept {
                     if (!file->is_file()) {
                         LOG_WARN(log, "{}, attempt to request non-regular file: {}", identity, file->get_name());
                         code = proto::ErrorCode::GENERIC;
+                    } else if (auto source = file->get_source(); source && source->is_locked()) {
+                        /* the file is being downloaded, only already written blocks can be served */
+                        auto block_size = file->get_block_size();
+                        auto index = block_size > 0 ? static_cast<size_t>(req->offset() / block_size) : 0;
+                        if (index >= source->get_blocks().size() || !source->is_locally_available(index)) {
+                            code = proto::ErrorCode::NO_SUCH_FILE;
+                        }
                     }
                 }
             }
@@ -550,47 +953,192 @@ void controller_actor_t::on_message(proto::message::Request &req) noexcept {
     }
 
     if (code != proto::ErrorCode::NO_BEP_ERROR) {
-        res.set_id(req->id());
-        res.set_code(code);
-        proto::serialize(data, res);
-        outgoing_buffer += static_cast<uint32_t>(data.size());
-        send<payload::transfer_data_t>(peer_addr, std::move(data));
+        auto res = proto::response_view_t{req->id(), {}, code};
+        proto::serialize_response(data, res, proto::make_compression(peer->get_compression(), false));
+        send_response(reply_to, std::move(data));
     } else {
         ++tx_blocks_requested;
+        if (reply_to != peer_addr) {
+            request_routes.emplace(req.get(), reply_to);
+        }
         send<fs::payload::block_request_t>(fs_addr, std::move(req), address);
     }
 }
 
-void controller_actor_t::on_message(proto::message::DownloadProgress &) noexcept { std::abort(); }
+void controller_actor_t::on_message(proto::message::DownloadProgress &message) noexcept {
+    auto &msg = *message;
+    LOG_TRACE(log, "{}, on_message (DownloadProgress), folder = {}, updates = {}", identity, msg.folder(),
+              msg.updates_size());
+    auto folder = cluster->get_folders().by_id(msg.folder());
+    if (!folder || !folder->get_folder_infos().by_device(*peer)) {
+        LOG_WARN(log, "{}, DownloadProgress for unknown or non-shared folder '{}', ignoring", identity, msg.folder());
+        return;
+    }
+    auto &swarm = cluster->get_swarm();
+    for (auto &update : msg.updates()) {
+        swarm.apply_progress(*peer, msg.folder(), update);
+    }
+    pull_ready();
+}
+
+void controller_actor_t::queue_progress(model::file_info_t &source, std::size_t block_index) noexcept {
+    auto folder_info = source.get_folder_info();
+    auto folder = folder_info->get_folder();
+    if (folder->is_temp_indexes_disabled() || folder_info->get_device() == peer.get()) {
+        return;
+    }
+    auto peer_folder = folder->get_folder_infos().by_device(*peer);
+    if (!peer_folder) {
+        return;
+    }
+    auto peer_file = peer_folder->get_file_infos().by_name(source.get_name());
+    if (peer_file) {
+        using relation_t = model::version_relation_t;
+        auto relation = model::compare(peer_file->get_version(), source.get_version());
+        if (relation == relation_t::identity || relation == relation_t::newer) {
+            return;
+        }
+    }
+
+    auto key = model::file_info_ptr_t(&source);
+    if (source.is_locally_available()) {
+        if (announced_files.erase(key)) {
+            auto &update = progress_updates[key];
+            update.blocks.clear();
+            update.forget = true;
+        }
+    } else {
+        announced_files.emplace(key);
+        progress_updates[key].blocks.push_back(static_cast<std::int32_t>(block_index));
+    }
+
+    if (!progress_updates.empty() && !progress_timer && state == r::state_t::OPERATIONAL) {
+        auto interval = pt::milliseconds(constants::download_progress_interval);
+        progress_timer = start_timer(interval, *this, &controller_actor_t::on_progress_timer);
+    }
+}
+
+void controller_actor_t::on_progress_timer(r::request_id_t, bool cancelled) noexcept {
+    progress_timer.reset();
+    if (!cancelled) {
+        send_progress();
+    }
+}
+
+void controller_actor_t::send_progress() noexcept {
+    using messages_t = std::unordered_map<std::string_view, proto::DownloadProgress>;
+    auto messages = messages_t{};
+    for (auto &[file, progress] : progress_updates) {
+        auto folder_id = file->get_folder_info()->get_folder()->get_id();
+        auto &msg = messages[folder_id];
+        msg.set_folder(std::string(folder_id));
+        auto update = msg.add_updates();
+        update->set_name(std::string(file->get_name()));
+        *update->mutable_version() = file->get_version();
+        if (progress.forget) {
+            update->set_update_type(proto::FileDownloadProgressUpdateType::FORGET);
+        } else {
+            update->set_update_type(proto::FileDownloadProgressUpdateType::APPEND);
+            for (auto i : progress.blocks) {
+                update->add_block_indexes(i);
+            }
+        }
+    }
+    progress_updates.clear();
+
+    for (auto &[folder_id, msg] : messages) {
+        LOG_TRACE(log, "{}, sending DownloadProgress, folder = {}, updates = {}", identity, folder_id,
+                  msg.updates_size());
+        fmt::memory_buffer data;
+        proto::serialize(data, msg, proto::make_compression(peer->get_compression(), true));
+        outgoing_buffer += static_cast<uint32_t>(data.size());
+        send<payload::transfer_data_t>(peer_addr, std::move(data), tx_class_t::index);
+    }
+}
+
+void controller_actor_t::send_response(const r::address_ptr_t &connection, fmt::memory_buffer &&data,
+                                       std::string_view tail, r::message_ptr_t tail_owner) noexcept {
+    /* the outgoing buffer limits the index updates, i.e. only the primary
+     * connection is accounted */
+    if (connection == peer_addr) {
+        outgoing_buffer += static_cast<uint32_t>(data.size() + tail.size());
+    }
+    send<payload::transfer_data_t>(connection, std::move(data), tx_class_t::response, tail, std::move(tail_owner));
+}
 
 void controller_actor_t::on_block_response(fs::message::block_response_t &message) noexcept {
     --tx_blocks_requested;
     auto &p = message.payload;
-    proto::Response res;
-    res.set_id(p.remote_request->id());
+    auto connection = peer_addr;
+    if (auto it = request_routes.find(p.remote_request.get()); it != request_routes.end()) {
+        connection = std::move(it->second);
+        request_routes.erase(it);
+    }
+    auto res = proto::response_view_t{p.remote_request->id()};
     if (p.ec) {
-        res.set_code(proto::ErrorCode::GENERIC);
+        res.code = proto::ErrorCode::GENERIC;
     } else {
-        res.set_data(std::move(p.data));
+        res.data = p.data;
     }
 
     fmt::memory_buffer data;
-    proto::serialize(data, res);
-    outgoing_buffer += static_cast<uint32_t>(data.size());
-    send<payload::transfer_data_t>(peer_addr, std::move(data));
+    auto compression = proto::make_compression(peer->get_compression(), false);
+    if (res.code != proto::ErrorCode::NO_BEP_ERROR || compression != proto::MessageCompression::NONE) {
+        proto::serialize_response(data, res, compression);
+        return send_response(connection, std::move(data));
+    }
+
+    /* the block is sent from the read buffer, which is held by the message */
+    proto::serialize_response_head(data, res);
+    auto owner = r::message_ptr_t(&message);
+    send_response(connection, std::move(data), res.data, std::move(owner));
 }
 
 void controller_actor_t::on_block(message::block_response_t &message) noexcept {
-    --rx_blocks_requested;
     auto ee = message.payload.ee;
-    auto &payload = message.payload.req->payload.request_payload;
-    auto &file_block = payload.block;
+    auto request_id = message.payload.req->payload.id;
+    auto fetch_it = block_fetches.find(request_id);
+    if (fetch_it == block_fetches.end()) {
+        /* the block has been re-requested via other connection */
+        return;
+    }
+    auto &fetch = fetch_it->second;
+    auto &file_block = fetch.block;
     auto &block = *file_block.block();
+    /* the block is requested on behalf of other peer controller */
+    auto swarm_block = file_block.file()->get_folder_info()->get_device() != peer.get();
 
     if (ee) {
         auto &ec = ee->root()->ec;
+        auto &connection = message.payload.req->address;
+        auto extra = connection != peer_addr && peer_addr && state == r::state_t::OPERATIONAL;
+        if (extra && ec.category() != utils::request_error_code_category()) {
+            /* the extra connection is lost, its blocks are requested via the primary one */
+            LOG_DEBUG(log, "{}, block request via extra connection failed: {}", identity, ee->message());
+            auto dead_connection = connection;
+            return drop_connection(dead_connection);
+        }
+    }
+
+    --rx_blocks_requested;
+    if (swarm_block) {
+        --swarm_requested;
+    }
+
+    if (ee) {
+        auto &ec = ee->root()->ec;
+        cluster->get_swarm().finish_fetch(*peer, block);
         if (ec.category() == utils::request_error_code_category()) {
             auto file = file_block.file();
+            if (swarm_block) {
+                LOG_DEBUG(log, "{}, can't receive block from file '{}': {}; returning it to swarm", identity,
+                          file->get_full_name(), ec.message());
+                cluster->get_swarm().release(*peer, file_block, true);
+                release_fetch(request_id);
+                return pull_ready();
+            }
+            release_fetch(request_id);
+            block_done(*file);
             if (!file->is_unreachable()) {
                 LOG_WARN(log, "{}, can't receive block from file '{}': {}; marking unreachable", identity,
                          file->get_full_name(), ec.message());
@@ -602,6 +1150,7 @@ void controller_actor_t::on_block(message::block_response_t &message) noexcept {
             pull_ready();
         } else {
             LOG_WARN(log, "{}, can't receive block : {}", identity, ee->message());
+            release_fetch(request_id);
             do_shutdown(ee);
         }
         return;
@@ -610,26 +1159,76 @@ void controller_actor_t::on_block(message::block_response_t &message) noexcept {
     auto &data = message.payload.res.data;
     auto hash = std::string(file_block.block()->get_hash());
     request_pool += block.get_size();
+    fetch.received = true;
+    cluster->get_swarm().on_received(*peer, data.size());
+    on_rx_delivered(data.size(), fetch);
 
     request<hasher::payload::validation_request_t>(hasher_proxy, data, hash, &message).send(init_timeout);
     resources->acquire(resource::hash);
     return pull_ready();
 }
 
+void controller_actor_t::on_rx_delivered(std::size_t bytes, const block_fetch_t &fetch) noexcept {
+    using duration_t = utils::request_window_t::duration_t;
+    auto rtt = std::chrono::duration_cast<duration_t>(std::chrono::steady_clock::now() - fetch.sent);
+    auto prev_window = rx_window.get_window();
+    rx_window.on_delivered(bytes, rtt);
+
+    /* live metrics, they are not persisted, hence no diff is needed */
+    auto metrics = model::rx_metrics_t{};
+    metrics.window = rx_window.get_window();
+    metrics.min_rtt = rx_window.get_min_rtt();
+    metrics.srtt = rx_window.get_srtt();
+    metrics.timeout = rx_window.get_timeout();
+    metrics.bandwidth = rx_window.get_bandwidth();
+    peer->set_rx_metrics(metrics);
+
+    if (metrics.window != prev_window) {
+        LOG_DEBUG(log, "{}, rx window {} -> {}, min rtt = {}us, bandwidth = {:.0f} B/s, timeout = {}ms", identity,
+                  prev_window, metrics.window, metrics.min_rtt.count(), metrics.bandwidth,
+                  metrics.timeout.count() / 1000);
+    }
+}
+
 void controller_actor_t::on_validation(hasher::message::validation_response_t &res) noexcept {
     using namespace model::diff;
     resources->release(resource::hash);
     auto &ee = res.payload.ee;
     auto block_res = (message::block_response_t *)res.payload.req->payload.request_payload->custom.get();
-    auto &payload = block_res->payload.req->payload.request_payload;
-    auto &file = payload.file;
-    auto &path = file->get_path();
+    auto request_id = block_res->payload.req->payload.id;
+    auto fetch_it = block_fetches.find(request_id);
+    assert(fetch_it != block_fetches.end());
+    /* the iterator might be invalidated by new requests, the node is not */
+    auto &fetch = fetch_it->second;
+    auto &file = fetch.file;
+    auto &file_block = fetch.block;
+    auto swarm_block = file_block.file()->get_folder_info()->get_device() != peer.get();
 
     if (ee) {
         LOG_WARN(log, "{}, on_validation failed : {}", identity, ee->message());
         do_shutdown(ee);
     } else {
-        if (!res.payload.res.valid) {
+        if (swarm_block) {
+            auto &swarm = cluster->get_swarm();
+            auto valid = res.payload.res.valid;
+            if (!valid) {
+                LOG_WARN(log, "{}, digest mismatch for '{}'; returning block to swarm", identity,
+                         file->get_full_name());
+            }
+            /* the source file might not be pulled anymore, drop the block then */
+            if (swarm.release(*peer, file_block, !valid) && valid) {
+                auto &data = block_res->payload.res.data;
+                auto index = file_block.block_index();
+                auto &source = *file_block.file();
+                auto diff = new modify::append_block_t(source, index, std::move(data), make_callback());
+                push_block_write(block_diff_ptr_t(diff));
+            } else {
+                swarm.finish_fetch(*peer, *file_block.block());
+                pull_ready();
+            }
+        } else if (!res.payload.res.valid) {
+            cluster->get_swarm().finish_fetch(*peer, *file_block.block());
+            block_done(*file);
             if (!file->is_unreachable()) {
                 auto ec = utils::make_error_code(utils::protocol_error_code_t::digest_mismatch);
                 LOG_WARN(log, "{}, digest mismatch for '{}'; marking reachable", identity, file->get_full_name(),
@@ -642,7 +1241,7 @@ void controller_actor_t::on_validation(hasher::message::validation_response_t &r
             pull_ready();
         } else {
             auto &data = block_res->payload.res.data;
-            auto index = payload.block.block_index();
+            auto index = file_block.block_index();
 
             LOG_TRACE(log, "{}, {}, got block {}, write requests left = {}", identity, file->get_name(), index,
                       cluster->get_write_requests());
@@ -650,6 +1249,7 @@ void controller_actor_t::on_validation(hasher::message::validation_response_t &r
             push_block_write(std::move(diff));
         }
     }
+    release_fetch(request_id);
 }
 
 #if 0
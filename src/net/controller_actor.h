@@ -10,13 +10,20 @@
 #include "model/messages.h"
 #include "model/messages.h"
 #include "model/diff/modify/block_transaction.h"
+#include "model/diff/peer/update_folder.h"
 #include "hasher/messages.h"
+#include "utils/bandwidth_shaper.h"
 #include "utils/log.h"
+#include "utils/request_window.h"
 #include "fs/messages.h"
 
 #include <unordered_set>
+#include <unordered_map>
+#include <chrono>
 #include <optional>
 #include <deque>
+#include <list>
+#include <variant>
 
 namespace syncspirit {
 namespace net {
@@ -41,7 +48,13 @@ struct controller_actor_config_t : r::actor_config_t {
     r::address_ptr_t peer_addr;
     pt::time_duration request_timeout;
     uint32_t blocks_max_requested = 8;
+    uint32_t files_max_active = 8;
     uint32_t outgoing_buffer_max = 0;
+    /* files + blocks per applied index chunk, zero means the default one */
+    uint32_t index_chunk_weight = 0;
+    tcp::endpoint peer_endpoint;
+    /* of the relay, bytes per second, 0 means no limit */
+    std::uint64_t session_limit = 0;
 };
 
 template <typename Actor> struct controller_actor_config_builder_t : r::actor_config_builder_t<Actor> {
@@ -84,10 +97,30 @@ template <typename Actor> struct controller_actor_config_builder_t : r::actor_co
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 
+    builder_t &&files_max_active(uint32_t value) && noexcept {
+        parent_t::config.files_max_active = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
+
     builder_t &&outgoing_buffer_max(uint32_t value) && noexcept {
         parent_t::config.outgoing_buffer_max = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
+
+    builder_t &&index_chunk_weight(uint32_t value) && noexcept {
+        parent_t::config.index_chunk_weight = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
+
+    builder_t &&peer_endpoint(const tcp::endpoint &value) && noexcept {
+        parent_t::config.peer_endpoint = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
+
+    builder_t &&session_limit(std::uint64_t value) && noexcept {
+        parent_t::config.session_limit = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
 };
 
 struct SYNCSPIRIT_API controller_actor_t : public r::actor_base_t,
@@ -103,7 +136,37 @@ struct SYNCSPIRIT_API controller_actor_t : public r::actor_base_t,
     void shutdown_finish() noexcept override;
 
   private:
-    enum substate_t { none = 0, iterating_files, iterating_blocks };
+    enum class pull_state_t { cloning, locking, pulling };
+
+    /* file, which is being downloaded; all such files share the same
+     * block requests window */
+    struct pulled_file_t {
+        model::file_info_ptr_t file;
+        model::block_iterator_ptr_t block_iterator;
+        pull_state_t state;
+        /* blocks, which are being fetched for other files */
+        std::vector<model::file_block_t> waiting;
+        /* own blocks, which are requested or cloned, but not written yet */
+        std::uint32_t in_flight = 0;
+    };
+
+    /* model side of the block request in flight; the block is locked
+     * meanwhile. It is never passed to the peer actor */
+    struct block_fetch_t {
+        model::file_info_ptr_t file;
+        model::file_block_t block;
+        std::chrono::steady_clock::time_point sent;
+        r::address_ptr_t connection;
+        /* the block data has been received and is being validated */
+        bool received = false;
+    };
+
+    /* pending DownloadProgress update for the file, which is being
+     * downloaded (the key is the source file of some peer) */
+    struct progress_update_t {
+        std::vector<std::int32_t> blocks;
+        bool forget = false;
+    };
 
     using peers_map_t = std::unordered_map<r::address_ptr_t, model::device_ptr_t>;
     using locked_files_t = std::unordered_set<model::file_info_ptr_t>;
@@ -112,9 +175,19 @@ struct SYNCSPIRIT_API controller_actor_t : public r::actor_base_t,
     using unlink_requests_t = std::vector<unlink_request_ptr_t>;
     using block_write_queue_t = std::deque<model::diff::block_diff_ptr_t>;
     using dispose_callback_t = model::diff::modify::block_transaction_t::dispose_callback_t;
+    using pulled_files_t = std::list<pulled_file_t>;
+    using progress_updates_t = std::unordered_map<model::file_info_ptr_t, progress_update_t>;
+    using announced_files_t = std::unordered_set<model::file_info_ptr_t>;
+    using connections_t = std::vector<r::address_ptr_t>;
+    using index_message_t = std::variant<proto::message::Index, proto::message::IndexUpdate>;
+    using index_queue_t = std::deque<index_message_t>;
+    using index_chunks_t = model::diff::peer::update_folder_t::chunks_t;
+    using request_routes_t = std::unordered_map<const proto::Request *, r::address_ptr_t>;
+    using block_fetches_t = std::unordered_map<r::request_id_t, block_fetch_t>;
 
     void on_termination(message::termination_signal_t &message) noexcept;
     void on_forward(message::forwarded_message_t &message) noexcept;
+    void on_forwarded_request(message::forwarded_request_t &message) noexcept;
     void on_pull_ready(message::pull_signal_t &message) noexcept;
     void on_block(message::block_response_t &message) noexcept;
     void on_validation(hasher::message::validation_response_t &res) noexcept;
@@ -128,21 +201,44 @@ struct SYNCSPIRIT_API controller_actor_t : public r::actor_base_t,
     void on_message(proto::message::ClusterConfig &message) noexcept;
     void on_message(proto::message::Index &message) noexcept;
     void on_message(proto::message::IndexUpdate &message) noexcept;
-    void on_message(proto::message::Request &message) noexcept;
+    void on_message(proto::message::Request &message, const r::address_ptr_t &connection = {}) noexcept;
     void on_message(proto::message::DownloadProgress &message) noexcept;
 
-    void request_block(const model::file_block_t &block) noexcept;
+    void request_block(const r::address_ptr_t &connection, const model::file_info_ptr_t &file,
+                       const model::file_block_t &block) noexcept;
+    void release_fetch(r::request_id_t request_id) noexcept;
+    void subscribe_model(bool subscribe) noexcept;
+    void process_index() noexcept;
+    void apply_index_chunk() noexcept;
+    const r::address_ptr_t &pick_connection() noexcept;
+    void drop_connection(const r::address_ptr_t &connection) noexcept;
+    void send_response(const r::address_ptr_t &connection, fmt::memory_buffer &&data, std::string_view tail = {},
+                       r::message_ptr_t tail_owner = {}) noexcept;
     void pull_ready() noexcept;
     void push_pending() noexcept;
-    void send_cluster_config() noexcept;
+    void send_cluster_config(const r::address_ptr_t &connection = {}) noexcept;
     void push_block_write(model::diff::block_diff_ptr_t block) noexcept;
     void process_block_write() noexcept;
+    void on_rx_delivered(std::size_t bytes, const block_fetch_t &fetch) noexcept;
     dispose_callback_t make_callback() noexcept;
 
     model::file_info_ptr_t next_file(bool reset) noexcept;
-    model::file_block_t next_block(bool reset) noexcept;
+    void activate_files() noexcept;
+    void schedule_blocks() noexcept;
+    void start_pulling(pulled_files_t::iterator it) noexcept;
+    pulled_files_t::iterator release_file(pulled_files_t::iterator it) noexcept;
+    pulled_files_t::iterator find_pulled(const model::file_info_t &file) noexcept;
+    void block_done(const model::file_info_t &file) noexcept;
+    void release_finishing(const model::file_info_ptr_t &file) noexcept;
+    void queue_progress(model::file_info_t &source, std::size_t block_index) noexcept;
+    void send_progress() noexcept;
+    void on_progress_timer(r::request_id_t, bool cancelled) noexcept;
+    void on_shaper_timer(r::request_id_t, bool cancelled) noexcept;
+    bool is_shaped() noexcept;
 
     outcome::result<void> operator()(const model::diff::peer::cluster_update_t &, void *) noexcept override;
+    outcome::result<void> operator()(const model::diff::peer::peer_connection_t &, void *) noexcept override;
+    outcome::result<void> operator()(const model::diff::peer::update_folder_t &, void *) noexcept override;
     outcome::result<void> operator()(const model::diff::modify::clone_file_t &, void *) noexcept override;
     outcome::result<void> operator()(const model::diff::modify::lock_file_t &, void *) noexcept override;
     outcome::result<void> operator()(const model::diff::modify::finish_file_ack_t &, void *) noexcept override;
@@ -158,30 +254,50 @@ struct SYNCSPIRIT_API controller_actor_t : public r::actor_base_t,
     model::folder_ptr_t folder;
     r::address_ptr_t coordinator;
     r::address_ptr_t peer_addr;
+    /* extra connections of the peer */
+    connections_t connections;
+    std::size_t next_connection = 0;
+    /* block requests, which have been received via extra connections */
+    request_routes_t request_routes;
+    /* indices, which are waiting for processing, and the one being applied */
+    index_queue_t index_queue;
+    index_chunks_t index_chunks;
+    std::size_t index_chunk = 0;
+    model::diff::peer::update_folder_t::owner_t index_owner;
+    std::string index_folder;
+    bool index_busy = false;
     r::address_ptr_t hasher_proxy;
     r::address_ptr_t fs_addr;
     r::address_ptr_t open_reading; /* for routing */
-    pt::time_duration request_timeout;
     model::ignored_folders_map_t *ignored_folders;
     // generic
     std::uint_fast32_t rx_blocks_requested;
     std::uint_fast32_t tx_blocks_requested;
+    std::uint_fast32_t swarm_requested;
     uint32_t outgoing_buffer;
     uint32_t outgoing_buffer_max;
 
     int64_t request_pool;
     uint32_t blocks_max_kept;
     uint32_t blocks_max_requested;
+    uint32_t files_max_active;
+    uint32_t index_chunk_weight;
+    utils::request_window_t rx_window;
+    utils::bandwidth_shaper_t::bucket_ptr_t rx_bucket;
     utils::logger_t log;
     unlink_requests_t unlink_requests;
-    model::file_info_ptr_t file;
     model::file_iterator_ptr_t file_iterator;
-    model::block_iterator_ptr_t block_iterator;
     model::updates_streamer_t updates_streamer;
-    int substate = substate_t::none;
+    pulled_files_t pulled_files;
+    progress_updates_t progress_updates;
+    announced_files_t announced_files;
+    std::optional<r::request_id_t> progress_timer;
+    std::optional<r::request_id_t> shaper_timer;
     locked_files_t locked_files;
-    locked_files_t locally_locked_files;
+    /* locked files, which are being finished by fs; unlocked on its ack */
+    locked_files_t finishing_files;
     block_write_queue_t block_write_queue;
+    block_fetches_t block_fetches;
 };
 
 } // namespace net
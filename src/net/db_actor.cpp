@@ -604,8 +604,8 @@ auto db_actor_t::operator()(const model::diff::peer::update_folder_t &diff, void
     }
 
     auto &blocks_map = cluster->get_blocks();
-    for (const auto &b : diff.blocks) {
-        auto block = blocks_map.get(b.hash());
+    for (auto b : diff.blocks) {
+        auto block = blocks_map.get(b->hash());
         auto key = block->get_key();
         auto data = block->serialize();
         auto r = db::save({key, data}, txn);
@@ -615,8 +615,8 @@ auto db_actor_t::operator()(const model::diff::peer::update_folder_t &diff, void
     }
 
     auto &files_map = folder_info->get_file_infos();
-    for (const auto &f : diff.files) {
-        auto file = files_map.by_name(f.name());
+    for (auto f : diff.files) {
+        auto file = files_map.by_name(f->name());
         LOG_TRACE(log, "{}, saving {}, seq = {}", identity, file->get_full_name(), file->get_sequence());
         auto key = file->get_key();
         auto data = file->serialize();
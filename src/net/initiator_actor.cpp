@@ -8,6 +8,7 @@
 #include "proto/relay_support.h"
 #include "utils/error_code.h"
 #include "utils/format.hpp"
+#include "model/diff/modify/dial_result.h"
 #include "model/diff/peer/peer_state.h"
 #include <sstream>
 #include <algorithm>
@@ -24,6 +25,7 @@ r::plugin::resource_id_t connect = 2;
 r::plugin::resource_id_t handshake = 3;
 r::plugin::resource_id_t read = 4;
 r::plugin::resource_id_t write = 5;
+r::plugin::resource_id_t timer = 6;
 } // namespace resource
 } // namespace
 
@@ -31,8 +33,9 @@ static constexpr size_t BUFF_SZ = 256;
 
 initiator_actor_t::initiator_actor_t(config_t &cfg)
     : r::actor_base_t{cfg}, peer_device_id{cfg.peer_device_id}, relay_key(std::move(cfg.relay_session)),
-      ssl_pair{*cfg.ssl_pair}, sock(std::move(cfg.sock)), cluster{std::move(cfg.cluster)}, sink(std::move(cfg.sink)),
-      custom(std::move(cfg.custom)), router{*cfg.router}, alpn(cfg.alpn) {
+      session_limit{cfg.session_limit}, ssl_pair{*cfg.ssl_pair}, sock(std::move(cfg.sock)),
+      devices_view{std::move(cfg.devices_view)}, sink(std::move(cfg.sink)), custom(std::move(cfg.custom)),
+      router{*cfg.router}, alpn(cfg.alpn) {
     log = utils::get_logger("net.imitator");
     auto tmp_identity = "init/unknown";
     for (auto &uri : cfg.uris) {
@@ -46,16 +49,6 @@ initiator_actor_t::initiator_actor_t(config_t &cfg)
             }
         }
     }
-    auto comparator = [](const utils::URI &a, const utils::URI &b) noexcept -> bool {
-        if (a.proto == b.proto) {
-            return std::lexicographical_compare(a.full.begin(), a.full.end(), b.full.begin(), b.full.end());
-        }
-        if (a.proto == "relay") {
-            return true;
-        }
-        return false;
-    };
-    std::sort(uris.begin(), uris.end(), comparator);
 
     if (sock.has_value()) {
         role = role_t::passive;
@@ -66,6 +59,37 @@ initiator_actor_t::initiator_actor_t(config_t &cfg)
             role = role_t::active;
         }
     }
+
+    /* direct urls go first, the ones, which were successfully dialed before,
+     * are preferred; relays are tried last */
+    auto history = model::device_t::dial_history_t{};
+    if (devices_view && role == role_t::active) {
+        auto device = devices_view->get(peer_device_id.get_sha256());
+        if (device) {
+            history = std::move(device->dial_history);
+        }
+    }
+    auto get_stats = [&](const utils::URI &uri) noexcept -> model::dial_stats_t {
+        auto it = history.find(uri.full);
+        return it != history.end() ? it->second : model::dial_stats_t{};
+    };
+    auto comparator = [&](const utils::URI &a, const utils::URI &b) noexcept -> bool {
+        if (a.proto != b.proto) {
+            return a.proto == "tcp";
+        }
+        if (a.proto == "tcp") {
+            auto sa = get_stats(a);
+            auto sb = get_stats(b);
+            if (sa.consecutive_failures != sb.consecutive_failures) {
+                return sa.consecutive_failures < sb.consecutive_failures;
+            }
+            if (sa.successes != sb.successes) {
+                return sa.successes > sb.successes;
+            }
+        }
+        return std::lexicographical_compare(a.full.begin(), a.full.end(), b.full.begin(), b.full.end());
+    };
+    std::sort(uris.begin(), uris.end(), comparator);
 }
 
 void initiator_actor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
@@ -93,11 +117,11 @@ void initiator_actor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
         p.subscribe_actor(&initiator_actor_t::on_resolve);
         resources->acquire(resource::initializing);
         if (role == role_t::active) {
-            if (cluster) {
+            if (devices_view) {
                 auto diff = model::diff::cluster_diff_ptr_t();
                 auto state = model::device_state_t::dialing;
                 auto sha256 = peer_device_id.get_sha256();
-                diff = new model::diff::peer::peer_state_t(*cluster, sha256, nullptr, state);
+                diff = new model::diff::peer::peer_state_t(*devices_view, sha256, nullptr, state);
                 send<model::payload::model_update_t>(coordinator, std::move(diff));
             }
             initiate_active();
@@ -113,26 +137,62 @@ void initiator_actor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
     });
 }
 
+/* Starts the next connection attempt without waiting for the previous ones
+ * ("happy eyeballs"): it is invoked on start, when the stagger timer fires,
+ * or when some attempt fails.
+ */
 void initiator_actor_t::initiate_active() noexcept {
-    if (state > r::state_t::OPERATIONAL) {
+    if (state > r::state_t::OPERATIONAL || transport) {
         return;
     }
 
+    cancel_timer();
     while (uri_idx < uris.size()) {
         auto &uri = uris[uri_idx++];
-        if (uri.proto == "tcp") {
-            initiate_active_tls(uri);
-        } else if (uri.proto == "relay") {
-            initiate_active_relay(uri);
-        } else {
+        auto &attempt = attempts.emplace_back();
+        attempt.uri = &uri;
+        auto started = uri.proto == "tcp" ? initiate_active_tls(attempt) : initiate_active_relay(attempt);
+        if (!started) {
+            attempts.pop_back();
             continue;
         }
+        if (uri_idx < uris.size()) {
+            schedule_attempt();
+        }
         return;
     }
 
-    LOG_TRACE(log, "{}, try_next_uri, no way to connect found, shut down", identity);
-    auto ec = utils::make_error_code(utils::error_code_t::connection_impossible);
-    do_shutdown(make_error(ec));
+    auto in_progress = std::any_of(attempts.begin(), attempts.end(), [](auto &it) { return !it.finished; });
+    if (!in_progress) {
+        LOG_TRACE(log, "{}, try_next_uri, no way to connect found, shut down", identity);
+        auto ec = utils::make_error_code(utils::error_code_t::connection_impossible);
+        do_shutdown(make_error(ec));
+    }
+}
+
+void initiator_actor_t::schedule_attempt() noexcept {
+    auto &next = uris[uri_idx];
+    auto delay = next.proto == "relay" ? constants::dial_relay_delay : constants::dial_attempt_delay;
+    timer_request = start_timer(r::pt::milliseconds{delay}, *this, &initiator_actor_t::on_timer);
+    resources->acquire(resource::timer);
+}
+
+void initiator_actor_t::cancel_timer() noexcept {
+    if (timer_request) {
+        r::actor_base_t::cancel_timer(*timer_request);
+        timer_request.reset();
+    }
+}
+
+void initiator_actor_t::on_timer(r::request_id_t request_id, bool cancelled) noexcept {
+    LOG_TRACE(log, "{}, on_timer, cancelled = {}", identity, cancelled);
+    resources->release(resource::timer);
+    if (timer_request && *timer_request == request_id) {
+        timer_request.reset();
+    }
+    if (!cancelled) {
+        initiate_active();
+    }
 }
 
 void initiator_actor_t::initiate_passive() noexcept {
@@ -141,8 +201,9 @@ void initiator_actor_t::initiate_passive() noexcept {
     }
 
     auto sup = static_cast<ra::supervisor_asio_t *>(&router);
-    transport = transport::initiate_tls_passive(*sup, ssl_pair, std::move(sock.value()), alpn);
-    initiate_handshake();
+    auto &attempt = attempts.emplace_back();
+    attempt.transport = transport::initiate_tls_passive(*sup, ssl_pair, std::move(sock.value()), alpn);
+    initiate_handshake(attempt);
 }
 
 void initiator_actor_t::initiate_relay_passive() noexcept {
@@ -152,15 +213,21 @@ void initiator_actor_t::initiate_relay_passive() noexcept {
 
     auto sup = static_cast<ra::supervisor_asio_t *>(&router);
     auto &uri = uris.at(0);
+    auto &attempt = attempts.emplace_back();
+    attempt.uri = &uri;
+    attempt.relay_key = std::move(relay_key);
     transport::transport_config_t cfg{{}, uri, *sup, {}, true};
-    transport = transport::initiate_stream(cfg);
-    assert(transport);
-    resolve(uri);
+    attempt.transport = transport::initiate_stream(cfg);
+    assert(attempt.transport);
+    resolve(attempt, uri);
 }
 
 void initiator_actor_t::on_start() noexcept {
     r::actor_base_t::on_start();
     LOG_TRACE(log, "{}, on_start, alpn = {}", identity, alpn);
+    if (active_uri && active_uri->proto == "relay") {
+        session_limit = proto::relay::parse_session_limit(*active_uri);
+    }
     std::string proto;
     if (active_uri) {
         proto = active_uri->proto;
@@ -172,7 +239,7 @@ void initiator_actor_t::on_start() noexcept {
         }
     }
     send<payload::peer_connected_t>(sink, std::move(transport), peer_device_id, remote_endpoint, std::move(proto),
-                                    std::move(custom));
+                                    std::move(custom), session_limit);
     success = true;
     do_shutdown();
 }
@@ -182,241 +249,293 @@ void initiator_actor_t::shutdown_start() noexcept {
     if (resources->has(resource::initializing)) {
         resources->release(resource::initializing);
     }
-    bool cancel_transport = resources->has(resource::connect) || resources->has(resource::handshake) ||
-                            resources->has(resource::read) || resources->has(resource::write);
-    if (cancel_transport) {
-        transport->cancel();
+    cancel_timer();
+    for (auto &attempt : attempts) {
+        finish(attempt);
     }
     r::actor_base_t::shutdown_start();
 }
 
 void initiator_actor_t::shutdown_finish() noexcept {
     LOG_TRACE(log, "{}, shutdown_finish", identity);
-    bool notify_offline = role == role_t::active && !success && cluster;
+    bool notify_offline = role == role_t::active && !success && devices_view;
     if (notify_offline) {
         auto diff = model::diff::cluster_diff_ptr_t();
         auto state = model::device_state_t::offline;
         auto sha256 = peer_device_id.get_sha256();
-        diff = new model::diff::peer::peer_state_t(*cluster, sha256, nullptr, state);
+        diff = new model::diff::peer::peer_state_t(*devices_view, sha256, nullptr, state);
         send<model::payload::model_update_t>(coordinator, std::move(diff));
     }
     r::actor_base_t::shutdown_finish();
 }
 
-void initiator_actor_t::resolve(const utils::URI &uri) noexcept {
-    LOG_DEBUG(log, "{}, resolving {} (transport = {})", identity, uri.full, (void *)transport.get());
+void initiator_actor_t::acquire(attempt_t &attempt, r::plugin::resource_id_t resource) noexcept {
+    resources->acquire(resource);
+    ++attempt.pending_io;
+}
+
+void initiator_actor_t::release(attempt_t &attempt, r::plugin::resource_id_t resource) noexcept {
+    resources->release(resource);
+    --attempt.pending_io;
+}
+
+void initiator_actor_t::finish(attempt_t &attempt) noexcept {
+    attempt.finished = true;
+    if (attempt.pending_io) {
+        attempt.transport->cancel();
+    }
+}
+
+void initiator_actor_t::fail(attempt_t &attempt, const sys::error_code &ec) noexcept {
+    finish(attempt);
+    if (role != role_t::active) {
+        LOG_DEBUG(log, "{}, initiating shutdown...", identity);
+        return do_shutdown(make_error(ec));
+    }
+    LOG_DEBUG(log, "{}, attempt via '{}' failed: {}", identity, attempt.uri->full, ec.message());
+    record_dial(attempt, false);
+    initiate_active();
+}
+
+void initiator_actor_t::record_dial(const attempt_t &attempt, bool succeeded) noexcept {
+    if (devices_view && role == role_t::active) {
+        auto diff = model::diff::contact_diff_ptr_t();
+        diff = new model::diff::modify::dial_result_t(*devices_view, peer_device_id, *attempt.uri, succeeded);
+        send<model::payload::contact_update_t>(coordinator, std::move(diff), this);
+    }
+}
+
+void initiator_actor_t::resolve(attempt_t &attempt, const utils::URI &uri) noexcept {
+    LOG_DEBUG(log, "{}, resolving {} (transport = {})", identity, uri.full, (void *)attempt.transport.get());
     pt::time_duration resolve_timeout = init_timeout / 2;
     auto port = std::to_string(uri.port);
-    request<payload::address_request_t>(resolver, uri.host, port).send(resolve_timeout);
+    attempt.resolve_request = request<payload::address_request_t>(resolver, uri.host, port).send(resolve_timeout);
     resources->acquire(resource::resolving);
 }
 
-void initiator_actor_t::initiate_active_tls(const utils::URI &uri) noexcept {
+bool initiator_actor_t::initiate_active_tls(attempt_t &attempt) noexcept {
+    auto &uri = *attempt.uri;
     LOG_DEBUG(log, "{}, trying '{}' as active tls, alpn = {}", identity, uri.full, alpn);
     auto sup = static_cast<ra::supervisor_asio_t *>(&router);
-    transport = transport::initiate_tls_active(*sup, ssl_pair, peer_device_id, uri, false, alpn);
-    active_uri = &uri;
-    relaying = false;
-    resolve(uri);
+    attempt.transport = transport::initiate_tls_active(*sup, ssl_pair, peer_device_id, uri, false, alpn);
+    resolve(attempt, uri);
+    return true;
 }
 
-void initiator_actor_t::initiate_active_relay(const utils::URI &uri) noexcept {
+bool initiator_actor_t::initiate_active_relay(attempt_t &attempt) noexcept {
+    auto &uri = *attempt.uri;
     LOG_TRACE(log, "{}, trying '{}' as active relay", identity, uri.full);
     auto relay_device = proto::relay::parse_device(uri);
     if (!relay_device) {
         LOG_WARN(log, "{}, relay url '{}' does not contains valid device_id", identity, uri.full);
-        return initiate_active();
+        return false;
     }
-    active_uri = &uri;
-    relaying = true;
+    attempt.relaying = true;
     auto sup = static_cast<ra::supervisor_asio_t *>(&router);
-    transport = transport::initiate_tls_active(*sup, ssl_pair, relay_device.value(), *active_uri);
-    resolve(uri);
+    attempt.transport = transport::initiate_tls_active(*sup, ssl_pair, relay_device.value(), uri);
+    resolve(attempt, uri);
+    return true;
 }
 
 void initiator_actor_t::on_resolve(message::resolve_response_t &res) noexcept {
     LOG_TRACE(log, "{}, on_resolve", identity);
     resources->release(resource::resolving);
-    if (state > r::state_t::OPERATIONAL) {
+    auto request_id = res.payload.req->payload.id;
+    auto predicate = [&](auto &it) { return it.resolve_request == request_id; };
+    auto it = std::find_if(attempts.begin(), attempts.end(), predicate);
+    if (state > r::state_t::OPERATIONAL || it == attempts.end() || it->finished) {
         return;
     }
 
+    auto &attempt = *it;
     auto &ee = res.payload.ee;
     if (ee) {
         LOG_WARN(log, "{}, on_resolve error : {}", identity, ee->message());
-        if (role == role_t::active) {
-            return initiate_active();
-        } else {
+        if (role != role_t::active) {
             return do_shutdown(ee);
         }
+        finish(attempt);
+        record_dial(attempt, false);
+        return initiate_active();
     }
 
     auto &addresses = res.payload.res->results;
-    transport::connect_fn_t on_connect = [&](const auto &arg) { this->on_connect(arg); };
-    transport::error_fn_t on_error = [&](auto arg) { this->on_io_error(arg, resource::connect); };
-    transport->async_connect(addresses, on_connect, on_error);
-    resources->acquire(resource::connect);
+    transport::connect_fn_t on_connect = [this, &attempt](const auto &) { this->on_connect(attempt); };
+    transport::error_fn_t on_error = [this, &attempt](auto arg) { on_io_error(attempt, arg, resource::connect); };
+    attempt.transport->async_connect(addresses, on_connect, on_error);
+    acquire(attempt, resource::connect);
 }
 
-void initiator_actor_t::on_io_error(const sys::error_code &ec, r::plugin::resource_id_t resource) noexcept {
+void initiator_actor_t::on_io_error(attempt_t &attempt, const sys::error_code &ec,
+                                    r::plugin::resource_id_t resource) noexcept {
     LOG_TRACE(log, "{}, on_io_error: {}", identity, ec.message());
-    resources->release(resource);
+    release(attempt, resource);
     if (ec != asio::error::operation_aborted) {
         LOG_WARN(log, "{}, on_io_error: {}", identity, ec.message());
     }
-    if (state < r::state_t::SHUTTING_DOWN) {
-        if (!connected && role == role_t::active) {
-            initiate_active();
-        } else {
-            connected = false;
-            LOG_DEBUG(log, "{}, on_io_error, initiating shutdown...", identity);
-            do_shutdown(make_error(ec));
-        }
+    if (state < r::state_t::SHUTTING_DOWN && !attempt.finished) {
+        fail(attempt, ec);
     }
 }
 
-void initiator_actor_t::on_connect(const tcp::endpoint &) noexcept {
+void initiator_actor_t::on_connect(attempt_t &attempt) noexcept {
     LOG_TRACE(log, "{}, on_connect, device_id = {}, transport = {}", identity, peer_device_id.get_short(),
-              (void *)transport.get());
-    resources->release(resource::connect);
-    // auto do_handshake = role == role_t::active;
+              (void *)attempt.transport.get());
+    release(attempt, resource::connect);
+    if (attempt.finished) {
+        return;
+    }
+    auto uri = attempt.uri;
     auto do_handshake =
-        (role == role_t::active) &&
-        (active_uri && ((((active_uri->proto == "relay") && relaying)) || (active_uri->proto == "tcp")));
+        (role == role_t::active) && (uri && (((uri->proto == "relay") && attempt.relaying) || (uri->proto == "tcp")));
     if (do_handshake) {
-        initiate_handshake();
+        initiate_handshake(attempt);
     } else {
-        join_session();
+        join_session(attempt);
     }
 }
 
-void initiator_actor_t::initiate_handshake() noexcept {
+void initiator_actor_t::initiate_handshake(attempt_t &attempt) noexcept {
     if (state > r::state_t::OPERATIONAL) {
         return;
     }
 
     LOG_TRACE(log, "{}, initializing handshake", identity);
-    connected = true;
-    transport::handshake_fn_t handshake_fn([&](auto &&...args) { on_handshake(args...); });
-    transport::error_fn_t error_fn([&](auto arg) { on_io_error(arg, resource::handshake); });
-    resources->acquire(resource::handshake);
-    transport->async_handshake(handshake_fn, error_fn);
+    transport::handshake_fn_t handshake_fn([this, &attempt](auto &&...args) { on_handshake(attempt, args...); });
+    transport::error_fn_t error_fn([this, &attempt](auto arg) { on_io_error(attempt, arg, resource::handshake); });
+    acquire(attempt, resource::handshake);
+    attempt.transport->async_handshake(handshake_fn, error_fn);
 }
 
-void initiator_actor_t::join_session() noexcept {
+void initiator_actor_t::join_session(attempt_t &attempt) noexcept {
     if (state > r::state_t::OPERATIONAL) {
         return;
     }
 
-    transport::error_fn_t read_err_fn([&](auto arg) { on_io_error(arg, resource::read); });
-    transport::io_fn_t read_fn = [this](size_t bytes) { on_read_relay(bytes); };
-    rx_buff.resize(BUFF_SZ);
-    transport->async_recv(asio::buffer(rx_buff), read_fn, read_err_fn);
-    resources->acquire(resource::read);
+    transport::error_fn_t read_err_fn([this, &attempt](auto arg) { on_io_error(attempt, arg, resource::read); });
+    transport::io_fn_t read_fn = [this, &attempt](size_t bytes) { on_read_relay(attempt, bytes); };
+    attempt.rx_buff.resize(BUFF_SZ);
+    attempt.transport->async_recv(asio::buffer(attempt.rx_buff), read_fn, read_err_fn);
+    acquire(attempt, resource::read);
 
     LOG_TRACE(log, "{}, join_session", identity);
-    auto msg = proto::relay::join_session_request_t{std::move(relay_key)};
-    proto::relay::serialize(msg, relay_tx);
-    transport::error_fn_t write_err_fn([&](auto arg) { on_io_error(arg, resource::write); });
-    transport::io_fn_t write_fn = [this](size_t bytes) { on_write(bytes); };
-    transport->async_send(asio::buffer(relay_tx), write_fn, write_err_fn);
-    resources->acquire(resource::write);
+    auto msg = proto::relay::join_session_request_t{std::move(attempt.relay_key)};
+    proto::relay::serialize(msg, attempt.relay_tx);
+    transport::error_fn_t write_err_fn([this, &attempt](auto arg) { on_io_error(attempt, arg, resource::write); });
+    transport::io_fn_t write_fn = [this, &attempt](size_t bytes) { on_write(attempt, bytes); };
+    attempt.transport->async_send(asio::buffer(attempt.relay_tx), write_fn, write_err_fn);
+    acquire(attempt, resource::write);
 }
 
-void initiator_actor_t::on_handshake(bool valid_peer, utils::x509_t &cert, const tcp::endpoint &peer_endpoint,
+void initiator_actor_t::on_handshake(attempt_t &attempt, bool valid_peer, utils::x509_t &cert,
+                                     const tcp::endpoint &peer_endpoint,
                                      const model::device_id_t *peer_device) noexcept {
-    resources->release(resource::handshake);
+    release(attempt, resource::handshake);
+    if (attempt.finished || state > r::state_t::OPERATIONAL) {
+        return;
+    }
     if (!peer_device) {
         LOG_WARN(log, "{}, on_handshake,  missing peer device id", identity);
         auto ec = utils::make_error_code(utils::error_code_t::missing_device_id);
-        return do_shutdown(make_error(ec));
+        return fail(attempt, ec);
     }
 
     auto cert_name = utils::get_common_name(cert);
     if (!cert_name) {
         LOG_WARN(log, "{}, on_handshake, can't get certificate name: {}", identity, cert_name.error().message());
         auto ec = utils::make_error_code(utils::error_code_t::missing_cn);
-        return do_shutdown(make_error(ec));
+        return fail(attempt, ec);
     }
     LOG_TRACE(log, "{}, on_handshake, valid = {}, issued by {}", identity, valid_peer, cert_name.value());
-    if (relaying) {
-        request_relay_connection();
+    if (attempt.relaying) {
+        request_relay_connection(attempt);
     } else {
+        attempt.finished = true;
+        transport = std::move(attempt.transport);
+        active_uri = attempt.uri;
         peer_device_id = *peer_device;
         remote_endpoint = peer_endpoint;
-        if (state <= r::state_t::OPERATIONAL) {
-            resources->release(resource::initializing);
+        record_dial(attempt, true);
+        cancel_timer();
+        for (auto &it : attempts) {
+            if (!it.finished) {
+                LOG_DEBUG(log, "{}, cancelling attempt via '{}'", identity, it.uri->full);
+                finish(it);
+            }
         }
+        resources->release(resource::initializing);
     }
 }
 
-void initiator_actor_t::on_write(size_t bytes) noexcept {
+void initiator_actor_t::on_write(attempt_t &attempt, size_t bytes) noexcept {
     LOG_TRACE(log, "{}, on_write, {} bytes", identity, bytes);
-    resources->release(resource::write);
+    release(attempt, resource::write);
 }
 
-void initiator_actor_t::on_read_relay(size_t bytes) noexcept {
+void initiator_actor_t::on_read_relay(attempt_t &attempt, size_t bytes) noexcept {
     LOG_TRACE(log, "{}, on_read_relay, {} bytes", identity, bytes);
-    resources->release(resource::read);
-    if (state > r::state_t::OPERATIONAL) {
+    release(attempt, resource::read);
+    if (attempt.finished || state > r::state_t::OPERATIONAL) {
         return;
     }
 
-    auto buff = std::string_view(rx_buff.data(), bytes);
+    auto buff = std::string_view(attempt.rx_buff.data(), bytes);
     auto r = proto::relay::parse(buff);
     auto wrapped = std::get_if<proto::relay::wrapped_message_t>(&r);
+    auto ec = utils::make_error_code(utils::error_code_t::relay_failure);
     if (!wrapped) {
         LOG_WARN(log, "{}, unexpected incoming relay data: {}", identity, spdlog::to_hex(buff.begin(), buff.end()));
-        auto ec = utils::make_error_code(utils::error_code_t::relay_failure);
-        return do_shutdown(make_error(ec));
+        return fail(attempt, ec);
     }
     auto reply = std::get_if<proto::relay::response_t>(&wrapped->message);
     if (!reply) {
         LOG_WARN(log, "{}, unexpected relay message: {}", identity, spdlog::to_hex(buff.begin(), buff.end()));
-        auto ec = utils::make_error_code(utils::error_code_t::relay_failure);
-        return do_shutdown(make_error(ec));
+        return fail(attempt, ec);
     }
     if (reply->code) {
         LOG_WARN(log, "{}, relay join failure({}): {}", identity, reply->code, reply->details);
-        auto ec = utils::make_error_code(utils::error_code_t::relay_failure);
-        return do_shutdown(make_error(ec));
+        return fail(attempt, ec);
     }
-    auto &upgradeable = dynamic_cast<transport::upgradeable_stream_base_t &>(*transport.get());
+    auto &upgradeable = dynamic_cast<transport::upgradeable_stream_base_t &>(*attempt.transport.get());
     auto ssl = transport::ssl_junction_t{peer_device_id, &ssl_pair, true, constants::protocol_name};
     auto active = role == role_t::active;
-    transport = upgradeable.upgrade(ssl, active);
-    initiate_handshake();
+    attempt.transport = upgradeable.upgrade(ssl, active);
+    initiate_handshake(attempt);
 }
 
-void initiator_actor_t::request_relay_connection() noexcept {
+void initiator_actor_t::request_relay_connection(attempt_t &attempt) noexcept {
     if (state > r::state_t::OPERATIONAL) {
         return;
     }
 
-    transport::error_fn_t read_err_fn([&](auto arg) { on_io_error(arg, resource::read); });
-    transport::io_fn_t read_fn = [this](size_t bytes) { on_read_relay_active(bytes); };
-    rx_buff.resize(BUFF_SZ);
-    transport->async_recv(asio::buffer(rx_buff), read_fn, read_err_fn);
-    resources->acquire(resource::read);
+    transport::error_fn_t read_err_fn([this, &attempt](auto arg) { on_io_error(attempt, arg, resource::read); });
+    transport::io_fn_t read_fn = [this, &attempt](size_t bytes) { on_read_relay_active(attempt, bytes); };
+    attempt.rx_buff.resize(BUFF_SZ);
+    attempt.transport->async_recv(asio::buffer(attempt.rx_buff), read_fn, read_err_fn);
+    acquire(attempt, resource::read);
 
     auto msg = proto::relay::connect_request_t{std::string(peer_device_id.get_sha256())};
-    proto::relay::serialize(msg, relay_tx);
-    transport::error_fn_t write_err_fn([&](auto arg) { on_io_error(arg, resource::write); });
-    transport::io_fn_t write_fn = [this](size_t bytes) { on_write(bytes); };
-    transport->async_send(asio::buffer(relay_tx), write_fn, write_err_fn);
-    resources->acquire(resource::write);
+    proto::relay::serialize(msg, attempt.relay_tx);
+    transport::error_fn_t write_err_fn([this, &attempt](auto arg) { on_io_error(attempt, arg, resource::write); });
+    transport::io_fn_t write_fn = [this, &attempt](size_t bytes) { on_write(attempt, bytes); };
+    attempt.transport->async_send(asio::buffer(attempt.relay_tx), write_fn, write_err_fn);
+    acquire(attempt, resource::write);
 }
 
-void initiator_actor_t::on_read_relay_active(size_t bytes) noexcept {
+void initiator_actor_t::on_read_relay_active(attempt_t &attempt, size_t bytes) noexcept {
     LOG_TRACE(log, "{}, on_read_relay_active, {} bytes", identity, bytes);
-    resources->release(resource::read);
-    auto buff = std::string_view(rx_buff.data(), bytes);
+    release(attempt, resource::read);
+    if (attempt.finished || state > r::state_t::OPERATIONAL) {
+        return;
+    }
+
+    auto buff = std::string_view(attempt.rx_buff.data(), bytes);
     auto r = proto::relay::parse(buff);
     auto wrapped = std::get_if<proto::relay::wrapped_message_t>(&r);
+    auto ec = utils::make_error_code(utils::error_code_t::relay_failure);
     if (!wrapped) {
         LOG_WARN(log, "{}, unexpected incoming relay data: {}", identity, spdlog::to_hex(buff.begin(), buff.end()));
-        auto ec = utils::make_error_code(utils::error_code_t::relay_failure);
-        return do_shutdown(make_error(ec));
+        return fail(attempt, ec);
     }
     auto inv = std::get_if<proto::relay::session_invitation_t>(&wrapped->message);
     if (!inv) {
@@ -426,25 +545,25 @@ void initiator_actor_t::on_read_relay_active(size_t bytes) noexcept {
         } else {
             LOG_WARN(log, "{}, unexpected relay message: {}", identity, spdlog::to_hex(buff.begin(), buff.end()));
         }
-        return initiate_active();
+        return fail(attempt, ec);
     }
     auto &peer = inv->from;
     if (peer != peer_device_id.get_sha256()) {
         LOG_WARN(log, "{}, unexpected peer device: {}", identity, spdlog::to_hex(peer.begin(), peer.end()));
-        return initiate_active();
+        return fail(attempt, ec);
     }
     auto &addr = inv->address;
-    relay_key = inv->key;
-    auto ip = !addr.empty() ? &addr : &active_uri->host;
+    attempt.relay_key = inv->key;
+    auto ip = !addr.empty() ? &addr : &attempt.uri->host;
     auto uri_str = fmt::format("tcp://{}:{}", *ip, inv->port);
     LOG_DEBUG(log, "{}, going to connect to {}, using key: {}", identity, uri_str,
-              spdlog::to_hex(relay_key.begin(), relay_key.end()));
+              spdlog::to_hex(attempt.relay_key.begin(), attempt.relay_key.end()));
     auto uri_opt = utils::parse(uri_str);
     auto &uri = uri_opt.value();
-    relaying = false;
+    attempt.relaying = false;
 
     auto sup = static_cast<ra::supervisor_asio_t *>(&router);
     transport::transport_config_t cfg{{}, uri, *sup, {}, true};
-    transport = transport::initiate_stream(cfg);
-    resolve(uri);
+    attempt.transport = transport::initiate_stream(cfg);
+    resolve(attempt, uri);
 }
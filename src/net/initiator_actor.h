@@ -4,11 +4,12 @@
 #pragma once
 
 #include <rotor.hpp>
-#include "model/cluster.h"
+#include "model/misc/devices_view.h"
 #include "config/bep.h"
 #include "messages.h"
 #include "utils/log.h"
 #include "transport/stream.h"
+#include <list>
 
 namespace syncspirit::net {
 
@@ -18,9 +19,10 @@ struct initiator_actor_config_t : public r::actor_config_t {
     model::device_id_t peer_device_id;
     utils::uri_container_t uris;
     std::string relay_session;
+    std::uint64_t session_limit = 0;
     const utils::key_pair_t *ssl_pair;
     std::optional<tcp_socket_t> sock;
-    model::cluster_ptr_t cluster;
+    model::devices_view_ptr_t devices_view;
     r::address_ptr_t sink;
     r::message_ptr_t custom;
     r::supervisor_t *router;
@@ -48,6 +50,11 @@ template <typename Actor> struct initiator_actor_config_builder_t : r::actor_con
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 
+    builder_t &&session_limit(std::uint64_t value) && noexcept {
+        parent_t::config.session_limit = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
+
     builder_t &&ssl_pair(const utils::key_pair_t *value) && noexcept {
         parent_t::config.ssl_pair = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
@@ -58,8 +65,8 @@ template <typename Actor> struct initiator_actor_config_builder_t : r::actor_con
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 
-    builder_t &&cluster(const model::cluster_ptr_t &value) && noexcept {
-        parent_t::config.cluster = value;
+    builder_t &&devices_view(const model::devices_view_ptr_t &value) && noexcept {
+        parent_t::config.devices_view = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 
@@ -105,33 +112,55 @@ struct SYNCSPIRIT_API initiator_actor_t : r::actor_base_t {
     using resolve_it_t = payload::address_response_t::resolve_results_t::iterator;
     enum class role_t { active, passive, relay_passive };
 
+    /* a single connection attempt; in the active role several of them
+     * might race, the first one, which completes TLS handshake, wins */
+    struct attempt_t {
+        const utils::URI *uri = nullptr;
+        transport::stream_sp_t transport;
+        r::request_id_t resolve_request = 0;
+        std::string rx_buff;
+        std::string relay_tx;
+        std::string relay_key;
+        std::size_t pending_io = 0;
+        bool relaying = false;
+        bool finished = false;
+    };
+    using attempts_t = std::list<attempt_t>;
+
     void initiate_passive() noexcept;
     void initiate_active() noexcept;
     void initiate_relay_passive() noexcept;
-    void initiate_active_tls(const utils::URI &uri) noexcept;
-    void initiate_active_relay(const utils::URI &uri) noexcept;
-    void initiate_handshake() noexcept;
-    void join_session() noexcept;
-    void request_relay_connection() noexcept;
-    void resolve(const utils::URI &uri) noexcept;
+    bool initiate_active_tls(attempt_t &attempt) noexcept;
+    bool initiate_active_relay(attempt_t &attempt) noexcept;
+    void initiate_handshake(attempt_t &attempt) noexcept;
+    void join_session(attempt_t &attempt) noexcept;
+    void request_relay_connection(attempt_t &attempt) noexcept;
+    void resolve(attempt_t &attempt, const utils::URI &uri) noexcept;
+    void schedule_attempt() noexcept;
+    void cancel_timer() noexcept;
+    void finish(attempt_t &attempt) noexcept;
+    void fail(attempt_t &attempt, const sys::error_code &ec) noexcept;
+    void record_dial(const attempt_t &attempt, bool succeeded) noexcept;
+    void acquire(attempt_t &attempt, r::plugin::resource_id_t resource) noexcept;
+    void release(attempt_t &attempt, r::plugin::resource_id_t resource) noexcept;
 
     void on_resolve(message::resolve_response_t &res) noexcept;
-    void on_connect(const tcp::endpoint &) noexcept;
-    void on_io_error(const sys::error_code &ec, r::plugin::resource_id_t resource) noexcept;
-    void on_handshake(bool valid_peer, utils::x509_t &peer_cert, const tcp::endpoint &peer_endpoint,
-                      const model::device_id_t *peer_device) noexcept;
-    void on_read_relay(size_t bytes) noexcept;
-    void on_read_relay_active(size_t bytes) noexcept;
-    void on_write(size_t bytes) noexcept;
+    void on_timer(r::request_id_t, bool cancelled) noexcept;
+    void on_connect(attempt_t &attempt) noexcept;
+    void on_io_error(attempt_t &attempt, const sys::error_code &ec, r::plugin::resource_id_t resource) noexcept;
+    void on_handshake(attempt_t &attempt, bool valid_peer, utils::x509_t &peer_cert,
+                      const tcp::endpoint &peer_endpoint, const model::device_id_t *peer_device) noexcept;
+    void on_read_relay(attempt_t &attempt, size_t bytes) noexcept;
+    void on_read_relay_active(attempt_t &attempt, size_t bytes) noexcept;
+    void on_write(attempt_t &attempt, size_t bytes) noexcept;
 
     model::device_id_t peer_device_id;
     utils::uri_container_t uris;
-    std::string relay_rx;
-    std::string relay_tx;
     std::string relay_key;
+    std::uint64_t session_limit;
     const utils::key_pair_t &ssl_pair;
     std::optional<tcp_socket_t> sock;
-    model::cluster_ptr_t cluster;
+    model::devices_view_ptr_t devices_view;
     r::address_ptr_t sink;
     r::message_ptr_t custom;
     r::supervisor_t &router;
@@ -141,14 +170,13 @@ struct SYNCSPIRIT_API initiator_actor_t : r::actor_base_t {
     transport::stream_sp_t transport;
     r::address_ptr_t resolver;
     r::address_ptr_t coordinator;
+    attempts_t attempts;
+    std::optional<r::request_id_t> timer_request;
     size_t uri_idx = 0;
     utils::logger_t log;
     tcp::endpoint remote_endpoint;
-    bool connected = false;
     role_t role = role_t::passive;
-    std::string rx_buff;
     bool success = false;
-    bool relaying = false;
 };
 
 namespace payload {
@@ -159,6 +187,8 @@ struct peer_connected_t {
     tcp::endpoint remote_endpoint;
     std::string proto;
     r::message_ptr_t custom;
+    /* of the relay, bytes per second, 0 means no limit */
+    std::uint64_t session_limit = 0;
 };
 
 } // namespace payload
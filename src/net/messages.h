@@ -10,6 +10,7 @@
 #include <boost/beast/core.hpp>
 #include <boost/beast/http.hpp>
 
+#include <chrono>
 #include <memory>
 #include <optional>
 
@@ -36,6 +37,10 @@ using v4 = asio::ip::address_v4;
 using udp_socket_t = udp::socket;
 using tcp_socket_t = tcp::socket;
 
+/* classes of outgoing BEP messages, in priority order */
+enum class tx_class_t : std::uint8_t { control = 0, index, request, response };
+static constexpr std::size_t tx_classes_count = 4;
+
 namespace payload {
 
 using cluster_config_ptr_t = std::unique_ptr<proto::ClusterConfig>;
@@ -125,16 +130,28 @@ using forwarded_message_t =
     std::variant<proto::message::ClusterConfig, proto::message::Index, proto::message::IndexUpdate,
                  proto::message::Request, proto::message::DownloadProgress>;
 
+/* block request, received via extra peer connection; it has to be
+ * replied via the same connection */
+struct forwarded_request_t {
+    proto::message::Request request;
+    r::address_ptr_t connection;
+};
+
 struct block_response_t {
     std::string data;
 };
 
+/* plain values only: the request is handled (and might be destroyed) by the
+ * peer actor, which might live on the other thread, while the requested
+ * model objects are kept by the controller */
 struct block_request_t {
     using response_t = block_response_t;
-    model::file_info_ptr_t file;
-    model::file_block_t block;
-    block_request_t(const model::file_info_ptr_t &file, const model::file_block_t &block) noexcept;
-    ~block_request_t();
+    std::string folder_id;
+    std::string file_name;
+    std::size_t block_index;
+    std::int64_t offset;
+    std::uint32_t size;
+    std::string hash;
 };
 
 struct connect_response_t {
@@ -151,6 +168,11 @@ struct connect_request_t {
 
 struct transfer_data_t {
     fmt::memory_buffer data;
+    tx_class_t tx_class;
+    /* sent right after data as is (i.e. block content of Response),
+     * the owner message keeps it alive */
+    std::string_view tail = {};
+    r::message_ptr_t tail_owner = {};
 };
 
 struct transfer_push_t {
@@ -183,6 +205,7 @@ using load_cluster_response_t = r::request_traits_t<payload::load_cluster_reques
 
 using start_reading_t = r::message_t<payload::start_reading_t>;
 using forwarded_message_t = r::message_t<payload::forwarded_message_t>;
+using forwarded_request_t = r::message_t<payload::forwarded_request_t>;
 using termination_signal_t = r::message_t<payload::termination_t>;
 using transfer_data_t = r::message_t<payload::transfer_data_t>;
 using transfer_push_t = r::message_t<payload::transfer_push_t>;
@@ -2,6 +2,7 @@
 // SPDX-FileCopyrightText: 2019-2024 Ivan Baidakou
 
 #include "config/utils.h"
+#include "utils/bandwidth_shaper.h"
 #include "utils/error_code.h"
 #include "net_supervisor.h"
 #include "global_discovery_actor.h"
@@ -24,7 +25,7 @@ namespace bfs = boost::filesystem;
 using namespace syncspirit::net;
 
 net_supervisor_t::net_supervisor_t(net_supervisor_t::config_t &cfg)
-    : parent_t{cfg}, app_config{cfg.app_config}, cluster_copies{cfg.cluster_copies} {
+    : parent_t{cfg}, app_config{cfg.app_config}, cluster_copies{cfg.cluster_copies}, devices_view{cfg.devices_view} {
     seed = (size_t)std::time(nullptr);
     log = utils::get_logger("net.coordinator");
     auto &files_cfg = app_config.global_announce_config;
@@ -79,6 +80,7 @@ void net_supervisor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
         p.subscribe_actor(&net_supervisor_t::on_model_update);
         p.subscribe_actor(&net_supervisor_t::on_block_update);
         p.subscribe_actor(&net_supervisor_t::on_contact_update);
+        p.subscribe_actor(&net_supervisor_t::on_model_interest);
         p.subscribe_actor(&net_supervisor_t::on_load_cluster);
         p.subscribe_actor(&net_supervisor_t::on_model_request);
         launch_early();
@@ -143,6 +145,16 @@ void net_supervisor_t::on_load_cluster(message::load_cluster_response_t &message
     }
 }
 
+/* The fs thread gets its own replica of the cluster, seeded the same way,
+ * and applies the same diffs in the same order, i.e. the coordinator is the
+ * single source of changes. The replica cannot be replaced by a shared
+ * (read-only) cluster: model objects are reference counted in thread-unsafe
+ * manner and the actors keep model pointers between messages, so any
+ * cross-thread access, even the read one, is a data race.
+ *
+ * Peer threads need devices only, they read the devices view, which is
+ * updated here, right after a diff has been applied.
+ */
 void net_supervisor_t::on_model_request(model::message::model_request_t &message) noexcept {
     --cluster_copies;
     LOG_TRACE(log, "{}, on_cluster_seed, left = {}", identity, cluster_copies);
@@ -165,11 +177,16 @@ void net_supervisor_t::on_model_update(model::message::model_update_t &message)
         auto ee = make_error(r.assume_error());
         do_shutdown(ee);
     }
+    devices_view->update(*cluster, diff);
     r = diff.visit(*this, nullptr);
     if (!r) {
         auto ee = make_error(r.assume_error());
         do_shutdown(ee);
     }
+    auto &p = message.payload;
+    for (auto &addr : diff_router.route(*cluster, diff, p.custom)) {
+        send<model::payload::model_update_t>(addr, p.diff, p.custom);
+    }
 }
 
 void net_supervisor_t::on_block_update(model::message::block_update_t &message) noexcept {
@@ -180,6 +197,10 @@ void net_supervisor_t::on_block_update(model::message::block_update_t &message)
         auto ee = make_error(r.assume_error());
         do_shutdown(ee);
     }
+    auto &p = message.payload;
+    for (auto &addr : diff_router.route(*cluster, diff, p.custom)) {
+        send<model::payload::block_update_t>(addr, p.diff, p.custom);
+    }
 }
 
 void net_supervisor_t::on_contact_update(model::message::contact_update_t &message) noexcept {
@@ -190,6 +211,17 @@ void net_supervisor_t::on_contact_update(model::message::contact_update_t &messa
         auto ee = make_error(r.assume_error());
         do_shutdown(ee);
     }
+    devices_view->update(*cluster, diff);
+}
+
+void net_supervisor_t::on_model_interest(model::message::model_interest_t &message) noexcept {
+    auto &p = message.payload;
+    LOG_TRACE(log, "{}, on_model_interest, subscribe = {}", identity, p.subscribe);
+    if (p.subscribe) {
+        diff_router.add(p.subscriber, p.owner, p.peer_id, p.kinds);
+    } else {
+        diff_router.remove(p.subscriber);
+    }
 }
 
 auto net_supervisor_t::operator()(const model::diff::load::load_cluster_t &, void *) noexcept -> outcome::result<void> {
@@ -229,6 +261,9 @@ auto net_supervisor_t::operator()(const model::diff::load::load_cluster_t &, voi
 
 void net_supervisor_t::launch_net() noexcept {
     LOG_INFO(log, "{}, launching network services", identity);
+    // the config is read only at startup, hence the limits are set once here;
+    // configure() can be called again as soon as there is a config reload path
+    utils::bandwidth_shaper_t::instance().configure(app_config.bandwidth_config);
 
     if (app_config.upnp_config.enabled) {
         auto factory = [this](r::supervisor_t &, const r::address_ptr_t &spawner) -> r::actor_ptr_t {
@@ -314,13 +349,14 @@ void net_supervisor_t::launch_net() noexcept {
     auto timeout = shutdown_timeout * 9 / 10;
     create_actor<acceptor_actor_t>().cluster(cluster).timeout(timeout).escalate_failure().finish();
     create_actor<peer_supervisor_t>()
-        .cluster(cluster)
+        .devices_view(devices_view)
         .ssl_pair(&ssl_pair)
         .device_name(app_config.device_name)
         .strand(strand)
         .timeout(timeout)
         .bep_config(app_config.bep_config)
         .relay_config(app_config.relay_config)
+        .net_threads(app_config.net_threads)
         .escalate_failure()
         .finish();
 
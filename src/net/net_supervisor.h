@@ -7,6 +7,8 @@
 #include "model/device.h"
 #include "model/diff/cluster_visitor.h"
 #include "model/diff/block_visitor.h"
+#include "model/misc/devices_view.h"
+#include "model/misc/diff_router.h"
 #include "utils/log.h"
 #include "messages.h"
 #include <boost/asio.hpp>
@@ -22,6 +24,7 @@ namespace outcome = boost::outcome_v2;
 struct net_supervisor_config_t : ra::supervisor_config_asio_t {
     config::main_t app_config;
     size_t cluster_copies = 0;
+    model::devices_view_ptr_t devices_view;
 };
 
 template <typename Supervisor>
@@ -39,6 +42,11 @@ struct net_supervisor_config_builder_t : ra::supervisor_config_asio_builder_t<Su
         parent_t::config.cluster_copies = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
+
+    builder_t &&devices_view(const model::devices_view_ptr_t &value) && noexcept {
+        parent_t::config.devices_view = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
 };
 
 struct SYNCSPIRIT_API net_supervisor_t : public ra::supervisor_asio_t, private model::diff::cluster_visitor_t {
@@ -59,6 +67,7 @@ struct SYNCSPIRIT_API net_supervisor_t : public ra::supervisor_asio_t, private m
     void on_model_update(model::message::model_update_t &message) noexcept;
     void on_block_update(model::message::block_update_t &message) noexcept;
     void on_contact_update(model::message::contact_update_t &message) noexcept;
+    void on_model_interest(model::message::model_interest_t &message) noexcept;
     void on_model_request(model::message::model_request_t &message) noexcept;
 
     void dial_peer(const model::device_id_t &peer_device_id, const utils::uri_container_t &uris) noexcept;
@@ -79,6 +88,8 @@ struct SYNCSPIRIT_API net_supervisor_t : public ra::supervisor_asio_t, private m
     model::device_id_t global_device;
     r::address_ptr_t db_addr;
     model::cluster_ptr_t cluster;
+    model::diff_router_t diff_router;
+    model::devices_view_ptr_t devices_view;
     utils::key_pair_t ssl_pair;
 
     // for debug
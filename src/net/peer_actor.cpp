@@ -7,10 +7,13 @@
 #include "utils/tls.h"
 #include "utils/error_code.h"
 #include "utils/format.hpp"
+#include "utils/network_interface.h"
 #include "proto/bep_support.h"
 #include "model/messages.h"
+#include "model/diff/peer/peer_connection.h"
 #include "model/diff/peer/peer_state.h"
 #include <boost/core/demangle.hpp>
+#include <algorithm>
 #include <sstream>
 
 using namespace syncspirit::net;
@@ -24,14 +27,23 @@ r::plugin::resource_id_t io_timer = 2;
 r::plugin::resource_id_t tx_timer = 3;
 r::plugin::resource_id_t rx_timer = 4;
 r::plugin::resource_id_t finalization = 5;
+r::plugin::resource_id_t shaper_timer = 6;
 } // namespace resource
 } // namespace
 
 peer_actor_t::peer_actor_t(config_t &config)
-    : r::actor_base_t{config}, cluster{config.cluster}, device_name{config.device_name}, bep_config{config.bep_config},
-      coordinator{config.coordinator}, peer_device_id{config.peer_device_id}, transport(std::move(config.transport)),
-      peer_endpoint{config.peer_endpoint}, peer_proto(std::move(config.peer_proto)) {
+    : r::actor_base_t{config}, devices_view{config.devices_view}, device_name{config.device_name},
+      bep_config{config.bep_config}, coordinator{config.coordinator}, peer_device_id{config.peer_device_id},
+      transport(std::move(config.transport)),
+      tx_queue{{bep_config.tx_control_quantum, bep_config.tx_index_quantum, bep_config.tx_request_quantum,
+                bep_config.tx_response_quantum}},
+      peer_endpoint{config.peer_endpoint}, peer_proto(std::move(config.peer_proto)),
+      session_limit{config.session_limit} {
+    using direction_t = utils::bandwidth_shaper_t::direction_t;
     rx_buff.resize(config.bep_config.rx_buff_size);
+    rx_arenas = std::make_shared<proto::arena_pool_t>(config.bep_config.rx_buff_size);
+    auto lan = utils::is_lan(peer_endpoint.address());
+    tx_bucket = utils::bandwidth_shaper_t::instance().make_bucket(direction_t::upload, lan, session_limit);
     log = utils::get_logger("net.peer_actor");
 }
 
@@ -57,10 +69,10 @@ void peer_actor_t::on_start() noexcept {
 
     fmt::memory_buffer buff;
     proto::make_hello_message(buff, device_name);
-    push_write(std::move(buff), true, false);
+    push_write(std::move(buff), tx_class_t::control, true, false);
 
-    read_more();
     read_action = &peer_actor_t::read_hello;
+    read_more();
     reset_rx_timer();
 }
 
@@ -85,39 +97,109 @@ void peer_actor_t::process_tx_queue() noexcept {
     if (finished) {
         return;
     }
-    assert(!tx_item);
-    if (!tx_queue.empty() && !finished) {
+    assert(tx_items.empty());
+    if (tx_queue.empty() || shaper_timer_request) {
+        return;
+    }
+
+    if (!tx_queue.front()->buff.size()) {
+        LOG_TRACE(log, "peer_actor_t::process_tx_queue, device_id = {}, final empty message, shutting down ",
+                  peer_device_id);
+        assert(tx_queue.front()->final);
+        tx_items.emplace_back(tx_queue.pop());
+        auto ec = r::make_error_code(r::shutdown_code_t::normal);
+        do_shutdown(make_error(ec));
+        finished = true;
+        return;
+    }
+
+    /* the upload rate limit; the final (close) message is not delayed */
+    if (!tx_queue.front()->final) {
+        auto delay = tx_bucket->get_delay();
+        if (delay.count()) {
+            LOG_TRACE(log, "{}, process_tx_queue, shaping delay {}us", identity, delay.count());
+            auto timeout = pt::microseconds(delay.count());
+            shaper_timer_request = start_timer(timeout, *this, &peer_actor_t::on_shaper_timeout);
+            resources->acquire(resource::shaper_timer);
+            return;
+        }
+    }
+
+    /* all queued frames (up to the limit) are written at once, in the order
+     * of the scheduler, i.e. control messages go ahead of block responses */
+    auto batch_sz = std::size_t{0};
+    while (!tx_queue.empty()) {
         auto &item = tx_queue.front();
-        tx_item = std::move(item);
-        tx_queue.pop_front();
-        transport::io_fn_t on_write = [&](auto arg) { this->on_write(arg); };
-        transport::error_fn_t on_error = [&](auto arg) { this->on_io_error(arg, resource::io_write); };
-        auto &tx_buff = tx_item->buff;
-
-        if (tx_buff.size()) {
-            resources->acquire(resource::io_write);
-            transport->async_send(asio::buffer(tx_buff.data(), tx_buff.size()), on_write, on_error);
-        } else {
-            LOG_TRACE(log, "peer_actor_t::process_tx_queue, device_id = {}, final empty message, shutting down ",
-                      peer_device_id);
-            assert(tx_item->final);
-            auto ec = r::make_error_code(r::shutdown_code_t::normal);
-            do_shutdown(make_error(ec));
-            finished = true;
+        auto sz = item->buff.size() + item->tail.size();
+        if (!item->buff.size() || (!tx_items.empty() && batch_sz + sz > constants::tx_batch_max_size)) {
+            break;
+        }
+        batch_sz += sz;
+        auto final = item->final;
+        tx_items.emplace_back(tx_queue.pop());
+        if (final) {
+            break;
         }
     }
+
+    /* small pieces are copied together, so they are encrypted into a single
+     * TLS record; large ones (i.e. block data) are sent as is */
+    auto for_pieces = [&](auto &&fn) {
+        for (auto &item : tx_items) {
+            fn(std::string_view(item->buff.data(), item->buff.size()));
+            fn(item->tail);
+        }
+    };
+    auto coalesced_sz = std::size_t{0};
+    for_pieces([&](std::string_view piece) {
+        if (piece.size() < constants::tx_coalesce_size) {
+            coalesced_sz += piece.size();
+        }
+    });
+    tx_coalesced.clear();
+    tx_coalesced.reserve(coalesced_sz);
+
+    auto buffs = transport::const_buffers_t();
+    for_pieces([&](std::string_view piece) {
+        if (piece.empty()) {
+            return;
+        }
+        auto ptr = piece.data();
+        if (piece.size() < constants::tx_coalesce_size) {
+            ptr = tx_coalesced.data() + tx_coalesced.size();
+            tx_coalesced.append(piece.data(), piece.data() + piece.size());
+        }
+        if (!buffs.empty()) {
+            auto &last = buffs.back();
+            if (reinterpret_cast<const char *>(last.data()) + last.size() == ptr) {
+                last = asio::const_buffer(last.data(), last.size() + piece.size());
+                return;
+            }
+        }
+        buffs.emplace_back(ptr, piece.size());
+    });
+
+    LOG_TRACE(log, "{}, process_tx_queue, {} frames, {} bytes, {} buffers", identity, tx_items.size(), batch_sz,
+              buffs.size());
+    tx_bucket->consume(batch_sz);
+    transport::io_fn_t on_write = [&](auto arg) { this->on_write(arg); };
+    transport::error_fn_t on_error = [&](auto arg) { this->on_io_error(arg, resource::io_write); };
+    resources->acquire(resource::io_write);
+    transport->async_send(buffs, on_write, on_error);
 }
 
-void peer_actor_t::push_write(fmt::memory_buffer &&buff, bool signal, bool final) noexcept {
+void peer_actor_t::push_write(fmt::memory_buffer &&buff, tx_class_t tx_class, bool signal, bool final,
+                              std::string_view tail, r::message_ptr_t tail_owner) noexcept {
     if (io_error) {
         return;
     }
-    if (signal && controller) {
-        send<payload::transfer_push_t>(controller, buff.size());
+    auto size = buff.size() + tail.size();
+    if (signal && controller && !secondary) {
+        send<payload::transfer_push_t>(controller, size);
     }
-    tx_item_t item = new confidential::payload::tx_item_t{std::move(buff), final};
-    tx_queue.emplace_back(std::move(item));
-    if (!tx_item) {
+    tx_item_t item = new confidential::payload::tx_item_t{std::move(buff), final, tail, std::move(tail_owner)};
+    tx_queue.push(static_cast<std::size_t>(tx_class), std::move(item), size);
+    if (tx_items.empty()) {
         process_tx_queue();
     }
     if (final) {
@@ -126,15 +208,43 @@ void peer_actor_t::push_write(fmt::memory_buffer &&buff, bool signal, bool final
 }
 
 void peer_actor_t::read_more() noexcept {
-    if (state > r::state_t::OPERATIONAL) {
+    if (state > r::state_t::OPERATIONAL || resources->has(resource::io_read)) {
         return;
     }
-    if (rx_idx >= rx_buff.size()) {
-        LOG_WARN(log, "{}, read_more, rx buffer limit reached, {}", identity, rx_buff.size());
+
+    /* the buffer grows up to the size of the frame being received; parsed
+     * frames are not moved, only the incomplete tail is moved to the buffer
+     * start, and only when the free space at the end is scarce */
+    auto ptr = rx_buff.data();
+    auto pending = rx_idx - rx_start;
+    auto frame_sz = proto::get_frame_size(asio::buffer(ptr + rx_start, pending));
+    if (frame_sz > constants::bep_max_frame_size) {
+        LOG_WARN(log, "{}, read_more, frame size {} exceeds the limit", identity, frame_sz);
         auto ec = utils::make_error_code(utils::error_code_t::rx_limit_reached);
         return do_shutdown(make_error(ec));
     }
 
+    std::size_t default_sz = bep_config.rx_buff_size;
+    auto capacity = std::max({frame_sz, default_sz, pending + 1});
+    if (!pending && rx_buff.size() > default_sz) {
+        LOG_TRACE(log, "{}, read_more, shrinking rx buffer {} -> {}", identity, rx_buff.size(), default_sz);
+        auto buff = fmt::memory_buffer();
+        buff.resize(default_sz);
+        rx_buff = std::move(buff);
+        rx_start = rx_idx = 0;
+    } else if (rx_start) {
+        auto free_sz = rx_buff.size() - rx_idx;
+        if (!pending || rx_start + capacity > rx_buff.size() || free_sz < rx_buff.size() / 2) {
+            std::memmove(ptr, ptr + rx_start, pending);
+            rx_start = 0;
+            rx_idx = pending;
+        }
+    }
+    if (rx_start + capacity > rx_buff.size()) {
+        LOG_TRACE(log, "{}, read_more, growing rx buffer {} -> {}", identity, rx_buff.size(), capacity);
+        rx_buff.resize(capacity);
+    }
+
     transport::io_fn_t on_read = [&](auto arg) { this->on_read(arg); };
     transport::error_fn_t on_error = [&](auto arg) { this->on_io_error(arg, resource::io_read); };
     resources->acquire(resource::io_read);
@@ -146,49 +256,71 @@ void peer_actor_t::read_more() noexcept {
 void peer_actor_t::on_write(std::size_t sz) noexcept {
     resources->release(resource::io_write);
     LOG_TRACE(log, "{}, on_write, {} bytes", identity, sz);
-    if (controller) {
+    if (controller && !secondary) {
         send<payload::transfer_pop_t>(controller, (uint32_t)sz);
     }
-    assert(tx_item);
-    if (tx_item->final) {
+    assert(!tx_items.empty());
+    if (tx_items.back()->final) {
         LOG_TRACE(log, "{}, process_tx_queue, final message has been sent, shutting down", identity);
         if (resources->has(resource::finalization)) {
             resources->release(resource::finalization);
         }
         cancel_io();
     } else {
-        tx_item.reset();
+        tx_items.clear();
         process_tx_queue();
     }
 }
 
 void peer_actor_t::on_read(std::size_t bytes) noexcept {
-    assert(read_action);
     resources->release(resource::io_read);
     rx_idx += bytes;
-    LOG_TRACE(log, "{}, on_read, {} bytes, total = {}", identity, bytes, rx_idx);
-    auto buff = asio::buffer(rx_buff.data(), rx_idx);
-    auto result = proto::parse_bep(buff);
-    if (result.has_error()) {
-        auto &ec = result.error();
-        LOG_WARN(log, "{}, on_read, error parsing message: {}", identity, ec.message());
-        return do_shutdown(make_error(ec));
+    LOG_TRACE(log, "{}, on_read, {} bytes, total = {}", identity, bytes, rx_idx - rx_start);
+    process_rx();
+}
+
+void peer_actor_t::process_rx() noexcept {
+    /* all complete frames are handled at once, until a read action pauses
+     * reading (i.e. resets itself) */
+    while (read_action && state <= r::state_t::OPERATIONAL) {
+        auto buff = asio::buffer(rx_buff.data() + rx_start, rx_idx - rx_start);
+        if (read_action == &peer_actor_t::read_controlled && proto::is_plain_response(buff)) {
+            /* block data is the bulk of traffic, it is taken without protobuf */
+            auto result = proto::parse_response(buff);
+            if (result.has_error()) {
+                auto &ec = result.error();
+                LOG_WARN(log, "{}, on_read, error parsing response: {}", identity, ec.message());
+                return do_shutdown(make_error(ec));
+            }
+            auto &value = result.value();
+            if (!value.consumed) {
+                break;
+            }
+            cancel_timer();
+            rx_start += value.consumed;
+            handle_response(value.response);
+            continue;
+        }
+        auto result = proto::parse_bep(buff, rx_arenas.get());
+        if (result.has_error()) {
+            auto &ec = result.error();
+            LOG_WARN(log, "{}, on_read, error parsing message: {}", identity, ec.message());
+            return do_shutdown(make_error(ec));
+        }
+        auto &value = result.value();
+        if (!value.consumed) {
+            break;
+        }
+
+        cancel_timer();
+        assert(rx_start + value.consumed <= rx_idx);
+        rx_start += value.consumed;
+        (this->*read_action)(std::move(value.message));
     }
-    auto &value = result.value();
-    if (!value.consumed) {
-        // log->trace("{}, on_read :: incomplete message", identity);
-        return read_more();
+    LOG_TRACE(log, "{}, on_read, pending = {} ", identity, rx_idx - rx_start);
+    if (read_action) {
+        read_more();
     }
-
-    cancel_timer();
-    assert(value.consumed <= rx_idx);
-    rx_idx -= value.consumed;
-    if (rx_idx) {
-        auto ptr = rx_buff.data();
-        std::memcpy(ptr, ptr + value.consumed, rx_idx);
-    }
-    (this->*read_action)(std::move(value.message));
-    LOG_TRACE(log, "{}, on_read, rx_idx = {} ", identity, rx_idx);
 }
 
 void peer_actor_t::on_timer(r::request_id_t, bool cancelled) noexcept {
@@ -212,7 +344,16 @@ void peer_actor_t::shutdown_start() noexcept {
     if (rx_timer_request) {
         r::actor_base_t::cancel_timer(*rx_timer_request);
     }
-    if (controller) {
+    if (shaper_timer_request) {
+        r::actor_base_t::cancel_timer(*shaper_timer_request);
+    }
+    /* loss of an extra connection does not take the peer down; the
+     * controller stops using it as soon as possible */
+    if (secondary) {
+        auto diff = model::diff::cluster_diff_ptr_t();
+        diff = new model::diff::peer::peer_connection_t(*devices_view, peer_device_id.get_sha256(), address, false);
+        send<model::payload::model_update_t>(coordinator, std::move(diff));
+    } else if (controller) {
         send<payload::termination_t>(controller, shutdown_reason);
     }
 
@@ -221,7 +362,7 @@ void peer_actor_t::shutdown_start() noexcept {
     close.set_reason(shutdown_reason->message());
     proto::serialize(buff, close);
     tx_queue.clear();
-    push_write(std::move(buff), true, true);
+    push_write(std::move(buff), tx_class_t::control, true, true);
     LOG_TRACE(log, "{}, going to send close message", identity);
 
     r::actor_base_t::shutdown_start();
@@ -234,17 +375,19 @@ void peer_actor_t::shutdown_finish() noexcept {
         reply_with_error(*it, make_error(ec));
     }
     block_requests.clear();
-    if (controller) {
+    if (controller && !secondary) {
         send<payload::termination_t>(controller, shutdown_reason);
     }
     r::actor_base_t::shutdown_finish();
+    if (secondary) {
+        return;
+    }
     auto sha256 = peer_device_id.get_sha256();
-    auto device = cluster->get_devices().by_sha256(sha256);
-    auto state = device->get_state();
-    if (state != model::device_state_t::offline) {
+    auto device = devices_view->get(sha256);
+    if (device && device->state != model::device_state_t::offline) {
         auto diff = model::diff::cluster_diff_ptr_t();
         auto state = model::device_state_t::offline;
-        diff = new model::diff::peer::peer_state_t(*cluster, sha256, address, state);
+        diff = new model::diff::peer::peer_state_t(*devices_view, sha256, address, state);
         send<model::payload::model_update_t>(coordinator, std::move(diff));
     }
 }
@@ -275,7 +418,7 @@ void peer_actor_t::on_start_reading(message::start_reading_t &message) noexcept
     controller = message.payload.controller;
     if (start) {
         read_action = &peer_actor_t::read_controlled;
-        read_more();
+        process_rx();
     }
 }
 
@@ -289,30 +432,26 @@ void peer_actor_t::on_termination(message::termination_signal_t &message) noexce
 }
 
 void peer_actor_t::on_block_request(message::block_request_t &message) noexcept {
-    auto req_id = (std::int32_t)message.payload.id;
-    proto::Request req;
     auto &p = message.payload.request_payload;
-    auto &file = p.file;
-    auto &file_block = p.block;
-    auto &block = *file_block.block();
-    req.set_id(req_id);
-    *req.mutable_folder() = file->get_folder_info()->get_folder()->get_id();
-    *req.mutable_name() = file->get_name();
-
-    req.set_offset(file_block.get_offset());
-    req.set_size(block.get_size());
-    *req.mutable_hash() = block.get_hash();
+    auto req = proto::request_view_t{};
+    req.id = (std::int32_t)message.payload.id;
+    req.folder = p.folder_id;
+    req.name = p.file_name;
+    req.offset = p.offset;
+    req.size = (std::int32_t)p.size;
+    req.hash = p.hash;
 
     fmt::memory_buffer buff;
-    proto::serialize(buff, req);
-    push_write(std::move(buff), true, false);
+    proto::serialize_request(buff, req);
+    push_write(std::move(buff), tx_class_t::request, true, false);
     block_requests.emplace_back(&message);
 }
 
 void peer_actor_t::on_transfer(message::transfer_data_t &message) noexcept {
     LOG_TRACE(log, "{}, on_transfer", identity);
 
-    push_write(std::move(message.payload.data), false, false);
+    auto &p = message.payload;
+    push_write(std::move(p.data), p.tx_class, false, false, p.tail, std::move(p.tail_owner));
 }
 
 void peer_actor_t::read_hello(proto::message::message_t &&msg) noexcept {
@@ -324,15 +463,24 @@ void peer_actor_t::read_hello(proto::message::message_t &&msg) noexcept {
             if constexpr (std::is_same_v<T, proto::message::Hello>) {
                 LOG_TRACE(log, "{}, read_hello, from {} ({} {})", identity, msg->device_name(), msg->client_name(),
                           msg->client_version());
-                auto peer = cluster->get_devices().by_sha256(peer_device_id.get_sha256());
-                if (peer && peer->get_state() == model::device_state_t::online) {
-                    auto ec = utils::make_error_code(utils::error_code_t::already_connected);
-                    return do_shutdown(make_error(ec));
-                }
+                auto sha256 = peer_device_id.get_sha256();
+                auto peer = devices_view->get(sha256);
                 auto diff = cluster_diff_ptr_t();
-                auto state = model::device_state_t::online;
-                diff = new peer::peer_state_t(*cluster, peer_device_id.get_sha256(), get_address(), state, cert_name,
-                                              peer_endpoint, msg->client_name());
+                if (peer && peer->state == model::device_state_t::online) {
+                    /* the online peer might have a group of connections */
+                    auto connections = peer->extra_connections + 1;
+                    if (connections >= bep_config.peer_connections) {
+                        auto ec = utils::make_error_code(utils::error_code_t::already_connected);
+                        return do_shutdown(make_error(ec));
+                    }
+                    LOG_DEBUG(log, "{}, read_hello, extra connection #{} of the peer", identity, connections + 1);
+                    secondary = true;
+                    diff = new peer::peer_connection_t(*devices_view, sha256, get_address(), true);
+                } else {
+                    auto state = model::device_state_t::online;
+                    diff = new peer::peer_state_t(*devices_view, sha256, get_address(), state, cert_name,
+                                                  peer_endpoint, msg->client_name(), session_limit);
+                }
                 send<model::payload::model_update_t>(coordinator, std::move(diff));
             } else {
                 LOG_WARN(log, "{}, read_hello, unexpected_message", identity);
@@ -341,11 +489,12 @@ void peer_actor_t::read_hello(proto::message::message_t &&msg) noexcept {
             }
         },
         msg);
+    /* the rest is read, when the controller is ready */
+    read_action = nullptr;
 }
 
 void peer_actor_t::read_controlled(proto::message::message_t &&msg) noexcept {
     LOG_TRACE(log, "{}, read_controlled", identity);
-    bool continue_reading = true;
     std::visit(
         [&](auto &&msg) {
             using T = std::decay_t<decltype(msg)>;
@@ -361,20 +510,28 @@ void peer_actor_t::read_controlled(proto::message::message_t &&msg) noexcept {
                 handle_ping(std::move(msg));
             } else if constexpr (std::is_same_v<T, m::Close>) {
                 handle_close(std::move(msg));
-                continue_reading = false;
+                read_action = nullptr;
             } else if constexpr (std::is_same_v<T, m::Response>) {
-                handle_response(std::move(msg));
+                auto response = proto::response_view_t{msg->id(), msg->data(), msg->code()};
+                handle_response(response);
             } else {
+                if constexpr (std::is_same_v<T, m::Request>) {
+                    if (secondary) {
+                        send<payload::forwarded_request_t>(controller, std::move(msg), get_address());
+                        return reset_rx_timer();
+                    }
+                } else if constexpr (std::is_same_v<T, m::ClusterConfig>) {
+                    /* it has been already received via the primary connection */
+                    if (secondary) {
+                        return reset_rx_timer();
+                    }
+                }
                 auto fwd = payload::forwarded_message_t{std::move(msg)};
                 send<payload::forwarded_message_t>(controller, std::move(fwd));
                 reset_rx_timer();
             }
         },
         msg);
-    if (continue_reading) {
-        read_action = &peer_actor_t::read_controlled;
-        read_more();
-    }
 }
 
 void peer_actor_t::handle_ping(proto::message::Ping &&) noexcept { log->trace("{}, handle_ping", identity); }
@@ -390,8 +547,8 @@ void peer_actor_t::handle_close(proto::message::Close &&message) noexcept {
     do_shutdown(ee);
 }
 
-void peer_actor_t::handle_response(proto::message::Response &&message) noexcept {
-    auto id = message->id();
+void peer_actor_t::handle_response(const proto::response_view_t &response) noexcept {
+    auto id = response.id;
     LOG_TRACE(log, "{}, handle_response, message id = {}", identity, id);
     auto predicate = [id = id](const block_request_ptr_t &it) { return ((std::int32_t)it->payload.id) == id; };
     auto it = std::find_if(block_requests.begin(), block_requests.end(), predicate);
@@ -401,9 +558,10 @@ void peer_actor_t::handle_response(proto::message::Response &&message) noexcept
             auto ec = utils::make_error_code(utils::bep_error_code_t::response_mismatch);
             do_shutdown(make_error(ec));
         }
+        return;
     }
 
-    auto error = message->code();
+    auto error = response.code;
     auto &block_request = *it;
     if (!shutdown_reason) {
         if (error) {
@@ -411,14 +569,14 @@ void peer_actor_t::handle_response(proto::message::Response &&message) noexcept
             LOG_WARN(log, "{}, block request error: {}", identity, ec.message());
             reply_with_error(*block_request, make_error(ec));
         } else {
-            auto &data = message->data();
-            auto request_sz = block_request->payload.request_payload.block.block()->get_size();
+            auto &data = response.data;
+            auto request_sz = block_request->payload.request_payload.size;
             if (data.size() != request_sz) {
                 LOG_WARN(log, "{}, got {} bytes, but requested {}", identity, data.size(), request_sz);
                 auto ec = utils::make_error_code(utils::bep_error_code_t::response_missize);
                 return do_shutdown(make_error(ec));
             }
-            reply_to(*block_request, std::move(data));
+            reply_to(*block_request, std::string(data));
         }
     }
     block_requests.erase(it);
@@ -442,11 +600,20 @@ void peer_actor_t::on_tx_timeout(r::request_id_t, bool cancelled) noexcept {
         fmt::memory_buffer buff;
         proto::Ping ping;
         proto::serialize(buff, ping);
-        push_write(std::move(buff), true, false);
+        push_write(std::move(buff), tx_class_t::control, true, false);
         reset_tx_timer();
     }
 }
 
+void peer_actor_t::on_shaper_timeout(r::request_id_t, bool) noexcept {
+    resources->release(resource::shaper_timer);
+    shaper_timer_request.reset();
+    /* even if cancelled, the close message is still to be sent */
+    if (tx_items.empty()) {
+        process_tx_queue();
+    }
+}
+
 void peer_actor_t::reset_rx_timer() noexcept {
     if (state == r::state_t::OPERATIONAL) {
         if (rx_timer_request) {
@@ -4,9 +4,12 @@
 #pragma once
 
 #include "config/bep.h"
+#include "model/misc/devices_view.h"
 #include "transport/stream.h"
 #include "proto/bep_support.h"
+#include "utils/bandwidth_shaper.h"
 #include "utils/log.h"
+#include "utils/tx_scheduler.hpp"
 #include "messages.h"
 #include <boost/asio.hpp>
 #include <rotor/asio/supervisor_asio.h>
@@ -23,9 +26,11 @@ struct peer_actor_config_t : public r::actor_config_t {
     config::bep_config_t bep_config;
     transport::stream_sp_t transport;
     r::address_ptr_t coordinator;
-    model::cluster_ptr_t cluster;
+    model::devices_view_ptr_t devices_view;
     tcp::endpoint peer_endpoint;
     std::string peer_proto;
+    /* of the relay, bytes per second, 0 means no limit */
+    std::uint64_t session_limit = 0;
 };
 
 template <typename Actor> struct peer_actor_config_builder_t : r::actor_config_builder_t<Actor> {
@@ -53,8 +58,8 @@ template <typename Actor> struct peer_actor_config_builder_t : r::actor_config_b
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 
-    builder_t &&cluster(const model::cluster_ptr_t &value) && noexcept {
-        parent_t::config.cluster = value;
+    builder_t &&devices_view(const model::devices_view_ptr_t &value) && noexcept {
+        parent_t::config.devices_view = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 
@@ -72,6 +77,11 @@ template <typename Actor> struct peer_actor_config_builder_t : r::actor_config_b
         parent_t::config.peer_proto = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
+
+    builder_t &&session_limit(std::uint64_t value) && noexcept {
+        parent_t::config.session_limit = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
 };
 
 struct SYNCSPIRIT_API peer_actor_t : public r::actor_base_t {
@@ -90,8 +100,12 @@ struct SYNCSPIRIT_API peer_actor_t : public r::actor_base_t {
             struct tx_item_t : boost::intrusive_ref_counter<tx_item_t, boost::thread_unsafe_counter> {
                 fmt::memory_buffer buff;
                 bool final = false;
+                std::string_view tail;
+                r::message_ptr_t tail_owner;
 
-                tx_item_t(fmt::memory_buffer &&buff_, bool final_) noexcept : buff{std::move(buff_)}, final{final_} {}
+                tx_item_t(fmt::memory_buffer &&buff_, bool final_, std::string_view tail_ = {},
+                          r::message_ptr_t tail_owner_ = {}) noexcept
+                    : buff{std::move(buff_)}, final{final_}, tail{tail_}, tail_owner{std::move(tail_owner_)} {}
                 tx_item_t(tx_item_t &&other) = default;
             };
         };
@@ -103,7 +117,8 @@ struct SYNCSPIRIT_API peer_actor_t : public r::actor_base_t {
 
     using tx_item_t = model::intrusive_ptr_t<confidential::payload::tx_item_t>;
     using tx_message_t = confidential::message::tx_item_t;
-    using tx_queue_t = std::list<tx_item_t>;
+    using tx_queue_t = utils::tx_scheduler_t<tx_item_t, tx_classes_count>;
+    using tx_items_t = std::vector<tx_item_t>;
     using read_action_t = void (peer_actor_t::*)(proto::message::message_t &&msg);
     using block_request_ptr_t = r::intrusive_ptr_t<message::block_request_t>;
     using block_requests_t = std::list<block_request_ptr_t>;
@@ -118,12 +133,15 @@ struct SYNCSPIRIT_API peer_actor_t : public r::actor_base_t {
     void on_read(std::size_t bytes) noexcept;
     void on_timer(r::request_id_t, bool cancelled) noexcept;
     void read_more() noexcept;
-    void push_write(fmt::memory_buffer &&buff, bool signal, bool final) noexcept;
+    void process_rx() noexcept;
+    void push_write(fmt::memory_buffer &&buff, tx_class_t tx_class, bool signal, bool final,
+                    std::string_view tail = {}, r::message_ptr_t tail_owner = {}) noexcept;
     void process_tx_queue() noexcept;
     void cancel_timer() noexcept;
     void cancel_io() noexcept;
     void on_tx_timeout(r::request_id_t, bool cancelled) noexcept;
     void on_rx_timeout(r::request_id_t, bool cancelled) noexcept;
+    void on_shaper_timeout(r::request_id_t, bool cancelled) noexcept;
 
     void reset_tx_timer() noexcept;
     void reset_rx_timer() noexcept;
@@ -132,9 +150,9 @@ struct SYNCSPIRIT_API peer_actor_t : public r::actor_base_t {
 
     void handle_ping(proto::message::Ping &&) noexcept;
     void handle_close(proto::message::Close &&) noexcept;
-    void handle_response(proto::message::Response &&) noexcept;
+    void handle_response(const proto::response_view_t &) noexcept;
 
-    model::cluster_ptr_t cluster;
+    model::devices_view_ptr_t devices_view;
     utils::logger_t log;
     std::string_view device_name;
     config::bep_config_t bep_config;
@@ -144,16 +162,24 @@ struct SYNCSPIRIT_API peer_actor_t : public r::actor_base_t {
     std::optional<r::request_id_t> timer_request;
     std::optional<r::request_id_t> tx_timer_request;
     std::optional<r::request_id_t> rx_timer_request;
+    std::optional<r::request_id_t> shaper_timer_request;
+    utils::bandwidth_shaper_t::bucket_ptr_t tx_bucket;
     tx_queue_t tx_queue;
-    tx_item_t tx_item;
+    tx_items_t tx_items;
+    fmt::memory_buffer tx_coalesced;
     fmt::memory_buffer rx_buff;
+    std::size_t rx_start = 0;
     std::size_t rx_idx = 0;
+    proto::arena_pool_ptr_t rx_arenas;
     bool finished = false;
     bool io_error = false;
+    /* extra connection of the peer, which is online via other connection */
+    bool secondary = false;
     std::string cert_name;
     tcp::endpoint peer_endpoint;
     std::string peer_proto;
-    read_action_t read_action;
+    std::uint64_t session_limit;
+    read_action_t read_action = nullptr;
     r::address_ptr_t controller;
     block_requests_t block_requests;
 };
@@ -8,6 +8,7 @@
 #include "../constants.h"
 #include "utils/error_code.h"
 #include "utils/format.hpp"
+#include "model/diff/peer/peer_connection.h"
 #include "model/diff/peer/peer_state.h"
 #include "model/diff/modify/connect_request.h"
 #include "model/diff/modify/relay_connect_request.h"
@@ -19,19 +20,22 @@ using namespace syncspirit::net;
 template <class> inline constexpr bool always_false_v = false;
 
 peer_supervisor_t::peer_supervisor_t(peer_supervisor_config_t &cfg)
-    : parent_t{cfg}, cluster{cfg.cluster}, device_name{cfg.device_name}, ssl_pair{*cfg.ssl_pair},
-      bep_config(cfg.bep_config), relay_config{cfg.relay_config} {
+    : parent_t{cfg}, devices_view{cfg.devices_view}, device_name{cfg.device_name}, ssl_pair{*cfg.ssl_pair},
+      bep_config(cfg.bep_config), relay_config{cfg.relay_config}, index{cfg.index}, net_threads{cfg.net_threads} {
     log = utils::get_logger("net.peer_supervisor");
 }
 
 void peer_supervisor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
     r::actor_base_t::configure(plugin);
     plugin.with_casted<r::plugin::address_maker_plugin_t>([&](auto &p) {
-        p.set_identity("peer_supervisor", false);
+        auto name = index ? fmt::format("peer_supervisor-{}", index) : std::string("peer_supervisor");
+        p.set_identity(name, false);
         addr_unknown = p.create_address();
     });
     plugin.with_casted<r::plugin::registry_plugin_t>([&](auto &p) {
-        p.register_name(names::peer_supervisor, get_address());
+        if (!index) {
+            p.register_name(names::peer_supervisor, get_address());
+        }
         p.discover_name(names::coordinator, coordinator, true).link(false).callback([&](auto phase, auto &ee) {
             if (!ee && phase == r::plugin::registry_plugin_t::phase_t::linking) {
                 auto p = get_plugin(r::plugin::starter_plugin_t::class_identity);
@@ -46,6 +50,14 @@ void peer_supervisor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
     });
 }
 
+bool peer_supervisor_t::is_mine(std::string_view key) const noexcept {
+    if (!net_threads) {
+        return true;
+    }
+    auto shard = std::hash<std::string_view>()(key) % net_threads;
+    return index == shard + 1;
+}
+
 void peer_supervisor_t::on_child_shutdown(actor_base_t *actor) noexcept {
     using namespace model::diff;
     auto &reason = actor->get_shutdown_reason();
@@ -83,12 +95,13 @@ void peer_supervisor_t::on_peer_ready(message::peer_connected_t &msg) noexcept {
     auto timeout = r::pt::milliseconds{bep_config.connect_timeout};
     auto &p = msg.payload;
     auto &d = p.peer_device_id;
-    auto peer = cluster->get_devices().by_sha256(d.get_sha256());
+    auto peer = devices_view->get(d.get_sha256());
     if (!peer) {
         LOG_INFO(log, "{} unknown peer '{}' for the cluster", identity, d.get_value());
         return;
     }
-    if (peer->get_state() == model::device_state_t::online) {
+    auto connections = peer->extra_connections + 1;
+    if (peer->state == model::device_state_t::online && connections >= bep_config.peer_connections) {
         LOG_DEBUG(log, "{}, peer '{}' is already online, ignoring request", identity, d.get_short());
         return;
     }
@@ -100,8 +113,9 @@ void peer_supervisor_t::on_peer_ready(message::peer_connected_t &msg) noexcept {
         .coordinator(coordinator)
         .peer_endpoint(p.remote_endpoint)
         .peer_proto(p.proto)
+        .session_limit(p.session_limit)
         .timeout(timeout)
-        .cluster(cluster)
+        .devices_view(devices_view)
         .finish();
 }
 
@@ -131,24 +145,88 @@ void peer_supervisor_t::on_connect(message::connect_request_t &msg) noexcept {
 auto peer_supervisor_t::operator()(const model::diff::peer::peer_state_t &diff, void *) noexcept
     -> outcome::result<void> {
     auto &peer_addr = diff.peer_addr;
+    if (!peer_addr || &peer_addr->supervisor != this) {
+        return outcome::success();
+    }
     if (!diff.known && diff.state == model::device_state_t::online) {
         auto ec = model::make_error_code(model::error_code_t::unknown_device);
         auto ee = make_error(ec);
         send<r::payload::shutdown_trigger_t>(address, peer_addr, ee);
+    } else if (diff.state == model::device_state_t::online && bep_config.peer_connections > 1) {
+        auto peer = devices_view->get(diff.peer_id);
+        if (peer) {
+            connect_extra(*peer);
+        }
+    }
+    return outcome::success();
+}
+
+auto peer_supervisor_t::operator()(const model::diff::peer::peer_connection_t &diff, void *) noexcept
+    -> outcome::result<void> {
+    auto &peer_addr = diff.peer_addr;
+    if (!peer_addr || &peer_addr->supervisor != this || !diff.connected) {
+        return outcome::success();
+    }
+    auto peer = devices_view->get(diff.peer_id);
+    if (!peer || peer->state != model::device_state_t::online) {
+        LOG_DEBUG(log, "{}, the peer went offline, dropping extra connection", identity);
+        auto ec = r::make_error_code(r::shutdown_code_t::normal);
+        send<r::payload::shutdown_trigger_t>(address, peer_addr, make_error(ec));
     }
     return outcome::success();
 }
 
+/* to avoid the counter dialing, the extra connections are initiated by the
+ * device with the lesser id only; they are direct (tcp) only */
+void peer_supervisor_t::connect_extra(const model::devices_view_t::device_t &peer) noexcept {
+    auto self = devices_view->get_self();
+    if (self.get_sha256() >= peer.device_id.get_sha256()) {
+        return;
+    }
+    auto uris = model::device_t::uris_t{};
+    for (auto &uri : peer.uris) {
+        if (uri.proto == "tcp") {
+            uris.emplace_back(uri);
+        }
+    }
+    if (uris.empty()) {
+        return;
+    }
+
+    auto connect_timeout = r::pt::milliseconds{bep_config.connect_timeout};
+    auto count = bep_config.peer_connections - 1;
+    LOG_DEBUG(log, "{}, initiating {} extra connection(s) with {}", identity, count, peer.device_id);
+    for (std::uint32_t i = 0; i < count; ++i) {
+        /* no devices view, as the peer state is not affected by the extra connections */
+        create_actor<initiator_actor_t>()
+            .router(*locality_leader)
+            .sink(address)
+            .ssl_pair(&ssl_pair)
+            .peer_device_id(peer.device_id)
+            .uris(uris)
+            .init_timeout(connect_timeout * (uris.size() + 1))
+            .shutdown_timeout(connect_timeout)
+            .finish();
+    }
+}
+
 auto peer_supervisor_t::operator()(const model::diff::modify::connect_request_t &diff, void *) noexcept
     -> outcome::result<void> {
+    auto remote = fmt::format("{}", diff.remote);
+    if (!is_mine(remote)) {
+        return outcome::success();
+    }
 
     auto lock = std::unique_lock(diff.mutex);
+    if (!diff.sock) {
+        return outcome::success();
+    }
     auto sock = std::move(*diff.sock);
     diff.sock.reset();
 
     auto timeout = r::pt::milliseconds{bep_config.connect_timeout};
     create_actor<initiator_actor_t>()
-        .cluster(cluster)
+        .devices_view(devices_view)
         .router(*locality_leader)
         .sink(address)
         .ssl_pair(&ssl_pair)
@@ -161,38 +239,41 @@ auto peer_supervisor_t::operator()(const model::diff::modify::connect_request_t
 
 auto peer_supervisor_t::operator()(const model::diff::modify::relay_connect_request_t &diff, void *) noexcept
     -> outcome::result<void> {
+    if (!is_mine(diff.peer.get_sha256())) {
+        return outcome::success();
+    }
 
-    auto peer = cluster->get_devices().by_sha256(diff.peer.get_sha256());
-    if (peer->get_state() == model::device_state_t::offline) {
-        LOG_DEBUG(log, "{} initiating relay connection with {}", identity, peer->device_id());
+    auto peer = devices_view->get(diff.peer.get_sha256());
+    if (peer && peer->state == model::device_state_t::offline) {
+        LOG_DEBUG(log, "{} initiating relay connection with {}", identity, diff.peer);
         auto timeout = r::pt::milliseconds{bep_config.connect_timeout};
         auto uri_str = fmt::format("tcp://{}", diff.relay);
         auto uri = utils::parse(uri_str);
         create_actor<initiator_actor_t>()
-            .cluster(cluster)
+            .devices_view(devices_view)
             .router(*locality_leader)
             .sink(address)
             .ssl_pair(&ssl_pair)
             .peer_device_id(diff.peer)
             .uris({std::move(uri.value())})
             .relay_session(diff.session_key)
+            .session_limit(diff.session_limit)
             .timeout(timeout)
             .finish();
     } else {
-        LOG_DEBUG(log, "{}, peer '{}' is not offline, dropping relay connection request", identity, peer->device_id());
+        LOG_DEBUG(log, "{}, peer '{}' is not offline, dropping relay connection request", identity, diff.peer);
     }
     return outcome::success();
 }
 
 auto peer_supervisor_t::operator()(const model::diff::modify::update_contact_t &diff, void *) noexcept
     -> outcome::result<void> {
-    if (!diff.self && diff.known) {
-        auto &devices = cluster->get_devices();
-        auto peer = devices.by_sha256(diff.device.get_sha256());
-        if (peer->get_state() == model::device_state_t::offline) {
+    if (!diff.self && diff.known && is_mine(diff.device.get_sha256())) {
+        auto peer = devices_view->get(diff.device.get_sha256());
+        if (peer && peer->state == model::device_state_t::offline) {
             auto &uris = diff.uris;
             auto connect_timeout = r::pt::milliseconds{bep_config.connect_timeout};
-            LOG_DEBUG(log, "{} initiating connection with {}", identity, peer->device_id());
+            LOG_DEBUG(log, "{} initiating connection with {}", identity, diff.device);
             create_actor<initiator_actor_t>()
                 .router(*locality_leader)
                 .sink(address)
@@ -200,12 +281,12 @@ auto peer_supervisor_t::operator()(const model::diff::modify::update_contact_t &
                 .peer_device_id(diff.device)
                 .uris(uris)
                 .relay_enabled(relay_config.enabled)
-                .cluster(cluster)
+                .devices_view(devices_view)
                 .init_timeout(connect_timeout * (uris.size() + 1))
                 .shutdown_timeout(connect_timeout)
                 .finish();
         } else {
-            LOG_DEBUG(log, "{}, peer '{}' is not offline, dropping connection", identity, peer->device_id());
+            LOG_DEBUG(log, "{}, peer '{}' is not offline, dropping connection", identity, diff.device);
         }
     }
     return outcome::success();
@@ -9,6 +9,7 @@
 #include "model/messages.h"
 #include "model/diff/cluster_visitor.h"
 #include "model/diff/contact_visitor.h"
+#include "model/misc/devices_view.h"
 #include "utils/log.h"
 #include <boost/asio.hpp>
 #include <rotor/asio.hpp>
@@ -32,7 +33,9 @@ struct peer_supervisor_config_t : ra::supervisor_config_asio_t {
     const utils::key_pair_t *ssl_pair;
     config::bep_config_t bep_config;
     config::relay_config_t relay_config;
-    model::cluster_ptr_t cluster;
+    model::devices_view_ptr_t devices_view;
+    std::uint32_t index = 0;
+    std::uint32_t net_threads = 0;
 };
 
 template <typename Supervisor>
@@ -61,12 +64,33 @@ struct peer_supervisor_config_builder_t : ra::supervisor_config_asio_builder_t<S
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 
-    builder_t &&cluster(const model::cluster_ptr_t &value) && noexcept {
-        parent_t::config.cluster = value;
+    builder_t &&devices_view(const model::devices_view_ptr_t &value) && noexcept {
+        parent_t::config.devices_view = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
+
+    builder_t &&index(std::uint32_t value) && noexcept {
+        parent_t::config.index = value;
+        return std::move(*static_cast<typename parent_t::builder_t *>(this));
+    }
+
+    builder_t &&net_threads(std::uint32_t value) && noexcept {
+        parent_t::config.net_threads = value;
         return std::move(*static_cast<typename parent_t::builder_t *>(this));
     }
 };
 
+/* Peers might be served by several peer supervisors, each one on its own
+ * thread (io_context). Peers need devices only, so instead of the cluster
+ * all supervisors read the devices view, which is shared with and updated
+ * by the coordinator.
+ *
+ * The supervisor with zero index lives on the coordinator thread and serves
+ * connect requests (relay, http); when there are no net threads it also
+ * serves all peers. Otherwise peers are spread over the net thread supervisors
+ * (index 1..N) by device id; incoming connections, where device id is not
+ * known yet, are spread by remote endpoint.
+ */
 struct SYNCSPIRIT_API peer_supervisor_t : public ra::supervisor_asio_t,
                                           private model::diff::cluster_visitor_t,
                                           private model::diff::contact_visitor_t {
@@ -85,13 +109,16 @@ struct SYNCSPIRIT_API peer_supervisor_t : public ra::supervisor_asio_t,
     void on_contact_update(model::message::contact_update_t &) noexcept;
     void on_peer_ready(message::peer_connected_t &) noexcept;
     void on_connected(message::peer_connected_t &) noexcept;
+    bool is_mine(std::string_view key) const noexcept;
+    void connect_extra(const model::devices_view_t::device_t &peer) noexcept;
 
     outcome::result<void> operator()(const model::diff::peer::peer_state_t &, void *) noexcept override;
+    outcome::result<void> operator()(const model::diff::peer::peer_connection_t &, void *) noexcept override;
     outcome::result<void> operator()(const model::diff::modify::update_contact_t &, void *) noexcept override;
     outcome::result<void> operator()(const model::diff::modify::connect_request_t &, void *) noexcept override;
     outcome::result<void> operator()(const model::diff::modify::relay_connect_request_t &, void *) noexcept override;
 
-    model::cluster_ptr_t cluster;
+    model::devices_view_ptr_t devices_view;
     utils::logger_t log;
     r::address_ptr_t coordinator;
     r::address_ptr_t addr_unknown;
@@ -99,6 +126,8 @@ struct SYNCSPIRIT_API peer_supervisor_t : public ra::supervisor_asio_t,
     const utils::key_pair_t &ssl_pair;
     config::bep_config_t bep_config;
     config::relay_config_t relay_config;
+    std::uint32_t index;
+    std::uint32_t net_threads;
 };
 
 } // namespace net
@@ -384,8 +384,9 @@ bool relay_actor_t::on(proto::relay::session_invitation_t &msg) noexcept {
         relay_ep = asio::ip::tcp::endpoint{master_endpoint.address(), (uint16_t)msg.port};
     }
 
+    auto session_limit = relays[relay_index]->session_limit;
     diff = new model::diff::modify::relay_connect_request_t(std::move(device_opt.value()), std::move(msg.key),
-                                                            std::move(relay_ep));
+                                                            std::move(relay_ep), session_limit);
     send<model::payload::contact_update_t>(coordinator, std::move(diff), this);
     return true;
 }
@@ -0,0 +1,62 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "arena_pool.h"
+#include <algorithm>
+
+using namespace syncspirit::proto;
+
+namespace {
+/* the arena does not use too small initial blocks */
+static constexpr std::size_t min_block_size = 1024;
+} // namespace
+
+arena_pool_t::arena_pool_t(std::size_t max_block_size_) noexcept
+    : max_block_size{std::max(max_block_size_, min_block_size)} {}
+
+arena_ptr_t arena_pool_t::acquire() noexcept {
+    auto block = block_t();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!blocks.empty()) {
+            block = std::move(blocks.back());
+            blocks.pop_back();
+        }
+    }
+    if (block.empty()) {
+        block.resize(min_block_size / sizeof(block_t::value_type));
+    }
+
+    auto options = google::protobuf::ArenaOptions();
+    options.initial_block = reinterpret_cast<char *>(block.data());
+    options.initial_block_size = block.size() * sizeof(block_t::value_type);
+    auto arena = new google::protobuf::Arena(options);
+
+    auto pool = std::weak_ptr<arena_pool_t>(shared_from_this());
+    auto deleter = [pool = std::move(pool), block = std::move(block)](google::protobuf::Arena *arena) mutable {
+        auto used = static_cast<std::size_t>(arena->SpaceAllocated());
+        delete arena;
+        if (auto self = pool.lock(); self) {
+            /* next time the whole message should fit into the initial block */
+            auto sz = std::min(used, self->max_block_size);
+            auto items = (sz + sizeof(block_t::value_type) - 1) / sizeof(block_t::value_type);
+            if (items > block.size()) {
+                block = block_t(items);
+            }
+            self->release(std::move(block));
+        }
+    };
+    return arena_ptr_t(arena, std::move(deleter));
+}
+
+void arena_pool_t::release(block_t block) noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (blocks.size() < max_free_blocks) {
+        blocks.emplace_back(std::move(block));
+    }
+}
+
+std::size_t arena_pool_t::free_blocks() noexcept {
+    std::lock_guard<std::mutex> lock(mutex);
+    return blocks.size();
+}
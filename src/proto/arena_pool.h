@@ -0,0 +1,47 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <google/protobuf/arena.h>
+#include "syncspirit-export.h"
+
+namespace syncspirit::proto {
+
+using arena_ptr_t = std::shared_ptr<google::protobuf::Arena>;
+
+/* Per-connection pool of memory for protobuf arenas, where incoming messages
+ * are decoded into. The arena is destroyed with its last message; its memory
+ * is returned to the pool and is used as the initial block of the next arena,
+ * so, after a few messages, decoding does not hit the heap at all.
+ *
+ * Messages might be released on other threads (e.g. with diffs), hence the
+ * pool is guarded by mutex.
+ */
+struct SYNCSPIRIT_API arena_pool_t : std::enable_shared_from_this<arena_pool_t> {
+    static constexpr std::size_t max_free_blocks = 4;
+
+    arena_pool_t(std::size_t max_block_size) noexcept;
+
+    arena_ptr_t acquire() noexcept;
+    std::size_t free_blocks() noexcept;
+
+  private:
+    using block_t = std::vector<std::uint64_t>;
+    using blocks_t = std::vector<block_t>;
+
+    void release(block_t block) noexcept;
+
+    std::size_t max_block_size;
+    std::mutex mutex;
+    blocks_t blocks;
+};
+
+using arena_pool_ptr_t = std::shared_ptr<arena_pool_t>;
+
+} // namespace syncspirit::proto
@@ -8,6 +8,8 @@
 #include <boost/endian/arithmetic.hpp>
 #include <boost/endian/conversion.hpp>
 #include <algorithm>
+#include <cassert>
+#include <cmath>
 #include <lz4.h>
 #include <spdlog/spdlog.h>
 
@@ -17,6 +19,16 @@
 using namespace syncspirit;
 namespace be = boost::endian;
 
+namespace {
+/* messages smaller than that are not worth compressing */
+static constexpr std::uint32_t compression_threshold = 128;
+/* bits per byte, above which data is considered already compressed */
+static constexpr double max_entropy = 7.5;
+static constexpr std::size_t entropy_sample_sz = 4096;
+/* per-thread serialization buffer, which is kept between messages */
+static constexpr std::size_t lz4_buffer_max = 1024 * 1024;
+} // namespace
+
 namespace syncspirit::proto {
 
 void make_hello_message(fmt::memory_buffer &buff, std::string_view device_name) noexcept {
@@ -43,10 +55,14 @@ template <typename... Ts> auto wrap(Ts &&...data) noexcept {
 
 static outcome::result<message::wrapped_message_t> parse_hello(const asio::const_buffer &buff) noexcept {
     auto sz = buff.size();
+    if (sz < 2) {
+        return wrap(message::message_t(), 0u);
+    }
     const std::uint16_t *ptr_16 = reinterpret_cast<const std::uint16_t *>(buff.data());
     std::uint16_t msg_sz = be::big_to_native(*ptr_16++);
-    if (msg_sz < sz - 2)
-        message::Hello();
+    if (msg_sz > sz - 2) {
+        return wrap(message::message_t(), 0u);
+    }
 
     const char *ptr = reinterpret_cast<const char *>(ptr_16);
 
@@ -112,20 +128,28 @@ template <> struct M2T<typename proto::Close> {
 };
 
 template <MessageType T>
-outcome::result<message::wrapped_message_t> parse(const asio::const_buffer &buff, std::size_t consumed) noexcept {
+outcome::result<message::wrapped_message_t> parse(const asio::const_buffer &buff, std::size_t consumed,
+                                                  arena_pool_t *pool) noexcept {
     using ProtoType = typename T2M<T>::type;
     using MessageType = typename message::as_pointer<ProtoType>;
 
     const char *ptr = reinterpret_cast<const char *>(buff.data());
 
-    auto msg = std::make_unique<ProtoType>();
+    auto msg = MessageType();
+    if (pool) {
+        auto arena = pool->acquire();
+        auto raw = google::protobuf::Arena::CreateMessage<ProtoType>(arena.get());
+        msg = MessageType(std::move(arena), raw);
+    } else {
+        msg = std::make_shared<ProtoType>();
+    }
     if (!msg->ParseFromArray(ptr, buff.size())) {
         return make_error_code(utils::bep_error_code_t::protobuf_err);
     }
     return wrap(MessageType{std::move(msg)}, static_cast<size_t>(consumed + buff.size()));
 }
 
-outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &buff) noexcept {
+outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &buff, arena_pool_t *pool) noexcept {
     auto sz = buff.size();
     if (sz < 4)
         return wrap(message::message_t(), 0u);
@@ -137,7 +161,7 @@ outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &
     } else {
         auto ptr_16 = reinterpret_cast<const std::uint16_t *>(buff.data());
         auto header_sz = be::big_to_native(*ptr_16++);
-        if (2 + header_sz > (int)sz)
+        if (2 + header_sz + 4 > (int)sz)
             return wrap(message::message_t(), 0u);
         proto::Header header;
         if (!header.ParseFromArray(ptr_16, header_sz)) {
@@ -155,24 +179,24 @@ outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &
             return wrap(message::message_t(), 0u);
         }
 
-        auto parse_msg = [type](const asio::const_buffer &buff, std::size_t consumed) noexcept {
+        auto parse_msg = [type, pool](const asio::const_buffer &buff, std::size_t consumed) noexcept {
             switch (type) {
             case MT::CLUSTER_CONFIG:
-                return parse<MT::CLUSTER_CONFIG>(buff, consumed);
+                return parse<MT::CLUSTER_CONFIG>(buff, consumed, pool);
             case MT::INDEX:
-                return parse<MT::INDEX>(buff, consumed);
+                return parse<MT::INDEX>(buff, consumed, pool);
             case MT::INDEX_UPDATE:
-                return parse<MT::INDEX_UPDATE>(buff, consumed);
+                return parse<MT::INDEX_UPDATE>(buff, consumed, pool);
             case MT::REQUEST:
-                return parse<MT::REQUEST>(buff, consumed);
+                return parse<MT::REQUEST>(buff, consumed, pool);
             case MT::RESPONSE:
-                return parse<MT::RESPONSE>(buff, consumed);
+                return parse<MT::RESPONSE>(buff, consumed, pool);
             case MT::DOWNLOAD_PROGRESS:
-                return parse<MT::DOWNLOAD_PROGRESS>(buff, consumed);
+                return parse<MT::DOWNLOAD_PROGRESS>(buff, consumed, pool);
             case MT::PING:
-                return parse<MT::PING>(buff, consumed);
+                return parse<MT::PING>(buff, consumed, pool);
             case MT::CLOSE:
-                return parse<MT::CLOSE>(buff, consumed);
+                return parse<MT::CLOSE>(buff, consumed, pool);
             default:
                 std::abort();
             }
@@ -189,7 +213,10 @@ outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &
             std::memcpy(&uncompr_sz, ptr_32, sizeof(uncompr_sz));
             be::big_to_native_inplace(uncompr_sz);
             ++ptr_32;
-            auto block_sz = sz - (header_sz + sizeof(std::uint16_t) + sizeof(std::uint32_t) * 2);
+            if (message_sz < sizeof(uncompr_sz)) {
+                return make_error_code(utils::bep_error_code_t::lz4_decoding);
+            }
+            auto block_sz = static_cast<int>(message_sz - sizeof(uncompr_sz));
             uncompressed.resize(uncompr_sz);
             auto dec =
                 LZ4_decompress_safe(reinterpret_cast<const char *>(ptr_32), uncompressed.data(), block_sz, uncompr_sz);
@@ -208,6 +235,34 @@ outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &
     }
 }
 
+std::size_t get_frame_size(const asio::const_buffer &buff) noexcept {
+    auto sz = buff.size();
+    auto ptr = reinterpret_cast<const char *>(buff.data());
+    if (sz < 4) {
+        return 0;
+    }
+    std::uint32_t magic;
+    std::memcpy(&magic, ptr, sizeof(magic));
+    if (be::big_to_native(magic) == constants::bep_magic) {
+        if (sz < 6) {
+            return 0;
+        }
+        std::uint16_t hello_sz;
+        std::memcpy(&hello_sz, ptr + 4, sizeof(hello_sz));
+        return 6 + be::big_to_native(hello_sz);
+    }
+
+    std::uint16_t header_sz;
+    std::memcpy(&header_sz, ptr, sizeof(header_sz));
+    auto prefix_sz = std::size_t{2} + be::big_to_native(header_sz) + 4;
+    if (sz < prefix_sz) {
+        return 0;
+    }
+    std::uint32_t message_sz;
+    std::memcpy(&message_sz, ptr + prefix_sz - 4, sizeof(message_sz));
+    return prefix_sz + be::big_to_native(message_sz);
+}
+
 std::size_t make_announce_message(fmt::memory_buffer &buff, std::string_view device_name, const payload::URIs &uris,
                                   std::int64_t instance) noexcept {
 
@@ -248,15 +303,305 @@ outcome::result<message::Announce> parse_announce(const asio::const_buffer &buff
     return msg;
 }
 
+/* rough estimation of the data entropy on a sample of it */
+static bool is_compressible(std::string_view data) noexcept {
+    auto step = std::max(data.size() / entropy_sample_sz, std::size_t{1});
+    std::uint32_t counts[256] = {0};
+    std::size_t total = 0;
+    for (std::size_t i = 0; i < data.size(); i += step) {
+        ++counts[static_cast<unsigned char>(data[i])];
+        ++total;
+    }
+    auto entropy = 0.0;
+    for (auto count : counts) {
+        if (count) {
+            auto p = static_cast<double>(count) / total;
+            entropy -= p * std::log2(p);
+        }
+    }
+    return entropy < max_entropy;
+}
+
+/* the compression state is allocated once per thread and reused */
+static void *get_lz4_state() noexcept {
+    thread_local auto state = std::vector<std::uint64_t>((LZ4_sizeofState() + 7) / 8);
+    return state.data();
+}
+
+static bool serialize_lz4(fmt::memory_buffer &buff, const google::protobuf::MessageLite &message, MT type,
+                          std::uint32_t message_sz) noexcept {
+    thread_local auto uncompressed = std::vector<char>();
+    uncompressed.resize(message_sz);
+    message.SerializeToArray(uncompressed.data(), message_sz);
+
+    proto::Header header;
+    header.set_compression(proto::MessageCompression::LZ4);
+    header.set_type(type);
+    std::uint16_t header_sz = header.ByteSizeLong();
+    auto prefix_sz = 2 + header_sz + sizeof(std::uint32_t) * 2;
+    auto bound = LZ4_compressBound(static_cast<int>(message_sz));
+    buff.resize(prefix_sz + bound);
+
+    auto src = uncompressed.data();
+    auto dst = buff.data() + prefix_sz;
+    auto compressed_sz = LZ4_compress_fast_extState(get_lz4_state(), src, dst, message_sz, bound, 1);
+    if (uncompressed.capacity() > lz4_buffer_max) {
+        /* do not hold memory of an oversized message for the thread lifetime */
+        std::vector<char>().swap(uncompressed);
+    }
+    if (compressed_sz <= 0 || compressed_sz + sizeof(std::uint32_t) >= message_sz) {
+        return false;
+    }
+    buff.resize(prefix_sz + compressed_sz);
+
+    std::uint16_t *ptr_16 = reinterpret_cast<std::uint16_t *>(buff.data());
+    *ptr_16++ = be::native_to_big(header_sz);
+    header.SerializeToArray(ptr_16, header_sz);
+    char *ptr = reinterpret_cast<char *>(ptr_16) + header_sz;
+
+    std::uint32_t sizes[2] = {be::native_to_big(static_cast<std::uint32_t>(compressed_sz + sizeof(std::uint32_t))),
+                              be::native_to_big(message_sz)};
+    std::memcpy(ptr, sizes, sizeof(sizes));
+    return true;
+}
+
+namespace {
+namespace wire {
+enum type_t : std::uint8_t { varint = 0, fixed64 = 1, length = 2, fixed32 = 5 };
+
+static constexpr std::uint8_t tag(std::uint8_t field, type_t type) noexcept { return (field << 3) | type; }
+
+/* negative int32 values are sign-extended, as protobuf does */
+static std::uint64_t widen(std::int32_t value) noexcept {
+    return static_cast<std::uint64_t>(static_cast<std::int64_t>(value));
+}
+
+static std::size_t varint_size(std::uint64_t value) noexcept {
+    std::size_t sz = 1;
+    while (value >= 0x80) {
+        value >>= 7;
+        ++sz;
+    }
+    return sz;
+}
+
+static char *write_varint(char *ptr, std::uint64_t value) noexcept {
+    while (value >= 0x80) {
+        *ptr++ = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    *ptr++ = static_cast<char>(value);
+    return ptr;
+}
+
+static bool read_varint(const char *&ptr, const char *end, std::uint64_t &value) noexcept {
+    value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (ptr == end) {
+            return false;
+        }
+        auto byte = static_cast<std::uint8_t>(*ptr++);
+        value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* size of the field, omitted if it has default value (proto3) */
+static std::size_t varint_field_size(std::uint64_t value) noexcept { return value ? 1 + varint_size(value) : 0; }
+
+static std::size_t bytes_field_size(std::string_view value) noexcept {
+    return value.empty() ? 0 : 1 + varint_size(value.size()) + value.size();
+}
+
+static char *write_varint_field(char *ptr, std::uint8_t field, std::uint64_t value) noexcept {
+    if (value) {
+        *ptr++ = static_cast<char>(tag(field, varint));
+        ptr = write_varint(ptr, value);
+    }
+    return ptr;
+}
+
+static char *write_bytes_field(char *ptr, std::uint8_t field, std::string_view value) noexcept {
+    if (!value.empty()) {
+        *ptr++ = static_cast<char>(tag(field, length));
+        ptr = write_varint(ptr, value.size());
+        std::memcpy(ptr, value.data(), value.size());
+        ptr += value.size();
+    }
+    return ptr;
+}
+
+/* writes the frame prefix (uncompressed) and returns the pointer to the message body */
+static char *prepare_frame(fmt::memory_buffer &buff, MT type, std::size_t message_sz) noexcept {
+    auto header_sz = varint_field_size(type);
+    buff.resize(2 + header_sz + 4 + message_sz);
+    auto ptr = buff.data();
+    std::uint16_t big_header_sz = be::native_to_big(static_cast<std::uint16_t>(header_sz));
+    std::memcpy(ptr, &big_header_sz, sizeof(big_header_sz));
+    ptr = write_varint_field(ptr + 2, 1, type);
+    std::uint32_t big_message_sz = be::native_to_big(static_cast<std::uint32_t>(message_sz));
+    std::memcpy(ptr, &big_message_sz, sizeof(big_message_sz));
+    return ptr + 4;
+}
+
+} // namespace wire
+} // namespace
+
+void serialize_request(fmt::memory_buffer &buff, const request_view_t &request) noexcept {
+    using namespace wire;
+    auto sz = varint_field_size(widen(request.id)) + bytes_field_size(request.folder) +
+              bytes_field_size(request.name) + varint_field_size(static_cast<std::uint64_t>(request.offset)) +
+              varint_field_size(widen(request.size)) + bytes_field_size(request.hash) +
+              varint_field_size(request.from_temporary) + varint_field_size(request.weak_hash);
+    auto ptr = prepare_frame(buff, MT::REQUEST, sz);
+    ptr = write_varint_field(ptr, 1, widen(request.id));
+    ptr = write_bytes_field(ptr, 2, request.folder);
+    ptr = write_bytes_field(ptr, 3, request.name);
+    ptr = write_varint_field(ptr, 4, static_cast<std::uint64_t>(request.offset));
+    ptr = write_varint_field(ptr, 5, widen(request.size));
+    ptr = write_bytes_field(ptr, 6, request.hash);
+    ptr = write_varint_field(ptr, 7, request.from_temporary);
+    ptr = write_varint_field(ptr, 8, request.weak_hash);
+    assert(ptr == buff.data() + buff.size());
+}
+
+void serialize_response(fmt::memory_buffer &buff, const response_view_t &response,
+                        proto::MessageCompression compression) noexcept {
+    using namespace wire;
+    if (compression != proto::MessageCompression::NONE) {
+        proto::Response message;
+        message.set_id(response.id);
+        message.set_data(response.data.data(), response.data.size());
+        message.set_code(response.code);
+        return serialize(buff, message, compression);
+    }
+    auto code = widen(static_cast<std::int32_t>(response.code));
+    auto sz = varint_field_size(widen(response.id)) + bytes_field_size(response.data) + varint_field_size(code);
+    auto ptr = prepare_frame(buff, MT::RESPONSE, sz);
+    ptr = write_varint_field(ptr, 1, widen(response.id));
+    ptr = write_bytes_field(ptr, 2, response.data);
+    ptr = write_varint_field(ptr, 3, code);
+    assert(ptr == buff.data() + buff.size());
+}
+
+void serialize_response_head(fmt::memory_buffer &buff, const response_view_t &response) noexcept {
+    using namespace wire;
+    assert(response.code == proto::ErrorCode::NO_BEP_ERROR);
+    auto sz = varint_field_size(widen(response.id)) + bytes_field_size(response.data);
+    auto ptr = prepare_frame(buff, MT::RESPONSE, sz);
+    ptr = write_varint_field(ptr, 1, widen(response.id));
+    if (!response.data.empty()) {
+        *ptr++ = static_cast<char>(tag(2, length));
+        ptr = write_varint(ptr, response.data.size());
+    }
+    buff.resize(static_cast<std::size_t>(ptr - buff.data()));
+}
+
+bool is_plain_response(const asio::const_buffer &buff) noexcept {
+    auto sz = buff.size();
+    auto ptr = reinterpret_cast<const char *>(buff.data());
+    if (sz < 2) {
+        return false;
+    }
+    std::uint16_t header_sz;
+    std::memcpy(&header_sz, ptr, sizeof(header_sz));
+    be::big_to_native_inplace(header_sz);
+    if (sz < 2u + header_sz) {
+        return false;
+    }
+    proto::Header header;
+    if (!header.ParseFromArray(ptr + 2, header_sz)) {
+        return false;
+    }
+    return header.type() == MT::RESPONSE && header.compression() == proto::MessageCompression::NONE;
+}
+
+outcome::result<wrapped_response_t> parse_response(const asio::const_buffer &buff) noexcept {
+    using namespace wire;
+    auto frame_sz = get_frame_size(buff);
+    if (!frame_sz || frame_sz > buff.size()) {
+        return wrapped_response_t{};
+    }
+
+    auto begin = reinterpret_cast<const char *>(buff.data());
+    std::uint16_t header_sz;
+    std::memcpy(&header_sz, begin, sizeof(header_sz));
+    auto ptr = begin + 2 + be::big_to_native(header_sz) + 4;
+    auto end = begin + frame_sz;
+
+    auto bad = []() { return make_error_code(utils::bep_error_code_t::protobuf_err); };
+    auto response = response_view_t{};
+    while (ptr != end) {
+        std::uint64_t tag_value, value;
+        if (!read_varint(ptr, end, tag_value) || tag_value > 0xFFFFFFFF || !(tag_value >> 3)) {
+            return bad();
+        }
+        auto field = tag_value >> 3;
+        auto type = tag_value & 0x07;
+        switch (type) {
+        case varint:
+            if (!read_varint(ptr, end, value)) {
+                return bad();
+            }
+            if (field == 1) {
+                response.id = static_cast<std::int32_t>(value);
+            } else if (field == 3) {
+                response.code = static_cast<proto::ErrorCode>(static_cast<std::int32_t>(value));
+            }
+            break;
+        case length:
+            if (!read_varint(ptr, end, value) || value > static_cast<std::uint64_t>(end - ptr)) {
+                return bad();
+            }
+            if (field == 2) {
+                response.data = std::string_view(ptr, value);
+            }
+            ptr += value;
+            break;
+        case fixed64:
+        case fixed32: {
+            auto sz = type == fixed64 ? 8 : 4;
+            if (end - ptr < sz) {
+                return bad();
+            }
+            ptr += sz;
+            break;
+        }
+        default:
+            /* groups are deprecated and not supported */
+            return bad();
+        }
+    }
+    return wrapped_response_t{response, frame_sz};
+}
+
+proto::MessageCompression make_compression(proto::Compression policy, bool metadata) noexcept {
+    bool compress = policy == proto::Compression::ALWAYS || (metadata && policy == proto::Compression::METADATA);
+    return compress ? proto::MessageCompression::LZ4 : proto::MessageCompression::NONE;
+}
+
 template <typename Message>
 SYNCSPIRIT_API void serialize(fmt::memory_buffer &buff, const Message &message,
                               proto::MessageCompression compression) noexcept {
     using type = typename M2T<Message>::type;
+    std::uint32_t message_sz = message.ByteSizeLong();
+    if (compression == proto::MessageCompression::LZ4) {
+        bool compress = message_sz >= compression_threshold;
+        if constexpr (std::is_same_v<Message, proto::Response>) {
+            compress = compress && is_compressible(message.data());
+        }
+        if (compress && serialize_lz4(buff, message, type::value, message_sz)) {
+            return;
+        }
+    }
+
     proto::Header header;
-    header.set_compression(compression);
+    header.set_compression(proto::MessageCompression::NONE);
     header.set_type(type::value);
     std::uint16_t header_sz = header.ByteSizeLong();
-    std::uint32_t message_sz = message.ByteSizeLong();
     buff.resize(2 + header_sz + 4 + message_sz);
     std::uint16_t *ptr_16 = reinterpret_cast<std::uint16_t *>(buff.data());
 
@@ -6,11 +6,14 @@
 #include <fmt/format.h>
 #include <boost/outcome.hpp>
 #include <boost/asio/buffer.hpp>
+#include <cstdint>
 #include <memory>
+#include <string_view>
 #include <variant>
 #include <vector>
 #include <type_traits>
 #include "syncspirit-export.h"
+#include "arena_pool.h"
 #include "bep.pb.h"
 #include "utils/uri.h"
 
@@ -25,7 +28,8 @@ using URIs = std::vector<utils::URI>;
 
 namespace message {
 
-template <typename Message> using as_pointer = std::unique_ptr<Message>;
+/* the message might be allocated on arena, which is kept alive by the pointer */
+template <typename Message> using as_pointer = std::shared_ptr<Message>;
 
 using Hello = as_pointer<syncspirit::proto::Hello>;
 using ClusterConfig = as_pointer<syncspirit::proto::ClusterConfig>;
@@ -54,11 +58,65 @@ SYNCSPIRIT_API void make_hello_message(fmt::memory_buffer &buff, std::string_vie
 SYNCSPIRIT_API std::size_t make_announce_message(fmt::memory_buffer &buff, std::string_view device_name,
                                                  const payload::URIs &uris, std::int64_t instance) noexcept;
 
+/* With LZ4 compression the message is compressed only if it is worth that,
+ * i.e. it is not too small, its data does not look random and the
+ * compressed output is smaller; otherwise it is sent as is. */
 template <typename Message>
 void serialize(fmt::memory_buffer &buff, const Message &message,
                proto::MessageCompression compression = proto::MessageCompression::NONE) noexcept;
 
-SYNCSPIRIT_API outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &buff) noexcept;
+/* Request and Response are the most frequent messages, so they have
+ * dedicated codec, which writes / reads protobuf wire format directly,
+ * without intermediate protobuf messages. */
+struct request_view_t {
+    std::int32_t id = 0;
+    std::string_view folder;
+    std::string_view name;
+    std::int64_t offset = 0;
+    std::int32_t size = 0;
+    std::string_view hash;
+    bool from_temporary = false;
+    std::uint32_t weak_hash = 0;
+};
+
+/* on parsing, the data refers the input buffer */
+struct response_view_t {
+    std::int32_t id = 0;
+    std::string_view data;
+    proto::ErrorCode code = proto::ErrorCode::NO_BEP_ERROR;
+};
+
+struct wrapped_response_t {
+    response_view_t response;
+    std::size_t consumed = 0;
+};
+
+SYNCSPIRIT_API void serialize_request(fmt::memory_buffer &buff, const request_view_t &request) noexcept;
+/* compressed responses are serialized via protobuf */
+SYNCSPIRIT_API void
+serialize_response(fmt::memory_buffer &buff, const response_view_t &response,
+                   proto::MessageCompression compression = proto::MessageCompression::NONE) noexcept;
+
+/* writes the uncompressed Response frame without the data bytes, which should
+ * be sent right after it; the response code should be NO_BEP_ERROR */
+SYNCSPIRIT_API void serialize_response_head(fmt::memory_buffer &buff, const response_view_t &response) noexcept;
+
+/* whether the buffer starts with uncompressed Response frame, which might be incomplete */
+SYNCSPIRIT_API bool is_plain_response(const asio::const_buffer &buff) noexcept;
+
+/* consumed is 0, if the frame is incomplete */
+SYNCSPIRIT_API outcome::result<wrapped_response_t> parse_response(const asio::const_buffer &buff) noexcept;
+
+/* compression of outgoing messages according to the peer device setting */
+SYNCSPIRIT_API proto::MessageCompression make_compression(proto::Compression policy, bool metadata) noexcept;
+
+/* if the pool is provided, the message is decoded into an arena from it */
+SYNCSPIRIT_API outcome::result<message::wrapped_message_t> parse_bep(const asio::const_buffer &buff,
+                                                                     arena_pool_t *pool = nullptr) noexcept;
+
+/* total size of the (possibly incomplete) frame at the buffer start, or 0,
+ * if there are not enough bytes to determine it */
+SYNCSPIRIT_API std::size_t get_frame_size(const asio::const_buffer &buff) noexcept;
 
 SYNCSPIRIT_API outcome::result<message::Announce> parse_announce(const asio::const_buffer &buff) noexcept;
 
@@ -4,6 +4,7 @@
 #include "relay_support.h"
 #include "utils/error_code.h"
 #include <nlohmann/json.hpp>
+#include <charconv>
 #include <boost/endian/arithmetic.hpp>
 #include <boost/endian/conversion.hpp>
 
@@ -343,6 +344,22 @@ std::optional<model::device_id_t> parse_device(const utils::URI &uri) noexcept {
     return std::move(device_opt.value());
 }
 
+std::uint64_t parse_session_limit(const utils::URI &uri) noexcept {
+    auto q = uri.decompose_query();
+    for (auto &pair : q) {
+        if (pair.first == "sessionLimitBps") {
+            auto &value = pair.second;
+            auto session_limit = std::uint64_t{0};
+            auto [ptr, ec] = std::from_chars(value.data(), value.data() + value.size(), session_limit);
+            if (ec != std::errc{} || ptr != value.data() + value.size()) {
+                return 0;
+            }
+            return session_limit;
+        }
+    }
+    return 0;
+}
+
 outcome::result<relay_infos_t> parse_endpoint(std::string_view buff) noexcept {
     using namespace syncspirit::utils;
     auto data = json::parse(buff.begin(), buff.end(), nullptr, false);
@@ -387,6 +404,7 @@ outcome::result<relay_infos_t> parse_endpoint(std::string_view buff) noexcept {
                 ping_interval_str = std::move(pair.second);
             }
         }
+        auto session_limit = parse_session_limit(uri);
         if (device_id_str.empty()) {
             continue;
         }
@@ -429,7 +447,7 @@ outcome::result<relay_infos_t> parse_endpoint(std::string_view buff) noexcept {
                                                            country.get<std::string>(),
                                                            continent.get<std::string>(),
                                                        },
-                                                       ping_interval}};
+                                                       ping_interval, session_limit}};
         r.emplace_back(std::move(relay));
     }
     return r;
@@ -73,18 +73,23 @@ struct location_t {
 
 struct relay_info_t : model::arc_base_t<relay_info_t> {
     inline relay_info_t(utils::URI uri_, const model::device_id_t &device_id_, location_t location_,
-                        const pt::time_duration &ping_interval_) noexcept
-        : uri(std::move(uri_)), device_id{device_id_}, location{std::move(location_)}, ping_interval{ping_interval_} {}
+                        const pt::time_duration &ping_interval_, std::uint64_t session_limit_ = 0) noexcept
+        : uri(std::move(uri_)), device_id{device_id_}, location{std::move(location_)}, ping_interval{ping_interval_},
+          session_limit{session_limit_} {}
     utils::URI uri;
     model::device_id_t device_id;
     location_t location;
     pt::time_duration ping_interval;
+    /* bytes per second the relay allows per session, 0 means no limit */
+    std::uint64_t session_limit;
 };
 
 using relay_info_ptr_t = model::intrusive_ptr_t<relay_info_t>;
 using relay_infos_t = std::vector<relay_info_ptr_t>;
 
 SYNCSPIRIT_API std::optional<model::device_id_t> parse_device(const utils::URI &uri) noexcept;
+/* sessionLimitBps of the relay uri, 0 means no limit */
+SYNCSPIRIT_API std::uint64_t parse_session_limit(const utils::URI &uri) noexcept;
 SYNCSPIRIT_API outcome::result<relay_infos_t> parse_endpoint(std::string_view data) noexcept;
 
 } // namespace syncspirit::proto::relay
@@ -6,6 +6,7 @@
 #include <memory>
 #include <functional>
 #include <optional>
+#include <vector>
 #include <memory>
 #include <rotor/asio.hpp>
 #include "model/device_id.h"
@@ -31,6 +32,7 @@ using error_fn_t = std::function<void(const sys::error_code &)>;
 using handshake_fn_t =
     std::function<void(bool valid, utils::x509_t &peer, const tcp::endpoint &, const model::device_id_t *peer_device)>;
 using io_fn_t = std::function<void(std::size_t)>;
+using const_buffers_t = std::vector<asio::const_buffer>;
 
 struct ssl_junction_t {
     model::device_id_t peer;
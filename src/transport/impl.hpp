@@ -4,7 +4,9 @@
 #pragma once
 
 #include "base.h"
+#include "utils/error_code.h"
 #include "utils/platform.h"
+#include "session_cache.h"
 #include "stream.h"
 #include <spdlog/spdlog.h>
 #include <boost/asio/ssl.hpp>
@@ -67,6 +69,31 @@ template <typename T, typename... Args> auto curry_io(Args &&...args) {
 
 // --------------------------------
 
+/* the accepted socket might belong to other io_context (i.e. other thread),
+ * then its descriptor is re-registered in the supervisor one */
+inline tcp::socket adopt_socket(tcp::socket sock, strand_t &strand) noexcept {
+    asio::execution_context &context = strand.context();
+    if (&asio::query(sock.get_executor(), asio::execution::context) == &context) {
+        return sock;
+    }
+    sys::error_code ec;
+    auto protocol = sock.local_endpoint(ec).protocol();
+    if (ec) {
+        return sock;
+    }
+    auto handle = sock.release(ec);
+    if (ec) {
+        spdlog::warn("cannot move socket to other io context :: {}", ec.message());
+        return sock;
+    }
+    tcp::socket adopted(strand.context());
+    adopted.assign(protocol, handle, ec);
+    if (ec) {
+        spdlog::error("cannot assign socket :: {}", ec.message());
+    }
+    return adopted;
+}
+
 template <typename Sock> struct base_impl_t;
 
 template <> struct base_impl_t<tcp_socket_t> {
@@ -78,7 +105,7 @@ template <> struct base_impl_t<tcp_socket_t> {
 
     static tcp_socket_t mk_sock(transport_config_t &config, strand_t &strand) noexcept {
         if (config.sock) {
-            tcp::socket sock(std::move(config.sock.value()));
+            auto sock = adopt_socket(std::move(config.sock.value()), strand);
             return {std::move(sock)};
         } else {
             tcp::socket sock(strand.context());
@@ -108,7 +135,7 @@ template <> struct base_impl_t<ssl_socket_t> {
     bool cancelling = false;
     bool active;
 
-    static ssl::context get_context(self_t &source, std::string_view alpn) noexcept {
+    static ssl::context get_context(self_t &source, std::string_view alpn, bool active) noexcept {
         ssl::context ctx(ssl::context::tls);
         ctx.set_options(ssl::context::default_workarounds | ssl::context::no_sslv2);
 
@@ -118,6 +145,7 @@ template <> struct base_impl_t<ssl_socket_t> {
             auto &key_data = me->key_data.bytes;
             ctx.use_certificate(asio::const_buffer(cert_data.c_str(), cert_data.size()), ssl::context::asn1);
             ctx.use_private_key(asio::const_buffer(key_data.c_str(), key_data.size()), ssl::context::asn1);
+            session_cache_t::instance().setup(ctx.native_handle(), active);
         }
 
         if (alpn.size()) {
@@ -135,7 +163,7 @@ template <> struct base_impl_t<ssl_socket_t> {
 
     static ssl_socket_t mk_sock(transport_config_t &config, ssl::context &ctx, strand_t &strand) noexcept {
         if (config.sock) {
-            tcp::socket sock(std::move(config.sock.value()));
+            auto sock = adopt_socket(std::move(config.sock.value()), strand);
             return {std::move(sock), ctx};
         } else {
             tcp::socket sock(strand.context());
@@ -145,7 +173,7 @@ template <> struct base_impl_t<ssl_socket_t> {
 
     base_impl_t(transport_config_t &config) noexcept
         : supervisor{config.supervisor}, strand{supervisor.get_strand()}, expected_peer{config.ssl_junction->peer},
-          me(config.ssl_junction->me), ctx(get_context(*this, config.ssl_junction->alpn)),
+          me(config.ssl_junction->me), ctx(get_context(*this, config.ssl_junction->alpn, config.active)),
           role(!config.active ? ssl::stream_base::server : ssl::stream_base::client),
           sock(mk_sock(config, ctx, strand)) {
         if (config.ssl_junction->sni_extension) {
@@ -161,41 +189,65 @@ template <> struct base_impl_t<ssl_socket_t> {
             sock.set_verify_depth(1);
             sock.set_verify_callback([&](bool, ssl::verify_context &peer_ctx) -> bool {
                 auto native = peer_ctx.native_handle();
-                auto peer_cert = X509_STORE_CTX_get_current_cert(native);
-                if (!peer_cert) {
-                    spdlog::warn("no peer certificate");
-                    return false;
-                }
-                auto der_option = utils::as_serialized_der(peer_cert);
-                if (!der_option) {
-                    spdlog::warn("peer certificate cannot be serialized as der : {}", der_option.error().message());
-                    return false;
-                }
+                return validate(X509_STORE_CTX_get_current_cert(native));
+            });
+            if (role == ssl::stream_base::client && expected_peer) {
+                session_cache_t::instance().attach(sock.native_handle(), expected_peer);
+            }
+        }
+    }
 
-                utils::cert_data_t cert_data{std::move(der_option.value())};
-                auto peer_option = model::device_id_t::from_cert(cert_data);
-                if (!peer_option) {
-                    spdlog::warn("cannot get device_id from peer");
-                    return false;
-                }
+    bool validate(X509 *peer_cert) noexcept {
+        if (!peer_cert) {
+            spdlog::warn("no peer certificate");
+            return false;
+        }
+        auto der_option = utils::as_serialized_der(peer_cert);
+        if (!der_option) {
+            spdlog::warn("peer certificate cannot be serialized as der : {}", der_option.error().message());
+            return false;
+        }
 
-                auto peer = std::move(peer_option.value());
-                if (!actual_peer) {
-                    actual_peer = std::move(peer);
-                    spdlog::trace("tls, peer device_id = {}", actual_peer);
-                }
+        utils::cert_data_t cert_data{std::move(der_option.value())};
+        auto peer_option = model::device_id_t::from_cert(cert_data);
+        if (!peer_option) {
+            spdlog::warn("cannot get device_id from peer");
+            return false;
+        }
 
-                if (role == ssl::stream_base::handshake_type::client) {
-                    if (actual_peer != expected_peer) {
-                        spdlog::warn("unexpected peer device_id. Got: {}, expected: {}", actual_peer.get_value(),
-                                     expected_peer.get_value());
-                        return false;
-                    }
-                }
-                validation_passed = true;
-                return true;
-            });
+        auto peer = std::move(peer_option.value());
+        if (!actual_peer) {
+            actual_peer = std::move(peer);
+            spdlog::trace("tls, peer device_id = {}", actual_peer);
+        }
+
+        if (role == ssl::stream_base::handshake_type::client) {
+            if (actual_peer != expected_peer) {
+                spdlog::warn("unexpected peer device_id. Got: {}, expected: {}", actual_peer.get_value(),
+                             expected_peer.get_value());
+                return false;
+            }
+        }
+        validation_passed = true;
+        return true;
+    }
+
+    /* the verification callback is not invoked for resumed sessions, so
+     * the peer is checked against the certificate stored in the session */
+    bool validate_resumed() noexcept {
+        auto native = sock.native_handle();
+        if (!me || !SSL_session_reused(native)) {
+            return true;
+        }
+        spdlog::trace("tls, session resumed, expected peer = {}", expected_peer);
+        auto peer_cert = utils::x509_t(SSL_get_peer_certificate(native));
+        if (!validate(peer_cert)) {
+            if (expected_peer) {
+                session_cache_t::instance().remove(expected_peer);
+            }
+            return false;
         }
+        return true;
     }
 
     tcp_socket_t &get_physical_layer() noexcept { return sock.next_layer(); }
@@ -203,9 +255,10 @@ template <> struct base_impl_t<ssl_socket_t> {
 
 // --------------------------------
 
-template <typename Sock, typename Owner> inline void generic_async_send(Owner owner, asio::const_buffer buff) noexcept {
+template <typename Sock, typename Owner, typename Buffers>
+inline void generic_async_send(Owner owner, const Buffers &buffs) noexcept {
     auto &sock = owner->backend->sock;
-    asio::async_write(sock, buff, [owner = std::move(owner)](auto ec, auto bytes) mutable {
+    asio::async_write(sock, buffs, [owner = std::move(owner)](auto ec, auto bytes) mutable {
         auto &strand = owner->backend->strand;
         if (ec) {
             strand.post([ec = ec, owner = std::move(owner)]() mutable {
@@ -281,8 +334,9 @@ template <> struct impl<tcp_socket_t> {
         }
     }
 
-    template <typename Owner> inline static void async_send(Owner owner, asio::const_buffer buff) noexcept {
-        generic_async_send<socket_t, Owner>(std::move(owner), buff);
+    template <typename Owner, typename Buffers>
+    inline static void async_send(Owner owner, const Buffers &buffs) noexcept {
+        generic_async_send<socket_t, Owner>(std::move(owner), buffs);
     }
 
     template <typename Owner> inline static void async_recv(Owner owner, asio::mutable_buffer buff) noexcept {
@@ -329,6 +383,10 @@ template <> struct impl<ssl_socket_t> {
             }
             strand.post([endpoint, owner = std::move(owner)]() {
                 auto &backend = owner->backend;
+                if (!backend->validate_resumed()) {
+                    owner->error(utils::make_error_code(utils::error_code_t::invalid_deviceid));
+                    return;
+                }
                 auto &sock = backend->sock;
                 auto peer_cert = SSL_get_peer_certificate(sock.native_handle());
                 auto x509 = utils::x509_t(peer_cert);
@@ -337,8 +395,9 @@ template <> struct impl<ssl_socket_t> {
         });
     }
 
-    template <typename Owner> inline static void async_send(Owner owner, asio::const_buffer buff) noexcept {
-        generic_async_send<socket_t, Owner>(std::move(owner), buff);
+    template <typename Owner, typename Buffers>
+    inline static void async_send(Owner owner, const Buffers &buffs) noexcept {
+        generic_async_send<socket_t, Owner>(std::move(owner), buffs);
     }
 
     template <typename Owner> inline static void async_recv(Owner owner, asio::mutable_buffer buff) noexcept {
@@ -373,6 +432,11 @@ template <typename T, typename Sock, typename P> struct interface_t : P {
         impl<Sock>::async_send(std::move(curry), buff);
     }
 
+    void async_send(const const_buffers_t &buffs, io_fn_t &on_write, error_fn_t &on_error) noexcept override {
+        auto curry = curry_io<self_t>(get_self(), on_write, on_error);
+        impl<Sock>::async_send(std::move(curry), buffs);
+    }
+
     void async_recv(asio::mutable_buffer buff, io_fn_t &on_read, error_fn_t &on_error) noexcept override {
         auto curry = curry_io<self_t>(get_self(), on_read, on_error);
         impl<Sock>::async_recv(std::move(curry), buff);
@@ -0,0 +1,149 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "session_cache.h"
+#include "constants.h"
+#include <openssl/rand.h>
+#include <spdlog/spdlog.h>
+#include <algorithm>
+
+using namespace syncspirit::transport;
+
+namespace {
+
+static const unsigned char session_id_context[] = "syncspirit";
+
+int get_ctx_index() noexcept {
+    static int index = SSL_CTX_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+int get_peer_index() noexcept {
+    static int index = SSL_get_ex_new_index(0, nullptr, nullptr, nullptr, nullptr);
+    return index;
+}
+
+/* invoked by openssl on the client side, when a new session ticket arrives,
+ * which might happen after the handshake.
+ *
+ * The copy is stored, as openssl marks the session non-resumable, when the
+ * connection is closed without TLS shutdown, which is usual for peers. */
+int on_new_session(SSL *ssl, SSL_SESSION *session) {
+    auto ctx = SSL_get_SSL_CTX(ssl);
+    auto cache = static_cast<session_cache_t *>(SSL_CTX_get_ex_data(ctx, get_ctx_index()));
+    auto peer = static_cast<const syncspirit::model::device_id_t *>(SSL_get_ex_data(ssl, get_peer_index()));
+    if (!cache || !peer) {
+        return 0;
+    }
+    auto copy = SSL_SESSION_dup(session);
+    if (copy) {
+        cache->put(*peer, copy);
+    }
+    return 0;
+}
+
+} // namespace
+
+session_cache_t::session_cache_t(std::chrono::seconds lifetime_, std::size_t max_size_) noexcept
+    : lifetime{lifetime_}, max_size{max_size_} {}
+
+session_cache_t::~session_cache_t() {
+    for (auto &it : entries) {
+        SSL_SESSION_free(it.second.session);
+    }
+}
+
+session_cache_t &session_cache_t::instance() noexcept {
+    static session_cache_t cache(std::chrono::seconds{constants::tls_session_lifetime},
+                                 constants::tls_session_cache_size);
+    return cache;
+}
+
+void session_cache_t::setup(SSL_CTX *ctx, bool active) noexcept {
+    SSL_CTX_set_timeout(ctx, static_cast<long>(lifetime.count()));
+    SSL_CTX_set_session_id_context(ctx, session_id_context, sizeof(session_id_context) - 1);
+    if (active) {
+        SSL_CTX_set_ex_data(ctx, get_ctx_index(), this);
+        SSL_CTX_set_session_cache_mode(ctx, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(ctx, on_new_session);
+        return;
+    }
+
+    std::lock_guard lock(mutex);
+    auto now = clock_t::now();
+    if (ticket_keys_created == clock_t::time_point{} || now - ticket_keys_created > lifetime) {
+        if (RAND_bytes(ticket_keys.data(), static_cast<int>(ticket_keys.size())) != 1) {
+            spdlog::warn("tls session cache, cannot generate ticket keys");
+            SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+            return;
+        }
+        ticket_keys_created = now;
+    }
+    SSL_CTX_set_tlsext_ticket_keys(ctx, ticket_keys.data(), static_cast<long>(ticket_keys.size()));
+}
+
+void session_cache_t::attach(SSL *ssl, const model::device_id_t &peer) noexcept {
+    SSL_set_ex_data(ssl, get_peer_index(), const_cast<model::device_id_t *>(&peer));
+    auto session = get(peer);
+    if (session) {
+        SSL_set_session(ssl, session);
+        SSL_SESSION_free(session);
+    }
+}
+
+SSL_SESSION *session_cache_t::get(const model::device_id_t &peer, clock_t::time_point now) noexcept {
+    std::lock_guard lock(mutex);
+    auto it = entries.find(std::string(peer.get_sha256()));
+    if (it == entries.end()) {
+        ++stats.misses;
+        return nullptr;
+    }
+    auto &entry = it->second;
+    if (now - entry.stored > lifetime || !SSL_SESSION_is_resumable(entry.session)) {
+        SSL_SESSION_free(entry.session);
+        entries.erase(it);
+        ++stats.expired;
+        ++stats.misses;
+        return nullptr;
+    }
+    ++stats.hits;
+    SSL_SESSION_up_ref(entry.session);
+    return entry.session;
+}
+
+void session_cache_t::put(const model::device_id_t &peer, SSL_SESSION *session, clock_t::time_point now) noexcept {
+    std::lock_guard lock(mutex);
+    auto key = std::string(peer.get_sha256());
+    auto it = entries.find(key);
+    if (it != entries.end()) {
+        SSL_SESSION_free(it->second.session);
+        it->second = entry_t{session, now};
+        return;
+    }
+    if (entries.size() >= max_size) {
+        auto predicate = [](auto &a, auto &b) { return a.second.stored < b.second.stored; };
+        auto oldest = std::min_element(entries.begin(), entries.end(), predicate);
+        SSL_SESSION_free(oldest->second.session);
+        entries.erase(oldest);
+    }
+    entries.emplace(std::move(key), entry_t{session, now});
+}
+
+void session_cache_t::remove(const model::device_id_t &peer) noexcept {
+    std::lock_guard lock(mutex);
+    auto it = entries.find(std::string(peer.get_sha256()));
+    if (it != entries.end()) {
+        SSL_SESSION_free(it->second.session);
+        entries.erase(it);
+    }
+}
+
+auto session_cache_t::get_stats() const noexcept -> stats_t {
+    std::lock_guard lock(mutex);
+    return stats;
+}
+
+std::size_t session_cache_t::size() const noexcept {
+    std::lock_guard lock(mutex);
+    return entries.size();
+}
@@ -0,0 +1,75 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include "model/device_id.h"
+#include "syncspirit-export.h"
+#include <openssl/ssl.h>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace syncspirit::transport {
+
+/* Process-wide cache of TLS sessions, which allows to resume the sessions
+ * with peers and relays on reconnect, skipping the full handshake.
+ *
+ * The client side keeps the last session ticket per remote device id; all
+ * the server-side contexts share the same ticket keys, so a ticket issued by
+ * one accepted connection is valid for the next ones. Sessions (and ticket
+ * keys) older than lifetime are not used.
+ */
+struct SYNCSPIRIT_API session_cache_t {
+    using clock_t = std::chrono::steady_clock;
+
+    struct stats_t {
+        std::uint64_t hits = 0;
+        std::uint64_t misses = 0;
+        std::uint64_t expired = 0;
+    };
+
+    session_cache_t(std::chrono::seconds lifetime, std::size_t max_size) noexcept;
+    session_cache_t(const session_cache_t &) = delete;
+    ~session_cache_t();
+
+    static session_cache_t &instance() noexcept;
+
+    /* prepares the context for resumption, should be called for each one */
+    void setup(SSL_CTX *ctx, bool active) noexcept;
+
+    /* binds the client connection to the peer: the cached session is offered
+     * to it, and the new session tickets will be stored */
+    void attach(SSL *ssl, const model::device_id_t &peer) noexcept;
+
+    /* returns a new reference to the session or nullptr */
+    SSL_SESSION *get(const model::device_id_t &peer, clock_t::time_point now = clock_t::now()) noexcept;
+
+    /* takes the ownership of the session */
+    void put(const model::device_id_t &peer, SSL_SESSION *session, clock_t::time_point now = clock_t::now()) noexcept;
+    void remove(const model::device_id_t &peer) noexcept;
+
+    stats_t get_stats() const noexcept;
+    std::size_t size() const noexcept;
+
+  private:
+    struct entry_t {
+        SSL_SESSION *session;
+        clock_t::time_point stored;
+    };
+    using entries_t = std::unordered_map<std::string, entry_t>;
+    using ticket_keys_t = std::array<unsigned char, 80>;
+
+    std::chrono::seconds lifetime;
+    std::size_t max_size;
+    mutable std::mutex mutex;
+    entries_t entries;
+    ticket_keys_t ticket_keys;
+    clock_t::time_point ticket_keys_created;
+    stats_t stats;
+};
+
+} // namespace syncspirit::transport
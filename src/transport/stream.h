@@ -12,6 +12,8 @@ struct stream_interface_t {
                                error_fn_t &on_error) noexcept = 0;
     virtual void async_handshake(handshake_fn_t &on_handshake, error_fn_t &on_error) noexcept = 0;
     virtual void async_send(asio::const_buffer buff, io_fn_t &on_write, error_fn_t &on_error) noexcept = 0;
+    /* gathering write: all buffers are sent one after another, as a single operation */
+    virtual void async_send(const const_buffers_t &buffs, io_fn_t &on_write, error_fn_t &on_error) noexcept = 0;
     virtual void async_recv(asio::mutable_buffer buff, io_fn_t &on_read, error_fn_t &on_error) noexcept = 0;
     virtual void cancel() noexcept = 0;
 };
@@ -19,6 +19,7 @@
 #include "utils/log.h"
 #include "utils/platform.h"
 #include "net/net_supervisor.h"
+#include "net/peer_supervisor.h"
 #include "fs/fs_supervisor.h"
 #include "hasher/hasher_supervisor.h"
 #include "command.h"
@@ -242,7 +243,10 @@ int main(int argc, char **argv) {
         auto strand = std::make_shared<asio::io_context::strand>(io_context);
         auto timeout = pt::milliseconds{cfg.timeout};
 
+        /* the fs thread holds the cluster replica, peers read devices view only */
+        auto net_count = cfg.net_threads;
         auto cluster_copies = 1ul;
+        auto devices_view = std::make_shared<model::devices_view_t>();
 
         auto sup_net = sys_context->create_supervisor<net::net_supervisor_t>()
                            .app_config(cfg)
@@ -251,6 +255,7 @@ int main(int argc, char **argv) {
                            .create_registry()
                            .guard_context(true)
                            .cluster_copies(cluster_copies)
+                           .devices_view(devices_view)
                            .shutdown_flag(shutdown_flag, r::pt::millisec{50})
                            .finish();
         sup_net->start();
@@ -288,6 +293,39 @@ int main(int argc, char **argv) {
                 .finish();
         }
 
+        /* peers are served on the own io_contexts, each one gets own keys copy */
+        auto ssl_pair = utils::key_pair_t();
+        if (net_count) {
+            auto &files_cfg = cfg.global_announce_config;
+            auto pair = utils::load_pair(files_cfg.cert_file.c_str(), files_cfg.key_file.c_str());
+            if (!pair) {
+                spdlog::error("cannot load certificate/key pair :: {}", pair.error().message());
+                return 1;
+            }
+            ssl_pair = std::move(pair.value());
+        }
+        auto net_ios = std::vector<std::unique_ptr<asio::io_context>>();
+        auto net_ctxs = std::vector<ra::system_context_ptr_t>();
+        for (uint32_t i = 1; i <= net_count; ++i) {
+            auto &io = *net_ios.emplace_back(new asio::io_context());
+            auto &ctx = net_ctxs.emplace_back(new asio_sys_context_t{io});
+            auto net_strand = std::make_shared<asio::io_context::strand>(io);
+            auto sup = ctx->create_supervisor<net::peer_supervisor_t>()
+                           .strand(net_strand)
+                           .timeout(timeout)
+                           .registry_address(sup_net->get_registry_address())
+                           .guard_context(true)
+                           .ssl_pair(&ssl_pair)
+                           .devices_view(devices_view)
+                           .device_name(cfg.device_name)
+                           .bep_config(cfg.bep_config)
+                           .relay_config(cfg.relay_config)
+                           .index(i)
+                           .net_threads(net_count)
+                           .finish();
+            sup->start();
+        }
+
         /* launch actors */
         auto fs_thread = std::thread([&]() {
 #if defined(__linux__)
@@ -315,6 +353,23 @@ int main(int argc, char **argv) {
             hasher_threads.emplace_back(std::move(thread));
         }
 
+        auto net_threads = std::vector<std::thread>();
+        for (uint32_t i = 0; i < net_count; ++i) {
+            auto &io = *net_ios.at(i);
+            auto thread = std::thread([&io = io, i = i]() {
+#if defined(__linux__)
+                std::string name = "ss/net-" + std::to_string(i + 1);
+                pthread_setname_np(pthread_self(), name.c_str());
+#endif
+                io.run();
+                shutdown_flag = true;
+#if defined(__linux__)
+                spdlog::trace("{} thread has been terminated", name);
+#endif
+            });
+            net_threads.emplace_back(std::move(thread));
+        }
+
         // main loop;
 #if defined(__linux__)
         pthread_setname_np(pthread_self(), "ss/net");
@@ -330,6 +385,11 @@ int main(int argc, char **argv) {
         for (auto &thread : hasher_threads) {
             thread.join();
         }
+
+        spdlog::trace("waiting net threads termination");
+        for (auto &thread : net_threads) {
+            thread.join();
+        }
         spdlog::trace("everything has been terminated");
     } catch (...) {
         spdlog::critical("unknown exception");
@@ -0,0 +1,52 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "bandwidth_shaper.h"
+#include <algorithm>
+
+using namespace syncspirit::utils;
+
+static std::uint64_t to_bytes(std::uint32_t kbps) noexcept { return static_cast<std::uint64_t>(kbps) * 1024; }
+
+bandwidth_shaper_t &bandwidth_shaper_t::instance() noexcept {
+    static bandwidth_shaper_t shaper;
+    return shaper;
+}
+
+void bandwidth_shaper_t::configure(const config::bandwidth_config_t &config_) noexcept {
+    auto lock = std::lock_guard(mutex);
+    config = config_;
+    global[(int)direction_t::upload].setup(to_bytes(config.upload_limit), nullptr);
+    global[(int)direction_t::download].setup(to_bytes(config.download_limit), nullptr);
+    for (auto &peer : peers) {
+        if (auto bucket = peer.bucket.lock(); bucket) {
+            setup(*bucket, peer);
+        }
+    }
+}
+
+auto bandwidth_shaper_t::make_bucket(direction_t direction, bool lan, std::uint64_t session_limit) noexcept
+    -> bucket_ptr_t {
+    auto lock = std::lock_guard(mutex);
+    auto expired = [](const peer_t &peer) { return peer.bucket.expired(); };
+    peers.erase(std::remove_if(peers.begin(), peers.end(), expired), peers.end());
+
+    auto bucket = std::make_shared<bucket_t>();
+    auto &peer = peers.emplace_back(peer_t{bucket, direction, lan, session_limit});
+    setup(*bucket, peer);
+    return bucket;
+}
+
+void bandwidth_shaper_t::setup(bucket_t &bucket, const peer_t &peer) noexcept {
+    auto limit = std::uint64_t{0};
+    auto parent = (bucket_t *)(nullptr);
+    if (!peer.lan || config.limit_lan) {
+        auto upload = peer.direction == direction_t::upload;
+        limit = to_bytes(upload ? config.peer_upload_limit : config.peer_download_limit);
+        parent = &global[(int)peer.direction];
+    }
+    if (peer.session_limit && (!limit || peer.session_limit < limit)) {
+        limit = peer.session_limit;
+    }
+    bucket.setup(limit, parent);
+}
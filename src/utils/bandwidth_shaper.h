@@ -0,0 +1,54 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include "config/bandwidth.h"
+#include "token_bucket.h"
+#include "syncspirit-export.h"
+#include <array>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace syncspirit::utils {
+
+/* Process-wide traffic shaping: global -> peer -> direction.
+ *
+ * Each direction has the global bucket, shared by all peers; each peer
+ * has its own bucket per direction, which is the child of the global one.
+ * Peers in local networks are not limited, unless it is configured.
+ * The peer, connected via relay, is additionally limited by the session
+ * limit of the relay (bytes per second, zero means no limit).
+ *
+ * The limits might be changed at any time, they are applied to the
+ * already connected peers too.
+ */
+struct SYNCSPIRIT_API bandwidth_shaper_t {
+    using bucket_t = token_bucket_t;
+    using bucket_ptr_t = std::shared_ptr<bucket_t>;
+    enum class direction_t { upload = 0, download = 1 };
+
+    static bandwidth_shaper_t &instance() noexcept;
+
+    void configure(const config::bandwidth_config_t &config) noexcept;
+    bucket_ptr_t make_bucket(direction_t direction, bool lan, std::uint64_t session_limit = 0) noexcept;
+
+  private:
+    struct peer_t {
+        std::weak_ptr<bucket_t> bucket;
+        direction_t direction;
+        bool lan;
+        std::uint64_t session_limit;
+    };
+    using peers_t = std::vector<peer_t>;
+
+    void setup(bucket_t &bucket, const peer_t &peer) noexcept;
+
+    std::mutex mutex;
+    config::bandwidth_config_t config = {0, 0, 0, 0, false};
+    std::array<bucket_t, 2> global;
+    peers_t peers;
+};
+
+} // namespace syncspirit::utils
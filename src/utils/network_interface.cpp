@@ -139,4 +139,23 @@ uri_container_t local_interfaces(const tcp::endpoint &fallback, logger_t &log) n
     return r;
 }
 
+bool is_lan(const boost::asio::ip::address &address) noexcept {
+    if (address.is_loopback()) {
+        return true;
+    }
+    if (address.is_v4()) {
+        auto bytes = address.to_v4().to_bytes();
+        return bytes[0] == 10                                      /* 10.0.0.0/8 */
+               || (bytes[0] == 172 && (bytes[1] & 0xF0) == 16)     /* 172.16.0.0/12 */
+               || (bytes[0] == 192 && bytes[1] == 168)             /* 192.168.0.0/16 */
+               || (bytes[0] == 169 && bytes[1] == 254);            /* 169.254.0.0/16 */
+    }
+    auto v6 = address.to_v6();
+    if (v6.is_v4_mapped()) {
+        return is_lan(boost::asio::ip::make_address_v4(boost::asio::ip::v4_mapped, v6));
+    }
+    auto bytes = v6.to_bytes();
+    return v6.is_link_local() || (bytes[0] & 0xFE) == 0xFC; /* fc00::/7 */
+}
+
 } // namespace syncspirit::utils
@@ -12,4 +12,7 @@ namespace syncspirit::utils {
 using tcp = boost::asio::ip::tcp;
 
 SYNCSPIRIT_API uri_container_t local_interfaces(const tcp::endpoint &fallback, logger_t &log) noexcept;
+
+/* loopback, link-local or private network address */
+SYNCSPIRIT_API bool is_lan(const boost::asio::ip::address &address) noexcept;
 } // namespace syncspirit::utils
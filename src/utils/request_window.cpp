@@ -0,0 +1,101 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "request_window.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace syncspirit::utils;
+
+namespace {
+/* min RTT is forgotten after that, to follow route changes */
+static constexpr auto min_rtt_expiry = std::chrono::seconds(10);
+/* the shortest interval for delivery rate sampling */
+static constexpr auto min_interval = std::chrono::milliseconds(10);
+/* the shortest duration of RTT probing */
+static constexpr auto min_probe = std::chrono::milliseconds(200);
+} // namespace
+
+request_window_t::request_window_t(std::uint32_t initial_window, std::uint32_t max_window_, duration_t min_timeout_,
+                                   duration_t max_timeout_) noexcept
+    : max_window{std::max(max_window_, min_window)}, min_timeout{std::min(min_timeout_, max_timeout_)},
+      max_timeout{max_timeout_}, window{std::clamp(initial_window, min_window, max_window)}, timeout{max_timeout},
+      min_rtt{0}, srtt{0}, rttvar{0}, probing{false}, probe_duration{0}, probe_rtt{0}, avg_size{0}, interval_bytes{0},
+      bw{}, bw_index{0} {}
+
+double request_window_t::get_bandwidth() const noexcept { return *std::max_element(bw.begin(), bw.end()); }
+
+void request_window_t::on_delivered(std::size_t bytes, duration_t rtt, clock_t::time_point now) noexcept {
+    rtt = std::max(rtt, duration_t{1});
+    auto restart = false;
+    if (srtt.count() == 0) {
+        srtt = rtt;
+        rttvar = rtt / 2;
+        avg_size = static_cast<double>(bytes);
+        min_rtt = rtt;
+        min_rtt_stamp = now;
+        restart = true;
+    } else {
+        auto delta = srtt > rtt ? srtt - rtt : rtt - srtt;
+        rttvar = (rttvar * 3 + delta) / 4;
+        srtt = (srtt * 7 + rtt) / 8;
+        avg_size = (avg_size * 7 + static_cast<double>(bytes)) / 8;
+        /* there were no requests in flight, i.e. it was not the link, which
+         * limited the delivery rate; start sampling over */
+        restart = now - last_delivery > srtt * 2;
+    }
+    last_delivery = now;
+
+    if (probing) {
+        probe_rtt = std::min(probe_rtt, rtt);
+        if (now - probe_start >= probe_duration) {
+            probing = false;
+            min_rtt = probe_rtt;
+            min_rtt_stamp = now;
+        }
+    } else if (rtt <= min_rtt) {
+        min_rtt = rtt;
+        min_rtt_stamp = now;
+    } else if (now - min_rtt_stamp > min_rtt_expiry) {
+        /* the window itself causes queueing, so the RTT has to be measured
+         * again with the minimal window, i.e. when the queue is drained */
+        probing = true;
+        probe_start = now;
+        probe_duration = srtt + min_probe;
+        probe_rtt = rtt;
+    }
+
+    if (restart) {
+        interval_start = now;
+        interval_bytes = 0;
+    } else {
+        interval_bytes += bytes;
+        auto elapsed = now - interval_start;
+        if (elapsed >= std::max<clock_t::duration>(min_rtt, min_interval)) {
+            auto seconds = std::chrono::duration<double>(elapsed).count();
+            bw[bw_index] = interval_bytes / seconds;
+            bw_index = (bw_index + 1) % bw_samples;
+            interval_bytes = 0;
+            interval_start = now;
+        }
+    }
+    update();
+}
+
+void request_window_t::update() noexcept {
+    auto rto = std::clamp((srtt + rttvar * 4) * 2, min_timeout, max_timeout);
+    timeout = rto;
+
+    if (probing) {
+        window = min_window;
+        return;
+    }
+    auto bandwidth = get_bandwidth();
+    if (bandwidth <= 0 || avg_size <= 0) {
+        return;
+    }
+    auto bdp = bandwidth * std::chrono::duration<double>(min_rtt).count();
+    auto blocks = std::ceil(gain * bdp / avg_size);
+    auto limit = static_cast<double>(max_window);
+    window = static_cast<std::uint32_t>(std::clamp(blocks, static_cast<double>(min_window), limit));
+}
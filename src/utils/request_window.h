@@ -0,0 +1,74 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include "syncspirit-export.h"
+
+namespace syncspirit::utils {
+
+/* Per-peer estimator of in-flight requests window, somewhat similar to BBR.
+ *
+ * Each delivered response is accounted together with its round-trip time.
+ * The window is the bandwidth-delay product (max recent delivery rate
+ * multiplied by min recent RTT) in units of the average response size,
+ * scaled with the gain to let the rate grow, when the link permits.
+ *
+ * The request timeout is derived from smoothed RTT and its variance
+ * (RFC 6298), and is clamped into [min_timeout, max_timeout].
+ */
+struct SYNCSPIRIT_API request_window_t {
+    using clock_t = std::chrono::steady_clock;
+    using duration_t = std::chrono::microseconds;
+
+    static constexpr double gain = 2.0;
+    static constexpr std::uint32_t min_window = 2;
+
+    request_window_t(std::uint32_t initial_window, std::uint32_t max_window, duration_t min_timeout,
+                     duration_t max_timeout) noexcept;
+
+    void on_delivered(std::size_t bytes, duration_t rtt, clock_t::time_point now = clock_t::now()) noexcept;
+
+    inline std::uint32_t get_window() const noexcept { return window; }
+    inline duration_t get_timeout() const noexcept { return timeout; }
+    inline duration_t get_min_rtt() const noexcept { return min_rtt; }
+    inline duration_t get_srtt() const noexcept { return srtt; }
+    /* bytes per second */
+    double get_bandwidth() const noexcept;
+
+  private:
+    static constexpr std::size_t bw_samples = 10;
+    using bw_samples_t = std::array<double, bw_samples>;
+
+    void update() noexcept;
+
+    std::uint32_t max_window;
+    duration_t min_timeout;
+    duration_t max_timeout;
+
+    std::uint32_t window;
+    duration_t timeout;
+
+    duration_t min_rtt;
+    clock_t::time_point min_rtt_stamp;
+    duration_t srtt;
+    duration_t rttvar;
+
+    bool probing;
+    clock_t::time_point probe_start;
+    duration_t probe_duration;
+    duration_t probe_rtt;
+
+    double avg_size;
+    clock_t::time_point interval_start;
+    clock_t::time_point last_delivery;
+    std::size_t interval_bytes;
+    bw_samples_t bw;
+    std::size_t bw_index;
+};
+
+} // namespace syncspirit::utils
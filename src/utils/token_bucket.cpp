@@ -0,0 +1,71 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "token_bucket.h"
+#include <algorithm>
+#include <cmath>
+
+using namespace syncspirit::utils;
+
+token_bucket_t::token_bucket_t(std::uint64_t rate, token_bucket_t *parent) noexcept
+    : parent{nullptr}, rate{0}, burst{0}, tokens{0} {
+    setup(rate, parent);
+}
+
+void token_bucket_t::setup(std::uint64_t rate_, token_bucket_t *parent_) noexcept {
+    auto lock = std::lock_guard(mutex);
+    auto period = std::chrono::duration<double>(burst_period).count();
+    parent = parent_;
+    rate = rate_;
+    burst = std::max(rate * period, static_cast<double>(min_burst));
+    tokens = std::min(tokens, burst);
+}
+
+std::uint64_t token_bucket_t::get_rate() const noexcept {
+    auto lock = std::lock_guard(mutex);
+    return rate;
+}
+
+void token_bucket_t::refill(clock_t::time_point now) noexcept {
+    if (last == clock_t::time_point{}) {
+        last = now;
+        tokens = burst;
+    }
+    if (now > last) {
+        auto elapsed = std::chrono::duration<double>(now - last).count();
+        tokens = std::min(tokens + elapsed * rate, burst);
+        last = now;
+    }
+}
+
+auto token_bucket_t::get_delay(clock_t::time_point now) noexcept -> duration_t {
+    auto delay = duration_t{0};
+    auto next = (token_bucket_t *)(nullptr);
+    {
+        auto lock = std::lock_guard(mutex);
+        if (rate) {
+            refill(now);
+            if (tokens < 0) {
+                auto seconds = -tokens / rate;
+                delay = duration_t(static_cast<std::int64_t>(std::ceil(seconds * 1000000)));
+            }
+        }
+        next = parent;
+    }
+    return next ? std::max(delay, next->get_delay(now)) : delay;
+}
+
+void token_bucket_t::consume(std::size_t bytes, clock_t::time_point now) noexcept {
+    auto next = (token_bucket_t *)(nullptr);
+    {
+        auto lock = std::lock_guard(mutex);
+        if (rate) {
+            refill(now);
+            tokens -= static_cast<double>(bytes);
+        }
+        next = parent;
+    }
+    if (next) {
+        next->consume(bytes, now);
+    }
+}
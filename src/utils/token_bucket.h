@@ -0,0 +1,56 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include "syncspirit-export.h"
+
+namespace syncspirit::utils {
+
+/* Rate limiter (bytes per second) for the traffic shaping.
+ *
+ * Buckets form a hierarchy, e.g. global -> peer: the traffic is allowed,
+ * when all the buckets up to the root have tokens, and it is charged from
+ * all of them. The tokens might go below zero, i.e. a frame, larger than
+ * the burst, is not split, but the debt delays the following traffic.
+ *
+ * The burst is the amount of tokens, gathered within burst_period, so the
+ * traffic is paced with short delays rather than long stalls.
+ *
+ * Zero rate means no limit. The buckets are thread-safe, as the global ones
+ * are shared by peers of different threads.
+ */
+struct SYNCSPIRIT_API token_bucket_t {
+    using clock_t = std::chrono::steady_clock;
+    using duration_t = std::chrono::microseconds;
+
+    static constexpr auto burst_period = std::chrono::milliseconds(100);
+    static constexpr std::uint64_t min_burst = 16 * 1024;
+
+    token_bucket_t(std::uint64_t rate = 0, token_bucket_t *parent = nullptr) noexcept;
+    token_bucket_t(const token_bucket_t &) = delete;
+
+    void setup(std::uint64_t rate, token_bucket_t *parent) noexcept;
+    std::uint64_t get_rate() const noexcept;
+
+    /* zero, when the traffic can go right now, otherwise the time, when
+     * all the debts in the hierarchy will be paid off */
+    duration_t get_delay(clock_t::time_point now = clock_t::now()) noexcept;
+    void consume(std::size_t bytes, clock_t::time_point now = clock_t::now()) noexcept;
+
+  private:
+    void refill(clock_t::time_point now) noexcept;
+
+    mutable std::mutex mutex;
+    token_bucket_t *parent;
+    std::uint64_t rate;
+    double burst;
+    double tokens;
+    clock_t::time_point last;
+};
+
+} // namespace syncspirit::utils
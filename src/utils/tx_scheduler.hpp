@@ -0,0 +1,91 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#pragma once
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <utility>
+
+namespace syncspirit::utils {
+
+/* Weighted scheduler of outgoing frames over N traffic classes; the lower
+ * class index means the higher priority.
+ *
+ * Each class has a byte budget per round (quantum). A class is served while
+ * its queue is not empty and its budget is positive, the classes are always
+ * checked in priority order. When no class with pending frames has budget
+ * left, a new round starts and the budgets are refilled; overspent bytes
+ * are carried over to the next round (deficit round robin). So latency
+ * sensitive classes go first, while bulk classes still get their share.
+ *
+ * Frames of the same class are kept in FIFO order.
+ */
+template <typename T, std::size_t N> struct tx_scheduler_t {
+    using quanta_t = std::array<std::uint32_t, N>;
+
+    tx_scheduler_t(const quanta_t &quanta_) noexcept : quanta{quanta_} {
+        for (std::size_t i = 0; i < N; ++i) {
+            budgets[i] = quanta[i];
+        }
+    }
+
+    void push(std::size_t tx_class, T item, std::size_t size) noexcept {
+        assert(tx_class < N);
+        queues[tx_class].emplace_back(std::move(item), size);
+        ++count;
+    }
+
+    inline bool empty() const noexcept { return count == 0; }
+    inline std::size_t size() const noexcept { return count; }
+
+    /* the next frame to be sent; the scheduler should not be empty */
+    T &front() noexcept { return queues[select()].front().first; }
+
+    T pop() noexcept {
+        auto tx_class = select();
+        auto &queue = queues[tx_class];
+        auto [item, size] = std::move(queue.front());
+        queue.pop_front();
+        budgets[tx_class] -= static_cast<std::int64_t>(size);
+        --count;
+        return std::move(item);
+    }
+
+    void clear() noexcept {
+        for (auto &queue : queues) {
+            queue.clear();
+        }
+        count = 0;
+    }
+
+  private:
+    using queue_t = std::deque<std::pair<T, std::size_t>>;
+
+    std::size_t select() noexcept {
+        assert(count);
+        while (true) {
+            for (std::size_t i = 0; i < N; ++i) {
+                if (!queues[i].empty() && budgets[i] > 0) {
+                    return i;
+                }
+            }
+            /* unused budget is not accumulated, and zero quantum still
+             * lets the class progress */
+            for (std::size_t i = 0; i < N; ++i) {
+                auto quantum = std::max<std::int64_t>(quanta[i], 1);
+                budgets[i] = std::min(budgets[i] + quantum, quantum);
+            }
+        }
+    }
+
+    quanta_t quanta;
+    std::array<std::int64_t, N> budgets;
+    std::array<queue_t, N> queues;
+    std::size_t count = 0;
+};
+
+} // namespace syncspirit::utils
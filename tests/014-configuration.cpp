@@ -15,7 +15,10 @@ bool operator==(const bep_config_t &lhs, const bep_config_t &rhs) noexcept {
            lhs.connect_timeout == rhs.connect_timeout && lhs.request_timeout == rhs.request_timeout &&
            lhs.tx_timeout == rhs.tx_timeout && lhs.rx_timeout == rhs.rx_timeout &&
            lhs.blocks_max_requested == rhs.blocks_max_requested &&
-           lhs.blocks_simultaneous_write == rhs.blocks_simultaneous_write;
+           lhs.blocks_simultaneous_write == rhs.blocks_simultaneous_write &&
+           lhs.files_max_active == rhs.files_max_active && lhs.tx_control_quantum == rhs.tx_control_quantum &&
+           lhs.tx_index_quantum == rhs.tx_index_quantum && lhs.tx_request_quantum == rhs.tx_request_quantum &&
+           lhs.tx_response_quantum == rhs.tx_response_quantum && lhs.peer_connections == rhs.peer_connections;
 }
 
 bool operator==(const dialer_config_t &lhs, const dialer_config_t &rhs) noexcept {
@@ -23,7 +26,8 @@ bool operator==(const dialer_config_t &lhs, const dialer_config_t &rhs) noexcept
 }
 
 bool operator==(const fs_config_t &lhs, const fs_config_t &rhs) noexcept {
-    return lhs.temporally_timeout == rhs.temporally_timeout && lhs.mru_size == rhs.mru_size;
+    return lhs.temporally_timeout == rhs.temporally_timeout && lhs.mru_size == rhs.mru_size &&
+           lhs.sync_batch_size == rhs.sync_batch_size && lhs.sync_batch_timeout == rhs.sync_batch_timeout;
 }
 
 bool operator==(const db_config_t &lhs, const db_config_t &rhs) noexcept {
@@ -53,12 +57,19 @@ bool operator==(const relay_config_t &lhs, const relay_config_t &rhs) noexcept {
     return lhs.enabled == rhs.enabled && lhs.discovery_url == rhs.discovery_url && lhs.rx_buff_size == rhs.rx_buff_size;
 }
 
+bool operator==(const bandwidth_config_t &lhs, const bandwidth_config_t &rhs) noexcept {
+    return lhs.upload_limit == rhs.upload_limit && lhs.download_limit == rhs.download_limit &&
+           lhs.peer_upload_limit == rhs.peer_upload_limit && lhs.peer_download_limit == rhs.peer_download_limit &&
+           lhs.limit_lan == rhs.limit_lan;
+}
+
 bool operator==(const main_t &lhs, const main_t &rhs) noexcept {
     return lhs.local_announce_config == rhs.local_announce_config && lhs.upnp_config == rhs.upnp_config &&
            lhs.global_announce_config == rhs.global_announce_config && lhs.bep_config == rhs.bep_config &&
            lhs.db_config == rhs.db_config && lhs.timeout == rhs.timeout && lhs.device_name == rhs.device_name &&
            lhs.config_path == rhs.config_path && lhs.log_configs == rhs.log_configs &&
-           lhs.hasher_threads == rhs.hasher_threads;
+           lhs.hasher_threads == rhs.hasher_threads && lhs.net_threads == rhs.net_threads &&
+           lhs.bandwidth_config == rhs.bandwidth_config;
 }
 
 } // namespace syncspirit::config
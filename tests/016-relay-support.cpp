@@ -273,8 +273,29 @@ TEST_CASE("endpoing parsing", "[relay]") {
     CHECK(l.country == "DE");
     CHECK(l.continent == "EU");
     CHECK(relay->ping_interval == pt::seconds{90});
+    CHECK(relay->session_limit == 0);
 
     auto device = parse_device(relay->uri);
     REQUIRE(device);
     CHECK(device.value() == relay->device_id);
+
+    SECTION("session limit") {
+        auto limited = std::string(body);
+        auto pos = limited.find("sessionLimitBps=0");
+        REQUIRE(pos != std::string::npos);
+        limited.replace(pos, 17, "sessionLimitBps=524288");
+        auto r = parse_endpoint(limited);
+        REQUIRE(r);
+        REQUIRE(r.value().size() == 1);
+        CHECK(r.value()[0]->session_limit == 524288);
+        CHECK(parse_session_limit(r.value()[0]->uri) == 524288);
+    }
+
+    SECTION("session limit of the peer relay uri") {
+        using syncspirit::utils::parse;
+        CHECK(parse_session_limit(parse("relay://1.2.3.4:22067/?sessionLimitBps=1024&globalLimitBps=0").value()) ==
+              1024);
+        CHECK(parse_session_limit(parse("relay://1.2.3.4:22067/?sessionLimitBps=x").value()) == 0);
+        CHECK(parse_session_limit(parse("relay://1.2.3.4:22067/").value()) == 0);
+    }
 }
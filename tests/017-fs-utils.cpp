@@ -3,6 +3,7 @@
 
 #include "test-utils.h"
 #include "fs/utils.h"
+#include "fs/dir_cache.h"
 
 using namespace syncspirit::fs;
 
@@ -32,3 +33,87 @@ TEST_CASE("get_block_size", "[fs]") {
         CHECK(get_block_size(1 * gb, 256 * kb) == D{4096, 256 * kb});
     };
 }
+
+TEST_CASE("dir_cache", "[fs]") {
+    namespace st = syncspirit::test;
+    auto root_path = bfs::unique_path();
+    auto path_guard = st::path_guard_t(root_path);
+    bfs::create_directory(root_path);
+
+    auto dirs = dir_cache_ptr_t(new dir_cache_t(root_path, 2));
+
+    SECTION("create directories & files relative to cached handles") {
+        auto dir = root_path / "a" / "b" / "c";
+        REQUIRE(dirs->create_directories(dir));
+        CHECK(bfs::is_directory(dir));
+        CHECK(dirs->opened_handles() <= 2);
+
+        auto file_opt = dirs->open(dir / "x.txt", dir_cache_t::open_mode_t::write);
+        REQUIRE(file_opt);
+        auto file = file_opt.value();
+        CHECK(fwrite("12345", 1, 5, file) == 5);
+        CHECK(fclose(file) == 0);
+        CHECK(st::read_file(dir / "x.txt") == "12345");
+
+        REQUIRE(dirs->rename(dir / "x.txt", dir / "y.txt"));
+        CHECK(!bfs::exists(dir / "x.txt"));
+        CHECK(st::read_file(dir / "y.txt") == "12345");
+
+        REQUIRE(dirs->set_modified(dir / "y.txt", 1641828421));
+        CHECK(bfs::last_write_time(dir / "y.txt") == 1641828421);
+        CHECK(dirs->sync(dir));
+    }
+
+    SECTION("directory removed behind the cache") {
+        auto dir = root_path / "a" / "b";
+        REQUIRE(dirs->create_directories(dir));
+        bfs::remove_all(root_path / "a");
+
+        auto file_opt = dirs->open(dir / "x.txt", dir_cache_t::open_mode_t::write);
+        REQUIRE(file_opt);
+        CHECK(fclose(file_opt.value()) == 0);
+        CHECK(bfs::exists(dir / "x.txt"));
+    }
+
+    SECTION("only the missing subtree is dropped") {
+        dirs = new dir_cache_t(root_path, 10);
+        REQUIRE(dirs->create_directories(root_path / "a" / "b"));
+        REQUIRE(dirs->create_directories(root_path / "c" / "d"));
+        CHECK(dirs->opened_handles() == 3);
+        bfs::remove_all(root_path / "a");
+
+        auto file_opt = dirs->open(root_path / "a" / "b" / "x.txt", dir_cache_t::open_mode_t::write);
+        REQUIRE(file_opt);
+        CHECK(fclose(file_opt.value()) == 0);
+        CHECK(bfs::exists(root_path / "a" / "b" / "x.txt"));
+        CHECK(dirs->opened_handles() == 4);
+    }
+
+    SECTION("renamed directory is not served from cache") {
+        dirs = new dir_cache_t(root_path, 10);
+        auto dir = root_path / "a" / "b";
+        REQUIRE(dirs->create_directories(dir));
+        auto file_opt = dirs->open(dir / "x.txt", dir_cache_t::open_mode_t::write);
+        REQUIRE(file_opt);
+        CHECK(fclose(file_opt.value()) == 0);
+
+        REQUIRE(dirs->rename(root_path / "a", root_path / "z"));
+        CHECK(bfs::exists(root_path / "z" / "b" / "x.txt"));
+
+        REQUIRE(dirs->create_directories(dir));
+        file_opt = dirs->open(dir / "y.txt", dir_cache_t::open_mode_t::write);
+        REQUIRE(file_opt);
+        CHECK(fclose(file_opt.value()) == 0);
+        CHECK(bfs::exists(dir / "y.txt"));
+        CHECK(!bfs::exists(root_path / "z" / "b" / "y.txt"));
+    }
+
+    SECTION("forget") {
+        auto dir = root_path / "a" / "b";
+        REQUIRE(dirs->create_directories(dir));
+        bfs::remove_all(root_path / "a");
+        dirs->forget(root_path / "a");
+        REQUIRE(dirs->create_directories(dir));
+        CHECK(bfs::is_directory(dir));
+    }
+}
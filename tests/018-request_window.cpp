@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "utils/request_window.h"
+#include <deque>
+
+using namespace syncspirit::utils;
+using namespace std::chrono_literals;
+
+using duration_t = request_window_t::duration_t;
+
+/* simulates the link with the fixed bandwidth and propagation delay, keeping
+ * the window full */
+static std::uint32_t simulate(request_window_t &w, double bandwidth, double delay, int responses) {
+    auto start = request_window_t::clock_t::now();
+    auto block_sz = std::size_t{128 * 1024};
+    auto in_flight = std::deque<double>();
+    auto now = 0.0;
+    auto last = 0.0;
+    for (int i = 0; i < responses; ++i) {
+        while (in_flight.size() < w.get_window()) {
+            in_flight.push_back(now);
+        }
+        auto sent = in_flight.front();
+        in_flight.pop_front();
+        now = last = std::max(sent + delay, last + block_sz / bandwidth);
+        auto rtt = std::chrono::duration_cast<duration_t>(std::chrono::duration<double>(now - sent));
+        auto stamp = start + std::chrono::duration_cast<duration_t>(std::chrono::duration<double>(now));
+        w.on_delivered(block_sz, rtt, stamp);
+    }
+    return w.get_window();
+}
+
+TEST_CASE("request window", "[support]") {
+    SECTION("initial values") {
+        auto w = request_window_t(8, 100, 5s, 60s);
+        CHECK(w.get_window() == 8);
+        CHECK(w.get_timeout() == 60s);
+        CHECK(w.get_bandwidth() == 0);
+    }
+
+    SECTION("window grows on long fat link") {
+        /* 10MB/s, 200ms: BDP is ~15 blocks */
+        auto w = request_window_t(8, 1000, 5s, 60s);
+        auto window = simulate(w, 10e6, 0.2, 5000);
+        CHECK(window >= 15);
+        CHECK(window <= 40);
+        CHECK(w.get_bandwidth() > 9.9e6);
+        CHECK(w.get_bandwidth() < 10.1e6);
+        CHECK(w.get_min_rtt() >= 200ms);
+        CHECK(w.get_min_rtt() < 250ms);
+    }
+
+    SECTION("window shrinks on fast local link") {
+        auto w = request_window_t(16, 1000, 5s, 60s);
+        auto window = simulate(w, 100e6, 0.001, 5000);
+        CHECK(window < 16);
+        CHECK(window >= request_window_t::min_window);
+    }
+
+    SECTION("window is limited") {
+        auto w = request_window_t(8, 20, 5s, 60s);
+        CHECK(simulate(w, 100e6, 0.2, 5000) == 20);
+    }
+
+    SECTION("timeout follows rtt") {
+        auto w = request_window_t(8, 100, 1s, 60s);
+        auto now = request_window_t::clock_t::now();
+        for (int i = 0; i < 20; ++i) {
+            w.on_delivered(1024, 1000ms, now + i * 100ms);
+        }
+        CHECK(w.get_timeout() > 1s);
+        CHECK(w.get_timeout() < 5s);
+
+        auto w2 = request_window_t(8, 100, 5s, 60s);
+        w2.on_delivered(1024, 10ms, now);
+        CHECK(w2.get_timeout() == 5s);
+    }
+}
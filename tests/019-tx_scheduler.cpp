@@ -0,0 +1,68 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "utils/tx_scheduler.hpp"
+#include <string>
+
+using namespace syncspirit::utils;
+
+using scheduler_t = tx_scheduler_t<std::string, 3>;
+
+TEST_CASE("tx scheduler", "[utils]") {
+    auto scheduler = scheduler_t({100, 200, 1000});
+    CHECK(scheduler.empty());
+
+    SECTION("priority and fifo") {
+        scheduler.push(2, "bulk-1", 10);
+        scheduler.push(2, "bulk-2", 10);
+        scheduler.push(1, "index", 10);
+        scheduler.push(0, "ping", 10);
+        CHECK(scheduler.size() == 4);
+        CHECK(scheduler.front() == "ping");
+        CHECK(scheduler.pop() == "ping");
+        CHECK(scheduler.pop() == "index");
+        CHECK(scheduler.pop() == "bulk-1");
+        CHECK(scheduler.pop() == "bulk-2");
+        CHECK(scheduler.empty());
+    }
+
+    SECTION("weighted share") {
+        for (int i = 0; i < 100; ++i) {
+            scheduler.push(1, "index", 100);
+            scheduler.push(2, "bulk", 100);
+        }
+        auto index = 0;
+        auto bulk = 0;
+        for (int i = 0; i < 60; ++i) {
+            (scheduler.pop() == "index" ? index : bulk) += 1;
+        }
+        /* 200 vs 1000 bytes per round */
+        CHECK(index == 10);
+        CHECK(bulk == 50);
+
+        scheduler.push(0, "ping", 10);
+        CHECK(scheduler.pop() == "ping");
+    }
+
+    SECTION("overspent budget is carried over") {
+        scheduler.push(0, "huge", 1000);
+        scheduler.push(0, "next", 10);
+        scheduler.push(2, "bulk-1", 500);
+        scheduler.push(2, "bulk-2", 500);
+        scheduler.push(2, "bulk-3", 500);
+        CHECK(scheduler.pop() == "huge");
+        CHECK(scheduler.pop() == "bulk-1");
+        CHECK(scheduler.pop() == "bulk-2");
+        /* 1000 bytes of debt take ~10 rounds of 100 bytes */
+        CHECK(scheduler.pop() == "bulk-3");
+        CHECK(scheduler.pop() == "next");
+    }
+
+    SECTION("clear") {
+        scheduler.push(1, "a", 1);
+        scheduler.push(2, "b", 1);
+        scheduler.clear();
+        CHECK(scheduler.empty());
+    }
+}
@@ -0,0 +1,83 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "transport/session_cache.h"
+
+using namespace syncspirit;
+using namespace syncspirit::transport;
+
+static SSL_SESSION *make_session(std::string_view id) {
+    auto session = SSL_SESSION_new();
+    SSL_SESSION_set1_id(session, reinterpret_cast<const unsigned char *>(id.data()), id.size());
+    return session;
+}
+
+TEST_CASE("tls session cache", "[transport]") {
+    auto peer_1 = model::device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD");
+    auto peer_2 = model::device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ");
+    auto peer_3 = model::device_id_t::from_string("EAMTZPW-Q4QYERN-D57DHFS-AUP2OMG-PAHOR3R-ZWLKGAA-WQC5SVW-UJ5NXQA");
+    REQUIRE(peer_1);
+    REQUIRE(peer_2);
+    REQUIRE(peer_3);
+
+    auto cache = session_cache_t(std::chrono::seconds{60}, 2);
+    auto now = session_cache_t::clock_t::now();
+
+    SECTION("hit & miss") {
+        CHECK(!cache.get(*peer_1, now));
+        auto session = make_session("s1");
+        cache.put(*peer_1, session, now);
+        auto s = cache.get(*peer_1, now + std::chrono::seconds{10});
+        REQUIRE(s);
+        CHECK(s == session);
+        SSL_SESSION_free(s);
+
+        auto stats = cache.get_stats();
+        CHECK(stats.hits == 1);
+        CHECK(stats.misses == 1);
+        CHECK(stats.expired == 0);
+
+        cache.remove(*peer_1);
+        CHECK(!cache.get(*peer_1, now));
+        CHECK(cache.size() == 0);
+    }
+
+    SECTION("newer session replaces the older one") {
+        cache.put(*peer_1, make_session("s1"), now);
+        auto session = make_session("s2");
+        cache.put(*peer_1, session, now);
+        CHECK(cache.size() == 1);
+        auto s = cache.get(*peer_1, now);
+        CHECK(s == session);
+        SSL_SESSION_free(s);
+    }
+
+    SECTION("expiration") {
+        cache.put(*peer_1, make_session("s1"), now);
+        CHECK(!cache.get(*peer_1, now + std::chrono::seconds{61}));
+        CHECK(cache.size() == 0);
+        auto stats = cache.get_stats();
+        CHECK(stats.expired == 1);
+        CHECK(stats.misses == 1);
+    }
+
+    SECTION("non-resumable session is dropped") {
+        cache.put(*peer_1, SSL_SESSION_new(), now);
+        CHECK(!cache.get(*peer_1, now));
+        CHECK(cache.size() == 0);
+    }
+
+    SECTION("the oldest session is evicted") {
+        cache.put(*peer_1, make_session("s1"), now);
+        cache.put(*peer_2, make_session("s2"), now + std::chrono::seconds{1});
+        cache.put(*peer_3, make_session("s3"), now + std::chrono::seconds{2});
+        CHECK(cache.size() == 2);
+        CHECK(!cache.get(*peer_1, now));
+        for (auto &peer : {*peer_2, *peer_3}) {
+            auto s = cache.get(peer, now);
+            CHECK(s);
+            SSL_SESSION_free(s);
+        }
+    }
+}
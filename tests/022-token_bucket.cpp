@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "utils/bandwidth_shaper.h"
+#include "utils/network_interface.h"
+
+using namespace syncspirit::utils;
+using namespace std::chrono_literals;
+
+TEST_CASE("token bucket", "[utils]") {
+    auto now = token_bucket_t::clock_t::now();
+
+    SECTION("unlimited") {
+        auto bucket = token_bucket_t();
+        bucket.consume(1000000000, now);
+        CHECK(bucket.get_delay(now).count() == 0);
+    }
+
+    SECTION("debt is paid off with the rate") {
+        auto bucket = token_bucket_t(1000000);
+        CHECK(bucket.get_delay(now).count() == 0);
+        /* the burst is 100ms worth of tokens */
+        bucket.consume(100000, now);
+        CHECK(bucket.get_delay(now).count() == 0);
+        bucket.consume(50000, now);
+        CHECK(bucket.get_delay(now) == 50ms);
+        CHECK(bucket.get_delay(now + 20ms) == 30ms);
+        CHECK(bucket.get_delay(now + 50ms).count() == 0);
+
+        /* unused tokens are not accumulated beyond the burst */
+        CHECK(bucket.get_delay(now + 10s).count() == 0);
+        bucket.consume(150000, now + 10s);
+        CHECK(bucket.get_delay(now + 10s) == 50ms);
+    }
+
+    SECTION("hierarchy") {
+        auto global = token_bucket_t(1000000);
+        auto peer_1 = token_bucket_t(2000000, &global);
+        auto peer_2 = token_bucket_t(0, &global);
+        peer_1.consume(150000, now);
+        CHECK(peer_1.get_delay(now) == 50ms);
+        CHECK(peer_2.get_delay(now) == 50ms);
+
+        global.setup(0, nullptr);
+        CHECK(peer_1.get_delay(now).count() == 0);
+        CHECK(peer_2.get_delay(now).count() == 0);
+    }
+}
+
+TEST_CASE("bandwidth shaper", "[utils]") {
+    using direction_t = bandwidth_shaper_t::direction_t;
+    auto &shaper = bandwidth_shaper_t::instance();
+    auto now = token_bucket_t::clock_t::now();
+    shaper.configure({0, 0, 0, 0, false});
+
+    auto wan_tx = shaper.make_bucket(direction_t::upload, false);
+    auto lan_tx = shaper.make_bucket(direction_t::upload, true);
+    auto wan_rx = shaper.make_bucket(direction_t::download, false);
+    CHECK(wan_tx->get_rate() == 0);
+
+    shaper.configure({1000, 2000, 100, 0, false});
+    CHECK(wan_tx->get_rate() == 100 * 1024);
+    CHECK(lan_tx->get_rate() == 0);
+    CHECK(wan_rx->get_rate() == 0);
+
+    wan_rx->consume(1000000, now);
+    CHECK(wan_rx->get_delay(now).count() > 0);
+    CHECK(lan_tx->get_delay(now).count() == 0);
+
+    shaper.configure({1000, 2000, 100, 0, true});
+    CHECK(lan_tx->get_rate() == 100 * 1024);
+
+    SECTION("relay session limit") {
+        auto relayed_tx = shaper.make_bucket(direction_t::upload, false, 50 * 1024);
+        auto relayed_rx = shaper.make_bucket(direction_t::download, false, 50 * 1024);
+        CHECK(relayed_tx->get_rate() == 50 * 1024);
+        CHECK(relayed_rx->get_rate() == 50 * 1024);
+
+        shaper.configure({1000, 2000, 10, 0, false});
+        CHECK(relayed_tx->get_rate() == 10 * 1024);
+        CHECK(relayed_rx->get_rate() == 50 * 1024);
+
+        shaper.configure({0, 0, 0, 0, false});
+        CHECK(relayed_tx->get_rate() == 50 * 1024);
+    }
+    shaper.configure({0, 0, 0, 0, false});
+}
+
+TEST_CASE("lan addresses", "[utils]") {
+    auto make = [](const char *str) { return boost::asio::ip::make_address(str); };
+    CHECK(is_lan(make("127.0.0.1")));
+    CHECK(is_lan(make("10.1.2.3")));
+    CHECK(is_lan(make("172.20.0.1")));
+    CHECK(is_lan(make("192.168.1.1")));
+    CHECK(is_lan(make("169.254.3.4")));
+    CHECK(is_lan(make("::1")));
+    CHECK(is_lan(make("fe80::1")));
+    CHECK(is_lan(make("fd00::1")));
+    CHECK(is_lan(make("::ffff:192.168.1.1")));
+    CHECK(!is_lan(make("172.32.0.1")));
+    CHECK(!is_lan(make("8.8.8.8")));
+    CHECK(!is_lan(make("2001:db8::1")));
+}
@@ -9,6 +9,7 @@
 #include "model/diff/modify/lock_file.h"
 #include "model/diff/modify/file_availability.h"
 #include "model/diff/modify/update_contact.h"
+#include "model/diff/peer/peer_connection.h"
 #include "model/diff/peer/peer_state.h"
 #include "model/diff/cluster_visitor.h"
 
@@ -40,6 +41,42 @@ TEST_CASE("peer state update", "[model]") {
     CHECK(peer_device->get_state() == model::device_state_t::offline);
 }
 
+TEST_CASE("peer connections", "[model]") {
+    auto my_id = device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
+    auto my_device = device_t::create(my_id, "my-device").value();
+    auto peer_id = device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ").value();
+
+    auto peer_device = device_t::create(peer_id, "peer-device").value();
+    auto cluster = cluster_ptr_t(new cluster_t(my_device, 1, 1));
+    cluster->get_devices().put(my_device);
+    cluster->get_devices().put(peer_device);
+
+    rotor::address_ptr_t addr;
+    auto sha256 = peer_id.get_sha256();
+    auto diff = diff::cluster_diff_ptr_t(new diff::peer::peer_connection_t(*cluster, sha256, addr, true));
+    REQUIRE(diff->apply(*cluster));
+    CHECK(peer_device->get_extra_connections() == 0);
+
+    diff = new diff::peer::peer_state_t(*cluster, sha256, addr, device_state_t::online);
+    REQUIRE(diff->apply(*cluster));
+    diff = new diff::peer::peer_connection_t(*cluster, sha256, addr, true);
+    REQUIRE(diff->apply(*cluster));
+    REQUIRE(diff->apply(*cluster));
+    CHECK(peer_device->get_extra_connections() == 2);
+
+    diff = new diff::peer::peer_connection_t(*cluster, sha256, addr, false);
+    REQUIRE(diff->apply(*cluster));
+    CHECK(peer_device->get_extra_connections() == 1);
+
+    diff = new diff::peer::peer_state_t(*cluster, sha256, addr, device_state_t::offline);
+    REQUIRE(diff->apply(*cluster));
+    CHECK(peer_device->get_extra_connections() == 0);
+
+    diff = new diff::peer::peer_connection_t(*cluster, sha256, addr, false);
+    REQUIRE(diff->apply(*cluster));
+    CHECK(peer_device->get_extra_connections() == 0);
+}
+
 TEST_CASE("with file", "[model]") {
     auto my_id = device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
     auto my_device = device_t::create(my_id, "my-device").value();
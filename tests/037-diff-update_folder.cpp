@@ -92,6 +92,57 @@ TEST_CASE("update folder (via Index)", "[model]") {
         }
     }
 
+    SECTION("chunked index") {
+        auto peer_folder_info = folder->get_folder_infos().by_device(*peer_device);
+        for (int i = 0; i < 5; ++i) {
+            auto file = pr_index.add_files();
+            file->set_name("file-" + std::to_string(i));
+            file->set_sequence(i + 1);
+            file->set_size(5ul);
+            file->set_block_size(5ul);
+            auto b = file->add_blocks();
+            b->set_hash(i % 2 ? "123" : "456");
+            b->set_size(5ul);
+        }
+
+        auto chunks = diff::peer::update_folder_t::prepare(pr_index, 5).value();
+        REQUIRE(chunks.size() == 3);
+        CHECK(chunks[0].size() == 2);
+        CHECK(chunks[1].size() == 2);
+        CHECK(chunks[2].size() == 1);
+        CHECK(diff::peer::update_folder_t::prepare(pr_index, 0).value().size() == 1);
+
+        auto &peer_files = peer_folder_info->get_file_infos();
+        peer_folder_info->set_max_sequence(5);
+        for (auto &files : chunks) {
+            auto opt = diff::peer::update_folder_t::create(*cluster, *peer_device, pr_index.folder(), files, {});
+            REQUIRE(opt);
+            REQUIRE(opt.value()->apply(*cluster));
+            if (&files == &chunks.front()) {
+                CHECK(peer_folder_info->get_received_sequence() == 2);
+                CHECK(peer_folder_info->get_max_sequence() == 5);
+                CHECK(!peer_folder_info->is_actual());
+            }
+        }
+        CHECK(peer_files.size() == 5);
+        CHECK(cluster->get_blocks().size() == 2);
+        CHECK(peer_folder_info->get_received_sequence() == 5);
+        CHECK(peer_folder_info->is_actual());
+    }
+
+    SECTION("index files are chunked in sequence order") {
+        for (int i = 0; i < 3; ++i) {
+            auto file = pr_index.add_files();
+            file->set_name("file-" + std::to_string(i));
+            file->set_sequence(3 - i);
+        }
+        auto chunks = diff::peer::update_folder_t::prepare(pr_index, 2).value();
+        REQUIRE(chunks.size() == 2);
+        CHECK(chunks[0][0]->sequence() == 1);
+        CHECK(chunks[0][1]->sequence() == 2);
+        CHECK(chunks[1][0]->sequence() == 3);
+    }
+
     SECTION("folder does not exists") {
         pr_index.set_folder(db_folder_1.id() + "xxx");
         auto opt = diff::peer::update_folder_t::create(*cluster, *peer_device, pr_index);
@@ -424,3 +424,82 @@ TEST_CASE("file iterator for 2 folders", "[model]") {
     CHECK(files.count("my-label-1/a.txt"));
     CHECK(files.count("my-label-2/b.txt"));
 }
+
+TEST_CASE("file iterator pull order", "[model]") {
+    auto my_id = device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
+    auto my_device = device_t::create(my_id, "my-device").value();
+    auto peer_id = device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ").value();
+    auto peer_device = device_t::create(peer_id, "peer-device").value();
+
+    auto b = proto::BlockInfo();
+    b.set_hash(utils::sha256_digest("12345").value());
+    b.set_weak_hash(555);
+    b.set_size(5ul);
+
+    auto get_names = [&](db::PullOrder order) -> std::vector<std::string> {
+        auto cluster = cluster_ptr_t(new cluster_t(my_device, 1, 1));
+        cluster->get_devices().put(my_device);
+        cluster->get_devices().put(peer_device);
+        cluster->get_blocks().put(block_info_t::create(b).value());
+
+        db::Folder db_folder;
+        db_folder.set_id("1234-5678");
+        db_folder.set_label("my-label");
+        db_folder.set_path("/my/path");
+        db_folder.set_pull_order(order);
+
+        auto diffs = diff::aggregate_t::diffs_t{};
+        diffs.push_back(new diff::modify::create_folder_t(db_folder));
+        diffs.push_back(new diff::modify::share_folder_t(peer_id.get_sha256(), db_folder.id()));
+        auto diff = diff::cluster_diff_ptr_t(new diff::aggregate_t(std::move(diffs)));
+        REQUIRE(diff->apply(*cluster));
+
+        auto cc = std::make_unique<proto::ClusterConfig>();
+        auto p_folder = cc->add_folders();
+        p_folder->set_id(db_folder.id());
+        p_folder->set_label(db_folder.label());
+        auto p_peer = p_folder->add_devices();
+        p_peer->set_id(std::string(peer_id.get_sha256()));
+        p_peer->set_name(std::string(peer_device->get_name()));
+        p_peer->set_max_sequence(12u);
+        p_peer->set_index_id(123u);
+
+        diff = diff::peer::cluster_update_t::create(*cluster, *peer_device, *cc).value();
+        REQUIRE(diff->apply(*cluster));
+
+        proto::Index idx;
+        idx.set_folder(db_folder.id());
+        auto add_file = [&](std::string_view name, std::int64_t size, std::int64_t modified, std::int64_t sequence) {
+            auto file = idx.add_files();
+            file->set_name(std::string(name));
+            file->set_sequence(sequence);
+            file->set_size(size);
+            file->set_block_size(5ul);
+            file->set_modified_s(modified);
+            for (std::int64_t i = 0; i < size / 5; ++i) {
+                *file->add_blocks() = b;
+            }
+        };
+        add_file("c.txt", 15, 200, 10);
+        add_file("a.txt", 10, 300, 11);
+        add_file("b.txt", 5, 100, 12);
+
+        diff = diff::peer::update_folder_t::create(*cluster, *peer_device, idx).value();
+        REQUIRE(diff->apply(*cluster));
+
+        auto names = std::vector<std::string>();
+        auto file_iterator = file_iterator_ptr_t(new file_iterator_t(*cluster, peer_device));
+        while (auto f = file_iterator->next()) {
+            names.emplace_back(f->get_name());
+        }
+        return names;
+    };
+
+    using names_t = std::vector<std::string>;
+    CHECK(get_names(db::PullOrder::alphabetic) == names_t{"a.txt", "b.txt", "c.txt"});
+    CHECK(get_names(db::PullOrder::smallest) == names_t{"b.txt", "a.txt", "c.txt"});
+    CHECK(get_names(db::PullOrder::largest) == names_t{"c.txt", "a.txt", "b.txt"});
+    CHECK(get_names(db::PullOrder::oldest) == names_t{"b.txt", "c.txt", "a.txt"});
+    CHECK(get_names(db::PullOrder::newest) == names_t{"a.txt", "c.txt", "b.txt"});
+    CHECK(get_names(db::PullOrder::random).size() == 3);
+}
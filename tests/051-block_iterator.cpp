@@ -150,7 +150,7 @@ TEST_CASE("block iterator", "[model]") {
         CHECK(fb1.file() == my_file.get());
     }
 
-    SECTION("locked/unlock blocks") {
+    SECTION("locked blocks are not skipped") {
         p_file.set_size(5ul);
         p_file.set_block_size(5ul);
 
@@ -166,9 +166,13 @@ TEST_CASE("block iterator", "[model]") {
         REQUIRE(fb);
         auto block = fb.block();
 
+        /* the block is being fetched/written for some other file; it is still
+         * iterated, deduplication of fetches is up to the swarm */
         block->lock();
-        REQUIRE(!next(my_file, true));
-
+        auto fb_locked = next(my_file, true);
+        REQUIRE(fb_locked);
+        CHECK(fb_locked.block_index() == 0);
+        CHECK(fb_locked.block() == block);
         block->unlock();
         REQUIRE(next(my_file, true));
     }
@@ -0,0 +1,224 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "model/cluster.h"
+#include "model/misc/swarm.h"
+#include "diff-builder.h"
+
+using namespace syncspirit;
+using namespace syncspirit::test;
+using namespace syncspirit::model;
+
+TEST_CASE("swarm", "[model]") {
+    auto my_id = device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
+    auto my_device = device_t::create(my_id, "my-device").value();
+    auto peer_1_id =
+        device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ").value();
+    auto peer_1 = device_t::create(peer_1_id, "peer-1").value();
+    auto peer_2_id =
+        device_id_t::from_string("EAMTZPW-Q4QYERN-D57DHFS-AUP2OMG-PAHOR3R-ZWLKGAA-WQC5SVW-UJ5NXQA").value();
+    auto peer_2 = device_t::create(peer_2_id, "peer-2").value();
+
+    auto cluster = cluster_ptr_t(new cluster_t(my_device, 1, 1));
+    cluster->get_devices().put(my_device);
+    cluster->get_devices().put(peer_1);
+    cluster->get_devices().put(peer_2);
+
+    auto folder_id = "1234-5678";
+    auto builder = diff_builder_t(*cluster);
+    REQUIRE(builder.create_folder(folder_id, "some/path")
+                .share_folder(peer_1_id.get_sha256(), folder_id)
+                .share_folder(peer_2_id.get_sha256(), folder_id)
+                .apply());
+    REQUIRE(builder.configure_cluster(peer_1_id.get_sha256())
+                .add(peer_1_id.get_sha256(), folder_id, 123, 10)
+                .finish()
+                .configure_cluster(peer_2_id.get_sha256())
+                .add(peer_2_id.get_sha256(), folder_id, 124, 10)
+                .finish()
+                .apply());
+
+    auto folder = cluster->get_folders().by_id(folder_id);
+    auto &folder_infos = folder->get_folder_infos();
+
+    auto pr_file = proto::FileInfo();
+    pr_file.set_name("a.bin");
+    pr_file.set_type(proto::FileInfoType::FILE);
+    pr_file.set_sequence(10);
+    pr_file.set_block_size(5);
+    pr_file.set_size(15);
+    auto counter = pr_file.mutable_version()->add_counters();
+    counter->set_id(1);
+    counter->set_value(1);
+
+    auto blocks = std::vector<block_info_ptr_t>();
+    for (auto data : {"11111", "22222", "33333"}) {
+        auto b = pr_file.add_blocks();
+        b->set_hash(utils::sha256_digest(data).value());
+        b->set_offset(static_cast<std::int64_t>(blocks.size() * 5));
+        b->set_size(5);
+        auto bi = block_info_t::create(*b).value();
+        cluster->get_blocks().put(bi);
+        blocks.push_back(bi);
+    }
+
+    auto make_file = [&](device_t &device) -> file_info_ptr_t {
+        auto folder_info = folder_infos.by_device(device);
+        auto file = file_info_t::create(cluster->next_uuid(), pr_file, folder_info).value();
+        for (size_t i = 0; i < blocks.size(); ++i) {
+            file->assign_block(blocks[i], i);
+        }
+        folder_info->add(file, true);
+        return file;
+    };
+    auto file_1 = make_file(*peer_1);
+    auto file_2 = make_file(*peer_2);
+
+    auto &swarm = cluster->get_swarm();
+    auto wakeups = 0;
+    file_1->lock();
+    swarm.add(*file_1, [&]() { ++wakeups; });
+
+    CHECK(swarm.is_pulled(*file_1));
+    CHECK(swarm.is_pulled(*file_2));
+    CHECK(!swarm.is_busy(*file_1));
+    CHECK(!swarm.next_block(*peer_1));
+
+    SECTION("helper takes blocks from the tail") {
+        auto a2 = swarm.next_block(*peer_2);
+        REQUIRE(a2);
+        CHECK(a2.peer_file == file_2);
+        CHECK(a2.block.file() == file_1.get());
+        CHECK(a2.block.block_index() == 2);
+        CHECK(swarm.is_busy(*file_1));
+
+        auto a1 = swarm.next_block(*peer_2);
+        REQUIRE(a1);
+        CHECK(a1.block.block_index() == 1);
+
+        swarm.start_fetch(*peer_1, *blocks[0]);
+        CHECK(!swarm.next_block(*peer_2));
+        swarm.finish_fetch(*peer_1, *blocks[0]);
+
+        CHECK(swarm.release(*peer_2, a2.block, false));
+        CHECK(wakeups == 0);
+        CHECK(swarm.release(*peer_2, a1.block, false));
+        CHECK(wakeups == 1);
+        CHECK(!swarm.is_busy(*file_1));
+    }
+
+    SECTION("failed block is returned to the owner") {
+        auto a = swarm.next_block(*peer_2);
+        REQUIRE(a);
+        CHECK(swarm.release(*peer_2, a.block, true));
+        CHECK(wakeups == 1);
+        CHECK(swarm.is_busy(*file_1));
+        CHECK(!swarm.next_block(*peer_2));
+
+        auto b = swarm.take_returned(*file_1);
+        REQUIRE(b);
+        CHECK(b.block_index() == 2);
+        CHECK(!swarm.take_returned(*file_1));
+        CHECK(!swarm.is_busy(*file_1));
+    }
+
+    SECTION("forgotten peer returns its blocks") {
+        auto a = swarm.next_block(*peer_2);
+        REQUIRE(a);
+        swarm.forget(*peer_2);
+        CHECK(wakeups == 1);
+        CHECK(!swarm.release(*peer_2, a.block, false));
+        auto b = swarm.take_returned(*file_1);
+        REQUIRE(b);
+        CHECK(b.block_index() == 2);
+    }
+
+    SECTION("no help for non-locked or different files") {
+        SECTION("non-locked") { file_1->unlock(); }
+        SECTION("different version") {
+            counter->set_value(2);
+            folder_infos.by_device(*peer_2)->get_file_infos().remove(file_2);
+            make_file(*peer_2);
+        }
+        CHECK(!swarm.next_block(*peer_2));
+    }
+
+    SECTION("blocks from temporary index") {
+        folder_infos.by_device(*peer_2)->get_file_infos().remove(file_2);
+        CHECK(!swarm.next_block(*peer_2));
+
+        auto update = proto::FileDownloadProgressUpdate();
+        update.set_name("a.bin");
+        *update.mutable_version() = pr_file.version();
+        update.add_block_indexes(1);
+        update.add_block_indexes(7);
+        swarm.apply_progress(*peer_2, folder_id, update);
+
+        auto a = swarm.next_block(*peer_2);
+        REQUIRE(a);
+        CHECK(a.peer_file == file_1);
+        CHECK(a.block.block_index() == 1);
+        swarm.start_fetch(*peer_1, *blocks[1]);
+        CHECK(!swarm.next_block(*peer_2));
+        swarm.finish_fetch(*peer_1, *blocks[1]);
+        CHECK(swarm.release(*peer_2, a.block, false));
+
+        SECTION("forget") {
+            update.set_update_type(proto::FileDownloadProgressUpdateType::FORGET);
+            swarm.apply_progress(*peer_2, folder_id, update);
+        }
+        SECTION("other version") {
+            update.mutable_version()->mutable_counters(0)->set_value(5);
+            swarm.apply_progress(*peer_2, folder_id, update);
+        }
+        SECTION("forgotten peer") { swarm.forget(*peer_2); }
+        CHECK(!swarm.next_block(*peer_2));
+    }
+
+    SECTION("blocks in flight") {
+        auto wakeups_2 = 0;
+        swarm.add(*file_2, [&]() { ++wakeups_2; });
+        swarm.start_fetch(*peer_1, *blocks[2]);
+        CHECK(swarm.is_fetching(*blocks[2]));
+        CHECK(!swarm.is_fetching(*blocks[1]));
+
+        auto a = swarm.next_block(*peer_2);
+        REQUIRE(a);
+        CHECK(a.block.block_index() == 1);
+        CHECK(swarm.release(*peer_2, a.block, true));
+        CHECK(wakeups == 1);
+
+        swarm.wait_fetch(*blocks[2], *file_2);
+        swarm.wait_fetch(*blocks[2], *file_2);
+        SECTION("finished") {
+            swarm.finish_fetch(*peer_2, *blocks[2]);
+            CHECK(swarm.is_fetching(*blocks[2]));
+            CHECK(wakeups_2 == 0);
+
+            swarm.finish_fetch(*peer_1, *blocks[2]);
+        }
+        SECTION("fetching peer is gone") { swarm.forget(*peer_1); }
+        CHECK(!swarm.is_fetching(*blocks[2]));
+        CHECK(wakeups_2 == 1);
+
+        auto b = swarm.take_returned(*file_1);
+        REQUIRE(b);
+        CHECK(b.block_index() == 1);
+        swarm.remove(*file_2);
+    }
+
+    SECTION("quota") {
+        auto now = swarm_t::clock_t::now();
+        swarm.on_received(*peer_1, 0, now);
+        swarm.on_received(*peer_1, 4000, now + std::chrono::seconds(1));
+        swarm.on_received(*peer_2, 0, now);
+        swarm.on_received(*peer_2, 1000, now + std::chrono::seconds(1));
+        CHECK(swarm.get_quota(*peer_1, 16) == 16);
+        CHECK(swarm.get_quota(*peer_2, 16) == 4);
+        CHECK(swarm.get_quota(*my_device, 16) == 16);
+    }
+
+    swarm.remove(*file_1);
+    CHECK(!swarm.is_pulled(*file_2));
+}
@@ -0,0 +1,103 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "test_supervisor.h"
+#include "model/cluster.h"
+#include "model/misc/diff_router.h"
+#include "model/diff/modify/create_folder.h"
+#include "model/diff/modify/local_update.h"
+#include "model/diff/modify/lock_file.h"
+#include "model/diff/modify/share_folder.h"
+#include "diff-builder.h"
+
+namespace st = syncspirit::test;
+
+using namespace syncspirit;
+using namespace syncspirit::test;
+using namespace syncspirit::model;
+
+TEST_CASE("diff router", "[model]") {
+    auto my_id = device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
+    auto my_device = device_t::create(my_id, "my-device").value();
+    auto peer_1_id =
+        device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ").value();
+    auto peer_1 = device_t::create(peer_1_id, "peer-1").value();
+    auto peer_2_id =
+        device_id_t::from_string("EAMTZPW-Q4QYERN-D57DHFS-AUP2OMG-PAHOR3R-ZWLKGAA-WQC5SVW-UJ5NXQA").value();
+    auto peer_2 = device_t::create(peer_2_id, "peer-2").value();
+
+    auto cluster = cluster_ptr_t(new cluster_t(my_device, 1, 1));
+    cluster->get_devices().put(my_device);
+    cluster->get_devices().put(peer_1);
+    cluster->get_devices().put(peer_2);
+
+    auto folder_id = "1234-5678";
+    auto builder = diff_builder_t(*cluster);
+    REQUIRE(builder.create_folder(folder_id, "some/path").share_folder(peer_1_id.get_sha256(), folder_id).apply());
+
+    r::system_context_t ctx;
+    auto sup = ctx.create_supervisor<st::supervisor_t>().timeout(r::pt::milliseconds{10}).finish();
+    sup->start();
+    sup->do_process();
+    auto addr_1 = sup->make_address();
+    auto addr_2 = sup->make_address();
+    int owner_1, owner_2;
+
+    using router_t = diff_router_t;
+    auto router = router_t();
+    auto kinds = router_t::all_kinds & ~static_cast<std::uint32_t>(router_t::lock_file);
+    router.add(addr_1, &owner_1, peer_1_id.get_sha256(), kinds);
+    router.add(addr_2, &owner_2, peer_2_id.get_sha256(), kinds);
+
+    SECTION("folder diff goes to the peers, which share the folder") {
+        auto pr_file = proto::FileInfo();
+        pr_file.set_name("a.txt");
+        auto diff = diff::cluster_diff_ptr_t(new diff::modify::local_update_t(*cluster, folder_id, pr_file));
+        auto addresses = router.route(*cluster, *diff, nullptr);
+        REQUIRE(addresses.size() == 1);
+        CHECK(addresses[0] == addr_1);
+
+        SECTION("own diff goes to the originator") {
+            addresses = router.route(*cluster, *diff, &owner_2);
+            REQUIRE(addresses.size() == 2);
+            CHECK(addresses[0] == addr_2);
+            CHECK(addresses[1] == addr_1);
+        }
+
+        SECTION("unsubscribed") {
+            router.remove(addr_1);
+            CHECK(router.route(*cluster, *diff, &owner_1).empty());
+        }
+    }
+
+    SECTION("peer diff goes to the peer only") {
+        auto diff = diff::cluster_diff_ptr_t(new diff::modify::share_folder_t(peer_2_id.get_sha256(), folder_id));
+        auto addresses = router.route(*cluster, *diff, nullptr);
+        REQUIRE(addresses.size() == 1);
+        CHECK(addresses[0] == addr_2);
+    }
+
+    SECTION("global diff goes to everyone") {
+        db::Folder db_folder;
+        db_folder.set_id("5555-4444");
+        auto diff = diff::cluster_diff_ptr_t(new diff::modify::create_folder_t(db_folder));
+        CHECK(router.route(*cluster, *diff, nullptr).size() == 2);
+    }
+
+    SECTION("not interesting kinds are filtered") {
+        auto pr_file = proto::FileInfo();
+        pr_file.set_name("a.txt");
+        pr_file.set_sequence(1);
+        REQUIRE(builder.local_update(folder_id, pr_file).apply());
+        auto folder = cluster->get_folders().by_id(folder_id);
+        auto folder_info = folder->get_folder_infos().by_device(*my_device);
+        auto file = folder_info->get_file_infos().by_name("a.txt");
+        auto diff = diff::cluster_diff_ptr_t(new diff::modify::lock_file_t(*file, true));
+        CHECK(router.route(*cluster, *diff, nullptr).empty());
+        CHECK(router.route(*cluster, *diff, &owner_1).size() == 1);
+    }
+
+    sup->shutdown();
+    sup->do_process();
+}
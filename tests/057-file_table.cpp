@@ -0,0 +1,112 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "model/cluster.h"
+#include "model/misc/file_table.h"
+#include "model/diff/modify/append_block.h"
+#include "diff-builder.h"
+
+using namespace syncspirit;
+using namespace syncspirit::test;
+using namespace syncspirit::model;
+
+TEST_CASE("file table", "[model]") {
+    auto my_id = device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
+    auto my_device = device_t::create(my_id, "my-device").value();
+    auto peer_id = device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ").value();
+    auto peer_device = device_t::create(peer_id, "peer-device").value();
+
+    auto cluster = cluster_ptr_t(new cluster_t(my_device, 1, 1));
+    cluster->get_devices().put(my_device);
+    cluster->get_devices().put(peer_device);
+
+    auto folder_id = "1234-5678";
+    auto builder = diff_builder_t(*cluster);
+    REQUIRE(builder.create_folder(folder_id, "some/path").share_folder(peer_id.get_sha256(), folder_id).apply());
+    auto folder = cluster->get_folders().by_id(folder_id);
+    auto folder_my = folder->get_folder_infos().by_device(*my_device);
+    auto folder_peer = folder->get_folder_infos().by_device(*peer_device);
+    auto &table = cluster->get_file_table();
+
+    auto pr_file = proto::FileInfo();
+    pr_file.set_name("a.txt");
+    pr_file.set_sequence(1);
+
+    SECTION("added file gets a handle") {
+        REQUIRE(builder.local_update(folder_id, pr_file).apply());
+        auto file = folder_my->get_file_infos().by_name("a.txt");
+        auto handle = file->get_handle();
+        REQUIRE(handle);
+        CHECK(table.get(handle) == file.get());
+        CHECK(table.size() == 1);
+
+        SECTION("newer version takes over the handle") {
+            pr_file.set_modified_s(1);
+            REQUIRE(builder.local_update(folder_id, pr_file).apply());
+            auto new_file = folder_my->get_file_infos().by_name("a.txt");
+            REQUIRE(new_file != file);
+            CHECK(new_file->get_handle() == handle);
+            CHECK(table.get(handle) == new_file.get());
+            CHECK(table.size() == 1);
+
+            auto diff = diff::modify::append_block_t(*new_file, 0, "12345", [](auto &) {});
+            CHECK(diff.handle == handle);
+            CHECK(diff.get_file(*cluster) == new_file.get());
+        }
+    }
+
+    SECTION("handles are released with the folder info") {
+        folder_peer->set_max_sequence(1);
+        REQUIRE(builder.make_index(peer_id.get_sha256(), folder_id).add(pr_file).finish().apply());
+        auto file = folder_peer->get_file_infos().by_name("a.txt");
+        auto handle = file->get_handle();
+        REQUIRE(table.get(handle) == file.get());
+        auto diff = diff::modify::append_block_t(*file, 0, "12345", [](auto &) {});
+
+        REQUIRE(builder.unshare_folder(peer_id.get_sha256(), folder_id).apply());
+        CHECK(!table.get(handle));
+        CHECK(!file->get_handle());
+        CHECK(table.size() == 0);
+        CHECK(!diff.get_file(*cluster));
+
+        SECTION("released slot is reused with the next generation") {
+            REQUIRE(builder.local_update(folder_id, pr_file).apply());
+            auto my_file = folder_my->get_file_infos().by_name("a.txt");
+            auto my_handle = my_file->get_handle();
+            CHECK(my_handle.index == handle.index);
+            CHECK(my_handle.generation == handle.generation + 1);
+            CHECK(!table.get(handle));
+
+            /* the diff of the gone file does not resolve to the file in the reused slot */
+            CHECK(!diff.get_file(*cluster));
+            auto my_diff = diff::modify::append_block_t(*my_file, 0, "12345", [](auto &) {});
+            CHECK(my_diff.get_file(*cluster) == my_file.get());
+
+            SECTION("handle of other file with the same index and generation") {
+                auto forged = diff::modify::append_block_t(*my_file, 0, "12345", [](auto &) {});
+                forged.device_id = peer_id.get_sha256();
+                CHECK(!table.get(my_handle, forged.folder_id, forged.device_id, forged.file_name));
+                CHECK(!forged.get_file(*cluster));
+            }
+        }
+    }
+
+    SECTION("mismatching handle falls back to the name lookup") {
+        REQUIRE(builder.local_update(folder_id, pr_file).apply());
+        auto pr_file_b = pr_file;
+        pr_file_b.set_name("b.txt");
+        pr_file_b.set_sequence(2);
+        REQUIRE(builder.local_update(folder_id, pr_file_b).apply());
+        auto file_a = folder_my->get_file_infos().by_name("a.txt");
+        auto file_b = folder_my->get_file_infos().by_name("b.txt");
+        REQUIRE(file_a->get_handle());
+        REQUIRE(file_b->get_handle());
+        CHECK(!(file_a->get_handle() == file_b->get_handle()));
+
+        auto diff = diff::modify::append_block_t(*file_a, 0, "12345", [](auto &) {});
+        diff.handle = file_b->get_handle();
+        CHECK(!table.get(diff.handle, diff.folder_id, diff.device_id, diff.file_name));
+        CHECK(diff.get_file(*cluster) == file_a.get());
+    }
+}
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: GPL-3.0-or-later
+// SPDX-FileCopyrightText: 2024 Ivan Baidakou
+
+#include "test-utils.h"
+#include "model/cluster.h"
+#include "model/misc/devices_view.h"
+#include "model/diff/modify/dial_result.h"
+#include "model/diff/modify/update_contact.h"
+#include "model/diff/modify/update_peer.h"
+#include "model/diff/peer/peer_connection.h"
+#include "model/diff/peer/peer_state.h"
+
+using namespace syncspirit;
+using namespace syncspirit::test;
+using namespace syncspirit::model;
+
+TEST_CASE("devices view", "[model]") {
+    auto my_id = device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
+    auto my_device = device_t::create(my_id, "my-device").value();
+    auto peer_1_id =
+        device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ").value();
+    auto peer_1 = device_t::create(peer_1_id, "peer-1").value();
+    auto peer_2_id =
+        device_id_t::from_string("EAMTZPW-Q4QYERN-D57DHFS-AUP2OMG-PAHOR3R-ZWLKGAA-WQC5SVW-UJ5NXQA").value();
+
+    auto cluster = cluster_ptr_t(new cluster_t(my_device, 1, 1));
+    cluster->get_devices().put(my_device);
+    cluster->get_devices().put(peer_1);
+
+    auto view = devices_view_t();
+    view.update(*cluster);
+    CHECK(view.get_self() == my_id);
+    CHECK(view.is_known(my_id.get_sha256()));
+    CHECK(view.is_known(peer_1_id.get_sha256()));
+    CHECK(!view.is_known(peer_2_id.get_sha256()));
+
+    auto apply = [&](auto diff) {
+        REQUIRE(diff->apply(*cluster));
+        view.update(*cluster, *diff);
+    };
+
+    SECTION("peer state & connections") {
+        auto sha256 = peer_1_id.get_sha256();
+        auto online = device_state_t::online;
+        apply(diff::cluster_diff_ptr_t(new diff::peer::peer_state_t(view, sha256, nullptr, online)));
+        CHECK(view.get(sha256)->state == online);
+        CHECK(view.get(sha256)->extra_connections == 0);
+
+        apply(diff::cluster_diff_ptr_t(new diff::peer::peer_connection_t(view, sha256, nullptr, true)));
+        CHECK(view.get(sha256)->extra_connections == 1);
+
+        apply(diff::cluster_diff_ptr_t(new diff::peer::peer_state_t(view, sha256, nullptr, device_state_t::offline)));
+        CHECK(view.get(sha256)->state == device_state_t::offline);
+        CHECK(view.get(sha256)->extra_connections == 0);
+
+        auto diff = diff::peer::peer_state_t(view, peer_2_id.get_sha256(), nullptr, online);
+        CHECK(!diff.known);
+    }
+
+    SECTION("contacts & dial history") {
+        auto uri = utils::parse("tcp://127.0.0.1:1234").value();
+        apply(diff::contact_diff_ptr_t(new diff::modify::update_contact_t(*cluster, peer_1_id, {uri})));
+        auto peer = view.get(peer_1_id.get_sha256());
+        REQUIRE(peer->uris.size() == 1);
+        CHECK(peer->uris[0] == uri);
+
+        apply(diff::contact_diff_ptr_t(new diff::modify::dial_result_t(view, peer_1_id, uri, true)));
+        peer = view.get(peer_1_id.get_sha256());
+        REQUIRE(peer->dial_history.count(uri.full));
+        CHECK(peer->dial_history.at(uri.full).successes == 1);
+    }
+
+    SECTION("new peer") {
+        auto db_device = db::Device();
+        db_device.set_name("peer-2");
+        apply(diff::cluster_diff_ptr_t(new diff::modify::update_peer_t(db_device, peer_2_id.get_sha256())));
+        REQUIRE(view.is_known(peer_2_id.get_sha256()));
+        CHECK(view.get(peer_2_id.get_sha256())->device_id == peer_2_id);
+    }
+}
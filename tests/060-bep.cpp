@@ -6,6 +6,8 @@
 #include "model/device_id.h"
 #include "utils/error_code.h"
 #include "utils/uri.h"
+#include <boost/endian/conversion.hpp>
+#include <random>
 
 using namespace syncspirit;
 using namespace syncspirit::test;
@@ -150,3 +152,288 @@ TEST_CASE("cluster config", "[bep]") {
         CHECK(msg2->folders(0).devices(0).id() == msg->folders(0).devices(0).id());
     }
 }
+
+TEST_CASE("compression", "[bep]") {
+    CHECK(make_compression(proto::Compression::METADATA, true) == proto::MessageCompression::LZ4);
+    CHECK(make_compression(proto::Compression::METADATA, false) == proto::MessageCompression::NONE);
+    CHECK(make_compression(proto::Compression::ALWAYS, false) == proto::MessageCompression::LZ4);
+    CHECK(make_compression(proto::Compression::NEVER, true) == proto::MessageCompression::NONE);
+
+    auto get_compression = [](const fmt::memory_buffer &buff) {
+        proto::Header header;
+        REQUIRE(header.ParseFromArray(buff.data() + 2, buff.data()[1]));
+        return header.compression();
+    };
+
+    SECTION("index") {
+        proto::Index index;
+        index.set_folder("1234-5678");
+        for (int i = 0; i < 100; ++i) {
+            auto file = index.add_files();
+            file->set_name(fmt::format("some/deep/directory/file-{}.txt", i));
+            file->set_size(1024);
+            file->set_sequence(i + 1);
+        }
+
+        fmt::memory_buffer plain;
+        serialize(plain, index);
+        fmt::memory_buffer compressed;
+        serialize(compressed, index, proto::MessageCompression::LZ4);
+        CHECK(get_compression(plain) == proto::MessageCompression::NONE);
+        CHECK(get_compression(compressed) == proto::MessageCompression::LZ4);
+        CHECK(compressed.size() * 4 < plain.size());
+
+        /* two messages in a row */
+        auto sz = compressed.size();
+        compressed.append(plain.data(), plain.data() + plain.size());
+        auto r = parse_bep(asio::buffer(compressed.data(), compressed.size()));
+        REQUIRE(r);
+        CHECK(r.value().consumed == sz);
+        auto &msg = std::get<proto::message::Index>(r.value().message);
+        REQUIRE(msg->files_size() == 100);
+        CHECK(msg->files(99).name() == "some/deep/directory/file-99.txt");
+    }
+
+    SECTION("small message is sent as is") {
+        proto::Ping ping;
+        fmt::memory_buffer buff;
+        serialize(buff, ping, proto::MessageCompression::LZ4);
+        CHECK(get_compression(buff) == proto::MessageCompression::NONE);
+    }
+
+    SECTION("response") {
+        proto::Response res;
+        res.set_id(5);
+        auto data = std::string(128 * 1024, 'x');
+        SECTION("compressible data") {
+            fmt::memory_buffer buff;
+            res.set_data(data);
+            serialize(buff, res, proto::MessageCompression::LZ4);
+            CHECK(get_compression(buff) == proto::MessageCompression::LZ4);
+            auto r = parse_bep(asio::buffer(buff.data(), buff.size()));
+            REQUIRE(r);
+            CHECK(std::get<proto::message::Response>(r.value().message)->data() == data);
+        }
+        SECTION("random data") {
+            auto state = std::uint32_t{12345};
+            for (auto &c : data) {
+                state = state * 1664525u + 1013904223u;
+                c = static_cast<char>(state >> 24);
+            }
+            fmt::memory_buffer buff;
+            res.set_data(data);
+            serialize(buff, res, proto::MessageCompression::LZ4);
+            CHECK(get_compression(buff) == proto::MessageCompression::NONE);
+        }
+        SECTION("oversized message, then a regular one") {
+            auto big_data = std::string(4 * 1024 * 1024, 'y');
+            fmt::memory_buffer big;
+            res.set_data(big_data);
+            serialize(big, res, proto::MessageCompression::LZ4);
+            CHECK(get_compression(big) == proto::MessageCompression::LZ4);
+            auto r = parse_bep(asio::buffer(big.data(), big.size()));
+            REQUIRE(r);
+            CHECK(std::get<proto::message::Response>(r.value().message)->data() == big_data);
+
+            fmt::memory_buffer buff;
+            res.set_data(data);
+            serialize(buff, res, proto::MessageCompression::LZ4);
+            r = parse_bep(asio::buffer(buff.data(), buff.size()));
+            REQUIRE(r);
+            CHECK(std::get<proto::message::Response>(r.value().message)->data() == data);
+        }
+    }
+}
+
+TEST_CASE("frame size", "[bep]") {
+    fmt::memory_buffer hello;
+    make_hello_message(hello, "test-device");
+    CHECK(get_frame_size(asio::buffer(hello.data(), 5)) == 0);
+    CHECK(get_frame_size(asio::buffer(hello.data(), 6)) == hello.size());
+
+    proto::Index index;
+    index.set_folder("1234-5678");
+    index.add_files()->set_name("a.txt");
+    fmt::memory_buffer buff;
+    serialize(buff, index);
+
+    auto header_sz = static_cast<std::size_t>(buff.data()[1]);
+    CHECK(get_frame_size(asio::buffer(buff.data(), 1)) == 0);
+    CHECK(get_frame_size(asio::buffer(buff.data(), 2 + header_sz + 3)) == 0);
+    for (auto sz = 2 + header_sz + 4; sz <= buff.size(); ++sz) {
+        CHECK(get_frame_size(asio::buffer(buff.data(), sz)) == buff.size());
+    }
+
+    for (std::size_t sz = 0; sz < buff.size(); ++sz) {
+        auto r = parse_bep(asio::buffer(buff.data(), sz));
+        REQUIRE(r);
+        CHECK(r.value().consumed == 0);
+    }
+}
+
+TEST_CASE("arena pool", "[bep]") {
+    proto::Index index;
+    index.set_folder("1234-5678");
+    for (int i = 0; i < 100; ++i) {
+        auto file = index.add_files();
+        file->set_name(fmt::format("file-{}.txt", i));
+        file->add_blocks()->set_hash(std::string(32, static_cast<char>(i)));
+    }
+    fmt::memory_buffer buff;
+    serialize(buff, index);
+
+    auto pool = std::make_shared<arena_pool_t>(1024 * 1024);
+    auto parse = [&]() -> proto::message::Index {
+        auto r = parse_bep(asio::buffer(buff.data(), buff.size()), pool.get());
+        REQUIRE(r);
+        CHECK(r.value().consumed == buff.size());
+        return std::get<proto::message::Index>(std::move(r.value().message));
+    };
+
+    auto msg = parse();
+    REQUIRE(msg->files_size() == 100);
+    CHECK(msg->GetArena());
+    CHECK(pool->free_blocks() == 0);
+    msg.reset();
+    CHECK(pool->free_blocks() == 1);
+
+    SECTION("memory is reused") {
+        auto msg_1 = parse();
+        auto msg_2 = parse();
+        CHECK(pool->free_blocks() == 0);
+        CHECK(msg_1->files(99).name() == "file-99.txt");
+        CHECK(msg_2->files(99).blocks(0).hash() == std::string(32, static_cast<char>(99)));
+        msg_1.reset();
+        msg_2.reset();
+        CHECK(pool->free_blocks() == 2);
+    }
+
+    SECTION("message outlives the pool") {
+        auto msg = parse();
+        pool.reset();
+        CHECK(msg->files(0).name() == "file-0.txt");
+    }
+}
+
+TEST_CASE("request & response codec", "[bep]") {
+    auto rng = std::mt19937(1234);
+    auto random_string = [&](size_t max_sz, bool text = false) {
+        auto sz = std::uniform_int_distribution<size_t>(0, max_sz)(rng);
+        auto r = std::string(sz, '\0');
+        for (auto &c : r) {
+            c = static_cast<char>(text ? 'a' + rng() % 26 : rng());
+        }
+        return r;
+    };
+    auto random_int = [&]() -> std::int32_t { return rng() % 3 ? static_cast<std::int32_t>(rng()) : 0; };
+
+    SECTION("serialization is identical to protobuf") {
+        for (int i = 0; i < 200; ++i) {
+            auto folder = random_string(20, true), name = random_string(300, true), hash = random_string(32);
+            auto req = request_view_t{random_int(), folder, name, static_cast<std::int64_t>(rng()) * random_int(),
+                                      random_int(), hash, rng() % 2 == 0, static_cast<std::uint32_t>(random_int())};
+            fmt::memory_buffer buff_1, buff_2;
+            serialize_request(buff_1, req);
+
+            auto pb_req = proto::Request();
+            pb_req.set_id(req.id);
+            pb_req.set_folder(folder);
+            pb_req.set_name(name);
+            pb_req.set_offset(req.offset);
+            pb_req.set_size(req.size);
+            pb_req.set_hash(hash);
+            pb_req.set_from_temporary(req.from_temporary);
+            pb_req.set_weak_hash(req.weak_hash);
+            serialize(buff_2, pb_req);
+            REQUIRE(std::string_view(buff_1.data(), buff_1.size()) == std::string_view(buff_2.data(), buff_2.size()));
+
+            auto data = random_string(1000);
+            auto res = response_view_t{random_int(), data, static_cast<proto::ErrorCode>(rng() % 4)};
+            buff_1.clear();
+            buff_2.clear();
+            serialize_response(buff_1, res);
+
+            auto pb_res = proto::Response();
+            pb_res.set_id(res.id);
+            pb_res.set_data(data);
+            pb_res.set_code(res.code);
+            serialize(buff_2, pb_res);
+            REQUIRE(std::string_view(buff_1.data(), buff_1.size()) == std::string_view(buff_2.data(), buff_2.size()));
+            if (res.code == proto::ErrorCode::NO_BEP_ERROR) {
+                fmt::memory_buffer head;
+                serialize_response_head(head, res);
+                CHECK(std::string(head.data(), head.size()) + data == std::string(buff_1.data(), buff_1.size()));
+            }
+
+            auto buff = asio::buffer(buff_1.data(), buff_1.size());
+            REQUIRE(is_plain_response(buff));
+            auto r = parse_response(buff);
+            REQUIRE(r);
+            CHECK(r.value().consumed == buff_1.size());
+            auto &parsed = r.value().response;
+            CHECK(parsed.id == res.id);
+            CHECK(parsed.data == res.data);
+            CHECK(parsed.code == res.code);
+
+            auto incomplete = parse_response(asio::buffer(buff_1.data(), buff_1.size() - 1));
+            REQUIRE(incomplete);
+            CHECK(incomplete.value().consumed == 0);
+        }
+    }
+
+    SECTION("other messages are not taken") {
+        fmt::memory_buffer buff;
+        serialize(buff, proto::Request());
+        CHECK(!is_plain_response(asio::buffer(buff.data(), buff.size())));
+
+        auto data = std::string(1000, 'a');
+        auto res = response_view_t{5, data};
+        serialize_response(buff, res, proto::MessageCompression::LZ4);
+        CHECK(!is_plain_response(asio::buffer(buff.data(), buff.size())));
+        CHECK(!is_plain_response(asio::buffer(buff.data(), 1)));
+    }
+
+    SECTION("malformed responses are rejected as protobuf does") {
+        for (int i = 0; i < 2000; ++i) {
+            auto data = random_string(64);
+            fmt::memory_buffer buff;
+            serialize_response(buff, response_view_t{random_int(), data, proto::ErrorCode::GENERIC});
+
+            /* mutate the message body only, keeping the frame prefix valid */
+            auto prefix_sz = std::size_t{2 + 2 + 4};
+            auto body = std::string(buff.data() + prefix_sz, buff.size() - prefix_sz);
+            auto mutations = std::uniform_int_distribution<int>(1, 4)(rng);
+            for (int j = 0; j < mutations && !body.empty(); ++j) {
+                auto pos = rng() % body.size();
+                switch (rng() % 3) {
+                case 0:
+                    body[pos] = static_cast<char>(rng());
+                    break;
+                case 1:
+                    body.resize(pos);
+                    break;
+                default:
+                    body.insert(pos, 1, static_cast<char>(rng()));
+                }
+            }
+            std::uint32_t body_sz = boost::endian::native_to_big(static_cast<std::uint32_t>(body.size()));
+            auto frame = std::string(buff.data(), 4);
+            frame.append(reinterpret_cast<const char *>(&body_sz), sizeof(body_sz));
+            frame += body;
+
+            auto r = parse_response(asio::buffer(frame.data(), frame.size()));
+            auto pb_res = proto::Response();
+            auto pb_ok = pb_res.ParseFromArray(body.data(), static_cast<int>(body.size()));
+            if (r) {
+                CHECK(pb_ok);
+                auto &parsed = r.value().response;
+                CHECK(r.value().consumed == frame.size());
+                CHECK(parsed.id == pb_res.id());
+                CHECK(parsed.data == pb_res.data());
+                CHECK(parsed.code == pb_res.code());
+            } else {
+                CHECK(r.error() == make_error_code(bep_error_code_t::protobuf_err));
+            }
+        }
+    }
+}
@@ -65,7 +65,12 @@ struct fixture_t {
         CHECK(static_cast<r::actor_base_t *>(sup.get())->access<to::state>() == r::state_t::OPERATIONAL);
 
         auto sha256 = peer_device->device_id().get_sha256();
-        file_actor = sup->create_actor<fs::file_actor_t>().mru_size(2).cluster(cluster).timeout(timeout).finish();
+        file_actor = sup->create_actor<fs::file_actor_t>()
+                         .mru_size(2)
+                         .sync_batch_size(sync_batch_size)
+                         .cluster(cluster)
+                         .timeout(timeout)
+                         .finish();
         sup->do_process();
         CHECK(static_cast<r::actor_base_t *>(file_actor.get())->access<to::state>() == r::state_t::OPERATIONAL);
         file_addr = file_actor->get_address();
@@ -109,6 +114,7 @@ struct fixture_t {
     msg_ptr_t reply;
     blk_res_ptr_t block_reply;
     std::string_view folder_id = "1234-5678";
+    size_t sync_batch_size = 0;
 };
 } // namespace
 
@@ -331,7 +337,9 @@ void test_append_block() {
                     bfs::remove_all(root_path);
                     diff_builder_t(*cluster).finish_file(*peer_file->local_file()).apply(*sup);
                     CHECK(static_cast<r::actor_base_t *>(file_actor.get())->access<to::state>() ==
-                          r::state_t::SHUT_DOWN);
+                          r::state_t::OPERATIONAL);
+                    CHECK(peer_file->is_unreachable());
+                    CHECK(!folder_my->get_file_infos().by_name(peer_file->get_name())->is_locally_available());
                 }
 #endif
             }
@@ -521,6 +529,102 @@ void test_clone_block() {
     F().run();
 }
 
+void test_sync_batch() {
+    struct F : fixture_t {
+        F() noexcept { sync_batch_size = 2; }
+
+        void main() noexcept override {
+            auto bi = proto::BlockInfo();
+            bi.set_size(5);
+            bi.set_weak_hash(12);
+            bi.set_hash(utils::sha256_digest("12345").value());
+            bi.set_offset(0);
+            auto b = block_info_t::create(bi).value();
+            cluster->get_blocks().put(b);
+
+            std::int64_t modified = 1641828421;
+            proto::FileInfo pr_fi;
+            pr_fi.set_block_size(5ul);
+            pr_fi.set_size(5ul);
+            pr_fi.set_modified_s(modified);
+            auto version = pr_fi.mutable_version();
+            auto counter = version->add_counters();
+            counter->set_id(1);
+            counter->set_value(peer_device->as_uint());
+
+            auto make_file = [&](std::string_view name) {
+                pr_fi.set_name(std::string(name));
+                auto file = file_info_t::create(cluster->next_uuid(), pr_fi, folder_peer).value();
+                file->assign_block(b, 0);
+                folder_peer->add(file, false);
+                return file;
+            };
+
+            auto builder = diff_builder_t(*cluster);
+            auto callback = [&](diff::modify::block_transaction_t &diff) {
+                REQUIRE(diff.errors.load() == 0);
+                builder.ack_block(diff);
+            };
+
+            auto file_a = make_file("a.txt");
+            auto file_b = make_file("b.txt");
+            builder.clone_file(*file_a)
+                .clone_file(*file_b)
+                .apply(*sup)
+                .append_block(*file_a, 0, "12345", callback)
+                .append_block(*file_b, 0, "12345", callback)
+                .apply(*sup);
+
+            auto path_a = root_path / "a.txt";
+            auto path_b = root_path / "b.txt";
+
+            builder.finish_file(*file_a->local_file()).apply(*sup);
+            CHECK(!bfs::exists(path_a));
+            CHECK(bfs::exists(fs::make_temporal(path_a)));
+            CHECK(!folder_my->get_file_infos().by_name("a.txt")->is_locally_available());
+
+            SECTION("batch is full") {
+                builder.finish_file(*file_b->local_file()).apply(*sup);
+                CHECK(sup->timers.empty());
+            }
+
+            SECTION("failed file does not abandon the batch") {
+                bfs::remove(fs::make_temporal(path_a));
+                builder.finish_file(*file_b->local_file()).apply(*sup);
+                CHECK(static_cast<r::actor_base_t *>(file_actor.get())->access<to::state>() ==
+                      r::state_t::OPERATIONAL);
+                CHECK(file_a->is_unreachable());
+                CHECK(!folder_my->get_file_infos().by_name("a.txt")->is_locally_available());
+                CHECK(!file_b->is_unreachable());
+                CHECK(read_file(path_b) == "12345");
+                CHECK(folder_my->get_file_infos().by_name("b.txt")->is_locally_available());
+                return;
+            }
+
+            SECTION("batch timeout") {
+                REQUIRE(sup->timers.size() == 1);
+                sup->do_invoke_timer(sup->timers.front()->request_id);
+                sup->do_process();
+                CHECK(!bfs::exists(path_b));
+                builder.finish_file(*file_b->local_file()).apply(*sup);
+                REQUIRE(sup->timers.size() == 1);
+                sup->do_invoke_timer(sup->timers.front()->request_id);
+                sup->do_process();
+            }
+
+            for (auto &path : {path_a, path_b}) {
+                REQUIRE(bfs::exists(path));
+                CHECK(!bfs::exists(fs::make_temporal(path)));
+                CHECK(read_file(path) == "12345");
+                CHECK(bfs::last_write_time(path) == 1641828421);
+            }
+            CHECK(folder_my->get_file_infos().by_name("a.txt")->is_locally_available());
+            CHECK(folder_my->get_file_infos().by_name("b.txt")->is_locally_available());
+        }
+    };
+    F().run();
+}
+
 void test_requesting_block() {
     struct F : fixture_t {
         void main() noexcept override {
@@ -609,6 +713,37 @@ void test_requesting_block() {
                 REQUIRE(!block_reply->payload.ec);
                 REQUIRE(block_reply->payload.data == "67890");
             }
+
+            SECTION("temporal file of the file being downloaded is kept opened") {
+                auto peer_file = file_info_t::create(cluster->next_uuid(), pr_source, folder_peer).value();
+                peer_file->assign_block(b, 0);
+                peer_file->assign_block(b2, 1);
+                folder_peer->add(peer_file, false);
+                file->set_source(peer_file);
+                peer_file->lock();
+
+                auto target_tmp = fs::make_temporal(target);
+                write_file(target_tmp, "1234567890");
+                sup->put(msg);
+                sup->do_process();
+                REQUIRE(block_reply);
+                REQUIRE(!block_reply->payload.ec);
+                REQUIRE(block_reply->payload.data == "12345");
+
+                /* the cached handle is used, the file is not re-opened */
+                bfs::remove(target_tmp);
+                block_reply.reset();
+                req.set_offset(5);
+                auto req_ptr = proto::message::Request(new proto::Request(req));
+                auto msg = r::make_message<fs::payload::block_request_t>(file_actor->get_address(), std::move(req_ptr),
+                                                                         sup->get_address());
+                sup->put(msg);
+                sup->do_process();
+                REQUIRE(block_reply);
+                REQUIRE(!block_reply->payload.ec);
+                REQUIRE(block_reply->payload.data == "67890");
+                peer_file->unlock();
+            }
         }
     };
     F().run();
@@ -618,6 +753,7 @@ int _init() {
     REGISTER_TEST_CASE(test_clone_file, "test_clone_file", "[fs]");
     REGISTER_TEST_CASE(test_append_block, "test_append_block", "[fs]");
     REGISTER_TEST_CASE(test_clone_block, "test_clone_block", "[fs]");
+    REGISTER_TEST_CASE(test_sync_batch, "test_sync_batch", "[fs]");
     REGISTER_TEST_CASE(test_requesting_block, "test_requesting_block", "[fs]");
     return 1;
 }
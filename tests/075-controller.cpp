@@ -6,6 +6,10 @@
 #include "test_supervisor.h"
 
 #include "model/cluster.h"
+#include "model/diff/modify/mark_reachable.h"
+#include "model/diff/peer/peer_connection.h"
+#include "model/diff/peer/update_folder.h"
+#include "model/misc/diff_router.h"
 #include "diff-builder.h"
 #include "hasher/hasher_proxy_actor.h"
 #include "hasher/hasher_actor.h"
@@ -15,7 +19,11 @@
 #include "utils/error_code.h"
 #include "proto/bep_support.h"
 #include <boost/core/demangle.hpp>
+#include <array>
+#include <functional>
+#include <unordered_map>
 #include <vector>
+#include <thread>
 
 using namespace syncspirit;
 using namespace syncspirit::test;
@@ -74,16 +82,27 @@ struct sample_peer_t : r::actor_base_t {
 
     void shutdown_start() noexcept override {
         LOG_TRACE(log, "{}, shutdown_start", identity);
-        if (controller) {
+        if (secondary) {
+            auto diff = model::diff::cluster_diff_ptr_t();
+            auto sha256 = peer_device.get_sha256();
+            diff = new model::diff::peer::peer_connection_t(*cluster, sha256, address, false);
+            send<model::payload::model_update_t>(supervisor->get_address(), std::move(diff));
+        } else if (controller) {
             send<net::payload::termination_t>(controller, shutdown_reason);
         }
         r::actor_base_t::shutdown_start();
     }
 
     void shutdown_finish() noexcept override {
+        if (secondary) {
+            for (auto &request : block_requests) {
+                reply_with_error(*request, make_error(r::make_error_code(r::error_code_t::cancelled)));
+            }
+            block_requests.clear();
+        }
         r::actor_base_t::shutdown_finish();
         LOG_TRACE(log, "{}, shutdown_finish, blocks requested = {}", identity, blocks_requested);
-        if (controller) {
+        if (controller && !secondary) {
             send<net::payload::termination_t>(controller, shutdown_reason);
         }
     }
@@ -108,6 +127,8 @@ struct sample_peer_t : r::actor_base_t {
 
     void on_transfer(net::message::transfer_data_t &message) noexcept {
         auto &data = message.payload.data;
+        auto &tail = message.payload.tail;
+        data.append(tail.data(), tail.data() + tail.size());
         LOG_TRACE(log, "{}, on_transfer, bytes = {}", identity, data.size());
         auto buff = boost::asio::buffer(data.data(), data.size());
         auto result = proto::parse_bep(buff);
@@ -134,13 +155,17 @@ struct sample_peer_t : r::actor_base_t {
         block_requests.push_front(&req);
         ++blocks_requested;
         log->debug("{}, requesting block # {}", identity,
-                   block_requests.front()->payload.request_payload.block.block_index());
+                   block_requests.front()->payload.request_payload.block_index);
+        process_block_requests();
+    }
+
+    void process_block_requests() noexcept {
         if (block_responses.size()) {
             log->debug("{}, top response block # {}", identity, block_responses.front().block_index);
         }
         auto condition = [&]() -> bool {
             return block_requests.size() && block_responses.size() &&
-                   block_requests.front()->payload.request_payload.block.block_index() ==
+                   block_requests.front()->payload.request_payload.block_index ==
                        block_responses.front().block_index;
         };
         while (condition()) {
@@ -179,6 +204,8 @@ struct sample_peer_t : r::actor_base_t {
 
     size_t blocks_requested = 0;
     bool reading = false;
+    bool secondary = false;
+    model::cluster_ptr_t cluster;
     remote_messages_t messages;
     r::address_ptr_t controller;
     model::device_id_t peer_device;
@@ -188,6 +215,46 @@ struct sample_peer_t : r::actor_base_t {
     uploaded_blocks_t uploaded_blocks;
 };
 
+/* records the applied peer index chunks */
+struct index_observer_t : r::actor_base_t {
+    using r::actor_base_t::actor_base_t;
+    using callback_t = std::function<void(const model::diff::peer::update_folder_t &)>;
+
+    void configure(r::plugin::plugin_base_t &plugin) noexcept override {
+        r::actor_base_t::configure(plugin);
+        plugin.with_casted<r::plugin::address_maker_plugin_t>([&](auto &p) { p.set_identity("index_observer", false); });
+        plugin.with_casted<r::plugin::starter_plugin_t>(
+            [&](auto &p) { p.subscribe_actor(&index_observer_t::on_model_update); });
+    }
+
+    void on_start() noexcept override {
+        r::actor_base_t::on_start();
+        subscribe(true);
+    }
+
+    void shutdown_start() noexcept override {
+        subscribe(false);
+        r::actor_base_t::shutdown_start();
+    }
+
+    void subscribe(bool value) noexcept {
+        using router_t = model::diff_router_t;
+        auto &coordinator = supervisor->get_address();
+        send<model::payload::model_interest_t>(coordinator, get_address(), this, peer_id, router_t::update_folder,
+                                               value);
+    }
+
+    void on_model_update(model::message::model_update_t &message) noexcept {
+        auto diff = dynamic_cast<const model::diff::peer::update_folder_t *>(message.payload.diff.get());
+        if (diff && callback) {
+            callback(*diff);
+        }
+    }
+
+    std::string peer_id;
+    callback_t callback;
+};
+
 struct fixture_t {
     using peer_ptr_t = r::intrusive_ptr_t<sample_peer_t>;
     using target_ptr_t = r::intrusive_ptr_t<net::controller_actor_t>;
@@ -231,7 +298,11 @@ struct fixture_t {
         }
 
         r::system_context_t ctx;
-        sup = ctx.create_supervisor<supervisor_t>().timeout(timeout).create_registry().finish();
+        sup = ctx.create_supervisor<supervisor_t>()
+                  .auto_finish(auto_finish)
+                  .timeout(timeout)
+                  .create_registry()
+                  .finish();
         sup->cluster = cluster;
 
         sup->configure_callback = [&](r::plugin::plugin_base_t &plugin) {
@@ -271,8 +342,9 @@ struct fixture_t {
         target = sup->create_actor<controller_actor_t>()
                      .peer(peer_device)
                      .peer_addr(peer_actor->get_address())
-                     .request_pool(1024)
+                     .request_pool(request_pool)
                      .outgoing_buffer_max(1024'000)
+                     .index_chunk_weight(index_chunk_weight)
                      .cluster(cluster)
                      .timeout(timeout)
                      .request_timeout(timeout)
@@ -302,6 +374,9 @@ struct fixture_t {
 
     bool auto_start;
     bool auto_share;
+    bool auto_finish = true;
+    int64_t request_pool = 1024;
+    uint32_t index_chunk_weight = 0;
     int64_t max_sequence;
     peer_ptr_t peer_actor;
     target_ptr_t target;
@@ -570,6 +645,10 @@ void test_downloading() {
                 CHECK(!f->is_locked());
                 CHECK(peer_actor->blocks_requested == 1);
 
+                auto &metrics = peer_device->get_rx_metrics();
+                CHECK(metrics.window > 0);
+                CHECK(metrics.timeout.count() > 0);
+
                 auto &queue = peer_actor->messages;
                 REQUIRE(queue.size() > 0);
                 auto msg = &(*queue.front()).payload;
@@ -731,6 +810,61 @@ void test_downloading() {
                 CHECK(!fp->is_locked());
             }
 
+            SECTION("several new files are downloaded concurrently") {
+                peer_actor->forward(proto::message::ClusterConfig(new proto::ClusterConfig(cc)));
+
+                auto contents = std::unordered_map<std::string, std::string>{
+                    {"file-1", "11111"},
+                    {"file-2", "22222"},
+                    {"file-3", "33333"},
+                };
+                auto index = proto::Index{};
+                index.set_folder(std::string(folder_1->get_id()));
+                auto sequence = folder_1_peer->get_max_sequence() - static_cast<std::int64_t>(contents.size());
+                for (auto &[name, data] : contents) {
+                    auto file = index.add_files();
+                    file->set_name(name);
+                    file->set_type(proto::FileInfoType::FILE);
+                    file->set_sequence(++sequence);
+                    file->set_block_size(5);
+                    file->set_size(5);
+                    auto counter = file->mutable_version()->add_counters();
+                    counter->set_id(1);
+                    counter->set_value(peer_device->as_uint());
+
+                    auto b = file->add_blocks();
+                    b->set_hash(utils::sha256_digest(data).value());
+                    b->set_offset(0);
+                    b->set_size(5);
+                }
+
+                peer_actor->forward(proto::message::Index(new proto::Index(index)));
+                sup->do_process();
+
+                // all files are requested before any block arrives
+                REQUIRE(peer_actor->blocks_requested == contents.size());
+                for (auto &req : peer_actor->block_requests) {
+                    auto name = req->payload.request_payload.file_name;
+                    peer_actor->push_block(contents.at(name), 0);
+                }
+                peer_actor->process_block_requests();
+                sup->do_process();
+
+                auto folder_my = folder_infos.by_device(*my_device);
+                REQUIRE(folder_my->get_file_infos().size() == contents.size());
+                for (auto &it : folder_my->get_file_infos()) {
+                    auto &f = it.item;
+                    CHECK(f->get_size() == 5);
+                    CHECK(f->is_locally_available());
+                    CHECK(!f->is_locked());
+                    CHECK(!f->is_locally_locked());
+                }
+                for (auto &it : folder_1_peer->get_file_infos()) {
+                    CHECK(!it.item->is_locked());
+                    CHECK(!it.item->is_locally_locked());
+                }
+            }
+
             SECTION("deleted file, has been restored => download it") {
                 peer_actor->forward(proto::message::ClusterConfig(new proto::ClusterConfig(cc)));
                 sup->do_process();
@@ -843,6 +977,52 @@ void test_downloading() {
                 CHECK(f->is_locally_available());
                 CHECK(!f->is_locked());
             }
+
+            SECTION("file is not released while own blocks are in flight") {
+                peer_actor->forward(proto::message::ClusterConfig(new proto::ClusterConfig(cc)));
+
+                auto index = proto::Index{};
+                index.set_folder(std::string(folder_1->get_id()));
+                auto file = index.add_files();
+                file->set_name("some-file");
+                file->set_type(proto::FileInfoType::FILE);
+                file->set_sequence(folder_1_peer->get_max_sequence());
+                file->set_block_size(5);
+                file->set_size(10);
+                auto counter = file->mutable_version()->add_counters();
+                counter->set_id(1u);
+                counter->set_value(1u);
+
+                auto b1 = file->add_blocks();
+                b1->set_hash(utils::sha256_digest("12345").value());
+                b1->set_offset(0);
+                b1->set_size(5);
+                auto b2 = file->add_blocks();
+                b2->set_hash(utils::sha256_digest("67890").value());
+                b2->set_offset(5);
+                b2->set_size(5);
+
+                peer_actor->forward(proto::message::Index(new proto::Index(index)));
+                peer_actor->push_block("67890", 1);
+                sup->do_process();
+
+                REQUIRE(peer_actor->blocks_requested == 2);
+                auto fp = folder_1_peer->get_file_infos().by_name(file->name());
+                REQUIRE(fp);
+                CHECK(fp->is_locked());
+                CHECK(fp->is_locally_locked());
+
+                peer_actor->push_block("12345", 0);
+                peer_actor->process_block_requests();
+                sup->do_process();
+
+                auto f = folder_my->get_file_infos().by_name(file->name());
+                REQUIRE(f);
+                CHECK(f->is_locally_available());
+                CHECK(!fp->is_locked());
+                CHECK(!fp->is_locally_locked());
+                CHECK(peer_actor->blocks_requested == 2);
+            }
         }
     };
     F(true, 10).run();
@@ -919,6 +1099,459 @@ void test_downloading_errors() {
     F(true, 10).run();
 }
 
+void test_finishing() {
+    struct F : fixture_t {
+        F() noexcept : fixture_t(true, 10) { auto_finish = false; }
+
+        void main(diff_builder_t &builder) noexcept override {
+            auto &folder_infos = folder_1->get_folder_infos();
+            auto folder_my = folder_infos.by_device(*my_device);
+
+            auto cc = proto::ClusterConfig{};
+            auto folder = cc.add_folders();
+            folder->set_id(std::string(folder_1->get_id()));
+            auto d_peer = folder->add_devices();
+            d_peer->set_id(std::string(peer_device->device_id().get_sha256()));
+            d_peer->set_max_sequence(folder_1_peer->get_max_sequence());
+            d_peer->set_index_id(folder_1_peer->get_index());
+            auto d_my = folder->add_devices();
+            d_my->set_id(std::string(my_device->device_id().get_sha256()));
+            d_my->set_max_sequence(folder_my->get_max_sequence());
+            d_my->set_index_id(folder_my->get_index());
+
+            peer_actor->forward(proto::message::ClusterConfig(new proto::ClusterConfig(cc)));
+
+            auto index = proto::Index{};
+            index.set_folder(std::string(folder_1->get_id()));
+            auto file = index.add_files();
+            file->set_name("some-file");
+            file->set_type(proto::FileInfoType::FILE);
+            file->set_sequence(folder_1_peer->get_max_sequence());
+            file->set_block_size(5);
+            file->set_size(5);
+            auto version = file->mutable_version();
+            auto counter = version->add_counters();
+            counter->set_id(1ul);
+            counter->set_value(1ul);
+
+            auto b1 = file->add_blocks();
+            b1->set_hash(utils::sha256_digest("12345").value());
+            b1->set_offset(0);
+            b1->set_size(5);
+
+            peer_actor->forward(proto::message::Index(new proto::Index(index)));
+            peer_actor->push_block("12345", 0);
+            sup->do_process();
+
+            auto folder_peer = folder_infos.by_device(*peer_device);
+            auto f = folder_peer->get_file_infos().by_name(file->name());
+            REQUIRE(f);
+            auto lf = f->local_file();
+            REQUIRE(lf);
+            CHECK(!lf->is_locally_available());
+            CHECK(f->is_locked());
+
+            SECTION("source is unlocked, when fs has acknowledged the file") {
+                builder.finish_file_ack(*lf).apply(*sup);
+                CHECK(folder_my->get_file_infos().by_name(file->name())->is_locally_available());
+                CHECK(!f->is_locked());
+            }
+
+            SECTION("source is unlocked, when fs has failed to finish the file") {
+                auto diff = model::diff::cluster_diff_ptr_t{};
+                diff = new model::diff::modify::mark_reachable_t(*f, false);
+                sup->send<model::payload::model_update_t>(sup->get_address(), std::move(diff), nullptr);
+                sup->do_process();
+                CHECK(f->is_unreachable());
+                CHECK(!f->is_locked());
+            }
+        }
+    };
+    F().run();
+}
+
+/* with net_threads > 0 the peer actor lives on the other thread, so the block
+ * request might be destroyed there; the request carries plain values only,
+ * and the requested block is locked and unlocked by the controller */
+void test_block_request_on_net_thread() {
+    struct F : fixture_t {
+        F() noexcept : fixture_t(true, 10) {}
+
+        void main(diff_builder_t &) noexcept override {
+            auto &folder_infos = folder_1->get_folder_infos();
+            auto folder_my = folder_infos.by_device(*my_device);
+
+            auto cc = proto::ClusterConfig{};
+            auto folder = cc.add_folders();
+            folder->set_id(std::string(folder_1->get_id()));
+            auto d_peer = folder->add_devices();
+            d_peer->set_id(std::string(peer_device->device_id().get_sha256()));
+            d_peer->set_max_sequence(folder_1_peer->get_max_sequence());
+            d_peer->set_index_id(folder_1_peer->get_index());
+            auto d_my = folder->add_devices();
+            d_my->set_id(std::string(my_device->device_id().get_sha256()));
+            d_my->set_max_sequence(folder_my->get_max_sequence());
+            d_my->set_index_id(folder_my->get_index());
+
+            peer_actor->forward(proto::message::ClusterConfig(new proto::ClusterConfig(cc)));
+
+            auto index = proto::Index{};
+            index.set_folder(std::string(folder_1->get_id()));
+            auto file = index.add_files();
+            file->set_name("some-file");
+            file->set_type(proto::FileInfoType::FILE);
+            file->set_sequence(folder_1_peer->get_max_sequence());
+            file->set_block_size(5);
+            file->set_size(5);
+            auto version = file->mutable_version();
+            auto counter = version->add_counters();
+            counter->set_id(1ul);
+            counter->set_value(1ul);
+
+            auto hash = utils::sha256_digest("12345").value();
+            auto b1 = file->add_blocks();
+            b1->set_hash(hash);
+            b1->set_offset(0);
+            b1->set_size(5);
+
+            peer_actor->forward(proto::message::Index(new proto::Index(index)));
+            sup->do_process();
+
+            REQUIRE(peer_actor->block_requests.size() == 1);
+            auto request = peer_actor->block_requests.front();
+            auto &p = request->payload.request_payload;
+            CHECK(p.folder_id == folder_1->get_id());
+            CHECK(p.file_name == "some-file");
+            CHECK(p.block_index == 0);
+            CHECK(p.offset == 0);
+            CHECK(p.size == 5);
+            CHECK(p.hash == hash);
+
+            auto f = folder_infos.by_device(*peer_device)->get_file_infos().by_name("some-file");
+            REQUIRE(f);
+            auto block = f->get_blocks().at(0);
+            CHECK(block->is_locked());
+
+            peer_actor->push_block("12345", 0);
+            peer_actor->process_block_requests();
+            sup->do_process();
+            CHECK(peer_actor->block_requests.empty());
+
+            /* the block is released by the controller, while the request is still alive */
+            CHECK(!block->is_locked());
+            CHECK(folder_my->get_file_infos().by_name("some-file")->is_locally_available());
+
+            std::thread([request = std::move(request)]() mutable { request.reset(); }).join();
+            CHECK(!block->is_locked());
+        }
+    };
+    F().run();
+}
+
+void test_extra_connections() {
+    struct F : fixture_t {
+        F() noexcept : fixture_t(true, 10) {}
+
+        void main(diff_builder_t &) noexcept override {
+            auto sha256 = peer_device->device_id().get_sha256();
+            auto extra_actor = sup->create_actor<sample_peer_t>()
+                                   .peer_device_id(peer_device->device_id())
+                                   .timeout(timeout)
+                                   .finish();
+            extra_actor->secondary = true;
+            extra_actor->cluster = cluster;
+            sup->do_process();
+
+            auto diff = model::diff::cluster_diff_ptr_t{};
+            diff = new model::diff::peer::peer_connection_t(*cluster, sha256, extra_actor->get_address(), true);
+            sup->send<model::payload::model_update_t>(sup->get_address(), std::move(diff), nullptr);
+            sup->do_process();
+
+            REQUIRE(extra_actor->reading);
+            REQUIRE(extra_actor->messages.size() == 1);
+            CHECK(std::get_if<proto::message::ClusterConfig>(&extra_actor->messages.front()->payload));
+            extra_actor->messages.clear();
+
+            auto &folder_infos = folder_1->get_folder_infos();
+            auto folder_my = folder_infos.by_device(*my_device);
+
+            auto cc = proto::ClusterConfig{};
+            auto folder = cc.add_folders();
+            folder->set_id(std::string(folder_1->get_id()));
+            auto d_peer = folder->add_devices();
+            d_peer->set_id(std::string(sha256));
+            d_peer->set_max_sequence(folder_1_peer->get_max_sequence());
+            d_peer->set_index_id(folder_1_peer->get_index());
+            auto d_my = folder->add_devices();
+            d_my->set_id(std::string(my_device->device_id().get_sha256()));
+            d_my->set_max_sequence(folder_my->get_max_sequence());
+            d_my->set_index_id(folder_my->get_index());
+
+            peer_actor->forward(proto::message::ClusterConfig(new proto::ClusterConfig(cc)));
+
+            auto blocks = std::array<std::string_view, 2>{"12345", "67890"};
+            auto index = proto::Index{};
+            index.set_folder(std::string(folder_1->get_id()));
+            auto file = index.add_files();
+            file->set_name("some-file");
+            file->set_type(proto::FileInfoType::FILE);
+            file->set_sequence(folder_1_peer->get_max_sequence());
+            file->set_block_size(5);
+            file->set_size(10);
+            auto version = file->mutable_version();
+            auto counter = version->add_counters();
+            counter->set_id(1ul);
+            counter->set_value(1ul);
+            for (std::size_t i = 0; i < blocks.size(); ++i) {
+                auto b = file->add_blocks();
+                b->set_hash(utils::sha256_digest(blocks[i]).value());
+                b->set_offset(static_cast<std::int64_t>(i * 5));
+                b->set_size(5);
+            }
+
+            peer_actor->forward(proto::message::Index(new proto::Index(index)));
+            sup->do_process();
+
+            auto reply = [&](sample_peer_t &actor) {
+                REQUIRE(actor.block_requests.size() == 1);
+                auto block_index = actor.block_requests.front()->payload.request_payload.block_index;
+                actor.push_block(blocks.at(block_index), block_index);
+                actor.process_block_requests();
+            };
+
+            /* the requests are striped over the primary and extra connections */
+            CHECK(peer_actor->blocks_requested == 1);
+            CHECK(extra_actor->blocks_requested == 1);
+
+            SECTION("both connections deliver blocks") {
+                reply(*peer_actor);
+                reply(*extra_actor);
+                sup->do_process();
+
+                CHECK(folder_my->get_file_infos().by_name("some-file")->is_locally_available());
+                CHECK(static_cast<r::actor_base_t *>(extra_actor.get())->access<to::state>() ==
+                      r::state_t::OPERATIONAL);
+            }
+
+            SECTION("lost extra connection, its block is re-requested via the primary one") {
+                REQUIRE(extra_actor->block_requests.size() == 1);
+                auto lost_index = extra_actor->block_requests.front()->payload.request_payload.block_index;
+                reply(*peer_actor);
+                extra_actor->do_shutdown();
+                sup->do_process();
+
+                CHECK(static_cast<r::actor_base_t *>(extra_actor.get())->access<to::state>() ==
+                      r::state_t::SHUT_DOWN);
+                CHECK(static_cast<r::actor_base_t *>(target.get())->access<to::state>() == r::state_t::OPERATIONAL);
+                CHECK(peer_actor->blocks_requested == 2);
+                REQUIRE(peer_actor->block_requests.size() == 1);
+                CHECK(peer_actor->block_requests.front()->payload.request_payload.block_index == lost_index);
+
+                reply(*peer_actor);
+                sup->do_process();
+
+                auto f = folder_infos.by_device(*peer_device)->get_file_infos().by_name("some-file");
+                REQUIRE(f);
+                CHECK(!f->is_unreachable());
+                CHECK(folder_my->get_file_infos().by_name("some-file")->is_locally_available());
+            }
+
+            SECTION("lost extra connection, while its block is being validated") {
+                reply(*extra_actor);
+                /* the disconnection is delivered before the hasher replies */
+                auto diff = model::diff::cluster_diff_ptr_t{};
+                diff = new model::diff::peer::peer_connection_t(*cluster, sha256, extra_actor->get_address(), false);
+                sup->send<model::payload::model_update_t>(sup->get_address(), std::move(diff), nullptr);
+                sup->do_process();
+
+                CHECK(static_cast<r::actor_base_t *>(extra_actor.get())->access<to::state>() ==
+                      r::state_t::SHUT_DOWN);
+                CHECK(static_cast<r::actor_base_t *>(target.get())->access<to::state>() == r::state_t::OPERATIONAL);
+                CHECK(peer_actor->blocks_requested == 1);
+
+                reply(*peer_actor);
+                sup->do_process();
+
+                CHECK(peer_actor->blocks_requested == 1);
+                CHECK(folder_my->get_file_infos().by_name("some-file")->is_locally_available());
+            }
+        }
+    };
+    F().run();
+}
+
+void test_index_chunks() {
+    struct F : fixture_t {
+        F() noexcept : fixture_t(true, 10) { index_chunk_weight = 1; }
+
+        void main(diff_builder_t &) noexcept override {
+            auto sha256 = peer_device->device_id().get_sha256();
+            auto observer = sup->create_actor<index_observer_t>().timeout(timeout).finish();
+            observer->peer_id = sha256;
+
+            auto &folder_infos = folder_1->get_folder_infos();
+            auto folder_my = folder_infos.by_device(*my_device);
+            auto folder_peer = folder_infos.by_device(*peer_device);
+
+            /* the peer request, which arrives while the index is being applied,
+             * is served before the rest of the index */
+            auto chunk_files = std::vector<std::size_t>{};
+            auto answered = std::vector<std::size_t>{};
+            observer->callback = [&](const model::diff::peer::update_folder_t &diff) {
+                chunk_files.emplace_back(diff.files.size());
+                answered.emplace_back(peer_actor->uploaded_blocks.size());
+                if (chunk_files.size() == 1) {
+                    auto req = proto::Request();
+                    req.set_id(1);
+                    req.set_folder("non-existing-folder");
+                    req.set_name("some-file");
+                    req.set_size(5);
+                    peer_actor->forward(proto::message::Request(new proto::Request(req)));
+                }
+            };
+            sup->do_process();
+
+            auto cc = proto::ClusterConfig{};
+            auto folder = cc.add_folders();
+            folder->set_id(std::string(folder_1->get_id()));
+            auto d_peer = folder->add_devices();
+            d_peer->set_id(std::string(sha256));
+            d_peer->set_max_sequence(folder_1_peer->get_max_sequence());
+            d_peer->set_index_id(folder_1_peer->get_index());
+            auto d_my = folder->add_devices();
+            d_my->set_id(std::string(my_device->device_id().get_sha256()));
+            d_my->set_max_sequence(folder_my->get_max_sequence());
+            d_my->set_index_id(folder_my->get_index());
+            peer_actor->forward(proto::message::ClusterConfig(new proto::ClusterConfig(cc)));
+
+            auto index = proto::Index{};
+            index.set_folder(std::string(folder_1->get_id()));
+            for (int i = 0; i < 4; ++i) {
+                auto file = index.add_files();
+                file->set_name("dir-" + std::to_string(i));
+                file->set_type(proto::FileInfoType::DIRECTORY);
+                file->set_sequence(folder_1_peer->get_max_sequence() - 3 + i);
+            }
+            peer_actor->forward(proto::message::Index(new proto::Index(index)));
+            sup->do_process();
+
+            CHECK(folder_peer->get_file_infos().size() == 4);
+            CHECK(chunk_files == std::vector<std::size_t>{1, 1, 1, 1});
+            REQUIRE(answered.size() == 4);
+            CHECK(answered.front() == 0);
+            CHECK(answered.back() == 1);
+            REQUIRE(peer_actor->uploaded_blocks.size() == 1);
+            CHECK(peer_actor->uploaded_blocks.front()->code() == proto::ErrorCode::NO_SUCH_FILE);
+            CHECK(static_cast<r::actor_base_t *>(target.get())->access<to::state>() == r::state_t::OPERATIONAL);
+        }
+    };
+    F().run();
+}
+
+void test_concurrent_finish() {
+    struct F : fixture_t {
+        F() noexcept : fixture_t(true, 10) {
+            auto_finish = false;
+            /* the owner requests a single block, the rest is left to helper */
+            request_pool = 1;
+        }
+
+        void main(diff_builder_t &builder) noexcept override {
+            auto peer_2_id =
+                device_id_t::from_string("EAMTZPW-Q4QYERN-D57DHFS-AUP2OMG-PAHOR3R-ZWLKGAA-WQC5SVW-UJ5NXQA").value();
+            auto peer_2 = device_t::create(peer_2_id, "peer-2").value();
+            cluster->get_devices().put(peer_2);
+            auto sha256_2 = peer_2_id.get_sha256();
+            builder.share_folder(sha256_2, folder_1->get_id())
+                .configure_cluster(sha256_2)
+                .add(sha256_2, folder_1->get_id(), 124, 10)
+                .finish()
+                .apply(*sup);
+
+            auto peer_actor_2 = sup->create_actor<sample_peer_t>().timeout(timeout).finish();
+            sup->create_actor<controller_actor_t>()
+                .peer(peer_2)
+                .peer_addr(peer_actor_2->get_address())
+                .request_pool(1024)
+                .outgoing_buffer_max(1024'000)
+                .cluster(cluster)
+                .timeout(timeout)
+                .request_timeout(timeout)
+                .finish();
+            sup->do_process();
+
+            auto &folder_infos = folder_1->get_folder_infos();
+            auto folder_my = folder_infos.by_device(*my_device);
+            auto folder_2_peer = folder_infos.by_device(*peer_2);
+
+            auto make_cc = [&](device_t &device, model::folder_info_t &peer_folder) {
+                auto cc = proto::ClusterConfig{};
+                auto folder = cc.add_folders();
+                folder->set_id(std::string(folder_1->get_id()));
+                auto d_peer = folder->add_devices();
+                d_peer->set_id(std::string(device.device_id().get_sha256()));
+                d_peer->set_max_sequence(peer_folder.get_max_sequence());
+                d_peer->set_index_id(peer_folder.get_index());
+                auto d_my = folder->add_devices();
+                d_my->set_id(std::string(my_device->device_id().get_sha256()));
+                d_my->set_max_sequence(folder_my->get_max_sequence());
+                d_my->set_index_id(folder_my->get_index());
+                return proto::message::ClusterConfig(new proto::ClusterConfig(cc));
+            };
+
+            auto index = proto::Index{};
+            index.set_folder(std::string(folder_1->get_id()));
+            auto file = index.add_files();
+            file->set_name("some-file");
+            file->set_type(proto::FileInfoType::FILE);
+            file->set_sequence(10);
+            file->set_block_size(5);
+            file->set_size(10);
+            auto counter = file->mutable_version()->add_counters();
+            counter->set_id(1ul);
+            counter->set_value(1ul);
+            auto b1 = file->add_blocks();
+            b1->set_hash(utils::sha256_digest("12345").value());
+            b1->set_offset(0);
+            b1->set_size(5);
+            auto b2 = file->add_blocks();
+            b2->set_hash(utils::sha256_digest("67890").value());
+            b2->set_offset(5);
+            b2->set_size(5);
+
+            peer_actor->forward(make_cc(*peer_device, *folder_1_peer));
+            peer_actor->forward(proto::message::Index(new proto::Index(index)));
+            sup->do_process();
+            CHECK(peer_actor->blocks_requested == 1);
+
+            peer_actor_2->forward(make_cc(*peer_2, *folder_2_peer));
+            peer_actor_2->forward(proto::message::Index(new proto::Index(index)));
+            sup->do_process();
+            REQUIRE(peer_actor_2->blocks_requested == 1);
+
+            /* both last blocks arrive at once */
+            peer_actor->push_block("12345", 0);
+            peer_actor_2->push_block("67890", 1);
+            peer_actor->process_block_requests();
+            peer_actor_2->process_block_requests();
+            sup->do_process();
+
+            auto f = folder_1_peer->get_file_infos().by_name(file->name());
+            REQUIRE(f);
+            auto lf = f->local_file();
+            REQUIRE(lf);
+            CHECK(f->is_locked());
+            CHECK(sup->finish_requests == 1);
+
+            builder.finish_file_ack(*lf).apply(*sup);
+            CHECK(folder_my->get_file_infos().by_name(file->name())->is_locally_available());
+            CHECK(!f->is_locked());
+            CHECK(sup->finish_requests == 1);
+        }
+    };
+    F().run();
+}
+
 void test_my_sharing() {
     struct F : fixture_t {
         using fixture_t::fixture_t;
@@ -1082,6 +1715,65 @@ void test_uploading() {
                 CHECK(peer_res.code() == proto::ErrorCode::NO_BEP_ERROR);
                 CHECK(peer_res.data() == "12345");
             }
+
+            SECTION("file is being downloaded") {
+                auto peer_file = model::file_info_t::create(cluster->next_uuid(), pr_fi, folder_1_peer).value();
+                peer_file->assign_block(b, 0);
+                folder_1_peer->add(peer_file, false);
+                file_info->set_source(peer_file);
+                peer_file->lock();
+
+                SECTION("block is not written yet") {
+                    peer_actor->forward(proto::message::Request(new proto::Request(req)));
+                    sup->do_process();
+                    CHECK(block_requests.size() == 0);
+
+                    REQUIRE(peer_actor->uploaded_blocks.size() == 1);
+                    auto &peer_res = *peer_actor->uploaded_blocks.front();
+                    CHECK(peer_res.id() == 1);
+                    CHECK(peer_res.code() == proto::ErrorCode::NO_SUCH_FILE);
+                }
+
+                SECTION("block is already written") {
+                    peer_file->mark_local_available(0);
+                    peer_actor->forward(proto::message::Request(new proto::Request(req)));
+
+                    auto req_ptr = proto::message::Request(new proto::Request(req));
+                    auto res = r::make_message<fs::payload::block_response_t>(
+                        target->get_address(), std::move(req_ptr), sys::error_code{}, std::string("12345"));
+                    block_responses.push_back(res);
+
+                    sup->do_process();
+                    REQUIRE(block_requests.size() == 1);
+                    REQUIRE(peer_actor->uploaded_blocks.size() == 1);
+                    auto &peer_res = *peer_actor->uploaded_blocks.front();
+                    CHECK(peer_res.code() == proto::ErrorCode::NO_BEP_ERROR);
+                    CHECK(peer_res.data() == "12345");
+                }
+                peer_file->unlock();
+            }
+
+            SECTION("download progress of peer is accepted") {
+                auto progress = proto::DownloadProgress();
+                progress.set_folder(std::string(folder_1->get_id()));
+                auto update = progress.add_updates();
+                update->set_name("data.bin");
+                *update->mutable_version() = pr_fi.version();
+                update->add_block_indexes(0);
+                peer_actor->forward(proto::message::DownloadProgress(new proto::DownloadProgress(progress)));
+                sup->do_process();
+                CHECK(static_cast<r::actor_base_t *>(target.get())->access<to::state>() == r::state_t::OPERATIONAL);
+
+                auto &swarm = cluster->get_swarm();
+                CHECK(swarm.has_temp_block(*peer_device, *file_info, 0));
+                CHECK(!swarm.has_temp_block(*my_device, *file_info, 0));
+
+                update->set_update_type(proto::FileDownloadProgressUpdateType::FORGET);
+                update->clear_block_indexes();
+                peer_actor->forward(proto::message::DownloadProgress(new proto::DownloadProgress(progress)));
+                sup->do_process();
+                CHECK(!swarm.has_temp_block(*peer_device, *file_info, 0));
+            }
         }
     };
     F(true, 10).run();
@@ -1093,6 +1785,11 @@ int _init() {
     REGISTER_TEST_CASE(test_index_sending, "test_index_sending", "[net]");
     REGISTER_TEST_CASE(test_downloading, "test_downloading", "[net]");
     REGISTER_TEST_CASE(test_downloading_errors, "test_downloading_errors", "[net]");
+    REGISTER_TEST_CASE(test_finishing, "test_finishing", "[net]");
+    REGISTER_TEST_CASE(test_concurrent_finish, "test_concurrent_finish", "[net]");
+    REGISTER_TEST_CASE(test_block_request_on_net_thread, "test_block_request_on_net_thread", "[net]");
+    REGISTER_TEST_CASE(test_extra_connections, "test_extra_connections", "[net]");
+    REGISTER_TEST_CASE(test_index_chunks, "test_index_chunks", "[net]");
     REGISTER_TEST_CASE(test_my_sharing, "test_my_sharing", "[net]");
     REGISTER_TEST_CASE(test_sending_index_updates, "test_sending_index_updates", "[net]");
     REGISTER_TEST_CASE(test_uploading, "test_uploading", "[net]");
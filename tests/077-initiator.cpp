@@ -3,17 +3,22 @@
 
 #include "test-utils.h"
 #include "access.h"
+#include "constants.h"
 
 #include "utils/tls.h"
 #include "utils/format.hpp"
 #include "model/cluster.h"
 #include "model/messages.h"
+#include "model/diff/modify/dial_result.h"
+#include "model/misc/devices_view.h"
 #include "net/names.h"
 #include "net/initiator_actor.h"
 #include "net/resolver_actor.h"
 #include "proto/relay_support.h"
 #include "transport/stream.h"
 #include <rotor/asio.hpp>
+#include <array>
+#include <chrono>
 
 using namespace syncspirit;
 using namespace syncspirit::test;
@@ -64,6 +69,7 @@ struct fixture_t {
     using ready_ptr_t = r::intrusive_ptr_t<net::message::peer_connected_t>;
     using diff_ptr_t = r::intrusive_ptr_t<model::message::model_update_t>;
     using diff_msgs_t = std::vector<diff_ptr_t>;
+    using contact_ptr_t = r::intrusive_ptr_t<model::message::contact_update_t>;
 
     fixture_t() noexcept : ctx(io_ctx), acceptor(io_ctx), peer_sock(io_ctx) {
         utils::set_default("trace");
@@ -84,14 +90,22 @@ struct fixture_t {
             plugin.template with_casted<r::plugin::starter_plugin_t>([&](auto &p) {
                 using connected_t = typename ready_ptr_t::element_type;
                 using diff_t = typename diff_ptr_t::element_type;
+                using contact_t = typename contact_ptr_t::element_type;
                 p.subscribe_actor(r::lambda<connected_t>([&](connected_t &msg) {
                     connected_message = &msg;
                     LOG_INFO(log, "received message::peer_connected_t");
+                    on_connected();
                 }));
                 p.subscribe_actor(r::lambda<diff_t>([&](diff_t &msg) {
                     diff_msgs.emplace_back(&msg);
                     LOG_INFO(log, "received diff message");
                 }));
+                p.subscribe_actor(r::lambda<contact_t>([&](contact_t &msg) {
+                    LOG_INFO(log, "received contact message");
+                    auto r = msg.payload.diff->apply(*cluster);
+                    CHECK(r);
+                    devices_view->update(*cluster, *msg.payload.diff);
+                }));
             });
         };
         sup->finish_callback = [&]() { finish(); };
@@ -122,6 +136,8 @@ struct fixture_t {
 
         cluster->get_devices().put(my_device);
         cluster->get_devices().put(peer_device);
+        devices_view = std::make_shared<devices_view_t>();
+        devices_view->update(*cluster);
 
         main();
     }
@@ -134,6 +150,8 @@ struct fixture_t {
         return fmt::format("tcp://{}", listening_ep);
     }
 
+    virtual utils::uri_container_t get_uris() noexcept { return {peer_uri}; }
+
     virtual void accept(const sys::error_code &ec) noexcept {
         LOG_INFO(log, "accept, ec: {}", ec.message());
         peer_trans = transport::initiate_tls_passive(*sup, peer_keys, std::move(peer_sock));
@@ -152,6 +170,8 @@ struct fixture_t {
 
     virtual void on_peer_handshake() noexcept { LOG_INFO(log, "peer handshake"); }
 
+    virtual void on_connected() noexcept {}
+
     void initiate_active() noexcept {
         tcp::resolver resolver(io_ctx);
         auto addresses = resolver.resolve(host, std::to_string(listening_ep.port()));
@@ -189,8 +209,8 @@ struct fixture_t {
             .peer_device_id(peer_device->device_id())
             .relay_session(relay_session)
             .relay_enabled(true)
-            .uris({peer_uri})
-            .cluster(use_model ? cluster : nullptr)
+            .uris(get_uris())
+            .devices_view(use_model ? devices_view : nullptr)
             .sink(sup->get_address())
             .ssl_pair(&my_keys)
             .router(*sup)
@@ -204,13 +224,14 @@ struct fixture_t {
             .sock(std::move(peer_sock))
             .ssl_pair(&my_keys)
             .router(*sup)
-            .cluster(cluster)
+            .devices_view(devices_view)
             .sink(sup->get_address())
             .escalate_failure()
             .finish();
     }
 
     cluster_ptr_t cluster;
+    devices_view_ptr_t devices_view;
     asio::io_context io_ctx{1};
     ra::system_context_asio_t ctx;
     acceptor_t acceptor;
@@ -395,6 +416,190 @@ void test_success_no_model() {
     F().run();
 }
 
+void test_next_uri_on_failure() {
+    struct F : fixture_t {
+        utils::uri_container_t get_uris() noexcept override {
+            auto refused = utils::parse(fmt::format("tcp://{}:0", host)).value();
+            return {refused, peer_uri};
+        }
+
+        void main() noexcept override {
+            auto act = create_actor();
+            io_ctx.run();
+            CHECK(sup->get_state() == r::state_t::OPERATIONAL);
+            REQUIRE(connected_message);
+            CHECK(connected_message->payload.peer_device_id == peer_device->device_id());
+            CHECK(valid_handshake);
+
+            auto &history = peer_device->get_dial_history();
+            REQUIRE(history.size() == 2);
+            auto &refused = history.at(fmt::format("tcp://{}:0", host));
+            CHECK(refused.successes == 0);
+            CHECK(refused.consecutive_failures == 1);
+            auto &ok = history.at(peer_uri.full);
+            CHECK(ok.successes == 1);
+            CHECK(ok.consecutive_failures == 0);
+
+            sup->do_shutdown();
+            sup->do_process();
+            CHECK(sup->get_state() == r::state_t::SHUT_DOWN);
+        }
+    };
+    F().run();
+}
+
+/* the extra endpoint accepts connections, but never replies, so the attempt
+ * via it hangs until it is cancelled */
+struct race_fixture_t : fixture_t {
+    using clock_t = std::chrono::steady_clock;
+
+    race_fixture_t() noexcept : slow_acceptor(io_ctx), slow_sock(io_ctx) {}
+
+    void main() noexcept override {
+        auto ep = asio::ip::tcp::endpoint(asio::ip::make_address(host), 0);
+        slow_acceptor.open(ep.protocol());
+        slow_acceptor.bind(ep);
+        slow_acceptor.listen();
+        slow_ep = slow_acceptor.local_endpoint();
+        slow_acceptor.async_accept(slow_sock, [this](auto ec) { on_slow_accept(ec); });
+        race();
+    }
+
+    virtual void race() noexcept {}
+
+    void on_slow_accept(const sys::error_code &ec) noexcept {
+        LOG_INFO(log, "slow/accept, ec: {}", ec.message());
+        if (!ec) {
+            slow_accepted = true;
+            slow_read();
+        }
+    }
+
+    void slow_read() noexcept {
+        slow_sock.async_read_some(asio::buffer(slow_buff), [this](auto ec, std::size_t) {
+            if (ec) {
+                LOG_INFO(log, "slow/read, ec: {}", ec.message());
+                slow_closed = true;
+                return;
+            }
+            slow_read();
+        });
+    }
+
+    void on_connected() noexcept override {
+        connected_at = clock_t::now();
+        if (!slow_accepted) {
+            slow_acceptor.cancel();
+        }
+    }
+
+    acceptor_t slow_acceptor;
+    asio::ip::tcp::socket slow_sock;
+    asio::ip::tcp::endpoint slow_ep;
+    std::array<char, 1024> slow_buff;
+    clock_t::time_point started_at;
+    clock_t::time_point connected_at;
+    bool slow_accepted = false;
+    bool slow_closed = false;
+};
+
+/* the slow uri is dialed first, as it was successfully dialed before, then
+ * the next one is started after the stagger delay and wins */
+struct staggered_fixture_t : race_fixture_t {
+    utils::uri_container_t get_uris() noexcept override { return {peer_uri, slow_uri}; }
+
+    void race() noexcept override {
+        slow_uri = utils::parse(fmt::format("tcp://{}", slow_ep)).value();
+        auto diff = model::diff::contact_diff_ptr_t();
+        diff = new model::diff::modify::dial_result_t(*cluster, peer_device->device_id(), slow_uri, true);
+        REQUIRE(diff->apply(*cluster));
+        devices_view->update(*cluster, *diff);
+
+        started_at = clock_t::now();
+        create_actor();
+        io_ctx.run();
+        CHECK(sup->get_state() == r::state_t::OPERATIONAL);
+        REQUIRE(connected_message);
+        CHECK(connected_message->payload.proto == "tcp");
+        CHECK(connected_message->payload.peer_device_id == peer_device->device_id());
+        CHECK(valid_handshake);
+        check();
+
+        sup->do_shutdown();
+        sup->do_process();
+        CHECK(sup->get_state() == r::state_t::SHUT_DOWN);
+    }
+
+    virtual void check() noexcept {}
+
+    utils::URI slow_uri;
+};
+
+void test_staggered_start() {
+    struct F : staggered_fixture_t {
+        void check() noexcept override {
+            CHECK(slow_accepted);
+            auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(connected_at - started_at);
+            CHECK(delay.count() >= constants::dial_attempt_delay);
+        }
+    };
+    F().run();
+}
+
+void test_losing_attempt_cancelled() {
+    struct F : staggered_fixture_t {
+        void check() noexcept override {
+            CHECK(slow_accepted);
+            CHECK(slow_closed);
+
+            /* cancelled attempt is not a failure */
+            auto &history = peer_device->get_dial_history();
+            REQUIRE(history.size() == 2);
+            auto &slow = history.at(slow_uri.full);
+            CHECK(slow.successes == 1);
+            CHECK(slow.consecutive_failures == 0);
+            auto &ok = history.at(peer_uri.full);
+            CHECK(ok.successes == 1);
+            CHECK(ok.consecutive_failures == 0);
+        }
+    };
+    F().run();
+}
+
+void test_relay_last() {
+    struct F : race_fixture_t {
+        utils::uri_container_t get_uris() noexcept override { return {relay_uri, peer_uri}; }
+
+        void race() noexcept override {
+            auto relay_keys = utils::generate_pair("relay").value();
+            auto relay_device = model::device_id_t::from_cert(relay_keys.cert_data).value();
+            auto uri_str = fmt::format("relay://{}?id={}", slow_ep, relay_device.get_value());
+            relay_uri = utils::parse(uri_str).value();
+
+            create_actor();
+            io_ctx.run();
+            CHECK(sup->get_state() == r::state_t::OPERATIONAL);
+            REQUIRE(connected_message);
+            CHECK(connected_message->payload.proto == "tcp");
+            CHECK(valid_handshake);
+
+            /* the relay is dialed after the direct uri with a longer delay,
+             * the direct one has won in the meantime */
+            CHECK(!slow_accepted);
+            auto &history = peer_device->get_dial_history();
+            CHECK(history.size() == 1);
+            CHECK(history.count(peer_uri.full) == 1);
+
+            sup->do_shutdown();
+            sup->do_process();
+            CHECK(sup->get_state() == r::state_t::SHUT_DOWN);
+        }
+
+        utils::URI relay_uri;
+    };
+    F().run();
+}
+
 struct passive_fixture_t : fixture_t {
     actor_ptr_t act;
     bool active_connect_invoked = false;
@@ -781,7 +986,7 @@ void test_relay_active_not_enabled() {
                 .peer_device_id(peer_device->device_id())
                 .relay_session(relay_session)
                 .uris({peer_uri})
-                .cluster(use_model ? cluster : nullptr)
+                .devices_view(use_model ? devices_view : nullptr)
                 .sink(sup->get_address())
                 .ssl_pair(&my_keys)
                 .router(*sup)
@@ -926,6 +1131,10 @@ int _init() {
     REGISTER_TEST_CASE(test_resolve_failure, "test_resolve_failure", "[initiator]");
     REGISTER_TEST_CASE(test_success, "test_success", "[initiator]");
     REGISTER_TEST_CASE(test_success_no_model, "test_success_no_model", "[initiator]");
+    REGISTER_TEST_CASE(test_next_uri_on_failure, "test_next_uri_on_failure", "[initiator]");
+    REGISTER_TEST_CASE(test_staggered_start, "test_staggered_start", "[initiator]");
+    REGISTER_TEST_CASE(test_losing_attempt_cancelled, "test_losing_attempt_cancelled", "[initiator]");
+    REGISTER_TEST_CASE(test_relay_last, "test_relay_last", "[initiator]");
     REGISTER_TEST_CASE(test_passive_success, "test_passive_success", "[initiator]");
     REGISTER_TEST_CASE(test_passive_garbage, "test_passive_garbage", "[initiator]");
     REGISTER_TEST_CASE(test_passive_timeout, "test_passive_timeout", "[initiator]");
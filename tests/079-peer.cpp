@@ -3,12 +3,14 @@
 
 #include "test-utils.h"
 #include "access.h"
+#include "constants.h"
 
 #include "utils/tls.h"
 #include "utils/format.hpp"
 #include "model/cluster.h"
 #include "model/messages.h"
 #include "model/diff/peer/peer_state.h"
+#include "model/misc/devices_view.h"
 #include "net/names.h"
 #include "net/messages.h"
 #include "net/peer_actor.h"
@@ -16,6 +18,7 @@
 
 #include <rotor/asio.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <list>
 
 using namespace syncspirit;
 using namespace syncspirit::test;
@@ -95,6 +98,7 @@ struct fixture_t : private model::diff::contact_visitor_t {
                         LOG_ERROR(log, "error updating model: {}", r.assume_error().message());
                         sup->do_shutdown();
                     }
+                    devices_view->update(*cluster, *diff);
                 }));
             });
         };
@@ -112,6 +116,8 @@ struct fixture_t : private model::diff::contact_visitor_t {
         cluster = new cluster_t(my_device, 1, 1);
         cluster->get_devices().put(my_device);
         cluster->get_devices().put(peer_device);
+        devices_view = std::make_shared<devices_view_t>();
+        devices_view->update(*cluster);
 
         auto ep = asio::ip::tcp::endpoint(asio::ip::make_address(host), 0);
         acceptor.open(ep.protocol());
@@ -151,14 +157,14 @@ struct fixture_t : private model::diff::contact_visitor_t {
         auto diff = model::diff::cluster_diff_ptr_t();
         auto state = model::device_state_t::dialing;
         auto sha256 = peer_device->device_id().get_sha256();
-        diff = new model::diff::peer::peer_state_t(*cluster, sha256, nullptr, state);
+        diff = new model::diff::peer::peer_state_t(*devices_view, sha256, nullptr, state);
         sup->send<model::payload::model_update_t>(sup->get_address(), std::move(diff));
 
         auto bep_config = config::bep_config_t();
         bep_config.rx_buff_size = 1024;
         return sup->create_actor<actor_ptr_t::element_type>()
             .timeout(timeout)
-            .cluster(cluster)
+            .devices_view(devices_view)
             .coordinator(sup->get_address())
             .bep_config(bep_config)
             .transport(peer_trans)
@@ -178,6 +184,7 @@ struct fixture_t : private model::diff::contact_visitor_t {
     }
 
     cluster_ptr_t cluster;
+    devices_view_ptr_t devices_view;
     supervisor_ptr_t sup;
     asio::io_context io_ctx;
     ra::system_context_asio_t ctx;
@@ -192,6 +199,172 @@ struct fixture_t : private model::diff::contact_visitor_t {
     transport::stream_sp_t client_trans;
 };
 
+/* in-memory transport: writes are kept pending until explicitly completed,
+ * reads never complete */
+struct mock_stream_t : transport::stream_base_t {
+    struct write_t {
+        transport::const_buffers_t buffs;
+        transport::io_fn_t on_write;
+        transport::error_fn_t on_error;
+    };
+    using writes_t = std::list<write_t>;
+
+    mock_stream_t(supervisor_t &sup_) noexcept : sup{sup_} {}
+
+    asio::ip::address local_address(sys::error_code &) noexcept override { return {}; }
+    void async_connect(const transport::resolved_hosts_t &, transport::connect_fn_t &,
+                       transport::error_fn_t &) noexcept override {}
+    void async_handshake(transport::handshake_fn_t &, transport::error_fn_t &) noexcept override {}
+
+    void async_send(asio::const_buffer buff, transport::io_fn_t &on_write,
+                    transport::error_fn_t &on_error) noexcept override {
+        async_send(transport::const_buffers_t{buff}, on_write, on_error);
+    }
+
+    void async_send(const transport::const_buffers_t &buffs, transport::io_fn_t &on_write,
+                    transport::error_fn_t &on_error) noexcept override {
+        writes.emplace_back(write_t{buffs, on_write, on_error});
+    }
+
+    void async_recv(asio::mutable_buffer, transport::io_fn_t &, transport::error_fn_t &on_error) noexcept override {
+        recv_error = on_error;
+    }
+
+    void cancel() noexcept override {
+        auto fail = [this](transport::error_fn_t fn) {
+            asio::post(sup.get_strand(), [this, fn = std::move(fn)]() {
+                fn(asio::error::operation_aborted);
+                sup.do_process();
+            });
+        };
+        if (recv_error) {
+            fail(std::move(recv_error));
+            recv_error = {};
+        }
+        while (!writes.empty()) {
+            fail(std::move(writes.front().on_error));
+            writes.pop_front();
+        }
+    }
+
+    /* the oldest pending write is done; the sent bytes are read from the
+     * original buffers only now, so they should be still alive */
+    std::string complete() noexcept {
+        auto write = std::move(writes.front());
+        writes.pop_front();
+        auto data = std::string();
+        for (auto &buff : write.buffs) {
+            data.append(reinterpret_cast<const char *>(buff.data()), buff.size());
+        }
+        write.on_write(data.size());
+        sup.do_process();
+        return data;
+    }
+
+    supervisor_t &sup;
+    writes_t writes;
+    transport::error_fn_t recv_error;
+};
+
+using mock_stream_ptr_t = model::intrusive_ptr_t<mock_stream_t>;
+
+struct blob_t {
+    std::string data;
+};
+
+using frames_t = std::vector<proto::message::message_t>;
+
+static frames_t parse_frames(std::string_view data) {
+    auto frames = frames_t();
+    while (!data.empty()) {
+        auto r = proto::parse_bep(asio::buffer(data.data(), data.size()));
+        REQUIRE(r);
+        REQUIRE(r.value().consumed);
+        frames.emplace_back(std::move(r.value().message));
+        data = data.substr(r.value().consumed);
+    }
+    return frames;
+}
+
+struct mock_fixture_t {
+    mock_fixture_t() noexcept : ctx(io_ctx) {
+        utils::set_default("trace");
+        log = utils::get_logger("fixture");
+    }
+
+    virtual void run() noexcept {
+        auto strand = std::make_shared<asio::io_context::strand>(io_ctx);
+        sup = ctx.create_supervisor<supervisor_t>().strand(strand).timeout(timeout).create_registry().finish();
+        sup->start();
+        sup->do_process();
+
+        auto my_id =
+            device_id_t::from_string("KHQNO2S-5QSILRK-YX4JZZ4-7L77APM-QNVGZJT-EKU7IFI-PNEPBMY-4MXFMQD").value();
+        auto peer_id =
+            device_id_t::from_string("VUV42CZ-IQD5A37-RPEBPM4-VVQK6E4-6WSKC7B-PVJQHHD-4PZD44V-ENC6WAZ").value();
+        auto my_device = device_t::create(my_id, "my-device").value();
+        peer_device = device_t::create(peer_id, "peer-device").value();
+        cluster = new cluster_t(my_device, 1, 1);
+        cluster->get_devices().put(my_device);
+        cluster->get_devices().put(peer_device);
+        devices_view = std::make_shared<devices_view_t>();
+        devices_view->update(*cluster);
+
+        auto bep_config = config::bep_config_t();
+        bep_config.rx_buff_size = 1024;
+        bep_config.rx_timeout = bep_config.tx_timeout = 60000;
+        bep_config.tx_control_quantum = 64 * 1024;
+        bep_config.tx_index_quantum = 256 * 1024;
+        bep_config.tx_request_quantum = 64 * 1024;
+        bep_config.tx_response_quantum = 1024 * 1024;
+
+        stream = new mock_stream_t(*sup);
+        act = sup->create_actor<peer_actor_t>()
+                  .timeout(timeout)
+                  .devices_view(devices_view)
+                  .coordinator(sup->get_address())
+                  .bep_config(bep_config)
+                  .transport(stream)
+                  .peer_device_id(peer_device->device_id())
+                  .device_name("peer-device")
+                  .peer_proto("tcp")
+                  .finish();
+        sup->do_process();
+        CHECK(act->access<to::state>() == r::state_t::OPERATIONAL);
+
+        /* hello is being written */
+        REQUIRE(stream->writes.size() == 1);
+        main();
+
+        sup->do_shutdown();
+        sup->do_process();
+        while (!stream->writes.empty()) {
+            stream->complete();
+        }
+        io_ctx.run();
+        CHECK(sup->get_state() == r::state_t::SHUT_DOWN);
+    }
+
+    virtual void main() noexcept {}
+
+    void transfer(fmt::memory_buffer &&buff, tx_class_t tx_class, std::string_view tail = {},
+                  r::message_ptr_t tail_owner = {}) noexcept {
+        sup->send<net::payload::transfer_data_t>(act->get_address(), std::move(buff), tx_class, tail,
+                                            std::move(tail_owner));
+        sup->do_process();
+    }
+
+    cluster_ptr_t cluster;
+    devices_view_ptr_t devices_view;
+    model::device_ptr_t peer_device;
+    supervisor_ptr_t sup;
+    actor_ptr_t act;
+    mock_stream_ptr_t stream;
+    asio::io_context io_ctx;
+    ra::system_context_asio_t ctx;
+    utils::logger_t log;
+};
+
 void test_shutdown_on_hello_timeout() {
     struct F : fixture_t {
         void main() noexcept override { auto act = create_actor(); }
@@ -204,8 +377,164 @@ void test_shutdown_on_hello_timeout() {
     F().run();
 }
 
+void test_response_tail_lifetime() {
+    struct F : mock_fixture_t {
+        void main() noexcept override {
+            /* big enough to be written directly from the owner memory */
+            auto owner = r::make_message<blob_t>(sup->get_address(), std::string(64 * 1024, 'x'));
+            auto tail = std::string_view(owner->payload.data);
+            fmt::memory_buffer head;
+            proto::serialize_response_head(head, proto::response_view_t{5, tail});
+            transfer(std::move(head), tx_class_t::response, tail, owner);
+
+            stream->complete(); /* hello */
+            REQUIRE(stream->writes.size() == 1);
+            CHECK(owner->use_count() > 1);
+
+            auto sent = stream->complete();
+            CHECK(owner->use_count() == 1);
+            auto frames = parse_frames(sent);
+            REQUIRE(frames.size() == 1);
+            auto &res = std::get<proto::message::Response>(frames.front());
+            CHECK(res->id() == 5);
+            CHECK(res->data() == tail);
+        }
+    };
+    F().run();
+}
+
+void test_queued_frames_batching() {
+    struct F : mock_fixture_t {
+        void main() noexcept override {
+            SECTION("queued frames are written at once") {
+                for (std::int32_t id = 1; id <= 3; ++id) {
+                    fmt::memory_buffer buff;
+                    proto::serialize_request(buff, proto::request_view_t{id, "folder", "file", 0, 5, "hash"});
+                    transfer(std::move(buff), tx_class_t::request);
+                }
+                CHECK(stream->writes.size() == 1);
+                stream->complete(); /* hello */
+
+                REQUIRE(stream->writes.size() == 1);
+                auto frames = parse_frames(stream->complete());
+                REQUIRE(frames.size() == 3);
+                for (std::int32_t id = 1; id <= 3; ++id) {
+                    auto &req = std::get<proto::message::Request>(frames[id - 1]);
+                    CHECK(req->id() == id);
+                    CHECK(req->name() == "file");
+                }
+                CHECK(stream->writes.empty());
+            }
+
+            SECTION("too many frames are split into several writes, frames are not split") {
+                auto tail_sz = constants::tx_batch_max_size * 2 / 5;
+                auto owner = r::make_message<blob_t>(sup->get_address(), std::string(tail_sz, 'y'));
+                auto tail = std::string_view(owner->payload.data);
+                for (std::int32_t id = 1; id <= 3; ++id) {
+                    fmt::memory_buffer head;
+                    proto::serialize_response_head(head, proto::response_view_t{id, tail});
+                    transfer(std::move(head), tx_class_t::response, tail, owner);
+                }
+                stream->complete(); /* hello */
+
+                REQUIRE(stream->writes.size() == 1);
+                auto sent_1 = stream->complete();
+                CHECK(sent_1.size() <= constants::tx_batch_max_size);
+                auto frames_1 = parse_frames(sent_1);
+                REQUIRE(frames_1.size() == 2);
+                CHECK(std::get<proto::message::Response>(frames_1[0])->id() == 1);
+                CHECK(std::get<proto::message::Response>(frames_1[1])->id() == 2);
+
+                REQUIRE(stream->writes.size() == 1);
+                auto frames_2 = parse_frames(stream->complete());
+                REQUIRE(frames_2.size() == 1);
+                auto &res = std::get<proto::message::Response>(frames_2[0]);
+                CHECK(res->id() == 3);
+                CHECK(res->data() == tail);
+                CHECK(owner->use_count() == 1);
+            }
+        }
+    };
+    F().run();
+}
+
+void test_tx_classes_priority() {
+    struct F : mock_fixture_t {
+        void main() noexcept override {
+            auto tail_sz = constants::tx_batch_max_size * 2 / 5;
+            owner = r::make_message<blob_t>(sup->get_address(), std::string(tail_sz, 'z'));
+
+            SECTION("request and control frames go ahead of queued responses") {
+                push_response(1);
+                push_response(2);
+                push_request(3);
+                push_ping();
+                stream->complete(); /* hello */
+
+                REQUIRE(stream->writes.size() == 1);
+                auto frames = parse_frames(stream->complete());
+                REQUIRE(frames.size() == 4);
+                CHECK(std::holds_alternative<proto::message::Ping>(frames[0]));
+                CHECK(std::get<proto::message::Request>(frames[1])->id() == 3);
+                CHECK(std::get<proto::message::Response>(frames[2])->id() == 1);
+                CHECK(std::get<proto::message::Response>(frames[3])->id() == 2);
+            }
+
+            SECTION("request overtakes responses, which are left for the next write") {
+                push_response(1);
+                push_response(2);
+                push_response(3);
+                stream->complete(); /* hello */
+                REQUIRE(stream->writes.size() == 1);
+
+                /* responses 1 & 2 are being written, 3 is queued */
+                push_request(4);
+                push_ping();
+                auto frames_1 = parse_frames(stream->complete());
+                REQUIRE(frames_1.size() == 2);
+                CHECK(std::get<proto::message::Response>(frames_1[0])->id() == 1);
+                CHECK(std::get<proto::message::Response>(frames_1[1])->id() == 2);
+
+                REQUIRE(stream->writes.size() == 1);
+                auto frames_2 = parse_frames(stream->complete());
+                REQUIRE(frames_2.size() == 3);
+                CHECK(std::holds_alternative<proto::message::Ping>(frames_2[0]));
+                CHECK(std::get<proto::message::Request>(frames_2[1])->id() == 4);
+                CHECK(std::get<proto::message::Response>(frames_2[2])->id() == 3);
+            }
+            owner.reset();
+        }
+
+        void push_response(std::int32_t id) noexcept {
+            auto tail = std::string_view(owner->payload.data);
+            fmt::memory_buffer head;
+            proto::serialize_response_head(head, proto::response_view_t{id, tail});
+            transfer(std::move(head), tx_class_t::response, tail, owner);
+        }
+
+        void push_request(std::int32_t id) noexcept {
+            fmt::memory_buffer buff;
+            proto::serialize_request(buff, proto::request_view_t{id, "folder", "file", 0, 5, "hash"});
+            transfer(std::move(buff), tx_class_t::request);
+        }
+
+        void push_ping() noexcept {
+            fmt::memory_buffer buff;
+            proto::Ping ping;
+            proto::serialize(buff, ping);
+            transfer(std::move(buff), tx_class_t::control);
+        }
+
+        r::intrusive_ptr_t<r::message_t<blob_t>> owner;
+    };
+    F().run();
+}
+
 int _init() {
     REGISTER_TEST_CASE(test_shutdown_on_hello_timeout, "test_shutdown_on_hello_timeout", "[peer]");
+    REGISTER_TEST_CASE(test_response_tail_lifetime, "test_response_tail_lifetime", "[peer]");
+    REGISTER_TEST_CASE(test_queued_frames_batching, "test_queued_frames_batching", "[peer]");
+    REGISTER_TEST_CASE(test_tx_classes_priority, "test_tx_classes_priority", "[peer]");
     return 1;
 }
 
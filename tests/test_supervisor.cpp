@@ -40,6 +40,7 @@ void supervisor_t::configure(r::plugin::plugin_base_t &plugin) noexcept {
         p.subscribe_actor(&supervisor_t::on_model_update);
         p.subscribe_actor(&supervisor_t::on_block_update);
         p.subscribe_actor(&supervisor_t::on_contact_update);
+        p.subscribe_actor(&supervisor_t::on_model_interest);
     });
     if (configure_callback) {
         configure_callback(plugin);
@@ -99,6 +100,10 @@ void supervisor_t::on_model_update(model::message::model_update_t &msg) noexcept
         LOG_ERROR(log, "{}, error visiting model: {}", identity, r.assume_error().message());
         do_shutdown(make_error(r.assume_error()));
     }
+
+    for (auto &addr : diff_router.route(*cluster, *diff, msg.payload.custom)) {
+        send<model::payload::model_update_t>(addr, diff, msg.payload.custom);
+    }
 }
 
 void supervisor_t::on_block_update(model::message::block_update_t &msg) noexcept {
@@ -109,6 +114,10 @@ void supervisor_t::on_block_update(model::message::block_update_t &msg) noexcept
         LOG_ERROR(log, "{}, error updating block: {}", identity, r.assume_error().message());
         do_shutdown(make_error(r.assume_error()));
     }
+
+    for (auto &addr : diff_router.route(*cluster, *diff, msg.payload.custom)) {
+        send<model::payload::block_update_t>(addr, diff, msg.payload.custom);
+    }
 }
 
 void supervisor_t::on_contact_update(model::message::contact_update_t &msg) noexcept {
@@ -121,8 +130,18 @@ void supervisor_t::on_contact_update(model::message::contact_update_t &msg) noex
     }
 }
 
+void supervisor_t::on_model_interest(model::message::model_interest_t &msg) noexcept {
+    auto &p = msg.payload;
+    if (p.subscribe) {
+        diff_router.add(p.subscriber, p.owner, p.peer_id, p.kinds);
+    } else {
+        diff_router.remove(p.subscriber);
+    }
+}
+
 auto supervisor_t::operator()(const model::diff::modify::finish_file_t &diff, void *custom) noexcept
     -> outcome::result<void> {
+    ++finish_requests;
     if (auto_finish) {
         auto folder = cluster->get_folders().by_id(diff.folder_id);
         auto file_info = folder->get_folder_infos().by_device(*cluster->get_device());
@@ -5,6 +5,7 @@
 
 #include "rotor/supervisor.h"
 #include "model/messages.h"
+#include "model/misc/diff_router.h"
 #include "utils/log.h"
 #include "syncspirit-test-export.h"
 
@@ -52,6 +53,7 @@ struct SYNCSPIRIT_TEST_API supervisor_t : r::supervisor_t, private model::diff::
     void on_model_update(model::message::model_update_t &) noexcept;
     void on_block_update(model::message::block_update_t &) noexcept;
     void on_contact_update(model::message::contact_update_t &) noexcept;
+    void on_model_interest(model::message::model_interest_t &) noexcept;
     void do_start_timer(const r::pt::time_duration &interval, r::timer_handler_base_t &handler) noexcept override;
     void do_invoke_timer(r::request_id_t timer_id) noexcept;
     void do_cancel_timer(r::request_id_t timer_id) noexcept override;
@@ -60,8 +62,10 @@ struct SYNCSPIRIT_TEST_API supervisor_t : r::supervisor_t, private model::diff::
 
     utils::logger_t log;
     model::cluster_ptr_t cluster;
+    model::diff_router_t diff_router;
     configure_callback_t configure_callback;
     timers_t timers;
+    std::size_t finish_requests = 0;
     bool auto_finish;
 };
 